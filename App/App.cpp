@@ -3,12 +3,14 @@
 #include "Windows/SettingsWindow.h"
 #include "Windows/CompositePackagePicker.h"
 #include "Windows/BulkImportWindow.h"
+#include "Misc/BatchRunner.h"
 
 #include <wx/mimetype.h>
 #include <wx/cmdline.h>
 #include <wx/stdpaths.h>
 #include <wx/fileconf.h>
 #include <wx/mstream.h>
+#include <wx/textcompleter.h>
 
 #include <Utils/ALog.h>
 #include <Tera/FPackage.h>
@@ -16,8 +18,17 @@
 
 const char* APP_NAME = "Real Editor";
 
+// Max number of suggestions in a composite name popup
+constexpr uint32 MaxCompositeCompletions = 50;
+
 wxIMPLEMENT_APP(App);
 
+const std::vector<FString>& App::GetClassPackageNames()
+{
+  static const std::vector<FString> names = { "Core.u", "Engine.u", "GameFramework.u", "S1Game.u", "GFxUI.u", "WinDrv.u", "IpDrv.u", "OnlineSubsystemPC.u", "UnrealEd.u", "GFxUIEditor.u" };
+  return names;
+}
+
 wxDEFINE_EVENT(DELAY_LOAD, wxCommandEvent);
 wxDEFINE_EVENT(OPEN_PACKAGE, wxCommandEvent);
 wxDEFINE_EVENT(LOAD_CORE_ERROR, wxCommandEvent);
@@ -485,8 +496,18 @@ bool App::OnInit()
   SetAppName(APP_NAME);
   SetAppDisplayName(APP_NAME);
 
+  // The command line is parsed by wxApp::OnInit. Batch mode must be known before any window is shown.
+  for (int idx = 1; idx < argc; ++idx)
+  {
+    if (argv[idx].StartsWith(wxT("--batch")) || argv[idx] == wxT("--serve") || argv[idx] == wxT("--shutdown"))
+    {
+      Headless = true;
+      break;
+    }
+  }
+
   // Update executable path if MIME is registered
-  if (CheckMimeTypes())
+  if (!Headless && CheckMimeTypes())
   {
     wxCommandEvent tmp;
     OnRegisterMime(tmp);
@@ -497,6 +518,13 @@ bool App::OnInit()
   {
     Config = cfg.GetConfig();
   }
+  if (Headless)
+  {
+    ALog::SharedLog();
+    ALog::SetConfig(Config.LogConfig);
+    IsReady = true;
+    return wxApp::OnInit();
+  }
   if (Config.RootDir.Empty())
   {
     FAppConfig newConfig;
@@ -524,6 +552,10 @@ bool App::OnInit()
 
 int App::OnRun()
 {
+  if (IsReady && Headless)
+  {
+    return BatchServe ? RunJobServer() : RunBatch();
+  }
   if (IsReady)
   {
     wxInitAllImageHandlers();
@@ -572,9 +604,8 @@ void App::LoadCore(ProgressWindow* pWindow)
     }
   }
 
-  const std::vector<FString> classPackageNames = { "Core.u", "Engine.u", "GameFramework.u", "S1Game.u", "GFxUI.u", "WinDrv.u", "IpDrv.u", "OnlineSubsystemPC.u", "UnrealEd.u", "GFxUIEditor.u" };
   PERF_START(ClassPackagesLoad);
-  for (const FString& name : classPackageNames)
+  for (const FString& name : GetClassPackageNames())
   {
     wxString desc = wxS("Loading ");
     desc += name.String() + "...";
@@ -678,12 +709,9 @@ void App::LoadCore(ProgressWindow* pWindow)
       return;
     }
 
-    const auto& compositeMap = FPackage::GetCompositePackageMap();
-    CompositePackageNames.reserve(compositeMap.size());
-    for (const auto& pair : compositeMap)
-    {
-      CompositePackageNames.push_back(pair.first.String());
-    }
+    PERF_START(CompositeNameIndex);
+    BuildCompositeNameIndex();
+    PERF_END(CompositeNameIndex);
 
     if (pWindow->IsCanceled())
     {
@@ -700,6 +728,152 @@ void App::LoadCore(ProgressWindow* pWindow)
   pWindow->Destroy();
 }
 
+void AttachParentConsole()
+{
+  // The app uses the GUI subsystem and has no console of its own. Write to the parent's console if there is one.
+  if (AttachConsole(ATTACH_PARENT_PROCESS))
+  {
+    FILE* tmp = nullptr;
+    freopen_s(&tmp, "CONOUT$", "w", stdout);
+    freopen_s(&tmp, "CONOUT$", "w", stderr);
+  }
+}
+
+int App::RunBatch()
+{
+  AttachParentConsole();
+
+  FILE* report = stdout;
+  if (BatchReportPath.size() && !(report = _wfopen(BatchReportPath.wc_str(), L"w")))
+  {
+    fprintf(stderr, "Failed to open the report file %s\n", BatchReportPath.ToStdString().c_str());
+    return 2;
+  }
+  auto emit = [report](const wxString& line) {
+    fputs(line.utf8_str(), report);
+    fputc('\n', report);
+    fflush(report);
+  };
+  auto finish = [report](int code) {
+    if (report != stdout)
+    {
+      fclose(report);
+    }
+    return code;
+  };
+
+  std::vector<BatchJob> jobs;
+  wxString error;
+  if (!BatchRunner::ParseJobFile(BatchPath, jobs, error))
+  {
+    emit(BatchRunner::ErrorToJson(error));
+    return finish(2);
+  }
+
+  auto start = std::chrono::steady_clock::now();
+  int32 failed = 0;
+  auto emitSummary = [&](int32 workers) {
+    const long long elapsed = (long long)std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+    emit(wxString::Format(wxT("{\"summary\":true,\"jobs\":%d,\"failed\":%d,\"workers\":%d,\"ms\":%lld}"), (int)jobs.size(), failed, workers, elapsed));
+  };
+
+  if (BatchRemote)
+  {
+    // Run on a warm job server if there is one
+    int32 reported = 0;
+    const bool ok = RpcClient::RunJobs(jobs, [&](bool jobOk, const wxString& line) {
+      emit(line);
+      reported++;
+      if (!jobOk)
+      {
+        failed++;
+      }
+    });
+    if (ok)
+    {
+      emitSummary(0);
+      return finish(failed ? 1 : 0);
+    }
+    if (reported)
+    {
+      emit(BatchRunner::ErrorToJson(wxT("Lost connection to the job server")));
+      return finish(2);
+    }
+    LogW("Job server is not running. Running jobs locally.");
+  }
+
+  const FString rootDir = BatchRootDir.size() ? FString(BatchRootDir.ToStdWstring()) : Config.RootDir;
+  if (rootDir.Empty())
+  {
+    emit(BatchRunner::ErrorToJson(wxT("S1Game folder is not set. Use --root or run the editor once to configure it.")));
+    return finish(2);
+  }
+
+  std::vector<std::pair<wxString, int64>> timings;
+  const bool loaded = BatchRunner::LoadCore(rootDir, timings, error);
+  for (const auto& stage : timings)
+  {
+    emit(BatchRunner::StageToJson(stage.first, stage.second));
+  }
+  if (!loaded)
+  {
+    emit(BatchRunner::ErrorToJson(error));
+    return finish(2);
+  }
+
+  const int32 workers = GetBatchWorkers();
+  BatchRunner::RunJobs(jobs, workers, [&](const BatchJobResult& result) {
+    emit(BatchRunner::ToJson(result));
+    if (!result.Ok)
+    {
+      failed++;
+    }
+  });
+
+  emitSummary(workers);
+  return finish(failed ? 1 : 0);
+}
+
+int App::RunJobServer()
+{
+  AttachParentConsole();
+  const FString rootDir = BatchRootDir.size() ? FString(BatchRootDir.ToStdWstring()) : Config.RootDir;
+  if (rootDir.Empty())
+  {
+    fprintf(stderr, "S1Game folder is not set. Use --root or run the editor once to configure it.\n");
+    return 2;
+  }
+
+  std::vector<std::pair<wxString, int64>> timings;
+  wxString error;
+  const bool loaded = BatchRunner::LoadCore(rootDir, timings, error);
+  for (const auto& stage : timings)
+  {
+    LogI("Load %s: %lldms", stage.first.ToStdString().c_str(), (long long)stage.second);
+  }
+  if (!loaded)
+  {
+    fprintf(stderr, "Failed to load the core: %s\n", error.ToStdString().c_str());
+    return 2;
+  }
+
+  Server = new RpcServer;
+  if (!Server->RunJobServer(this, GetBatchWorkers()))
+  {
+    fprintf(stderr, "Failed to start the job server. Is it running already?\n");
+    return 2;
+  }
+  fprintf(stdout, "Job server is ready\n");
+  fflush(stdout);
+  // Keep the core warm until a client sends "shutdown"
+  return wxApp::OnRun();
+}
+
+int32 App::GetBatchWorkers() const
+{
+  return BatchWorkers > 0 ? (int32)BatchWorkers : (int32)std::max<unsigned>(1, std::thread::hardware_concurrency());
+}
+
 void App::DelayLoad(wxCommandEvent&)
 {
   bool anyLoaded = false;
@@ -732,7 +906,11 @@ void App::DelayLoad(wxCommandEvent&)
 
 int App::OnExit()
 {
-  FPackage::UnloadDefaultClassPackages();
+  // Running jobs still use the class packages
+  if (!Server || Server->StopJobs())
+  {
+    FPackage::UnloadDefaultClassPackages();
+  }
   ALog::GetConfig(Config.LogConfig);
   AConfiguration cfg = AConfiguration(W2A(GetConfigPath().ToStdWstring()));
   cfg.SetConfig(Config);
@@ -746,6 +924,13 @@ void App::OnInitCmdLine(wxCmdLineParser& parser)
   static const wxCmdLineEntryDesc cmdLineDesc[] =
   {
     { wxCMD_LINE_PARAM,  NULL, NULL, "Package path", wxCMD_LINE_VAL_STRING, wxCMD_LINE_PARAM_OPTIONAL | wxCMD_LINE_PARAM_MULTIPLE },
+    { wxCMD_LINE_OPTION, NULL, "batch", "Run jobs from the file without UI and exit", wxCMD_LINE_VAL_STRING },
+    { wxCMD_LINE_OPTION, NULL, "workers", "Number of batch workers", wxCMD_LINE_VAL_NUMBER },
+    { wxCMD_LINE_OPTION, NULL, "report", "Write the batch report to the file instead of stdout", wxCMD_LINE_VAL_STRING },
+    { wxCMD_LINE_OPTION, NULL, "root", "S1Game folder for the batch mode", wxCMD_LINE_VAL_STRING },
+    { wxCMD_LINE_SWITCH, NULL, "remote", "Send batch jobs to a running job server", wxCMD_LINE_VAL_NONE },
+    { wxCMD_LINE_SWITCH, NULL, "serve", "Keep the core loaded and serve jobs until shutdown", wxCMD_LINE_VAL_NONE },
+    { wxCMD_LINE_SWITCH, NULL, "shutdown", "Stop the running job server", wxCMD_LINE_VAL_NONE },
     { wxCMD_LINE_NONE }
   };
   parser.SetDesc(cmdLineDesc);
@@ -769,6 +954,21 @@ void App::OnLoadError(wxCommandEvent& e)
 
 bool App::OnCmdLineParsed(wxCmdLineParser& parser)
 {
+  if (Headless)
+  {
+    parser.Found(wxT("batch"), &BatchPath);
+    parser.Found(wxT("workers"), &BatchWorkers);
+    parser.Found(wxT("report"), &BatchReportPath);
+    parser.Found(wxT("root"), &BatchRootDir);
+    if (parser.Found(wxT("shutdown")))
+    {
+      RpcClient::StopJobServer();
+      return false;
+    }
+    BatchRemote = parser.Found(wxT("remote"));
+    BatchServe = parser.Found(wxT("serve"));
+    return BatchPath.size() || BatchServe;
+  }
   int paramsCount = parser.GetParamCount();
   if (InstanceChecker && InstanceChecker->IsAnotherRunning())
   {
@@ -836,9 +1036,46 @@ void App::OnUnregisterMime(wxCommandEvent&)
   UnregisterFileType(".umap", man);
 }
 
-const wxArrayString& App::GetCompositePackageNames() const
+void App::BuildCompositeNameIndex()
+{
+  const auto& compositeMap = FPackage::GetCompositePackageMap();
+  std::vector<std::string> names;
+  names.reserve(compositeMap.size());
+  for (const auto& pair : compositeMap)
+  {
+    names.push_back(pair.first.String());
+  }
+  CompositeNameIndex.Build(names);
+}
+
+bool App::IsCompositePackageName(const wxString& name) const
+{
+  return CompositeNameIndex.Find(name.ToStdString()) != INDEX_NONE;
+}
+
+class CompositeNameCompleter : public wxTextCompleterSimple {
+public:
+  CompositeNameCompleter(const NameIndex& index)
+    : Index(index)
+  {}
+
+  void GetCompletions(const wxString& prefix, wxArrayString& res) override
+  {
+    std::vector<uint32> matches = Index.Complete(prefix.ToStdString(), MaxCompositeCompletions);
+    res.reserve(matches.size());
+    for (uint32 idx : matches)
+    {
+      res.push_back(Index.GetName(idx));
+    }
+  }
+
+private:
+  const NameIndex& Index;
+};
+
+wxTextCompleter* App::CreateCompositeNameCompleter() const
 {
-  return CompositePackageNames;
+  return new CompositeNameCompleter(CompositeNameIndex);
 }
 
 bool App::CheckMimeTypes() const
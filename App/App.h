@@ -9,16 +9,27 @@
 #include "Windows/PackageWindow.h"
 
 #include <Tera/Core.h>
+#include <Tera/FStructs.h>
 #include <Utils/AConfiguration.h>
+#include <Utils/NameIndex.h>
 
 class wxEventHandler;
+// Events sent to a null handler are dropped. Allows headless callers to skip progress reporting.
 inline void SendEvent(wxEvtHandler* obj, wxEventType type)
 {
+  if (!obj)
+  {
+    return;
+  }
   wxQueueEvent(obj, new wxCommandEvent(type));
 }
 
 inline void SendEvent(wxEvtHandler* obj, wxEventType type, const wxString& msg)
 {
+  if (!obj)
+  {
+    return;
+  }
   wxCommandEvent* e = new wxCommandEvent(type);
   e->SetString(msg);
   wxQueueEvent(obj, e);
@@ -26,6 +37,10 @@ inline void SendEvent(wxEvtHandler* obj, wxEventType type, const wxString& msg)
 
 inline void SendEvent(wxEvtHandler* obj, wxEventType type, int32 number)
 {
+  if (!obj)
+  {
+    return;
+  }
   wxCommandEvent* e = new wxCommandEvent(type);
   e->SetInt(number);
   wxQueueEvent(obj, e);
@@ -33,12 +48,19 @@ inline void SendEvent(wxEvtHandler* obj, wxEventType type, int32 number)
 
 inline void SendEvent(wxEvtHandler* obj, wxEventType type, const wxString& msg, int32 value)
 {
+  if (!obj)
+  {
+    return;
+  }
   wxCommandEvent* e = new wxCommandEvent(type);
   e->SetString(msg);
   e->SetInt(value);
   wxQueueEvent(obj, e);
 }
 
+// Parse localization meta data file
+void LoadMeta(const wxString& source, std::unordered_map<FString, std::unordered_map<FString, AMetaDataEntry>>& output);
+
 wxDECLARE_EVENT(DELAY_LOAD, wxCommandEvent);
 wxDECLARE_EVENT(OPEN_PACKAGE, wxCommandEvent);
 wxDECLARE_EVENT(LOAD_CORE_ERROR, wxCommandEvent);
@@ -50,6 +72,9 @@ class ProgressWindow;
 class BulkImportWindow;
 class App : public wxApp {
 public:
+  // Class packages loaded by LoadCore in this order
+  static const std::vector<FString>& GetClassPackageNames();
+
   static App* GetSharedApp()
   {
     return (App*)wxTheApp;
@@ -87,7 +112,20 @@ public:
 
   void OnFatalException() override;
 
-  const wxArrayString& GetCompositePackageNames() const;
+  // Index the names of the loaded composite package map. Called by LoadCore and BatchRunner::LoadCore
+  void BuildCompositeNameIndex();
+
+  // Case-insensitive index of composite package names. Built by LoadCore
+  const NameIndex& GetCompositeNameIndex() const
+  {
+    return CompositeNameIndex;
+  }
+
+  // Check if a composite package with the name exists. Case-insensitive
+  bool IsCompositePackageName(const wxString& name) const;
+
+  // Create a ranked auto-completer for composite package names. The text entry takes the ownership
+  wxTextCompleter* CreateCompositeNameCompleter() const;
 
   bool CheckMimeTypes() const;
 
@@ -111,6 +149,11 @@ private:
   void LoadCore(ProgressWindow*);
   // Create windows for loaded packages
   void DelayLoad(wxCommandEvent&);
+  // Run the --batch job file without UI. Returns the process exit code.
+  int RunBatch();
+  // Load the core and serve jobs of other processes without UI
+  int RunJobServer();
+  int32 GetBatchWorkers() const;
 
   wxDECLARE_EVENT_TABLE();
 private:
@@ -120,10 +163,17 @@ private:
   RpcServer* Server = nullptr;
   bool IsReady = false;
   bool ShowedStartupCfg = false;
+  bool Headless = false;
+  wxString BatchPath;
+  wxString BatchReportPath;
+  wxString BatchRootDir;
+  long BatchWorkers = 0;
+  bool BatchRemote = false;
+  bool BatchServe = false;
   std::vector<PackageWindow*> PackageWindows;
   std::vector<wxString> OpenList;
 
-  wxArrayString CompositePackageNames;
+  NameIndex CompositeNameIndex;
 
   bool NeedsRestart = false;
 };
@@ -90,29 +90,9 @@ GenericEditor::GenericEditor(wxPanel* parent, PackageWindow* window)
 
 void GenericEditor::LoadObject()
 {
-  if (IsLoading())
-  {
-    return;
-  }
-  std::string id = GetEditorId();
-  if (!Object->IsLoaded())
-  {
-    Loading = true;
-    UObject* obj = Object;
-    std::weak_ptr<FPackage> wpackage = Window->GetPackage();
-    std::thread([obj, id, wpackage] {
-      if (auto l = wpackage.lock())
-      {
-        obj->Load();
-        SendEvent(wxTheApp, OBJECT_LOADED, id);
-      }
-    }).detach();
-    // TODO: some UI progress?
-  }
-  else
-  {
-    SendEvent(wxTheApp, OBJECT_LOADED, id);
-  }
+  // Requested even if a load is pending: a later selection may have dropped it
+  Loading = !Object->IsLoaded();
+  Window->GetLoadQueue().Select(Object, GetEditorId());
 }
 
 void GenericEditor::OnObjectLoaded()
@@ -120,6 +100,11 @@ void GenericEditor::OnObjectLoaded()
   Loading = false;
 }
 
+bool GenericEditor::HasPendingLoad() const
+{
+  return Loading && Window->GetLoadQueue().IsPending(Object);
+}
+
 std::string GenericEditor::GetEditorId() const
 {
   return std::to_string((uint64)std::addressof(*this)) + "." + std::to_string((uint64)std::addressof(Object));
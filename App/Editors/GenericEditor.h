@@ -40,12 +40,23 @@ public:
     return Loading;
   }
 
+  // True while a load the editor waits for is queued or running. A load dropped by a later selection is not pending,
+  // so its editor may be destroyed.
+  virtual bool HasPendingLoad() const;
+
   virtual void SetNeedsUpdate()
   {}
 
   virtual void OnTick()
   {}
 
+  // Approximate size of decoded data the editor holds. Hidden editors are destroyed to stay within a budget.
+  // Only data owned by the editor counts: loaded objects stay loaded after the editor is destroyed.
+  virtual size_t GetMemoryFootprint() const
+  {
+    return 0;
+  }
+
   virtual std::vector<FPropertyTag*> GetObjectProperties();
 
   virtual void PopulateToolBar(wxToolBar* toolbar);
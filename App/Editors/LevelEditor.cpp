@@ -2,11 +2,12 @@
 #include "../App.h"
 #include "../Windows/PackageWindow.h"
 #include "../Windows/ProgressWindow.h"
+#include "../Misc/RenderModelCache.h"
+#include "../Misc/SceneOctree.h"
 
 #include <osgViewer/ViewerEventHandlers>
 #include <osgGA/TrackballManipulator>
 #include <osgUtil/SmoothingVisitor>
-#include <osg/BlendFunc>
 #include <osg/Depth>
 #include <osg/PositionAttitudeTransform>
 
@@ -18,15 +19,65 @@
 #include <Tera/UMaterial.h>
 #include <Tera/UTexture.h>
 
+#include <Utils/ALog.h>
+
+#include <algorithm>
+
+wxDEFINE_EVENT(STREAMING_LEVEL_LOADED, wxCommandEvent);
+
+namespace
+{
+  UStaticMesh* GetActorMesh(UStaticMeshActor* actor)
+  {
+    UStaticMeshComponent* component = actor ? actor->StaticMeshComponent : nullptr;
+    if (!component)
+    {
+      return nullptr;
+    }
+    // TODO: not sure what should be replaced. The component or its model?
+    if (component->ReplacementPrimitive)
+    {
+      UStaticMeshComponent* replacement = Cast<UStaticMeshComponent>(component->ReplacementPrimitive);
+      if (replacement && replacement->StaticMesh)
+      {
+        return replacement->StaticMesh;
+      }
+    }
+    return component->StaticMesh;
+  }
+}
+
 LevelEditor::LevelEditor(wxPanel* parent, PackageWindow* window)
   : GenericEditor(parent, window)
 {
   CreateRenderer();
   window->FixOSG();
+  Streaming->Editor = this;
+  Bind(STREAMING_LEVEL_LOADED, &LevelEditor::OnStreamingLevelLoaded, this);
+  Canvas->Bind(wxEVT_LEFT_DCLICK, &LevelEditor::OnCanvasDoubleClick, this);
+}
+
+LevelEditor::~LevelEditor()
+{
+  // The loader may be in the middle of a sublevel load. It checks the state and quits after the load.
+  {
+    std::scoped_lock<std::mutex> lock(Streaming->Mutex);
+    Streaming->Editor = nullptr;
+  }
+  // Running builds stop at the next actor
+  StreamingBuilds.cancel();
+  StreamingBuilds.wait();
+  delete Renderer;
 }
 
 void LevelEditor::OnTick()
 {
+  if (Renderer && ModelGeneration != RenderModelCache::Get().GetGeneration())
+  {
+    // Workers have built new LODs. Draw them.
+    ModelGeneration = RenderModelCache::Get().GetGeneration();
+    Renderer->requestRedraw();
+  }
   if (Renderer && Renderer->isRealized() && Renderer->checkNeedToDoFrame())
   {
     Renderer->frame();
@@ -39,7 +90,7 @@ void LevelEditor::OnObjectLoaded()
   {
     LevelNodes.clear();
     Level = (ULevel*)Object;
-    Root = new osg::Geode;
+    Root = new osg::Group;
     Bind(wxEVT_IDLE, &LevelEditor::OnIdle, this);
   }
   GenericEditor::OnObjectLoaded();
@@ -105,7 +156,8 @@ void LevelEditor::CreateRenderer()
   manipulator->setAllowThrow(false);
   manipulator->setVerticalAxisFixed(true);
   Renderer->setCameraManipulator(manipulator);
-  Renderer->setThreadingModel(osgViewer::Viewer::AutomaticSelection);
+  // Models are shared with other viewers and updated on the UI thread
+  Renderer->setThreadingModel(osgViewer::Viewer::SingleThreaded);
 }
 
 void LevelEditor::LoadPersistentLevel()
@@ -122,35 +174,123 @@ void LevelEditor::LoadPersistentLevel()
   progress.Layout();
 
   std::thread([&] {
+    // Finer LODs are built on the PPL pool later. Their builds don't load objects.
+    for (UActor* actor : Level->GetActors())
+    {
+      RenderModelCache::LoadDependencies(GetActorMesh(Cast<UStaticMeshActor>(actor)));
+    }
     CreateLevel(Level, Root.get());
-    UObject* world = Level->GetOuter();
-    auto worldInner = world->GetInner();
+    SendEvent(&progress, UPDATE_PROGRESS_FINISH, true);
+  }).detach();
+
+  progress.ShowModal();
+
+  Renderer->getCamera()->setViewport(0, 0, GetSize().x, GetSize().y);
+  Renderer->setSceneData(Root.get());
+  LevelLoaded = true;
 
-    for (UObject* inner : worldInner)
+  std::vector<ULevelStreaming*> levels;
+  for (UObject* inner : Level->GetOuter()->GetInner())
+  {
+    if (ULevelStreaming* level = Cast<ULevelStreaming>(inner))
+    {
+      levels.push_back(level);
+    }
+  }
+  if (levels.size())
+  {
+    LoadStreamingLevels(levels);
+  }
+}
+
+void LevelEditor::LoadStreamingLevels(const std::vector<ULevelStreaming*>& levels)
+{
+  // Sublevels and their meshes are loaded in parallel by a few loader threads. UObject::Load waits for objects
+  // shared between sublevels. Loads block, so they stay off the PPL pool that builds the scene graphs.
+  // Each sublevel is shown as soon as its scene graph is ready.
+  std::weak_ptr<FPackage> wpackage = Window->GetPackage();
+  std::shared_ptr<StreamingState> state = Streaming;
+  std::thread([this, state, levels, wpackage] {
+    auto l = wpackage.lock();
+    if (!l)
     {
-      if (ULevelStreaming* level = Cast<ULevelStreaming>(inner))
+      return;
+    }
+    std::atomic<size_t> next(0);
+    auto loader = [&] {
+      for (size_t idx = next++; idx < levels.size(); idx = next++)
       {
+        {
+          std::scoped_lock<std::mutex> lock(state->Mutex);
+          if (!state->Editor)
+          {
+            return;
+          }
+        }
+        ULevelStreaming* level = levels[idx];
         level->Load();
-        if (level->Level)
+        if (!level->Level)
         {
-          osg::Geode* geode = new osg::Geode;
-          geode->setName(level->Level->GetPackage()->GetPackageName().C_str());
-          CreateLevel(level->Level, geode);
-          Root->addChild(geode);
+          continue;
         }
+        for (UActor* actor : level->Level->GetActors())
+        {
+          RenderModelCache::LoadDependencies(GetActorMesh(Cast<UStaticMeshActor>(actor)));
+        }
+
+        // The editor waits for builds it has seen. Don't start new ones once it is closing.
+        std::scoped_lock<std::mutex> lock(state->Mutex);
+        if (!state->Editor)
+        {
+          return;
+        }
+        StreamingBuilds.run([this, state, level] {
+          osg::ref_ptr<osg::Group> group = new osg::Group;
+          group->setName(level->Level->GetPackage()->GetPackageName().C_str());
+          CreateLevel(level->Level, group.get());
+          std::scoped_lock<std::mutex> lock(state->Mutex);
+          if (state->Editor && !concurrency::is_current_task_group_canceling())
+          {
+            state->Groups.push_back(group);
+            SendEvent(this, STREAMING_LEVEL_LOADED);
+          }
+        });
       }
+    };
+
+    std::vector<std::thread> loaders;
+    const size_t loaderCount = std::min<size_t>(std::clamp<size_t>(std::thread::hardware_concurrency() / 4, 2, 4), levels.size());
+    for (size_t idx = 1; idx < loaderCount; ++idx)
+    {
+      loaders.emplace_back(loader);
+    }
+    loader();
+    for (std::thread& t : loaders)
+    {
+      t.join();
     }
-    SendEvent(&progress, UPDATE_PROGRESS_FINISH, true);
   }).detach();
+}
 
-  progress.ShowModal();
-
-  Renderer->getCamera()->setViewport(0, 0, GetSize().x, GetSize().y);
-  Renderer->setSceneData(Root.get());
-  LevelLoaded = true;
+void LevelEditor::OnStreamingLevelLoaded(wxCommandEvent&)
+{
+  std::vector<osg::ref_ptr<osg::Group>> groups;
+  {
+    std::scoped_lock<std::mutex> lock(Streaming->Mutex);
+    groups.swap(Streaming->Groups);
+  }
+  // The scene graph is only modified on the UI thread, between frames
+  for (osg::ref_ptr<osg::Group>& group : groups)
+  {
+    Root->addChild(group.get());
+  }
+  if (groups.size())
+  {
+    Renderer->requestRedraw();
+  }
 }
 
-void LevelEditor::CreateLevel(ULevel* level, osg::Geode* root)
+void LevelEditor::CreateLevel(ULevel* level, osg::Group* root)
 {
   if (!level)
   {
@@ -168,28 +308,37 @@ void LevelEditor::CreateLevel(ULevel* level, osg::Geode* root)
   static const osg::Vec3d pitchAxis(-1.0, 0.0, 0.0);
   static const osg::Vec3d rollAxis(0.0, -1.0, 0.0);
 
+  std::vector<SceneOctree::Item> items;
+  items.reserve(actors.size());
+  std::vector<PickTarget> targets;
   for (UActor* actor : actors)
   {
+    if (concurrency::is_current_task_group_canceling())
+    {
+      // The editor is closing
+      return;
+    }
     if (!actor)
     {
       continue;
     }
 
-    osg::Geode* geode = nullptr;
+    osg::ref_ptr<osg::Node> node;
     FVector compTranslation;
     FRotator compRotation;
     FVector compScale3D;
     float compScale = 1.;
+    FBoxSphereBounds bounds;
     if (UStaticMeshActor* a = Cast<UStaticMeshActor>(actor))
     {
-      geode = CreateStaticActor(a, compTranslation, compScale3D, compRotation, compScale);
+      node = CreateStaticActor(a, compTranslation, compScale3D, compRotation, compScale, bounds);
     }
 
-    if (geode)
+    if (node)
     {
-      geode->setName(actor->GetObjectName().UTF8().c_str());
-      osg::PositionAttitudeTransform* transform = new osg::PositionAttitudeTransform;
-      transform->addChild(geode);
+      osg::ref_ptr<osg::PositionAttitudeTransform> transform = new osg::PositionAttitudeTransform;
+      transform->setName(actor->GetObjectName().UTF8().c_str());
+      transform->addChild(node.get());
       transform->setPosition(osg::Vec3(actor->Location.X + compTranslation.X,
         -(actor->Location.Y + compTranslation.Y),
         actor->Location.Z + compTranslation.Z));
@@ -206,9 +355,36 @@ void LevelEditor::CreateLevel(ULevel* level, osg::Geode* root)
         euler.Z * M_PI / 180., yawAxis
       );
       transform->setAttitude(quat);
-      root->addChild(transform);
+
+      // World bounds from the mesh bounds. Computing node bounds here would touch the shared model from several threads.
+      osg::Matrix localToWorld;
+      transform->computeLocalToWorldMatrix(localToWorld, nullptr);
+      const osg::Vec3 origin(bounds.Origin.X, -bounds.Origin.Y, bounds.Origin.Z);
+      const osg::Vec3 extent(bounds.BoxExtent.X, bounds.BoxExtent.Y, bounds.BoxExtent.Z);
+      SceneOctree::Item& item = items.emplace_back();
+      item.Node = transform;
+      for (int corner = 0; corner < 8; ++corner)
+      {
+        const osg::Vec3 offset((corner & 1) ? extent.x() : -extent.x(), (corner & 2) ? extent.y() : -extent.y(), (corner & 4) ? extent.z() : -extent.z());
+        item.Bounds.expandBy((origin + offset) * localToWorld);
+      }
+
+      if (MeshLodNode* lodNode = dynamic_cast<MeshLodNode*>(node.get()))
+      {
+        PickTarget& target = targets.emplace_back();
+        target.Actor = actor;
+        target.Mesh = (UStaticMesh*)lodNode->GetMesh();
+        target.WorldToLocal = osg::Matrix::inverse(localToWorld);
+        target.Bounds = item.Bounds;
+      }
     }
   }
+
+  // Nested groups let the viewer cull whole regions of the level at once
+  root->addChild(SceneOctree::Build(items).get());
+
+  std::scoped_lock<std::mutex> lock(PickTargetsMutex);
+  PickTargets.insert(PickTargets.end(), targets.begin(), targets.end());
 }
 
 void LevelEditor::OnIdle(wxIdleEvent& e)
@@ -216,103 +392,138 @@ void LevelEditor::OnIdle(wxIdleEvent& e)
   Unbind(wxEVT_IDLE, &LevelEditor::OnIdle, this);
 }
 
-osg::Geode* LevelEditor::CreateStaticActor(UStaticMeshActor* actor, FVector& translation, FVector& scale3d, FRotator& rotation, float& scale)
+void LevelEditor::OnCanvasDoubleClick(wxMouseEvent& e)
+{
+  e.Skip();
+  UActor* actor = LevelLoaded ? PickActor(e.GetPosition()) : nullptr;
+  if (!actor)
+  {
+    return;
+  }
+  if (actor->GetPackage() == Window->GetPackage().get())
+  {
+    Window->SelectObject(actor);
+  }
+  else
+  {
+    LogI("Picked %s from %s", actor->GetObjectName().UTF8().c_str(), actor->GetPackage()->GetPackageName().C_str());
+  }
+}
+
+UActor* LevelEditor::PickActor(const wxPoint& point)
 {
-  if (!actor->StaticMeshComponent)
+  osg::Camera* camera = Renderer->getCamera();
+  if (!camera->getViewport())
   {
     return nullptr;
   }
-  UStaticMeshComponent* component = actor->StaticMeshComponent;
-  UStaticMesh* mesh = nullptr;
+  // Canvas to scene. Window coordinates start at the bottom.
+  const osg::Matrix windowToWorld = osg::Matrix::inverse(camera->getViewMatrix() * camera->getProjectionMatrix() * camera->getViewport()->computeWindowMatrix());
+  const double x = point.x;
+  const double y = camera->getViewport()->height() - point.y;
+  const osg::Vec3d start = osg::Vec3d(x, y, 0.) * windowToWorld;
+  const osg::Vec3d end = osg::Vec3d(x, y, 1.) * windowToWorld;
+  const osg::Vec3d direction = end - start;
+
+  std::vector<PickTarget> targets;
+  {
+    std::scoped_lock<std::mutex> lock(PickTargetsMutex);
+    targets = PickTargets;
+  }
 
-  // TODO: not sure what should be replaced. The component or its model?
-  if (component->ReplacementPrimitive)
+  // Hit times are fractions of the same segment in every actor space, so they compare directly
+  UActor* result = nullptr;
+  float closest = 1.f;
+  for (const PickTarget& target : targets)
   {
-    UStaticMeshComponent* replacement = Cast<UStaticMeshComponent>(component->ReplacementPrimitive);
-    if (replacement && replacement->StaticMesh)
+    // Cheap rejection by the world bounds
+    double entry = 0.;
+    double exit = closest;
+    bool miss = false;
+    for (int axis = 0; axis < 3 && !miss; ++axis)
     {
-      mesh = replacement->StaticMesh;
+      if (std::abs(direction[axis]) < 1e-12)
+      {
+        miss = start[axis] < target.Bounds._min[axis] || start[axis] > target.Bounds._max[axis];
+        continue;
+      }
+      double t1 = (target.Bounds._min[axis] - start[axis]) / direction[axis];
+      double t2 = (target.Bounds._max[axis] - start[axis]) / direction[axis];
+      entry = std::max(entry, std::min(t1, t2));
+      exit = std::min(exit, std::max(t1, t2));
+      miss = entry > exit;
     }
-    else
+    if (miss)
     {
-      mesh = component->StaticMesh;
+      continue;
+    }
+
+    std::unique_ptr<MeshCollision>& collision = Collisions[target.Mesh];
+    if (!collision)
+    {
+      collision = std::make_unique<MeshCollision>(target.Mesh);
+    }
+    const osg::Vec3d localStart = start * target.WorldToLocal;
+    const osg::Vec3d localEnd = end * target.WorldToLocal;
+    MeshCollisionHit hit;
+    if (collision->RayCast(FVector((float)localStart.x(), (float)-localStart.y(), (float)localStart.z()), FVector((float)localEnd.x(), (float)-localEnd.y(), (float)localEnd.z()), hit) && hit.Time < closest)
+    {
+      closest = hit.Time;
+      result = target.Actor;
     }
   }
-  else
-  {
-    mesh = component->StaticMesh;
-  }
+  return result;
+}
 
+osg::ref_ptr<osg::Node> LevelEditor::CreateStaticActor(UStaticMeshActor* actor, FVector& translation, FVector& scale3d, FRotator& rotation, float& scale, FBoxSphereBounds& bounds)
+{
+  UStaticMesh* mesh = GetActorMesh(actor);
   if (!mesh)
   {
     return nullptr;
   }
+  UStaticMeshComponent* component = actor->StaticMeshComponent;
 
   translation = component->Translation;
   scale3d = component->Scale3D;
   rotation = component->Rotation;
   scale = component->Scale;
 
-  const FStaticMeshRenderData* model = mesh->GetLod(0);
-
-  osg::ref_ptr<osg::Vec3Array> vertices = new osg::Vec3Array;
-  osg::ref_ptr<osg::Vec3Array> normals = new osg::Vec3Array(osg::Array::BIND_PER_VERTEX);
-  osg::ref_ptr<osg::Vec2Array> uvs = new osg::Vec2Array(osg::Array::BIND_PER_VERTEX);
-
-  std::vector<FStaticVertex> uvertices = model->GetVertices();
-  for (auto & uvertex : uvertices)
-  {
-    FVector normal = uvertex.TangentZ;
-    normals->push_back(osg::Vec3(normal.X, -normal.Y, normal.Z));
-    vertices->push_back(osg::Vec3(uvertex.Position.X, -uvertex.Position.Y, uvertex.Position.Z));
-    uvs->push_back(osg::Vec2(uvertex.UVs[0].X, uvertex.UVs[0].Y));
-  }
+  bounds = mesh->GetBounds();
 
-  osg::Geode* result = new osg::Geode;
-  std::vector<FStaticMeshElement> elements = model->GetElements();
-  const FRawIndexBuffer& indexContainer = model->IndexBuffer;
-  for (const FStaticMeshElement& section : elements)
+  // All actors of the mesh share one LOD node. Only the transforms are per actor.
   {
-    if (!section.NumTriangles)
+    std::scoped_lock<std::mutex> lock(MeshNodesMutex);
+    auto it = MeshNodes.find(mesh);
+    if (it != MeshNodes.end())
     {
-      continue;
-    }
-    osg::Geometry* geo = new osg::Geometry;
-    osg::ref_ptr<osg::DrawElementsUInt> indices = new osg::DrawElementsUInt(GL_TRIANGLES);
-    for (int32 faceIndex = 0; faceIndex < section.NumTriangles; ++faceIndex)
-    {
-      indices->push_back(indexContainer.GetIndex(section.FirstIndex + (faceIndex * 3) + 0));
-      indices->push_back(indexContainer.GetIndex(section.FirstIndex + (faceIndex * 3) + 1));
-      indices->push_back(indexContainer.GetIndex(section.FirstIndex + (faceIndex * 3) + 2));
+      return it->second;
     }
-    geo->addPrimitiveSet(indices.get());
-    geo->setVertexArray(vertices.get());
-    geo->setNormalArray(normals.get());
-    geo->setTexCoordArray(0, uvs.get());
+  }
 
-    if (UMaterialInterface* material = Cast<UMaterialInterface>(section.Material))
-    {
-      if (UTexture2D* tex = material->GetDiffuseTexture())
-      {
-        osg::ref_ptr<osg::Image> img = new osg::Image;
-        tex->RenderTo(img.get());
-        osg::ref_ptr<osg::Texture2D> osgtex = new osg::Texture2D(img);
-        osgtex->setWrap(osg::Texture::WrapParameter::WRAP_S, osg::Texture::WrapMode::REPEAT);
-        osgtex->setWrap(osg::Texture::WrapParameter::WRAP_T, osg::Texture::WrapMode::REPEAT);
-        geo->getOrCreateStateSet()->setTextureAttributeAndModes(0, osgtex.get());
-        if (material->GetBlendMode() == EBlendMode::BLEND_Masked)
-        {
-          geo->getOrCreateStateSet()->setAttributeAndModes(new osg::BlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA));
-          geo->getOrCreateStateSet()->setRenderingHint(osg::StateSet::TRANSPARENT_BIN);
-        }
-      }
-    }
-    result->addDrawable(geo);
+  // Build the coarsest LOD right away, so the mesh is visible at any distance. Finer LODs are built when a view gets close.
+  const int32 coarsestLod = std::max(mesh->GetLodCount() - 1, 0);
+  osg::ref_ptr<osg::Geode> model = RenderModelCache::Get().AcquireModel(mesh, Window->GetPackage(), coarsestLod);
+  if (!model)
+  {
+    return nullptr;
   }
-  return result;
+  float radius = bounds.SphereRadius;
+  if (radius <= 0)
+  {
+    radius = osg::Vec3(bounds.BoxExtent.X, bounds.BoxExtent.Y, bounds.BoxExtent.Z).length();
+  }
+  osg::BoundingSphere sphere(osg::Vec3(bounds.Origin.X, -bounds.Origin.Y, bounds.Origin.Z), std::max(radius, 1.f));
+  osg::ref_ptr<MeshLodNode> node = new MeshLodNode(mesh, coarsestLod + 1, sphere, Window->GetPackage());
+  node->SetLod(coarsestLod, model.get());
+
+  std::scoped_lock<std::mutex> lock(MeshNodesMutex);
+  // Another sublevel may have added the mesh meanwhile
+  auto result = MeshNodes.emplace(mesh, node);
+  return result.first->second;
 }
 
-osg::Geode* LevelEditor::CreateStreamingLevelVolumeActor(ULevelStreamingVolume* actor)
+osg::Group* LevelEditor::CreateStreamingLevelVolumeActor(ULevelStreamingVolume* actor)
 {
   if (!actor || actor->StreamingLevels.empty())
   {
@@ -333,13 +544,13 @@ osg::Geode* LevelEditor::CreateStreamingLevelVolumeActor(ULevelStreamingVolume*
     return nullptr;
   }
 
-  osg::Geode* result = new osg::Geode;
+  osg::Group* result = new osg::Group;
   for (ULevelStreaming* level : aliveLevels)
   {
-    osg::Geode* lgeode = new osg::Geode;
-    lgeode->setName(level->PackageName.UTF8().c_str());
-    result->addChild(lgeode);
-    CreateLevel(level->Level, lgeode);
+    osg::Group* lgroup = new osg::Group;
+    lgroup->setName(level->PackageName.UTF8().c_str());
+    result->addChild(lgroup);
+    CreateLevel(level->Level, lgroup);
   }
 
   return result;
@@ -3,23 +3,31 @@
 
 #include <Tera/ULevel.h>
 
+#include "../Misc/MeshLodNode.h"
 #include "../Misc/OSGWindow.h"
 
+#include <Utils/MeshCollision.h>
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <thread>
 #include <unordered_map>
+#include <vector>
+#include <ppl.h>
 
 class UActor;
 class ULevel;
+class UStaticMesh;
 class UStaticMeshActor;
+class ULevelStreaming;
 class ULevelStreamingVolume;
 class LevelEditor : public GenericEditor {
 public:
   using GenericEditor::GenericEditor;
   LevelEditor(wxPanel* parent, PackageWindow* window);
 
-  ~LevelEditor() override
-  {
-    delete Renderer;
-  }
+  ~LevelEditor() override;
 
   void OnTick() override;
   void OnObjectLoaded() override;
@@ -33,18 +41,53 @@ public:
 protected:
   void CreateRenderer();
   void LoadPersistentLevel();
-  void CreateLevel(ULevel* level, osg::Geode* root);
+  void LoadStreamingLevels(const std::vector<ULevelStreaming*>& levels);
+  void OnStreamingLevelLoaded(wxCommandEvent&);
+  void CreateLevel(ULevel* level, osg::Group* root);
   void OnIdle(wxIdleEvent& e);
+  void OnCanvasDoubleClick(wxMouseEvent& e);
+
+  // Closest actor under the point of the canvas
+  UActor* PickActor(const wxPoint& point);
 
-  osg::Geode* CreateStaticActor(UStaticMeshActor* actor, FVector& translation, FVector& scale3d, FRotator& rotation, float& scale);
-  osg::Geode* CreateStreamingLevelVolumeActor(ULevelStreamingVolume* actor);
+  osg::ref_ptr<osg::Node> CreateStaticActor(UStaticMeshActor* actor, FVector& translation, FVector& scale3d, FRotator& rotation, float& scale, FBoxSphereBounds& bounds);
+  osg::Group* CreateStreamingLevelVolumeActor(ULevelStreamingVolume* actor);
 
 protected:
   ULevel* Level = nullptr;
   bool LevelLoaded = false;
   std::unordered_map<UActor*, osg::Geode*> LevelNodes;
-  osg::ref_ptr<osg::Geode> Root = nullptr;
+  osg::ref_ptr<osg::Group> Root = nullptr;
   OSGCanvas* Canvas = nullptr;
   OSGWindow* OSGProxy = nullptr;
   osgViewer::Viewer* Renderer = nullptr;
+
+  // Shared with the sublevel loader. The loader is detached, so closing the editor doesn't wait for a sublevel load.
+  struct StreamingState {
+    std::mutex Mutex;
+    // Nullptr when the editor is closing
+    LevelEditor* Editor = nullptr;
+    // Loaded sublevels waiting to be attached to the Root
+    std::vector<osg::ref_ptr<osg::Group>> Groups;
+  };
+  std::shared_ptr<StreamingState> Streaming = std::make_shared<StreamingState>();
+  // Scene graphs of loaded sublevels. Builds use the editor, so it waits for them.
+  concurrency::task_group StreamingBuilds;
+
+  std::mutex MeshNodesMutex;
+  // LOD nodes shared by actors of the same mesh
+  std::unordered_map<UStaticMesh*, osg::ref_ptr<MeshLodNode>> MeshNodes;
+  uint32 ModelGeneration = 0;
+
+  struct PickTarget {
+    UActor* Actor = nullptr;
+    UStaticMesh* Mesh = nullptr;
+    // Scene to model space. Models are in the mesh space with the Y axis flipped.
+    osg::Matrix WorldToLocal;
+    osg::BoundingBox Bounds;
+  };
+  std::mutex PickTargetsMutex;
+  std::vector<PickTarget> PickTargets;
+  // Collision of picked meshes. Built on the first hit of their bounds.
+  std::unordered_map<UStaticMesh*, std::unique_ptr<MeshCollision>> Collisions;
 };
\ No newline at end of file
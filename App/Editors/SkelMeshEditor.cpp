@@ -1,17 +1,14 @@
 #include "SkelMeshEditor.h"
 #include "../Windows/PackageWindow.h"
+#include "../Misc/RenderModelCache.h"
 
 #include <osgViewer/ViewerEventHandlers>
 #include <osgGA/TrackballManipulator>
 #include <osgUtil/SmoothingVisitor>
-#include <osg/BlendFunc>
 #include <osg/Depth>
 
 #include <Utils/FbxUtils.h>
 
-#include <Tera/Cast.h>
-#include <Tera/UMaterial.h>
-
 enum ExportMode {
   ExportGeometry = wxID_HIGHEST + 1,
   ExportFull
@@ -40,16 +37,35 @@ void SkelMeshEditor::OnTick()
   }
 }
 
+void SkelMeshEditor::LoadObject()
+{
+  // The load queue loads the mesh with its materials
+  GenericEditor::LoadObject();
+  // Loading lasts until the model is built
+  Loading = true;
+}
+
 void SkelMeshEditor::OnObjectLoaded()
 {
-  if (Loading || !Mesh)
+  Mesh = (USkeletalMesh*)Object;
+  if (!ModelRequested && !RenderModelCache::Get().GetModel(Mesh))
   {
-    Mesh = (USkeletalMesh*)Object;
-    CreateRenderModel();
+    // The mesh is loaded. The cache sends the event again when the model is built.
+    ModelRequested = true;
+    RenderModelCache::Get().RequestModel(Object, Window->GetPackage(), GetEditorId());
+    return;
   }
+  // The model is ready or its build has failed
+  ModelRequested = false;
+  CreateRenderModel();
   GenericEditor::OnObjectLoaded();
 }
 
+bool SkelMeshEditor::HasPendingLoad() const
+{
+  return Loading && (GenericEditor::HasPendingLoad() || RenderModelCache::Get().IsBuilding(Object, 0));
+}
+
 void SkelMeshEditor::PopulateToolBar(wxToolBar* toolbar)
 {
   GenericEditor::PopulateToolBar(toolbar);
@@ -147,68 +163,15 @@ void SkelMeshEditor::CreateRenderModel()
   {
     return;
   }
-  Root = new osg::Geode;
-
-  const FStaticLODModel* model = Mesh->GetLod(0);
-
-  osg::ref_ptr<osg::Vec3Array> vertices = new osg::Vec3Array;
-  osg::ref_ptr<osg::Vec3Array> normals = new osg::Vec3Array(osg::Array::BIND_PER_VERTEX);
-  osg::ref_ptr<osg::Vec2Array> uvs = new osg::Vec2Array(osg::Array::BIND_PER_VERTEX);
-
-  std::vector<FSoftSkinVertex> uvertices = model->GetVertices();
-  for (int32 idx = 0; idx < uvertices.size(); ++idx)
-  {
-    FVector normal = uvertices[idx].TangentZ;
-    normals->push_back(osg::Vec3(normal.X, -normal.Y, normal.Z));
-    vertices->push_back(osg::Vec3(uvertices[idx].Position.X, -uvertices[idx].Position.Y, uvertices[idx].Position.Z));
-    uvs->push_back(osg::Vec2(uvertices[idx].UVs[0].X, uvertices[idx].UVs[0].Y));
-  }
-
-  std::vector<const FSkelMeshSection*> sections = model->GetSections();
-  const FMultiSizeIndexContainer* indexContainer = model->GetIndexContainer();
-  for (const FSkelMeshSection* section : sections)
-  {
-    osg::ref_ptr<osg::Geometry> geo = new osg::Geometry;
-    osg::ref_ptr<osg::DrawElementsUInt> indices = new osg::DrawElementsUInt(GL_TRIANGLES);
-    for (int32 faceIndex = 0; faceIndex < section->NumTriangles; ++faceIndex)
-    {
-      indices->push_back(indexContainer->GetIndex(section->BaseIndex + (faceIndex * 3) + 0));
-      indices->push_back(indexContainer->GetIndex(section->BaseIndex + (faceIndex * 3) + 1));
-      indices->push_back(indexContainer->GetIndex(section->BaseIndex + (faceIndex * 3) + 2));
-    }
-    geo->addPrimitiveSet(indices.get());
-    geo->setVertexArray(vertices.get());
-    geo->setNormalArray(normals.get());
-    geo->setTexCoordArray(0, uvs.get());
-
-    // TODO: Use MaterialMap to remap section materials to the global materials list
-    if (Mesh->GetMaterials().size() > section->MaterialIndex)
-    {
-      if (UMaterialInterface* material = Cast<UMaterialInterface>(Mesh->GetMaterials()[section->MaterialIndex]))
-      {
-        if (UTexture2D* tex = material->GetDiffuseTexture())
-        {
-          osg::ref_ptr<osg::Image> img = new osg::Image;
-          tex->RenderTo(img.get());
-          osg::ref_ptr<osg::Texture2D> osgtex = new osg::Texture2D(img);
-          osgtex->setWrap(osg::Texture::WrapParameter::WRAP_S, osg::Texture::WrapMode::REPEAT);
-          osgtex->setWrap(osg::Texture::WrapParameter::WRAP_T, osg::Texture::WrapMode::REPEAT);
-          geo->getOrCreateStateSet()->setTextureAttributeAndModes(0, osgtex.get());
-          if (material->GetBlendMode() == EBlendMode::BLEND_Masked)
-          {
-            geo->getOrCreateStateSet()->setAttributeAndModes(new osg::BlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA));
-            geo->getOrCreateStateSet()->setRenderingHint(osg::StateSet::TRANSPARENT_BIN);
-          }
-        }
-      }
-    }
-    Root->addDrawable(geo.get());
-  }
+  // The model is shared with other editors of the mesh
+  Root = RenderModelCache::Get().GetModel(Mesh);
   Renderer->setSceneData(Root.get());
   Renderer->getCamera()->setViewport(0, 0, GetSize().x, GetSize().y);
 }
 
 void SkelMeshEditor::OnRefreshClicked()
 {
+  // Pick up changed materials and imported textures. Geometry stays cached.
+  RenderModelCache::Get().RefreshMaterials(Mesh);
   CreateRenderModel();
 }
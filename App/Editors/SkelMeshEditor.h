@@ -12,7 +12,9 @@ public:
   ~SkelMeshEditor() override;
 
   void OnTick() override;
+  void LoadObject() override;
   void OnObjectLoaded() override;
+  bool HasPendingLoad() const override;
 
   void PopulateToolBar(wxToolBar* toolbar) override;
   void OnToolBarEvent(wxCommandEvent& e) override;
@@ -27,6 +29,8 @@ protected:
 
 protected:
   USkeletalMesh* Mesh = nullptr;
+  // Waiting for RenderModelCache
+  bool ModelRequested = false;
   osg::ref_ptr<osg::Geode> Root = nullptr;
   OSGCanvas* Canvas = nullptr;
   OSGWindow* OSGProxy = nullptr;
@@ -2,8 +2,157 @@
 #include "../Windows/PackageWindow.h"
 #include "../App.h"
 
+#include <wx/dcbuffer.h>
+
+#include <Utils/SoundDecoder.h>
 #include <Utils/SoundTravaller.h>
 
+#include <cmath>
+#include <vector>
+#include <ppl.h>
+
+wxDEFINE_EVENT(SOUND_SUMMARY_READY, wxCommandEvent);
+
+// Draws the peaks of a waveform summary
+class SoundWaveformPanel : public wxPanel {
+public:
+  SoundWaveformPanel(wxWindow* parent)
+    : wxPanel(parent, wxID_ANY, wxDefaultPosition, wxDefaultSize, wxTAB_TRAVERSAL | wxFULL_REPAINT_ON_RESIZE)
+  {
+    SetBackgroundStyle(wxBG_STYLE_PAINT);
+    Bind(wxEVT_PAINT, &SoundWaveformPanel::OnPaint, this);
+  }
+
+  void SetSummary(std::shared_ptr<const SoundSummary> summary)
+  {
+    Summary = summary;
+    Refresh();
+  }
+
+private:
+  void OnPaint(wxPaintEvent&)
+  {
+    wxAutoBufferedPaintDC dc(this);
+    const wxSize size = GetClientSize();
+    dc.SetBackground(wxBrush(wxSystemSettings::GetColour(wxSYS_COLOUR_WINDOW)));
+    dc.Clear();
+    const int mid = size.y / 2;
+    dc.SetPen(wxPen(wxSystemSettings::GetColour(wxSYS_COLOUR_GRAYTEXT)));
+    dc.DrawLine(0, mid, size.x, mid);
+    if (!Summary || Summary->Waveform.empty() || size.x <= 0)
+    {
+      return;
+    }
+    dc.SetPen(wxPen(wxSystemSettings::GetColour(wxSYS_COLOUR_HIGHLIGHT)));
+    const std::vector<float>& peaks = Summary->Waveform;
+    for (int x = 0; x < size.x; ++x)
+    {
+      const float peak = std::min(peaks[(size_t)x * peaks.size() / size.x], 1.f);
+      const int height = (int)(peak * (mid - 2));
+      dc.DrawLine(x, mid - height, x, mid + height + 1);
+    }
+  }
+
+  std::shared_ptr<const SoundSummary> Summary;
+};
+
+static wxString FormatDecibels(float value)
+{
+  return value > 0.f ? wxString::Format(wxT("%.1f dBFS"), 20.f * std::log10(value)) : wxString(wxT("-inf dBFS"));
+}
+
+SoundWaveEditor::SoundWaveEditor(wxPanel* parent, PackageWindow* window)
+  : GenericEditor(parent, window)
+{
+  wxBoxSizer* sizer;
+  sizer = new wxBoxSizer(wxVERTICAL);
+
+  Waveform = new SoundWaveformPanel(this);
+  Waveform->SetMinSize(wxSize(-1, 120));
+  sizer->Add(Waveform, 1, wxEXPAND | wxALL, 5);
+
+  SummaryLabel = new wxStaticText(this, wxID_ANY, wxEmptyString, wxDefaultPosition, wxDefaultSize, 0);
+  SummaryLabel->Wrap(-1);
+  sizer->Add(SummaryLabel, 0, wxALL, 5);
+
+  SetSizer(sizer);
+  Layout();
+
+  Summary->Editor = this;
+  Bind(SOUND_SUMMARY_READY, &SoundWaveEditor::OnSummaryReady, this);
+}
+
+SoundWaveEditor::~SoundWaveEditor()
+{
+  std::scoped_lock<std::mutex> lock(Summary->Mutex);
+  Summary->Editor = nullptr;
+}
+
+void SoundWaveEditor::OnObjectLoaded()
+{
+  UpdateSummary();
+  GenericEditor::OnObjectLoaded();
+}
+
+void SoundWaveEditor::UpdateSummary()
+{
+  uint32 request = 0;
+  {
+    std::scoped_lock<std::mutex> lock(Summary->Mutex);
+    request = ++Summary->Request;
+    // Drop a result of an older request waiting for its event
+    Summary->Result = nullptr;
+  }
+  USoundNodeWave* wave = (USoundNodeWave*)Object;
+  Waveform->SetSummary(nullptr);
+  if (!wave || !wave->GetResourceData())
+  {
+    SummaryLabel->SetLabelText(wxT("PC wave data is empty!"));
+    return;
+  }
+  SummaryLabel->SetLabelText(wxT("Decoding..."));
+
+  // Import may replace the data while it is decoded, so the task gets a copy
+  const uint8* data = (const uint8*)wave->GetResourceData();
+  auto copy = std::make_shared<std::vector<uint8>>(data, data + wave->GetResourceSize());
+  std::shared_ptr<SummaryState> state = Summary;
+  concurrency::create_task([state, copy, request] {
+    std::shared_ptr<const SoundSummary> summary = SoundDecoder::GetSummary(copy->data(), copy->size());
+    std::scoped_lock<std::mutex> lock(state->Mutex);
+    if (state->Editor && state->Request == request)
+    {
+      state->Result = summary;
+      SendEvent(state->Editor, SOUND_SUMMARY_READY);
+    }
+  });
+}
+
+void SoundWaveEditor::OnSummaryReady(wxCommandEvent&)
+{
+  std::shared_ptr<const SoundSummary> summary;
+  {
+    std::scoped_lock<std::mutex> lock(Summary->Mutex);
+    summary = std::move(Summary->Result);
+  }
+  if (!summary)
+  {
+    return;
+  }
+  Waveform->SetSummary(summary);
+  if (!summary->NumChannels)
+  {
+    SummaryLabel->SetLabelText(summary->Error);
+    return;
+  }
+  wxString label = wxString::Format(wxT("%.2f s, %u Hz, %u channel(s). Peak: %s, RMS: %s"), summary->Duration, summary->SampleRate, summary->NumChannels, FormatDecibels(summary->Peak), FormatDecibels(summary->Rms));
+  if (summary->Error.size())
+  {
+    label += wxT(". ") + wxString(summary->Error);
+  }
+  SummaryLabel->SetLabelText(label);
+  Layout();
+}
+
 void SoundWaveEditor::OnExportClicked(wxCommandEvent&)
 {
   USoundNodeWave* wave = (USoundNodeWave*)Object;
@@ -81,7 +230,8 @@ void SoundWaveEditor::OnImportClicked(wxCommandEvent&)
     wxMessageBox("Unexpected error!", wxT("Error!"), wxICON_ERROR);
     return;
   }
-  
+
+  UpdateSummary();
   SendEvent(Window, UPDATE_PROPERTIES);
 }
 
@@ -3,11 +3,40 @@
 #include "GenericEditor.h"
 #include <Tera/USoundNode.h>
 
+#include <memory>
+#include <mutex>
+
+struct SoundSummary;
+class SoundWaveformPanel;
+
 class SoundWaveEditor : public GenericEditor {
 public:
-  using GenericEditor::GenericEditor;
+  SoundWaveEditor(wxPanel* parent, PackageWindow* window);
+
+  ~SoundWaveEditor() override;
 
+  void OnObjectLoaded() override;
   void PopulateToolBar(wxToolBar* toolbar) override;
   void OnExportClicked(wxCommandEvent&) override;
   void OnImportClicked(wxCommandEvent&) override;
+
+private:
+  // Decode a copy of the wave data on the PPL pool
+  void UpdateSummary();
+  void OnSummaryReady(wxCommandEvent&);
+
+private:
+  SoundWaveformPanel* Waveform = nullptr;
+  wxStaticText* SummaryLabel = nullptr;
+
+  // Shared with decoding tasks. A task finishing after the editor is closed drops its result.
+  struct SummaryState {
+    std::mutex Mutex;
+    // Nullptr when the editor is closing
+    SoundWaveEditor* Editor = nullptr;
+    // Results of older requests are dropped
+    uint32 Request = 0;
+    std::shared_ptr<const SoundSummary> Result;
+  };
+  std::shared_ptr<SummaryState> Summary = std::make_shared<SummaryState>();
 };
\ No newline at end of file
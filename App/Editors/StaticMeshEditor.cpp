@@ -1,17 +1,14 @@
 #include "StaticMeshEditor.h"
 #include "../Windows/PackageWindow.h"
+#include "../Misc/RenderModelCache.h"
 
 #include <osgViewer/ViewerEventHandlers>
 #include <osgGA/TrackballManipulator>
 #include <osgUtil/SmoothingVisitor>
-#include <osg/BlendFunc>
 #include <osg/Depth>
 
 #include <Utils/FbxUtils.h>
 
-#include <Tera/Cast.h>
-#include <Tera/UMaterial.h>
-
 StaticMeshEditor::StaticMeshEditor(wxPanel* parent, PackageWindow* window)
   : GenericEditor(parent, window)
 {
@@ -35,16 +32,35 @@ void StaticMeshEditor::OnTick()
   }
 }
 
+void StaticMeshEditor::LoadObject()
+{
+  // The load queue loads the mesh with its materials
+  GenericEditor::LoadObject();
+  // Loading lasts until the model is built
+  Loading = true;
+}
+
 void StaticMeshEditor::OnObjectLoaded()
 {
-  if (Loading || !Mesh)
+  Mesh = (UStaticMesh*)Object;
+  if (!ModelRequested && !RenderModelCache::Get().GetModel(Mesh))
   {
-    Mesh = (UStaticMesh*)Object;
-    CreateRenderModel();
+    // The mesh is loaded. The cache sends the event again when the model is built.
+    ModelRequested = true;
+    RenderModelCache::Get().RequestModel(Object, Window->GetPackage(), GetEditorId());
+    return;
   }
+  // The model is ready or its build has failed
+  ModelRequested = false;
+  CreateRenderModel();
   GenericEditor::OnObjectLoaded();
 }
 
+bool StaticMeshEditor::HasPendingLoad() const
+{
+  return Loading && (GenericEditor::HasPendingLoad() || RenderModelCache::Get().IsBuilding(Object, 0));
+}
+
 void StaticMeshEditor::PopulateToolBar(wxToolBar* toolbar)
 {
   GenericEditor::PopulateToolBar(toolbar);
@@ -133,70 +149,15 @@ void StaticMeshEditor::CreateRenderModel()
   {
     return;
   }
-  Root = new osg::Geode;
-
-  const FStaticMeshRenderData* model = Mesh->GetLod(0);
-
-  osg::ref_ptr<osg::Vec3Array> vertices = new osg::Vec3Array;
-  osg::ref_ptr<osg::Vec3Array> normals = new osg::Vec3Array(osg::Array::BIND_PER_VERTEX);
-  osg::ref_ptr<osg::Vec2Array> uvs = new osg::Vec2Array(osg::Array::BIND_PER_VERTEX);
-
-  std::vector<FStaticVertex> uvertices = model->GetVertices();
-  for (int32 idx = 0; idx < uvertices.size(); ++idx)
-  {
-    FVector normal = uvertices[idx].TangentZ;
-    normals->push_back(osg::Vec3(normal.X, -normal.Y, normal.Z));
-    vertices->push_back(osg::Vec3(uvertices[idx].Position.X, -uvertices[idx].Position.Y, uvertices[idx].Position.Z));
-    uvs->push_back(osg::Vec2(uvertices[idx].UVs[0].X, uvertices[idx].UVs[0].Y));
-  }
-
-  std::vector<FStaticMeshElement> elements = model->GetElements();
-  const FRawIndexBuffer& indexContainer = model->IndexBuffer;
-  for (const FStaticMeshElement& section : elements)
-  {
-    if (!section.NumTriangles)
-    {
-      continue;
-    }
-    osg::ref_ptr<osg::Geometry> geo = new osg::Geometry;
-    osg::ref_ptr<osg::DrawElementsUInt> indices = new osg::DrawElementsUInt(GL_TRIANGLES);
-    for (int32 faceIndex = 0; faceIndex < section.NumTriangles; ++faceIndex)
-    {
-      indices->push_back(indexContainer.GetIndex(section.FirstIndex + (faceIndex * 3) + 0));
-      indices->push_back(indexContainer.GetIndex(section.FirstIndex + (faceIndex * 3) + 1));
-      indices->push_back(indexContainer.GetIndex(section.FirstIndex + (faceIndex * 3) + 2));
-    }
-    geo->addPrimitiveSet(indices.get());
-    geo->setVertexArray(vertices.get());
-    geo->setNormalArray(normals.get());
-    geo->setTexCoordArray(0, uvs.get());
-
-    if (UMaterialInterface* material = Cast<UMaterialInterface>(section.Material))
-    {
-      if (UTexture2D* tex = material->GetDiffuseTexture())
-      {
-        osg::ref_ptr<osg::Image> img = new osg::Image;
-        tex->RenderTo(img.get());
-        osg::ref_ptr<osg::Texture2D> osgtex = new osg::Texture2D(img);
-        osgtex->setWrap(osg::Texture::WrapParameter::WRAP_S, osg::Texture::WrapMode::REPEAT);
-        osgtex->setWrap(osg::Texture::WrapParameter::WRAP_T, osg::Texture::WrapMode::REPEAT);
-        geo->getOrCreateStateSet()->setTextureAttributeAndModes(0, osgtex.get());
-        if (material->GetBlendMode() == EBlendMode::BLEND_Masked)
-        {
-          geo->getOrCreateStateSet()->setAttributeAndModes(new osg::BlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA));
-          geo->getOrCreateStateSet()->setRenderingHint(osg::StateSet::TRANSPARENT_BIN);
-        }
-      }
-    }
-
-    Root->addDrawable(geo.get());
-  }
-
+  // The model is shared with other editors of the mesh
+  Root = RenderModelCache::Get().GetModel(Mesh);
   Renderer->setSceneData(Root.get());
   Renderer->getCamera()->setViewport(0, 0, GetSize().x, GetSize().y);
 }
 
 void StaticMeshEditor::OnRefreshClicked()
 {
+  // Pick up changed materials and imported textures. Geometry stays cached.
+  RenderModelCache::Get().RefreshMaterials(Mesh);
   CreateRenderModel();
 }
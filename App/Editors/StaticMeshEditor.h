@@ -12,7 +12,9 @@ public:
   ~StaticMeshEditor() override;
 
   void OnTick() override;
+  void LoadObject() override;
   void OnObjectLoaded() override;
+  bool HasPendingLoad() const override;
 
   void PopulateToolBar(wxToolBar* toolbar) override;
   void OnToolBarEvent(wxCommandEvent& e) override;
@@ -26,6 +28,8 @@ protected:
 
 protected:
   UStaticMesh* Mesh = nullptr;
+  // Waiting for RenderModelCache
+  bool ModelRequested = false;
   osg::ref_ptr<osg::Geode> Root = nullptr;
   OSGCanvas* Canvas = nullptr;
   OSGWindow* OSGProxy = nullptr;
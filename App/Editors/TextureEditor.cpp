@@ -363,6 +363,7 @@ void TextureEditor::OnImportClicked(wxCommandEvent&)
   processor.SetAddressY(importer.GetAddressY());
   processor.SetGenerateMips(importer.GetGenerateMips());
   processor.SetMipFilter(importer.GetMipFilter());
+  processor.SetQuality(importer.GetQuality());
 
   ProgressWindow progress(Window, "Please, wait...");
   progress.SetCurrentProgress(-1);
@@ -427,10 +428,9 @@ void TextureEditor::OnImportClicked(wxCommandEvent&)
     travaller.SetCompression(importer.IsNormal() ? processor.GetAlpha() ? TC_NormalmapAlpha : TC_Normalmap : TC_Default);
   }
 
-  const auto& mips = processor.GetOutputMips();
-  for (const auto mip : mips)
+  for (const auto& mip : processor.TakeOutputMips())
   {
-    travaller.AddMipMap(mip.SizeX, mip.SizeY, mip.Size, mip.Data);
+    travaller.AddMipMap(mip.SizeX, mip.SizeY, mip.Size, mip.Data, true);
   }
 
   if (!travaller.Visit(Texture))
@@ -5,6 +5,8 @@
 
 #include "../Misc/OSGWindow.h"
 
+#include <osg/Image>
+
 class TextureEditor : public GenericEditor {
 public:
   using GenericEditor::GenericEditor;
@@ -16,6 +18,11 @@ public:
 
   void OnTick() override;
 
+  size_t GetMemoryFootprint() const override
+  {
+    return Image ? Image->getTotalSizeInBytesIncludingMipmaps() : 0;
+  }
+
   void PopulateToolBar(wxToolBar* toolbar) override;
 
   void OnToolBarEvent(wxCommandEvent& event) override;
@@ -0,0 +1,845 @@
+#include "BatchRunner.h"
+#include "BulkImportOperation.h"
+#include "../App.h"
+
+#include <wx/file.h>
+#include <wx/filename.h>
+#include <wx/textfile.h>
+
+#include <Tera/Cast.h>
+#include <Tera/FObjectResource.h>
+#include <Tera/FPackage.h>
+#include <Tera/FStream.h>
+#include <Tera/USkeletalMesh.h>
+#include <Tera/USoundNode.h>
+#include <Tera/UStaticMesh.h>
+#include <Tera/UTexture.h>
+
+#include <Utils/ALog.h>
+#include <Utils/MeshExporter.h>
+#include <Utils/NameIndex.h>
+#include <Utils/SoundDecoder.h>
+#include <Utils/TextureProcessor.h>
+#include <Utils/TfcBuilder.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <filesystem>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <ppl.h>
+
+// Max number of names returned by a query job without an explicit limit
+#define BATCH_DEFAULT_QUERY_LIMIT 50
+
+namespace
+{
+  int64 ElapsedMs(const std::chrono::steady_clock::time_point& start)
+  {
+    return (int64)std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+  }
+
+  // Retains a package for the lifetime of the job
+  class PackageRef {
+  public:
+    PackageRef(const wxString& arg)
+    {
+      Package = wxFileExists(arg) ? FPackage::GetPackage(arg.ToStdWstring()) : FPackage::GetPackageNamed(arg.ToStdWstring());
+      if (!Package)
+      {
+        throw std::runtime_error("Failed to find the package " + arg.ToStdString());
+      }
+      try
+      {
+        Package->Load();
+      }
+      catch (...)
+      {
+        FPackage::UnloadPackage(Package);
+        throw;
+      }
+      if (!Package->IsReady())
+      {
+        FPackage::UnloadPackage(Package);
+        throw std::runtime_error("Failed to load the package " + arg.ToStdString());
+      }
+    }
+
+    ~PackageRef()
+    {
+      FPackage::UnloadPackage(Package);
+    }
+
+    PackageRef(const PackageRef&) = delete;
+    PackageRef& operator=(const PackageRef&) = delete;
+
+    FPackage* operator->() const
+    {
+      return Package.get();
+    }
+
+    FPackage* Get() const
+    {
+      return Package.get();
+    }
+
+  private:
+    std::shared_ptr<FPackage> Package;
+  };
+
+  // Accepts a full object path, a path without the package name or just the object name
+  FObjectExport* FindExport(FPackage* package, const wxString& objectPath)
+  {
+    const wxString path = objectPath.Lower();
+    for (FObjectExport* exp : package->GetExportObject(objectPath.AfterLast('.').ToStdWstring()))
+    {
+      const wxString expPath = wxString(exp->GetObjectPath().WString()).Lower();
+      if (expPath == path || expPath.EndsWith(wxT(".") + path))
+      {
+        return exp;
+      }
+    }
+    throw std::runtime_error("Failed to find " + objectPath.ToStdString());
+  }
+
+  void SavePackage(FPackage* package, const wxString& dest, ECompressionFlags compression, bool disableTextureCaching = true)
+  {
+    PackageSaveContext ctx;
+    ctx.Path = W2A(dest.ToStdWstring());
+    ctx.Compression = compression;
+    ctx.DisableTextureCaching = disableTextureCaching;
+    if (!package->Save(ctx))
+    {
+      throw std::runtime_error(ctx.Error.size() ? ctx.Error : "Failed to save " + dest.ToStdString());
+    }
+  }
+
+  void ExportTexture(UTexture2D* texture, const wxString& dest, const wxString& ext)
+  {
+    FTexture2DMipMap* mip = nullptr;
+    for (FTexture2DMipMap* mipmap : texture->Mips)
+    {
+      if (mipmap->Data && mipmap->Data->GetAllocation() && mipmap->SizeX && mipmap->SizeY)
+      {
+        mip = mipmap;
+        break;
+      }
+    }
+    if (!mip)
+    {
+      throw std::runtime_error("The texture has no mipmaps!");
+    }
+
+    TextureProcessor::TCFormat inputFormat = TextureProcessor::TCFormat::None;
+    switch (texture->Format)
+    {
+    case PF_DXT1:
+      inputFormat = TextureProcessor::TCFormat::DXT1;
+      break;
+    case PF_DXT3:
+      inputFormat = TextureProcessor::TCFormat::DXT3;
+      break;
+    case PF_DXT5:
+      inputFormat = TextureProcessor::TCFormat::DXT5;
+      break;
+    case PF_A8R8G8B8:
+      inputFormat = TextureProcessor::TCFormat::ARGB8;
+      break;
+    case PF_G8:
+      inputFormat = TextureProcessor::TCFormat::G8;
+      break;
+    default:
+      throw std::runtime_error(std::string("Format ") + PixelFormatToString(texture->Format).String() + " is not supported!");
+    }
+
+    TextureProcessor::TCFormat outputFormat = TextureProcessor::TCFormat::DDS;
+    if (ext == "png")
+    {
+      outputFormat = TextureProcessor::TCFormat::PNG;
+    }
+    else if (ext == "tga")
+    {
+      outputFormat = TextureProcessor::TCFormat::TGA;
+    }
+
+    TextureProcessor processor(inputFormat, outputFormat);
+    processor.SetInputData(mip->Data->GetAllocation(), mip->Data->GetBulkDataSize());
+    processor.SetOutputPath(W2A(dest.ToStdWstring()));
+    processor.SetInputDataDimensions(mip->SizeX, mip->SizeY);
+    if (!processor.Process())
+    {
+      std::string err = processor.GetError();
+      throw std::runtime_error(err.size() ? err : "Texture Processor: failed with an unknown error!");
+    }
+  }
+
+  void ExportRaw(UObject* object, const wxString& dest)
+  {
+    FPackage* package = object->GetPackage();
+    const FILE_OFFSET size = object->GetSerialSize();
+    FWriteStream s(dest.ToStdWstring());
+    if (!s.IsGood())
+    {
+      throw std::runtime_error("Failed to create " + dest.ToStdString());
+    }
+    if (size <= 0)
+    {
+      return;
+    }
+    FReadStream rs = FReadStream(A2W(package->GetDataPath()));
+    rs.SetPackage(package);
+    rs.SetLoadSerializedObjects(package->GetStream().GetLoadSerializedObjects());
+    rs.SetPosition(object->GetSerialOffset());
+    std::vector<uint8> data(size);
+    rs.SerializeBytes(data.data(), size);
+    s.SerializeBytes(data.data(), size);
+    if (!s.IsGood())
+    {
+      throw std::runtime_error("Failed to write " + dest.ToStdString());
+    }
+  }
+
+  void RunOpen(const BatchJob& job, BatchJobResult&)
+  {
+    PackageRef package(job.Args[0]);
+  }
+
+  void RunResave(const BatchJob& job, BatchJobResult& result)
+  {
+    PackageRef package(job.Args[0]);
+    const bool lzo = job.Command == wxT("compress") || (job.Args.size() > 2 && job.Args[2].Lower() == wxT("lzo"));
+    SavePackage(package.Get(), job.Args[1], lzo ? COMPRESS_LZO : COMPRESS_None);
+    result.Output.push_back(job.Args[1]);
+  }
+
+  void RunExport(const BatchJob& job, BatchJobResult& result)
+  {
+    PackageRef package(job.Args[0]);
+    FObjectExport* exp = FindExport(package.Get(), job.Args[1]);
+    UObject* object = package->GetObject(exp);
+    if (!object)
+    {
+      throw std::runtime_error("Failed to load " + job.Args[1].ToStdString());
+    }
+    const wxString ext = wxFileName(job.Args[2]).GetExt().Lower();
+    UTexture2D* texture = Cast<UTexture2D>(object);
+    MeshExportContext meshCtx;
+    if (texture && (ext == "png" || ext == "tga" || ext == "dds"))
+    {
+      ExportTexture(texture, job.Args[2], ext);
+    }
+    else if ((Cast<UStaticMesh>(object) || Cast<USkeletalMesh>(object)) && MeshExporter::FormatFromExtension(ext.ToStdWstring(), meshCtx.Format))
+    {
+      meshCtx.Path = job.Args[2].ToStdWstring();
+      const bool ok = Cast<UStaticMesh>(object) ? MeshExporter::ExportStaticMesh(Cast<UStaticMesh>(object), meshCtx) : MeshExporter::ExportSkeletalMesh(Cast<USkeletalMesh>(object), meshCtx);
+      if (!ok)
+      {
+        throw std::runtime_error(meshCtx.Error);
+      }
+    }
+    else
+    {
+      ExportRaw(object, job.Args[2]);
+    }
+    result.Output.push_back(job.Args[2]);
+  }
+
+  void RunImport(const BatchJob& job, BatchJobResult& result)
+  {
+    // Keep the package loaded while the operation runs
+    PackageRef package(job.Args[0]);
+    FObjectExport* exp = FindExport(package.Get(), job.Args[1]);
+    BulkImportAction action;
+    action.ClassName = exp->GetClassName().WString();
+    action.ObjectName = exp->GetObjectName().WString();
+    action.ImportPath = job.Args[2];
+    BulkImportAction::Entry& entry = action.Entries.emplace_back();
+    entry.ObjectPath = exp->GetObjectPath().WString();
+    entry.PackageName = job.Args[0];
+    entry.Index = exp->ObjectIndex;
+
+    BulkImportOperation operation({ action }, job.Args[3]);
+    if (job.Args.size() > 4)
+    {
+      operation.SetTfcName(job.Args[4]);
+    }
+    const bool ok = operation.Execute(nullptr);
+    if (!ok || operation.HasErrors())
+    {
+      wxString err;
+      for (const auto& pair : operation.GetErrors())
+      {
+        if (err.size())
+        {
+          err += wxT("; ");
+        }
+        err += pair.first + wxT(": ") + pair.second;
+      }
+      throw std::runtime_error(err.size() ? err.ToStdString() : "Import failed!");
+    }
+    result.Output.push_back(job.Args[3]);
+  }
+
+  void RunTfc(const BatchJob& job, BatchJobResult& result)
+  {
+    const wxString& tfcName = job.Args[0];
+    const std::filesystem::path destDir = job.Args[1].ToStdWstring();
+    std::vector<std::unique_ptr<PackageRef>> packages;
+    for (size_t idx = 2; idx < job.Args.size(); ++idx)
+    {
+      packages.emplace_back(std::make_unique<PackageRef>(job.Args[idx]));
+    }
+
+    TfcBuilder tfc(tfcName.ToStdWstring());
+    for (const auto& package : packages)
+    {
+      for (FObjectExport* exp : (*package)->GetAllExports())
+      {
+        if (exp->GetClassName() == UTexture2D::StaticClassName())
+        {
+          tfc.AddTexture(Cast<UTexture2D>((*package)->GetObject(exp)));
+        }
+      }
+    }
+
+    const FString tfcPath = W2A((destDir / tfcName.ToStdWstring()).wstring()) + ".tfc";
+    tfc.OpenStore(tfcPath);
+    if (!tfc.Compile() || !tfc.Save(tfcPath))
+    {
+      throw std::runtime_error(tfc.GetError().UTF8());
+    }
+    result.Output.push_back(tfcPath.WString());
+
+    for (const auto& package : packages)
+    {
+      const wxString dest = (destDir / ((*package)->GetPackageName().WString() + L".gpk")).wstring();
+      SavePackage(package->Get(), dest, COMPRESS_None, false);
+      result.Output.push_back(dest);
+    }
+  }
+
+  void RunComposite(const BatchJob& job, BatchJobResult& result)
+  {
+    std::vector<FString> items;
+    for (size_t idx = 3; idx < job.Args.size(); ++idx)
+    {
+      items.emplace_back(job.Args[idx].ToStdWstring());
+    }
+    FPackage::CreateCompositeMod(items, job.Args[0].ToStdWstring(), job.Args[1].ToStdString(), job.Args[2].ToStdString());
+    result.Output.push_back(job.Args[0]);
+  }
+
+  void RunSounds(const BatchJob& job, BatchJobResult& result)
+  {
+    PackageRef package(job.Args[0]);
+    std::vector<FObjectExport*> exports;
+    for (FObjectExport* exp : package->GetAllExports())
+    {
+      if (exp->GetClassName() == USoundNodeWave::StaticClassName())
+      {
+        exports.push_back(exp);
+      }
+    }
+
+    // Objects are loaded on this thread one by one. Each wave is decoded on the pool as soon as it is loaded.
+    std::vector<USoundNodeWave*> waves(exports.size());
+    std::vector<std::shared_ptr<const SoundSummary>> summaries(exports.size());
+    concurrency::task_group decodes;
+    for (size_t idx = 0; idx < exports.size(); ++idx)
+    {
+      USoundNodeWave* wave = Cast<USoundNodeWave>(package->GetObject(exports[idx]));
+      if (!wave)
+      {
+        continue;
+      }
+      waves[idx] = wave;
+      decodes.run([&summaries, wave, idx] {
+        summaries[idx] = SoundDecoder::GetSummary(wave);
+      });
+    }
+    decodes.wait();
+
+    wxFile file;
+    if (!file.Create(job.Args[1], true))
+    {
+      throw std::runtime_error("Failed to create " + job.Args[1].ToStdString());
+    }
+    file.Write(wxT("path,channels,sample_rate,frames,duration,peak,rms,error\n"));
+    for (size_t idx = 0; idx < waves.size(); ++idx)
+    {
+      if (!waves[idx])
+      {
+        continue;
+      }
+      const SoundSummary& summary = *summaries[idx];
+      wxString error = summary.Error;
+      error.Replace(wxT("\""), wxT("\"\""));
+      file.Write(wxString::Format(wxT("%s,%u,%u,%llu,%.3f,%.6f,%.6f,\"%s\"\n"), waves[idx]->GetObjectPath().WString().c_str(), summary.NumChannels, summary.SampleRate, summary.NumFrames, summary.Duration, summary.Peak, summary.Rms, error));
+    }
+    if (!file.Close())
+    {
+      throw std::runtime_error("Failed to write " + job.Args[1].ToStdString());
+    }
+    result.Output.push_back(job.Args[1]);
+  }
+
+  void RunQuery(const BatchJob& job, BatchJobResult& result)
+  {
+    long limit = 0;
+    if (job.Args.size() < 2 || !job.Args[1].ToLong(&limit) || limit <= 0)
+    {
+      limit = BATCH_DEFAULT_QUERY_LIMIT;
+    }
+    const NameIndex& index = App::GetSharedApp()->GetCompositeNameIndex();
+    for (uint32 idx : index.Complete(job.Args[0].ToStdString(), (uint32)limit))
+    {
+      result.Output.push_back(index.GetName(idx));
+    }
+  }
+
+  struct BatchCommand {
+    const char* Name = nullptr;
+    size_t MinArgs = 0;
+    size_t MaxArgs = 0;
+    // Range of package arguments. Jobs with a shared package are serialized.
+    size_t FirstPackage = 0;
+    size_t LastPackage = 0;
+    void(*Run)(const BatchJob&, BatchJobResult&) = nullptr;
+  };
+
+  const BatchCommand BatchCommands[] = {
+    { "open", 1, 1, 0, 1, RunOpen },
+    { "resave", 2, 3, 0, 1, RunResave },
+    { "compress", 2, 2, 0, 1, RunResave },
+    { "export", 3, 3, 0, 1, RunExport },
+    { "import", 4, 5, 0, 1, RunImport },
+    { "tfc", 3, SIZE_MAX, 2, SIZE_MAX, RunTfc },
+    { "composite", 4, SIZE_MAX, 3, SIZE_MAX, RunComposite },
+    { "query", 1, 2, 0, 0, RunQuery },
+    { "sounds", 2, 2, 0, 1, RunSounds },
+    { "wait", 0, 0, 0, 0, nullptr },
+  };
+
+  const BatchCommand* FindCommand(const wxString& name)
+  {
+    for (const BatchCommand& cmd : BatchCommands)
+    {
+      if (name == cmd.Name)
+      {
+        return &cmd;
+      }
+    }
+    return nullptr;
+  }
+
+  // A package argument may be a path or a name. Both forms of the same file must share a lock.
+  wxString GetPackageLockKey(const wxString& arg)
+  {
+    wxString path = arg;
+    if (!wxFileExists(path))
+    {
+      FString found = FPackage::GetPackagePathNamed(arg.ToStdWstring());
+      if (found.Empty())
+      {
+        // Composite or missing packages are locked by name
+        return wxT("name:") + arg.Lower();
+      }
+      path = found.WString();
+    }
+    wxFileName fn(path);
+    fn.Normalize(wxPATH_NORM_DOTS | wxPATH_NORM_ABSOLUTE | wxPATH_NORM_LONG);
+    return fn.GetFullPath().Lower();
+  }
+
+  // Lock every package of the job in a stable order to avoid deadlocks between jobs
+  std::vector<std::unique_lock<std::mutex>> LockPackages(const BatchCommand& cmd, const BatchJob& job)
+  {
+    static std::mutex guard;
+    static std::map<wxString, std::unique_ptr<std::mutex>> packageMutexes;
+
+    std::vector<wxString> keys;
+    for (size_t idx = cmd.FirstPackage; idx < std::min(cmd.LastPackage, job.Args.size()); ++idx)
+    {
+      keys.push_back(GetPackageLockKey(job.Args[idx]));
+    }
+    std::sort(keys.begin(), keys.end());
+    keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+
+    std::vector<std::mutex*> mutexes;
+    {
+      std::scoped_lock<std::mutex> lock(guard);
+      for (const wxString& key : keys)
+      {
+        auto& ptr = packageMutexes[key];
+        if (!ptr)
+        {
+          ptr = std::make_unique<std::mutex>();
+        }
+        mutexes.push_back(ptr.get());
+      }
+    }
+
+    std::vector<std::unique_lock<std::mutex>> locks;
+    for (std::mutex* m : mutexes)
+    {
+      locks.emplace_back(*m);
+    }
+    return locks;
+  }
+}
+
+bool BatchRunner::LoadCore(const FString& rootDir, std::vector<std::pair<wxString, int64>>& timings, wxString& error)
+{
+  auto measure = [&timings](const wxString& stage, const std::function<void()>& body) {
+    auto start = std::chrono::steady_clock::now();
+    body();
+    timings.emplace_back(stage, ElapsedMs(start));
+  };
+
+  try
+  {
+    measure(wxT("dir_cache"), [&] {
+      FPackage::SetRootPath(rootDir);
+    });
+
+    measure(wxT("meta_data"), [&] {
+      // Meta data is optional
+      std::unordered_map<FString, std::unordered_map<FString, AMetaDataEntry>> meta;
+      try
+      {
+        FString root = rootDir;
+        LoadMeta(root.FStringByAppendingPath("..\\Engine\\Localization\\AutoGenerated.Properties"), meta);
+        FPackage::SetMetaData(meta);
+      }
+      catch (const std::exception& e)
+      {
+        LogE("Can't load metadata: %s", e.what());
+      }
+    });
+
+    measure(wxT("class_packages"), [] {
+      for (const FString& name : App::GetClassPackageNames())
+      {
+        FPackage::LoadClassPackage(name);
+      }
+    });
+
+    measure(wxT("persistent_data"), [] {
+      FPackage::LoadPersistentData();
+    });
+
+    if (FPackage::GetCoreVersion() > VER_TERA_CLASSIC)
+    {
+      measure(wxT("mappers"), [] {
+        concurrency::parallel_invoke(
+          [] { FPackage::LoadPkgMapper(); },
+          [] { FPackage::LoadCompositePackageMapper(); },
+          [] { FPackage::LoadObjectRedirectorMapper(); }
+        );
+      });
+
+      measure(wxT("name_index"), [] {
+        App::GetSharedApp()->BuildCompositeNameIndex();
+      });
+    }
+  }
+  catch (const std::exception& e)
+  {
+    error = e.what();
+    return false;
+  }
+  return true;
+}
+
+bool BatchRunner::ParseJobFile(const wxString& path, std::vector<BatchJob>& output, wxString& error)
+{
+  wxTextFile file;
+  if (!file.Open(path))
+  {
+    error = wxT("Failed to open the job file ") + path;
+    return false;
+  }
+  for (size_t idx = 0; idx < file.GetLineCount(); ++idx)
+  {
+    BatchJob job;
+    if (!ParseJobLine(file.GetLine(idx), job))
+    {
+      continue;
+    }
+    job.Line = (int32)idx + 1;
+    if (!ValidateJob(job, error))
+    {
+      error = wxString::Format(wxT("Line %d: "), job.Line) + error;
+      return false;
+    }
+    output.push_back(job);
+  }
+  return true;
+}
+
+bool BatchRunner::ValidateJob(const BatchJob& job, wxString& error)
+{
+  const BatchCommand* cmd = FindCommand(job.Command);
+  if (!cmd)
+  {
+    error = wxString::Format(wxT("unknown command \"%s\""), job.Command);
+    return false;
+  }
+  if (job.Args.size() < cmd->MinArgs || job.Args.size() > cmd->MaxArgs)
+  {
+    error = wxString::Format(wxT("wrong number of arguments for \"%s\""), job.Command);
+    return false;
+  }
+  return true;
+}
+
+wxString BatchRunner::FormatJobLine(const BatchJob& job)
+{
+  wxString line = job.Command;
+  for (const wxString& arg : job.Args)
+  {
+    line += ' ';
+    if (arg.empty() || arg.find_first_of(wxT(" \t#")) != wxString::npos)
+    {
+      line += '"' + arg + '"';
+    }
+    else
+    {
+      line += arg;
+    }
+  }
+  return line;
+}
+
+bool BatchRunner::ParseJobLine(const wxString& line, BatchJob& output)
+{
+  std::vector<wxString> tokens;
+  wxString token;
+  bool quoted = false;
+  bool hasToken = false;
+  for (wxUniChar ch : line)
+  {
+    if (quoted)
+    {
+      if (ch == '"')
+      {
+        quoted = false;
+      }
+      else
+      {
+        token += ch;
+      }
+    }
+    else if (ch == '"')
+    {
+      quoted = true;
+      hasToken = true;
+    }
+    else if (ch == ' ' || ch == '\t')
+    {
+      if (hasToken)
+      {
+        tokens.push_back(token);
+        token.clear();
+        hasToken = false;
+      }
+    }
+    else if (ch == '#' && !hasToken)
+    {
+      break;
+    }
+    else
+    {
+      token += ch;
+      hasToken = true;
+    }
+  }
+  if (hasToken)
+  {
+    tokens.push_back(token);
+  }
+  if (tokens.empty())
+  {
+    return false;
+  }
+  output.Command = tokens.front().Lower();
+  output.Args.assign(tokens.begin() + 1, tokens.end());
+  return true;
+}
+
+BatchJobResult BatchRunner::RunJob(const BatchJob& job)
+{
+  BatchJobResult result;
+  result.Line = job.Line;
+  result.Command = job.Command;
+  auto start = std::chrono::steady_clock::now();
+  if (!ValidateJob(job, result.Error))
+  {
+    return result;
+  }
+  const BatchCommand* cmd = FindCommand(job.Command);
+  if (!cmd->Run)
+  {
+    result.Ok = true;
+    return result;
+  }
+  try
+  {
+    auto locks = LockPackages(*cmd, job);
+    cmd->Run(job, result);
+    result.Ok = true;
+  }
+  catch (const std::exception& e)
+  {
+    result.Error = e.what();
+  }
+  catch (...)
+  {
+    result.Error = wxT("Unknown error!");
+  }
+  if (!result.Ok)
+  {
+    result.Output.clear();
+    LogE("Batch: line %d: %s", job.Line, result.Error.ToStdString().c_str());
+  }
+  result.Milliseconds = ElapsedMs(start);
+  return result;
+}
+
+void BatchRunner::RunJobs(const std::vector<BatchJob>& jobs, int32 workers, const std::function<void(const BatchJobResult&)>& report)
+{
+  workers = std::max<int32>(1, workers);
+  size_t first = 0;
+  while (first < jobs.size())
+  {
+    // Jobs up to the next barrier run concurrently
+    size_t last = first;
+    while (last < jobs.size() && jobs[last].Command != wxT("wait"))
+    {
+      last++;
+    }
+
+    const size_t count = last - first;
+    std::vector<BatchJobResult> results(count);
+    std::vector<bool> ready(count);
+    std::mutex mutex;
+    std::condition_variable resultReady;
+    std::atomic_size_t next = 0;
+
+    auto worker = [&] {
+      for (size_t idx = next++; idx < count; idx = next++)
+      {
+        BatchJobResult result = RunJob(jobs[first + idx]);
+        {
+          std::scoped_lock<std::mutex> lock(mutex);
+          results[idx] = std::move(result);
+          ready[idx] = true;
+        }
+        resultReady.notify_one();
+      }
+    };
+
+    std::vector<std::thread> threads;
+    for (size_t idx = 0; idx < std::min<size_t>(workers, count); ++idx)
+    {
+      threads.emplace_back(worker);
+    }
+
+    for (size_t idx = 0; idx < count; ++idx)
+    {
+      BatchJobResult result;
+      {
+        std::unique_lock<std::mutex> lock(mutex);
+        resultReady.wait(lock, [&] { return ready[idx]; });
+        result = std::move(results[idx]);
+      }
+      report(result);
+    }
+
+    for (std::thread& thread : threads)
+    {
+      thread.join();
+    }
+
+    if (last < jobs.size())
+    {
+      report(RunJob(jobs[last]));
+    }
+    first = last + 1;
+  }
+}
+
+wxString BatchRunner::JsonEscape(const wxString& str)
+{
+  wxString result;
+  result.reserve(str.size() + 2);
+  result += '"';
+  for (wxUniChar ch : str)
+  {
+    switch ((wxChar)ch)
+    {
+    case '"':
+      result += wxT("\\\"");
+      break;
+    case '\\':
+      result += wxT("\\\\");
+      break;
+    case '\n':
+      result += wxT("\\n");
+      break;
+    case '\r':
+      result += wxT("\\r");
+      break;
+    case '\t':
+      result += wxT("\\t");
+      break;
+    default:
+      if (ch < 0x20)
+      {
+        result += wxString::Format(wxT("\\u%04x"), (int)ch.GetValue());
+      }
+      else
+      {
+        result += ch;
+      }
+    }
+  }
+  result += '"';
+  return result;
+}
+
+wxString BatchRunner::ToJson(const BatchJobResult& result)
+{
+  wxString json = wxString::Format(wxT("{\"line\":%d,\"command\":"), result.Line);
+  json += JsonEscape(result.Command);
+  json += wxString::Format(wxT(",\"ok\":%s,\"ms\":%lld"), result.Ok ? wxT("true") : wxT("false"), (long long)result.Milliseconds);
+  if (result.Error.size())
+  {
+    json += wxT(",\"error\":") + JsonEscape(result.Error);
+  }
+  json += wxT(",\"output\":[");
+  for (size_t idx = 0; idx < result.Output.size(); ++idx)
+  {
+    if (idx)
+    {
+      json += ',';
+    }
+    json += JsonEscape(result.Output[idx]);
+  }
+  json += wxT("]}");
+  return json;
+}
+
+wxString BatchRunner::StageToJson(const wxString& stage, int64 milliseconds)
+{
+  return wxT("{\"stage\":") + JsonEscape(stage) + wxString::Format(wxT(",\"ms\":%lld}"), (long long)milliseconds);
+}
+
+wxString BatchRunner::ErrorToJson(const wxString& error)
+{
+  return wxT("{\"ok\":false,\"error\":") + JsonEscape(error) + wxT("}");
+}
@@ -0,0 +1,69 @@
+#pragma once
+#include <wx/wx.h>
+
+#include <Tera/Core.h>
+#include <Tera/FString.h>
+
+#include <functional>
+#include <vector>
+
+// A single command of a job file
+struct BatchJob {
+	// Line of the job file or the request id of a job server client
+	int32 Line = 0;
+	wxString Command;
+	std::vector<wxString> Args;
+};
+
+struct BatchJobResult {
+	int32 Line = 0;
+	wxString Command;
+	bool Ok = false;
+	wxString Error;
+	// Files written by the job or names found by a query
+	std::vector<wxString> Output;
+	int64 Milliseconds = 0;
+};
+
+// Headless front end for package operations. Runs commands from a job file on a worker pool without any windows.
+// One command per line. Arguments are separated by spaces, quotes group arguments with spaces, '#' starts a comment.
+//   open <package>
+//   resave <package> <dest> [lzo]
+//   compress <package> <dest>
+//   export <package> <objectPath> <dest> - textures to png/tga/dds, meshes to glb/obj, anything else raw
+//   import <package> <objectPath> <source> <destDir> [tfcName]
+//   tfc <tfcName> <destDir> <package>...
+//   composite <dest> <name> <author> <package>...
+//   query <text> [limit] - ranked composite package names
+//   sounds <package> <dest.csv> - channels, rate, duration, peak and RMS of every sound wave
+//   wait
+// <package> is a path to a package file or a package name. "wait" finishes all previous jobs before starting the next ones.
+// Jobs that share a package argument never run at the same time.
+class BatchRunner {
+public:
+	// Load meta data, class packages, persistent data and mappers. Appends (stage, milliseconds) pairs to the timings.
+	static bool LoadCore(const FString& rootDir, std::vector<std::pair<wxString, int64>>& timings, wxString& error);
+
+	static bool ParseJobFile(const wxString& path, std::vector<BatchJob>& output, wxString& error);
+
+	// Returns false if the line has no command
+	static bool ParseJobLine(const wxString& line, BatchJob& output);
+
+	// Check the command and the number of its arguments
+	static bool ValidateJob(const BatchJob& job, wxString& error);
+
+	// Inverse of ParseJobLine
+	static wxString FormatJobLine(const BatchJob& job);
+
+	// Run a single job on the calling thread. Doesn't throw.
+	static BatchJobResult RunJob(const BatchJob& job);
+
+	// Run jobs on the worker pool. Results are reported in the job order on the calling thread.
+	static void RunJobs(const std::vector<BatchJob>& jobs, int32 workers, const std::function<void(const BatchJobResult&)>& report);
+
+	// Single-line JSON records for machine-readable reports
+	static wxString ToJson(const BatchJobResult& result);
+	static wxString StageToJson(const wxString& stage, int64 milliseconds);
+	static wxString ErrorToJson(const wxString& error);
+	static wxString JsonEscape(const wxString& str);
+};
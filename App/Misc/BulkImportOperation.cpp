@@ -14,64 +14,99 @@
 #include <Utils/SoundTravaller.h>
 #include <Utils/TfcBuilder.h>
 
+#include <algorithm>
+#include <atomic>
 #include <thread>
+#include <ppl.h>
 
-bool BulkImportOperation::Execute(ProgressWindow& progress)
+// Max number of encoded textures kept in memory at once per hardware thread
+#define BULK_IMPORT_TEXTURES_PER_THREAD 2
+
+bool BulkImportOperation::Execute(ProgressWindow* progress)
 {
   Errors.clear();
+  TextureJobs.clear();
 
-  // Load all packages
-  int total = 0;
-  std::vector<std::shared_ptr<FPackage>> packages;
+  // Collect unique packages
+  std::vector<wxString> packageNames;
+  std::map<wxString, size_t> packageIndices;
   for (auto& operation : Actions)
   {
     if (!operation.IsValid())
     {
       continue;
     }
-
     for (auto& item : operation.Entries)
     {
       if (!item.Enabled)
       {
         continue;
       }
-      std::shared_ptr<FPackage> package = nullptr;
-      try
+      if (!packageIndices.count(item.PackageName))
       {
-        if ((package = FPackage::GetPackageNamed(item.PackageName.ToStdWstring())))
-        {
-          total++;
-          package->Load();
-          bool packageAdded = false;
-          for (std::shared_ptr<FPackage> pkg : packages)
-          {
-            if (pkg.get() == package.get())
-            {
-              item.Package = package.get();
-              packageAdded = true;
-              break;
-            }
-          }
+        packageIndices[item.PackageName] = packageNames.size();
+        packageNames.push_back(item.PackageName);
+      }
+    }
+  }
 
-          if (packageAdded)
-          {
-            FPackage::UnloadPackage(package);
-          }
-          else
-          {
-            item.Package = package.get();
-            packages.push_back(package);
-          }
-        }
-        else
-        {
-          AddError(item.PackageName, "Failed to load\\get the package!");
-        }
+  // Load all packages. Packages are independent, so we can load them concurrently.
+  SendEvent(progress, UPDATE_PROGRESS_DESC, wxString::Format(wxT("Loading %d package(s)..."), (int)packageNames.size()));
+  std::vector<std::shared_ptr<FPackage>> loadedPackages(packageNames.size());
+  std::vector<wxString> loadErrors(packageNames.size());
+  concurrency::parallel_for(size_t(0), packageNames.size(), [&](size_t idx) {
+    try
+    {
+      const wxString& name = packageNames[idx];
+      if ((loadedPackages[idx] = wxFileExists(name) ? FPackage::GetPackage(name.ToStdWstring()) : FPackage::GetPackageNamed(name.ToStdWstring())))
+      {
+        loadedPackages[idx]->Load();
       }
-      catch (const std::exception& e)
+      else
+      {
+        loadErrors[idx] = "Failed to load\\get the package!";
+      }
+    }
+    catch (const std::exception& e)
+    {
+      loadErrors[idx] = wxString("Internal error: ") + e.what();
+    }
+  });
+
+  // Different names may resolve to the same package. Keep a single reference per package.
+  std::vector<std::shared_ptr<FPackage>> packages;
+  for (size_t idx = 0; idx < packageNames.size(); ++idx)
+  {
+    if (loadErrors[idx].size())
+    {
+      AddError(packageNames[idx], loadErrors[idx]);
+      if (loadedPackages[idx])
+      {
+        FPackage::UnloadPackage(loadedPackages[idx]);
+        loadedPackages[idx] = nullptr;
+      }
+      continue;
+    }
+    auto it = std::find(packages.begin(), packages.end(), loadedPackages[idx]);
+    if (it != packages.end())
+    {
+      FPackage::UnloadPackage(loadedPackages[idx]);
+      loadedPackages[idx] = *it;
+      continue;
+    }
+    packages.push_back(loadedPackages[idx]);
+  }
+
+  int total = 0;
+  for (auto& operation : Actions)
+  {
+    for (auto& item : operation.Entries)
+    {
+      auto it = packageIndices.find(item.PackageName);
+      item.Package = it != packageIndices.end() && loadedPackages[it->second] ? loadedPackages[it->second].get() : nullptr;
+      if (item.Package && item.Enabled && operation.IsValid())
       {
-        AddError(item.PackageName, wxString("Internal error: ") + e.what());
+        total++;
       }
     }
   }
@@ -82,9 +117,8 @@ bool BulkImportOperation::Execute(ProgressWindow& progress)
     return false;
   }
 
-  SendEvent(&progress, UPDATE_MAX_PROGRESS, total);
-  SendEvent(&progress, UPDATE_PROGRESS_DESC, wxString::Format(wxT("Executing %d operation(s)..."), total));
-  std::this_thread::sleep_for(std::chrono::seconds(1));
+  SendEvent(progress, UPDATE_MAX_PROGRESS, total);
+  SendEvent(progress, UPDATE_PROGRESS_DESC, wxString::Format(wxT("Executing %d operation(s)..."), total));
 
   int idx = 0;
   for (const auto& operation : Actions)
@@ -101,8 +135,8 @@ bool BulkImportOperation::Execute(ProgressWindow& progress)
       }
 
       idx++;
-      SendEvent(&progress, UPDATE_PROGRESS, idx);
-      SendEvent(&progress, UPDATE_PROGRESS_DESC, wxString("Processing: ") + item.Package->GetPackageName(true).WString() + wxString::Format("(%d/%d)", idx, total));
+      SendEvent(progress, UPDATE_PROGRESS, idx);
+      SendEvent(progress, UPDATE_PROGRESS_DESC, wxString("Processing: ") + item.Package->GetPackageName(true).WString() + wxString::Format("(%d/%d)", idx, total));
 
       UObject* object = nullptr;
       try
@@ -128,6 +162,7 @@ bool BulkImportOperation::Execute(ProgressWindow& progress)
       {
         if (operation.ClassName == UTexture2D::StaticClassName())
         {
+          // Textures are encoded later in parallel
           ImportTexture(item.Package, Cast<UTexture2D>(object), operation.ImportPath);
         }
         else if (operation.ClassName == USoundNodeWave::StaticClassName())
@@ -184,11 +219,13 @@ bool BulkImportOperation::Execute(ProgressWindow& progress)
     }
   }
 
+  EncodeTextures(progress);
+
   bool disableTextureCaching = true;
   if (TfcName.size())
   {
-    SendEvent(&progress, UPDATE_PROGRESS, -1);
-    SendEvent(&progress, UPDATE_PROGRESS_DESC, wxT("Building texture cache..."));
+    SendEvent(progress, UPDATE_PROGRESS, -1);
+    SendEvent(progress, UPDATE_PROGRESS_DESC, wxT("Building texture cache..."));
     TfcBuilder tfc(TfcName.ToStdWstring());
     for (std::shared_ptr<FPackage> pkg : packages)
     {
@@ -209,18 +246,18 @@ bool BulkImportOperation::Execute(ProgressWindow& progress)
       }
     }
 
+    const FString tfcPath = W2A((std::filesystem::path(Path.ToStdWstring()) / TfcName.ToStdWstring()).wstring()) + ".tfc";
+    // Reuse payloads of the previous build if the cache is still there
+    tfc.OpenStore(tfcPath);
     if (tfc.Compile())
     {
-      FILE_OFFSET tfcSize = 0;
-      void* tfcData = nullptr;
-      if ((tfcData = tfc.GetAllocation(tfcSize)) && tfcSize)
+      if (tfc.Save(tfcPath))
       {
-        FWriteStream s(W2A((std::filesystem::path(Path.ToStdWstring()) / TfcName.ToStdWstring()).wstring()) + ".tfc");
-        s.SerializeBytes(tfcData, tfcSize);
-        if (s.IsGood())
-        {
-          disableTextureCaching = false;
-        }
+        disableTextureCaching = false;
+      }
+      else
+      {
+        AddError("TFC", tfc.GetError().WString());
       }
     }
     else if (tfc.GetCount())
@@ -228,14 +265,17 @@ bool BulkImportOperation::Execute(ProgressWindow& progress)
       AddError("TFC", tfc.GetError().WString());
     }
   }
-  
 
-  PackageSaveContext ctx;
-  ctx.EmbedObjectPath = true;
-  ctx.DisableTextureCaching = disableTextureCaching;
-  SendEvent(&progress, UPDATE_PROGRESS_DESC, wxString("Saving..."));
-  for (std::shared_ptr<FPackage> pkg : packages)
-  {
+  // Packages are saved to different files and don't share state. Save them concurrently.
+  SendEvent(progress, UPDATE_MAX_PROGRESS, (int)packages.size());
+  SendEvent(progress, UPDATE_PROGRESS, 0);
+  SendEvent(progress, UPDATE_PROGRESS_DESC, wxString("Saving..."));
+  std::atomic_int saved = 0;
+  concurrency::parallel_for(size_t(0), packages.size(), [&](size_t pkgIdx) {
+    std::shared_ptr<FPackage> pkg = packages[pkgIdx];
+    PackageSaveContext ctx;
+    ctx.EmbedObjectPath = true;
+    ctx.DisableTextureCaching = disableTextureCaching;
     ctx.Path = W2A((std::filesystem::path(Path.ToStdWstring()) / pkg->GetPackageName().WString()).wstring()) + ".gpk";
     try
     {
@@ -259,6 +299,11 @@ bool BulkImportOperation::Execute(ProgressWindow& progress)
     {
       AddError(pkg->GetPackageName(false).WString(), "Unknown error while saving");
     }
+    SendEvent(progress, UPDATE_PROGRESS, ++saved);
+  });
+
+  for (std::shared_ptr<FPackage> pkg : packages)
+  {
     FPackage::UnloadPackage(pkg);
   }
   return true;
@@ -266,6 +311,7 @@ bool BulkImportOperation::Execute(ProgressWindow& progress)
 
 void BulkImportOperation::AddError(const wxString& source, const wxString& error)
 {
+  std::scoped_lock<std::mutex> lock(ErrorsMutex);
   Errors.emplace_back(std::make_pair(source, error ));
 }
 
@@ -299,65 +345,140 @@ void BulkImportOperation::ImportTexture(FPackage* package, UTexture2D* texture,
     return;
   }
 
-  TextureProcessor processor(inputFormat, TextureProcessor::TCFormat::None);
-  processor.SetInputPath(W2A(source.ToStdWstring()));
-  EPixelFormat processorFormat = PF_Unknown;
-
-  bool isNormal = texture->CompressionSettings == TC_Normalmap ||
-    texture->CompressionSettings == TC_NormalmapAlpha ||
-    texture->CompressionSettings == TC_NormalmapUncompressed ||
-    texture->CompressionSettings == TC_NormalmapBC5;
-
-  switch ((processorFormat = texture->Format))
+  TextureProcessor::TCFormat outputFormat = TextureProcessor::TCFormat::None;
+  switch (texture->Format)
   {
   case PF_DXT1:
-    processor.SetOutputFormat(TextureProcessor::TCFormat::DXT1);
+    outputFormat = TextureProcessor::TCFormat::DXT1;
     break;
   case PF_DXT3:
-    processor.SetOutputFormat(TextureProcessor::TCFormat::DXT3);
+    outputFormat = TextureProcessor::TCFormat::DXT3;
     break;
   case PF_DXT5:
-    processor.SetOutputFormat(TextureProcessor::TCFormat::DXT5);
+    outputFormat = TextureProcessor::TCFormat::DXT5;
     break;
   case PF_A8R8G8B8:
-    processor.SetOutputFormat(TextureProcessor::TCFormat::ARGB8);
+    outputFormat = TextureProcessor::TCFormat::ARGB8;
     break;
   case PF_G8:
-    processor.SetOutputFormat(TextureProcessor::TCFormat::G8);
+    outputFormat = TextureProcessor::TCFormat::G8;
     break;
   default:
     AddError(package->GetPackageName().WString(), wxString("Can't import to textures with 0x") + std::to_string(texture->Format) + " pixel format.");
     return;
   }
 
-  processor.SetSrgb(texture->SRGB);
-  processor.SetNormal(isNormal);
-  processor.SetGenerateMips(TfcName.size() && HasAVX2() && inputFormat != TextureProcessor::TCFormat::DDS);
-  processor.SetAddressX(texture->AddressX);
-  processor.SetAddressY(texture->AddressY);
-  processor.ClearOutput();
+  bool isNormal = texture->CompressionSettings == TC_Normalmap ||
+    texture->CompressionSettings == TC_NormalmapAlpha ||
+    texture->CompressionSettings == TC_NormalmapUncompressed ||
+    texture->CompressionSettings == TC_NormalmapBC5;
+  bool generateMips = TfcName.size() && inputFormat != TextureProcessor::TCFormat::DDS;
 
-  if (!processor.Process())
+  // Textures with the same source and encoding settings share a single encoding job
+  const wxString key = wxString::Format("%s|%d|%d|%d|%d|%d|%d", source, (int)texture->Format, (int)texture->SRGB, (int)isNormal, (int)generateMips, (int)texture->AddressX, (int)texture->AddressY);
+  auto it = TextureJobIndices.find(key);
+  if (it != TextureJobIndices.end())
   {
-    AddError(package->GetPackageName().WString(), processor.GetError());
+    TextureJobs[it->second].Targets.emplace_back(package, texture);
     return;
   }
 
-  TextureTravaller travaller;
-  travaller.SetFormat(processorFormat);
-  travaller.SetAddressX(texture->AddressX);
-  travaller.SetAddressY(texture->AddressY);
+  TextureJob& job = TextureJobs.emplace_back();
+  TextureJobIndices[key] = TextureJobs.size() - 1;
+  job.Source = source;
+  job.InputFormat = inputFormat;
+  job.OutputFormat = outputFormat;
+  job.PixelFormat = texture->Format;
+  job.SRGB = texture->SRGB;
+  job.Normal = isNormal;
+  job.GenerateMips = generateMips;
+  job.AddressX = texture->AddressX;
+  job.AddressY = texture->AddressY;
+  job.Targets.emplace_back(package, texture);
+}
 
-  const auto& mips = processor.GetOutputMips();
-  for (const auto mip : mips)
+void BulkImportOperation::EncodeTextures(ProgressWindow* progress)
+{
+  if (TextureJobs.empty())
   {
-    travaller.AddMipMap(mip.SizeX, mip.SizeY, mip.Size, mip.Data);
+    TextureJobIndices.clear();
+    return;
   }
 
-  if (!travaller.Visit(texture))
+  // Encode in batches to keep the number of encoded textures in memory bounded
+  const size_t batchSize = std::max<size_t>(1, std::thread::hardware_concurrency() * BULK_IMPORT_TEXTURES_PER_THREAD);
+  const int totalJobs = (int)TextureJobs.size();
+  SendEvent(progress, UPDATE_MAX_PROGRESS, totalJobs);
+  SendEvent(progress, UPDATE_PROGRESS, 0);
+  std::atomic_int encoded = 0;
+  for (size_t batchStart = 0; batchStart < TextureJobs.size(); batchStart += batchSize)
   {
-    AddError(package->GetPackageName().WString(), travaller.GetError());
+    const size_t batchEnd = std::min(batchStart + batchSize, TextureJobs.size());
+    SendEvent(progress, UPDATE_PROGRESS_DESC, wxString::Format(wxT("Encoding textures (%d/%d)..."), (int)batchEnd, totalJobs));
+    concurrency::parallel_for(batchStart, batchEnd, [&](size_t jobIdx) {
+      TextureJob& job = TextureJobs[jobIdx];
+      job.Processor = std::make_unique<TextureProcessor>(job.InputFormat, job.OutputFormat);
+      job.Processor->SetInputPath(W2A(job.Source.ToStdWstring()));
+      job.Processor->SetSrgb(job.SRGB);
+      job.Processor->SetNormal(job.Normal);
+      job.Processor->SetGenerateMips(job.GenerateMips);
+      job.Processor->SetAddressX(job.AddressX);
+      job.Processor->SetAddressY(job.AddressY);
+      job.Processor->ClearOutput();
+      try
+      {
+        job.Ok = job.Processor->Process();
+      }
+      catch (...)
+      {
+        job.Ok = false;
+      }
+      SendEvent(progress, UPDATE_PROGRESS, ++encoded);
+    });
+
+    // Apply results on the owning packages and release the encoded data
+    for (size_t jobIdx = batchStart; jobIdx < batchEnd; ++jobIdx)
+    {
+      TextureJob& job = TextureJobs[jobIdx];
+      for (const auto& target : job.Targets)
+      {
+        if (!job.Ok)
+        {
+          std::string error = job.Processor->GetError();
+          AddError(target.first->GetPackageName().WString(), error.size() ? error : "Failed to encode the texture!");
+          continue;
+        }
+        TextureTravaller travaller;
+        travaller.SetFormat(job.PixelFormat);
+        travaller.SetAddressX(job.AddressX);
+        travaller.SetAddressY(job.AddressY);
+
+        // The last texture takes the encoded buffers, the others get copies
+        if (&target == &job.Targets.back())
+        {
+          for (const auto& mip : job.Processor->TakeOutputMips())
+          {
+            travaller.AddMipMap(mip.SizeX, mip.SizeY, mip.Size, mip.Data, true);
+          }
+        }
+        else
+        {
+          for (const auto& mip : job.Processor->GetOutputMips())
+          {
+            travaller.AddMipMap(mip.SizeX, mip.SizeY, mip.Size, mip.Data);
+          }
+        }
+
+        if (!travaller.Visit(target.second))
+        {
+          AddError(target.first->GetPackageName().WString(), travaller.GetError());
+        }
+      }
+      job.Processor.reset();
+    }
   }
+  TextureJobs.clear();
+  TextureJobIndices.clear();
 }
 
 void BulkImportOperation::ImportSound(FPackage* package, USoundNodeWave* sound, const wxString& source)
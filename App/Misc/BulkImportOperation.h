@@ -5,10 +5,16 @@
 #include "../Windows/ProgressWindow.h"
 
 #include <Tera/Core.h>
+#include <Utils/TextureProcessor.h>
+
+#include <map>
+#include <memory>
+#include <mutex>
 
 struct BulkImportAction {
 	struct Entry {
 		wxString ObjectPath;
+		// Package name or a path to a package file
 		wxString PackageName;
 		PACKAGE_INDEX Index = 0;
 		bool Enabled = true;
@@ -70,7 +76,8 @@ public:
 		, Actions(ops)
 	{}
 
-	bool Execute(ProgressWindow& progress);
+	// Progress window may be null
+	bool Execute(ProgressWindow* progress);
 
 	inline std::vector<std::pair<wxString, wxString>> GetErrors() const
 	{
@@ -88,14 +95,38 @@ public:
 	}
 
 protected:
+	// Thread safe
 	void AddError(const wxString& source, const wxString& error);
+	// Validate the texture and queue it for encoding
 	void ImportTexture(FPackage* package, class UTexture2D* tobject, const wxString& source);
+	// Encode queued textures in parallel and apply them to their objects
+	void EncodeTextures(ProgressWindow* progress);
 	void ImportSound(FPackage* package, class USoundNodeWave* tobject, const wxString& source);
 	void ImportUntyped(FPackage* package, class UObject* tobject, const wxString& source);
 
+protected:
+	// A source image encoded once and applied to every texture that shares the settings
+	struct TextureJob {
+		wxString Source;
+		TextureProcessor::TCFormat InputFormat = TextureProcessor::TCFormat::None;
+		TextureProcessor::TCFormat OutputFormat = TextureProcessor::TCFormat::None;
+		EPixelFormat PixelFormat = PF_Unknown;
+		bool SRGB = false;
+		bool Normal = false;
+		bool GenerateMips = false;
+		TextureAddress AddressX = TA_Wrap;
+		TextureAddress AddressY = TA_Wrap;
+		std::vector<std::pair<FPackage*, class UTexture2D*>> Targets;
+		std::unique_ptr<TextureProcessor> Processor;
+		bool Ok = false;
+	};
+
 protected:
 	wxString Path;
 	wxString TfcName;
 	std::vector<BulkImportAction> Actions;
 	std::vector<std::pair<wxString, wxString>> Errors;
+	std::mutex ErrorsMutex;
+	std::vector<TextureJob> TextureJobs;
+	std::map<wxString, size_t> TextureJobIndices;
 };
\ No newline at end of file
@@ -0,0 +1,350 @@
+#include "CompositeDumpOperation.h"
+#include "../App.h"
+
+#include <Tera/FPackage.h>
+#include <Tera/FStream.h>
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <thread>
+
+// Max packages per worker task. Packages of a task share the container stream.
+#define COMPOSITE_DUMP_BATCH_SIZE 32
+// Max packages processed ahead of the writer
+#define COMPOSITE_DUMP_WINDOW 4096
+// Save the checkpoint every N written packages
+#define COMPOSITE_DUMP_CHECKPOINT_INTERVAL 512
+#define COMPOSITE_DUMP_CHECKPOINT_MAGIC "RE_COMPOSITE_DUMP 1"
+
+CompositeDumpOperation::CompositeDumpOperation(const wxString& dest)
+  : Path(dest)
+{
+  std::filesystem::path errDst = dest.ToStdWstring();
+  errDst.replace_extension("errors.txt");
+  ErrorsPath = errDst.wstring();
+  CheckpointPath = dest + ".resume";
+}
+
+void CompositeDumpOperation::BuildUnits()
+{
+  Units.clear();
+  std::unordered_map<FString, FString> containers;
+  for (const auto& pair : FPackage::GetCompositePackageMap())
+  {
+    if (pair.first == "tmm_marker")
+    {
+      // Skip the TMM marker
+      continue;
+    }
+    Unit& unit = Units.emplace_back();
+    unit.Name = pair.first;
+    unit.Entry = pair.second;
+    auto it = containers.find(pair.second.FileName);
+    if (it == containers.end())
+    {
+      it = containers.emplace(pair.second.FileName, FPackage::GetCompositeContainerPath(pair.second)).first;
+    }
+    unit.ContainerPath = it->second;
+  }
+
+  std::sort(Units.begin(), Units.end(), [](const Unit& a, const Unit& b) {
+    if (a.ContainerPath != b.ContainerPath)
+    {
+      return a.ContainerPath < b.ContainerPath;
+    }
+    if (a.Entry.Offset != b.Entry.Offset)
+    {
+      return a.Entry.Offset < b.Entry.Offset;
+    }
+    return a.Name < b.Name;
+  });
+
+  // The checkpoint is valid only for the same list of packages
+  ContentHasher hasher;
+  for (const Unit& unit : Units)
+  {
+    hasher.Update(unit.Name.C_str(), unit.Name.Size());
+    hasher.Update(unit.Entry.FileName.C_str(), unit.Entry.FileName.Size());
+    hasher.UpdateValue(unit.Entry.Offset);
+    hasher.UpdateValue(unit.Entry.Size);
+  }
+  Fingerprint = hasher.Final();
+}
+
+bool CompositeDumpOperation::ReadCheckpoint(Checkpoint& checkpoint) const
+{
+  std::ifstream s(CheckpointPath.ToStdWstring(), std::ios::in);
+  std::string magic;
+  if (!std::getline(s, magic) || magic != COMPOSITE_DUMP_CHECKPOINT_MAGIC)
+  {
+    return false;
+  }
+  s >> checkpoint.Fingerprint.A >> checkpoint.Fingerprint.B >> checkpoint.NextUnit >> checkpoint.OutputSize >> checkpoint.ErrorsSize >> checkpoint.ErrorCount;
+  return !s.fail();
+}
+
+void CompositeDumpOperation::WriteCheckpoint(const Checkpoint& checkpoint) const
+{
+  std::ofstream s(CheckpointPath.ToStdWstring(), std::ios::out | std::ios::trunc);
+  s << COMPOSITE_DUMP_CHECKPOINT_MAGIC << '\n';
+  s << checkpoint.Fingerprint.A << ' ' << checkpoint.Fingerprint.B << '\n';
+  s << checkpoint.NextUnit << ' ' << checkpoint.OutputSize << ' ' << checkpoint.ErrorsSize << ' ' << checkpoint.ErrorCount << '\n';
+}
+
+bool CompositeDumpOperation::CanResume()
+{
+  Checkpoint checkpoint;
+  if (!ReadCheckpoint(checkpoint))
+  {
+    return false;
+  }
+  BuildUnits();
+  std::error_code err;
+  return checkpoint.Fingerprint == Fingerprint && checkpoint.NextUnit <= Units.size() && std::filesystem::file_size(Path.ToStdWstring(), err) >= checkpoint.OutputSize && !err;
+}
+
+bool CompositeDumpOperation::Execute(ProgressWindow& progress, bool resume)
+{
+  BuildUnits();
+  ErrorCount = 0;
+  Error.clear();
+
+  Checkpoint checkpoint;
+  if (!resume || !ReadCheckpoint(checkpoint) || checkpoint.Fingerprint != Fingerprint || checkpoint.NextUnit > Units.size())
+  {
+    checkpoint = Checkpoint();
+    checkpoint.Fingerprint = Fingerprint;
+    resume = false;
+  }
+
+  std::filesystem::path outputPath = Path.ToStdWstring();
+  std::filesystem::path errorsPath = ErrorsPath.ToStdWstring();
+  if (resume)
+  {
+    // Drop everything written after the last checkpoint
+    std::error_code err;
+    std::filesystem::resize_file(outputPath, checkpoint.OutputSize, err);
+    if (!err && std::filesystem::exists(errorsPath, err))
+    {
+      std::filesystem::resize_file(errorsPath, checkpoint.ErrorsSize, err);
+    }
+    if (err)
+    {
+      Error = wxString("Failed to continue the dump: ") + err.message();
+      return false;
+    }
+  }
+
+  const auto mode = std::ios::out | std::ios::binary | (resume ? std::ios::app : std::ios::trunc);
+  std::ofstream output(outputPath, mode);
+  std::ofstream errors(errorsPath, mode);
+  if (!output.good())
+  {
+    Error = wxString("Failed to open ") + Path;
+    return false;
+  }
+  // Append mode doesn't move the put position until the first write
+  output.seekp(0, std::ios::end);
+  errors.seekp(0, std::ios::end);
+  ErrorCount = checkpoint.ErrorCount;
+
+  // Split the rest of the list into container-local tasks
+  struct Task {
+    size_t Start = 0;
+    size_t End = 0;
+  };
+  std::vector<Task> tasks;
+  for (size_t idx = checkpoint.NextUnit; idx < Units.size();)
+  {
+    Task& task = tasks.emplace_back();
+    task.Start = idx;
+    while (idx < Units.size() && idx - task.Start < COMPOSITE_DUMP_BATCH_SIZE && Units[idx].ContainerPath == Units[task.Start].ContainerPath)
+    {
+      idx++;
+    }
+    task.End = idx;
+  }
+
+  struct Result {
+    std::string Text;
+    std::string Error;
+    bool Ready = false;
+  };
+  std::vector<Result> results(Units.size());
+  std::mutex mutex;
+  std::condition_variable resultReady;
+  std::condition_variable windowMoved;
+  std::atomic_size_t nextTask = 0;
+  std::atomic_bool stop = false;
+  size_t written = checkpoint.NextUnit;
+
+  auto worker = [&] {
+    std::vector<FExportTableEntry> exports;
+    while (!stop.load())
+    {
+      const size_t taskIndex = nextTask++;
+      if (taskIndex >= tasks.size())
+      {
+        break;
+      }
+      const Task& task = tasks[taskIndex];
+      {
+        std::unique_lock<std::mutex> lock(mutex);
+        windowMoved.wait(lock, [&] { return stop.load() || task.Start < written + COMPOSITE_DUMP_WINDOW; });
+      }
+      if (stop.load())
+      {
+        break;
+      }
+
+      std::unique_ptr<FReadStream> container;
+      if (Units[task.Start].ContainerPath.Size())
+      {
+        container = std::make_unique<FReadStream>(Units[task.Start].ContainerPath);
+      }
+      for (size_t idx = task.Start; idx < task.End && !stop.load(); ++idx)
+      {
+        const Unit& unit = Units[idx];
+        Result result;
+        if (!container || !container->IsGood())
+        {
+          result.Error = "Failed to open the package!";
+        }
+        else
+        {
+          try
+          {
+            FPackage::ReadCompositeExportTable(*container, unit.Name, unit.Entry, exports);
+            result.Text = "// Object path: " + unit.Entry.ObjectPath.UTF8() + '\n';
+            for (const FExportTableEntry& exp : exports)
+            {
+              result.Text += exp.ClassName.UTF8() + '\t' + std::to_string(exp.ObjectIndex) + '\t' + exp.ObjectPath.UTF8() + '\n';
+            }
+            result.Text += '\n';
+          }
+          catch (const std::exception& e)
+          {
+            result.Error = e.what();
+            result.Text.clear();
+            // The stream may be in a bad state after a failed read
+            container = std::make_unique<FReadStream>(unit.ContainerPath);
+          }
+        }
+        result.Ready = true;
+        {
+          std::scoped_lock<std::mutex> lock(mutex);
+          results[idx] = std::move(result);
+        }
+        resultReady.notify_one();
+      }
+    }
+  };
+
+  std::vector<std::thread> workers;
+  const size_t workerCount = std::max<size_t>(1, std::min<size_t>(std::thread::hardware_concurrency(), tasks.size()));
+  for (size_t idx = 0; idx < workerCount && tasks.size(); ++idx)
+  {
+    workers.emplace_back(worker);
+  }
+
+  // Ordered merge
+  const int total = (int)Units.size();
+  SendEvent(&progress, UPDATE_MAX_PROGRESS, total);
+  bool cancelled = false;
+  while (written < Units.size())
+  {
+    Result result;
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      if (!resultReady.wait_for(lock, std::chrono::milliseconds(250), [&] { return results[written].Ready; }))
+      {
+        lock.unlock();
+        if (progress.IsCanceled())
+        {
+          cancelled = true;
+          break;
+        }
+        continue;
+      }
+      result = std::move(results[written]);
+      results[written] = Result();
+    }
+
+    if (result.Error.size())
+    {
+      errors << Units[written].Name.UTF8() << ": " << result.Error << '\n';
+      ErrorCount++;
+    }
+    else
+    {
+      output.write(result.Text.data(), result.Text.size());
+    }
+
+    {
+      std::scoped_lock<std::mutex> lock(mutex);
+      written++;
+    }
+    windowMoved.notify_all();
+
+    if (written % COMPOSITE_DUMP_CHECKPOINT_INTERVAL == 0)
+    {
+      output.flush();
+      errors.flush();
+      checkpoint.NextUnit = written;
+      checkpoint.OutputSize = (uint64)output.tellp();
+      checkpoint.ErrorsSize = (uint64)errors.tellp();
+      checkpoint.ErrorCount = ErrorCount;
+      WriteCheckpoint(checkpoint);
+    }
+
+    if (written % 16 == 0)
+    {
+      if (progress.IsCanceled())
+      {
+        cancelled = true;
+        break;
+      }
+      SendEvent(&progress, UPDATE_PROGRESS, (int)written);
+      SendEvent(&progress, UPDATE_PROGRESS_DESC, wxString::Format("Saving %d/%d...", (int)written, total));
+    }
+  }
+
+  stop.store(true);
+  windowMoved.notify_all();
+  for (std::thread& thread : workers)
+  {
+    thread.join();
+  }
+
+  output.flush();
+  errors.flush();
+  if (!output.good())
+  {
+    // Keep the last valid checkpoint
+    Error = wxString("Failed to write ") + Path;
+    return false;
+  }
+  if (cancelled)
+  {
+    checkpoint.NextUnit = written;
+    checkpoint.OutputSize = (uint64)output.tellp();
+    checkpoint.ErrorsSize = (uint64)errors.tellp();
+    checkpoint.ErrorCount = ErrorCount;
+    WriteCheckpoint(checkpoint);
+    return false;
+  }
+
+  output.close();
+  errors.close();
+  std::error_code err;
+  std::filesystem::remove(CheckpointPath.ToStdWstring(), err);
+  if (!ErrorCount)
+  {
+    std::filesystem::remove(errorsPath, err);
+  }
+  return true;
+}
@@ -0,0 +1,66 @@
+#pragma once
+#include <wx/wx.h>
+
+#include "../Windows/ProgressWindow.h"
+
+#include <Tera/Core.h>
+#include <Tera/FStructs.h>
+#include <Utils/ContentHash.h>
+
+// Dumps export tables of all composite packages to a text file.
+// Packages are grouped by their container and read on a worker pool. Results are merged in a stable order.
+// Progress is saved to a checkpoint next to the destination, so an interrupted dump can be continued.
+class CompositeDumpOperation {
+public:
+	CompositeDumpOperation(const wxString& dest);
+
+	// Checkpoint of an interrupted dump of the current composite map exists
+	bool CanResume();
+
+	// Run dumping. Composite mapper must be loaded. Returns false if cancelled or failed.
+	bool Execute(ProgressWindow& progress, bool resume);
+
+	inline size_t GetErrorCount() const
+	{
+		return ErrorCount;
+	}
+
+	inline wxString GetErrorsPath() const
+	{
+		return ErrorsPath;
+	}
+
+	inline wxString GetError() const
+	{
+		return Error;
+	}
+
+protected:
+	struct Unit {
+		FString Name;
+		FString ContainerPath;
+		FCompositePackageMapEntry Entry;
+	};
+
+	struct Checkpoint {
+		FContentHash Fingerprint;
+		size_t NextUnit = 0;
+		uint64 OutputSize = 0;
+		uint64 ErrorsSize = 0;
+		size_t ErrorCount = 0;
+	};
+
+	// Collect composite packages sorted by container and offset
+	void BuildUnits();
+	bool ReadCheckpoint(Checkpoint& checkpoint) const;
+	void WriteCheckpoint(const Checkpoint& checkpoint) const;
+
+protected:
+	wxString Path;
+	wxString ErrorsPath;
+	wxString CheckpointPath;
+	std::vector<Unit> Units;
+	FContentHash Fingerprint;
+	size_t ErrorCount = 0;
+	wxString Error;
+};
@@ -0,0 +1,123 @@
+#include "MeshLodNode.h"
+#include "RenderModelCache.h"
+
+#include <osgUtil/CullVisitor>
+
+#include <algorithm>
+#include <iterator>
+
+MeshLodNode::MeshLodNode(UObject* mesh, int32 numLods, const osg::BoundingSphere& bounds, std::weak_ptr<FPackage> package)
+  : Mesh(mesh)
+  , Package(package)
+  , Bounds(bounds)
+  , Lods(std::max(numLods, 1))
+  , Requested(Lods.size())
+{}
+
+MeshLodNode::MeshLodNode(const MeshLodNode& node, const osg::CopyOp& copyop)
+  : osg::Node(node, copyop)
+  , Mesh(node.Mesh)
+  , Package(node.Package)
+  , Bounds(node.Bounds)
+  , Lods(node.Lods)
+  , Requested(node.Requested)
+{}
+
+void MeshLodNode::SetLod(int32 lod, osg::Geode* model)
+{
+  if (lod >= 0 && lod < (int32)Lods.size())
+  {
+    Lods[lod] = model;
+  }
+}
+
+osg::Geode* MeshLodNode::GetLod(int32 lod)
+{
+  if (!Lods[lod])
+  {
+    RenderModelCache& cache = RenderModelCache::Get();
+    Lods[lod] = cache.GetModel(Mesh, lod);
+    if (!Lods[lod] && Requested[lod] < MaxBuildAttempts && !cache.IsBuilding(Mesh, lod))
+    {
+      // Failed builds are retried a few times
+      Requested[lod]++;
+      cache.PrefetchModel(Mesh, lod, Package);
+    }
+  }
+  return Lods[lod].get();
+}
+
+void MeshLodNode::traverse(osg::NodeVisitor& nv)
+{
+  osgUtil::CullVisitor* cv = dynamic_cast<osgUtil::CullVisitor*>(&nv);
+  if (!cv)
+  {
+    // Update and intersection visitors get the finest built LOD. Only views request builds.
+    for (const osg::ref_ptr<osg::Geode>& model : Lods)
+    {
+      if (model)
+      {
+        model->accept(nv);
+        break;
+      }
+    }
+    return;
+  }
+
+  // Same metric as osg::LOD in PIXEL_SIZE_ON_SCREEN mode
+  const float pixelSize = cv->clampedPixelSize(getBound()) / cv->getLODScale();
+  const int32 lastLod = (int32)Lods.size() - 1;
+  int32 lod = 0;
+  while (lod < lastLod && lod < (int32)std::size(LodPixelSizes) && pixelSize < LodPixelSizes[lod])
+  {
+    ++lod;
+  }
+
+  osg::Geode* model = GetLod(lod);
+  // Fall back to built LODs, closest first, without requesting more builds
+  for (int32 offset = 1; !model && (lod - offset >= 0 || lod + offset <= lastLod); ++offset)
+  {
+    if (lod + offset <= lastLod && Lods[lod + offset])
+    {
+      model = Lods[lod + offset].get();
+    }
+    else if (lod - offset >= 0 && Lods[lod - offset])
+    {
+      model = Lods[lod - offset].get();
+    }
+  }
+  if (model)
+  {
+    model->accept(nv);
+  }
+}
+
+osg::BoundingSphere MeshLodNode::computeBound() const
+{
+  // Mesh bounds. Models may not be built yet.
+  return Bounds;
+}
+
+void MeshLodNode::resizeGLObjectBuffers(unsigned int maxSize)
+{
+  osg::Node::resizeGLObjectBuffers(maxSize);
+  for (const osg::ref_ptr<osg::Geode>& model : Lods)
+  {
+    if (model)
+    {
+      model->resizeGLObjectBuffers(maxSize);
+    }
+  }
+}
+
+void MeshLodNode::releaseGLObjects(osg::State* state) const
+{
+  osg::Node::releaseGLObjects(state);
+  for (const osg::ref_ptr<osg::Geode>& model : Lods)
+  {
+    if (model)
+    {
+      model->releaseGLObjects(state);
+    }
+  }
+}
@@ -0,0 +1,53 @@
+#pragma once
+#include <osg/Geode>
+
+#include <Tera/Core.h>
+
+#include <memory>
+#include <vector>
+
+class FPackage;
+class UObject;
+
+// Draws the LOD of a mesh that matches its size on the screen. One node is shared by all instances of the mesh.
+// LOD models come from RenderModelCache and are built on a worker thread the first time a view needs them.
+// Until then the closest built LOD is drawn.
+class MeshLodNode : public osg::Node {
+public:
+	MeshLodNode() = default;
+	MeshLodNode(UObject* mesh, int32 numLods, const osg::BoundingSphere& bounds, std::weak_ptr<FPackage> package);
+	MeshLodNode(const MeshLodNode& node, const osg::CopyOp& copyop = osg::CopyOp::SHALLOW_COPY);
+
+	META_Node(RE, MeshLodNode);
+
+	// A built model for the LOD. Draws it until a finer or coarser LOD is requested.
+	void SetLod(int32 lod, osg::Geode* model);
+
+	UObject* GetMesh() const
+	{
+		return Mesh;
+	}
+
+	void traverse(osg::NodeVisitor& nv) override;
+	osg::BoundingSphere computeBound() const override;
+
+	void resizeGLObjectBuffers(unsigned int maxSize) override;
+	void releaseGLObjects(osg::State* state = nullptr) const override;
+
+	// Screen size in pixels below which the next LOD is used
+	static constexpr float LodPixelSizes[] = { 250.f, 100.f, 40.f, 16.f };
+
+	// Build requests per LOD before a failed LOD is given up
+	static constexpr uint8 MaxBuildAttempts = 3;
+
+protected:
+	// Ready model of the LOD. Requests a build and returns nullptr if the LOD is not built yet.
+	osg::Geode* GetLod(int32 lod);
+
+	UObject* Mesh = nullptr;
+	std::weak_ptr<FPackage> Package;
+	osg::BoundingSphere Bounds;
+	std::vector<osg::ref_ptr<osg::Geode>> Lods;
+	// Build requests per LOD
+	std::vector<uint8> Requested;
+};
@@ -0,0 +1,184 @@
+#include "ObjectLoadQueue.h"
+#include "RenderModelCache.h"
+#include "../App.h"
+
+#include <Tera/Cast.h>
+#include <Tera/FPackage.h>
+#include <Tera/UObject.h>
+#include <Tera/USkeletalMesh.h>
+#include <Tera/UStaticMesh.h>
+
+#include <algorithm>
+
+namespace
+{
+  // Meshes need their materials and textures to build a model
+  bool IsMesh(UObject* object)
+  {
+    return Cast<UStaticMesh>(object) || Cast<USkeletalMesh>(object);
+  }
+}
+
+ObjectLoadQueue::ObjectLoadQueue(std::weak_ptr<FPackage> package, size_t numWorkers)
+  : Package(package)
+{
+  if (!numWorkers)
+  {
+    // Loads are mostly bound by reads and decompression of the same package. More workers only compete for the disk.
+    numWorkers = std::clamp<size_t>(std::thread::hardware_concurrency() / 4, 2, 4);
+  }
+  MaxPrefetches = std::max<size_t>(numWorkers - 1, 1);
+  for (size_t idx = 0; idx < numWorkers; ++idx)
+  {
+    Workers.emplace_back(&ObjectLoadQueue::WorkerMain, this);
+  }
+}
+
+ObjectLoadQueue::~ObjectLoadQueue()
+{
+  {
+    std::scoped_lock<std::mutex> lock(Mutex);
+    Stopping = true;
+    Selections.clear();
+    Prefetches.clear();
+  }
+  Condition.notify_all();
+  for (std::thread& worker : Workers)
+  {
+    worker.join();
+  }
+}
+
+void ObjectLoadQueue::Select(UObject* object, const std::string& editorId)
+{
+  if (!object)
+  {
+    return;
+  }
+  {
+    std::scoped_lock<std::mutex> lock(Mutex);
+    // Earlier selections and their neighbours are not needed anymore. Their editors request them again when selected.
+    Selections.clear();
+    Prefetches.clear();
+    auto it = Running.find(object);
+    if (it != Running.end())
+    {
+      it->second.push_back(editorId);
+      return;
+    }
+    // A loaded mesh may still miss its materials. Loading them again is cheap.
+    // An object loaded as a dependency of another request may be in its PostLoad. The worker waits for it.
+    if (!object->IsLoaded() || object->IsLoading() || IsMesh(object))
+    {
+      Request& request = Selections.emplace_back();
+      request.Object = object;
+      request.Waiting.push_back(editorId);
+      Condition.notify_one();
+      return;
+    }
+  }
+  SendEvent(wxTheApp, OBJECT_LOADED, editorId);
+}
+
+void ObjectLoadQueue::Prefetch(UObject* object)
+{
+  if (!object)
+  {
+    return;
+  }
+  std::scoped_lock<std::mutex> lock(Mutex);
+  if (object->IsLoaded() || Running.count(object) || std::find(Prefetches.begin(), Prefetches.end(), object) != Prefetches.end())
+  {
+    return;
+  }
+  for (const Request& request : Selections)
+  {
+    if (request.Object == object)
+    {
+      return;
+    }
+  }
+  Prefetches.push_back(object);
+  Condition.notify_one();
+}
+
+bool ObjectLoadQueue::IsPending(UObject* object)
+{
+  std::scoped_lock<std::mutex> lock(Mutex);
+  if (Running.count(object))
+  {
+    return true;
+  }
+  return std::find_if(Selections.begin(), Selections.end(), [object](const Request& request) {
+    return request.Object == object;
+  }) != Selections.end();
+}
+
+void ObjectLoadQueue::WorkerMain()
+{
+  while (true)
+  {
+    UObject* object = nullptr;
+    bool prefetch = false;
+    {
+      std::unique_lock<std::mutex> lock(Mutex);
+      Condition.wait(lock, [this] {
+        return Stopping || Selections.size() || (Prefetches.size() && RunningPrefetches < MaxPrefetches);
+      });
+      if (Stopping)
+      {
+        return;
+      }
+      if (Selections.size())
+      {
+        Request request = std::move(Selections.front());
+        Selections.pop_front();
+        object = request.Object;
+        Running[object] = std::move(request.Waiting);
+      }
+      else
+      {
+        object = Prefetches.front();
+        Prefetches.pop_front();
+        Running[object];
+        prefetch = true;
+        RunningPrefetches++;
+      }
+    }
+
+    // Dependencies are shared between requests. Load waits for the ones other workers are loading.
+    std::shared_ptr<FPackage> package = Package.lock();
+    if (package && IsMesh(object))
+    {
+      RenderModelCache::LoadDependencies(object);
+    }
+    else if (package)
+    {
+      object->Load();
+    }
+
+    std::vector<std::string> waiting;
+    {
+      std::scoped_lock<std::mutex> lock(Mutex);
+      auto it = Running.find(object);
+      waiting = std::move(it->second);
+      Running.erase(it);
+      if (prefetch)
+      {
+        RunningPrefetches--;
+      }
+    }
+    if (prefetch)
+    {
+      // A prefetch slot is free
+      Condition.notify_all();
+    }
+    if (package)
+    {
+      for (const std::string& id : waiting)
+      {
+        SendEvent(wxTheApp, OBJECT_LOADED, id);
+      }
+    }
+  }
+}
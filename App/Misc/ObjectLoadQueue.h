@@ -0,0 +1,57 @@
+#pragma once
+#include <Tera/Core.h>
+
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+class FPackage;
+class UObject;
+
+// Loads objects selected in a package window on a small pool of threads.
+// A selection drops the loads of earlier selections and their prefetches that have not started yet, so scrolling
+// through the object tree loads only the objects that stay selected. Prefetches run at a lower priority and always
+// leave a worker for selections. A load in progress can't be interrupted: editors that select an object being loaded
+// get their event when it finishes. Meshes are loaded with their materials and textures, so model builds don't load.
+// Workers may load the same dependency at once: UObject::Load waits for a load running on another thread.
+class ObjectLoadQueue {
+public:
+	ObjectLoadQueue(std::weak_ptr<FPackage> package, size_t numWorkers = 0);
+	// Drops pending loads and waits for the running ones
+	~ObjectLoadQueue();
+
+	// Load the object and send OBJECT_LOADED with the editorId to the app. Sent right away if the object is loaded.
+	void Select(UObject* object, const std::string& editorId);
+
+	// Load the object when a worker is free
+	void Prefetch(UObject* object);
+
+	// True if a selection of the object is queued or the object is being loaded. Dropped selections are not pending.
+	bool IsPending(UObject* object);
+
+private:
+	void WorkerMain();
+
+	struct Request {
+		UObject* Object = nullptr;
+		// Editors waiting for the object
+		std::vector<std::string> Waiting;
+	};
+
+	std::weak_ptr<FPackage> Package;
+	std::mutex Mutex;
+	std::condition_variable Condition;
+	std::deque<Request> Selections;
+	std::deque<UObject*> Prefetches;
+	// Objects being loaded and editors waiting for them
+	std::map<UObject*, std::vector<std::string>> Running;
+	size_t RunningPrefetches = 0;
+	size_t MaxPrefetches = 1;
+	bool Stopping = false;
+	std::vector<std::thread> Workers;
+};
@@ -8,6 +8,8 @@
 #include <Tera/UProperty.h>
 #include <Tera/Cast.h>
 
+#include <algorithm>
+
 inline wxString _GetPropertyName(FPropertyValue* v)
 {
   return v->Property->ClassProperty&& v->Property->ClassProperty->DisplayName.Size() ? v->Property->ClassProperty->DisplayName.WString() : v->Property->Name.String().WString();
@@ -84,6 +86,30 @@ inline wxString GetObjectNameForIndex(FPropertyValue* value)
   return wxT("NULL");
 }
 
+// Children of a collapsed category. Properties are created when the category is expanded.
+class APendingProperties : public wxClientData {
+public:
+  APendingProperties(FPropertyValue* value, int32 first, int32 count)
+    : Value(value)
+    , First(first)
+    , Count(count)
+  {}
+
+  FPropertyValue* Value = nullptr;
+  // Range of array elements
+  int32 First = 0;
+  int32 Count = 0;
+};
+
+static void DeferProperties(wxPropertyGridManager* mgr, wxPropertyCategory* cat, FPropertyValue* value, int32 first, int32 count)
+{
+  cat->SetClientObject(new APendingProperties(value, first, count));
+  // Categories without children can't be expanded
+  wxPGProperty* placeholder = new wxStringProperty(wxT("..."), GetPropertyId(value) + wxString::Format("_pending_%d", first));
+  placeholder->Enable(false);
+  mgr->AppendIn(cat, placeholder);
+}
+
 void CreateProperty(wxPropertyGridManager* mgr, wxPropertyCategory* cat, const std::vector<FPropertyTag*>& properties)
 {
   std::vector<wxPropertyCategory*> cats = { cat };
@@ -271,9 +297,9 @@ void CreateProperty(wxPropertyGridManager* mgr, wxPropertyCategory* cat, FProper
         ncat->SetHelpString(value->Property->ClassProperty->GetToolTip().WString());
       }
 
-      for (int32 aidx = 0; aidx < arr.size(); ++aidx)
+      if (arr.size())
       {
-        CreateProperty(mgr, ncat, arr[aidx], aidx);
+        DeferProperties(mgr, ncat, value, 0, (int32)arr.size());
       }
     }
   }
@@ -307,28 +333,69 @@ void CreateProperty(wxPropertyGridManager* mgr, wxPropertyCategory* cat, FProper
     {
       ncat->SetHelpString(value->Property->ClassProperty->GetToolTip().WString());
     }
-    std::vector<FPropertyValue*> arr = value->GetArray();
+    if (value->GetArray().size())
+    {
+      DeferProperties(mgr, ncat, value, 0, (int32)value->GetArray().size());
+    }
+  }
+}
 
-    if (arr.size())
+bool CreateDeferredProperties(wxPropertyGridManager* mgr, wxPGProperty* prop)
+{
+  APendingProperties* pending = prop ? dynamic_cast<APendingProperties*>(prop->GetClientObject()) : nullptr;
+  wxPropertyCategory* cat = wxDynamicCast(prop, wxPropertyCategory);
+  if (!pending || !cat)
+  {
+    return false;
+  }
+  FPropertyValue* value = pending->Value;
+  const int32 first = pending->First;
+  const int32 count = pending->Count;
+  prop->SetClientObject(nullptr);
+  // Remove the placeholder
+  prop->DeleteChildren();
+
+  const std::vector<FPropertyValue*>& arr = value->GetArray();
+  if (value->Type == FPropertyValue::VID::Struct)
+  {
+    if (arr.front()->Type == FPropertyValue::VID::Property)
     {
-      if (arr.front()->Type == FPropertyValue::VID::Property)
+      std::vector<FPropertyTag*> props;
+      for (FPropertyValue* v : arr)
       {
-        std::vector<FPropertyTag*> props;
-        for (FPropertyValue* v : arr)
-        {
-          props.push_back(v->GetPropertyTagPtr());
-        }
-        CreateProperty(mgr, ncat, props);
+        props.push_back(v->GetPropertyTagPtr());
       }
-      else
+      CreateProperty(mgr, cat, props);
+    }
+    else
+    {
+      for (FPropertyValue* v : arr)
       {
-        for (FPropertyValue* v : arr)
-        {
-          CreateProperty(mgr, ncat, v);
-        }
+        CreateProperty(mgr, cat, v);
       }
     }
   }
+  else if (count > ArrayPropertiesPageSize)
+  {
+    // Split large arrays into pages. Each page creates its elements when it is expanded.
+    for (int32 page = first; page < first + count; page += ArrayPropertiesPageSize)
+    {
+      const int32 pageCount = std::min(ArrayPropertiesPageSize, first + count - page);
+      wxPropertyCategory* pcat = new wxPropertyCategory(wxString::Format("[%d - %d]", page, page + pageCount - 1), GetPropertyId(value) + wxString::Format("_%d", page));
+      pcat->Enable(cat->IsEnabled());
+      pcat->SetExpanded(false);
+      mgr->AppendIn(cat, pcat);
+      DeferProperties(mgr, pcat, value, page, pageCount);
+    }
+  }
+  else
+  {
+    for (int32 aidx = first; aidx < first + count && aidx < (int32)arr.size(); ++aidx)
+    {
+      CreateProperty(mgr, cat, arr[aidx], aidx);
+    }
+  }
+  return true;
 }
 
 class ObjPropEditDialog : public wxDialog {
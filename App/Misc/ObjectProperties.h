@@ -6,6 +6,11 @@
 
 extern void CreateProperty(wxPropertyGridManager* mgr, wxPropertyCategory* cat, const std::vector<FPropertyTag*>& tags);
 extern void CreateProperty(wxPropertyGridManager* mgr, wxPropertyCategory* cat, FPropertyValue* value, int32 idx = -1);
+// Create children of a collapsed struct or array category. Returns false if they exist already.
+extern bool CreateDeferredProperties(wxPropertyGridManager* mgr, wxPGProperty* prop);
+
+// Array categories with more elements are split into pages
+constexpr int32 ArrayPropertiesPageSize = 100;
 
 class AIntProperty : public wxIntProperty {
 public:
@@ -4,6 +4,10 @@
 
 #include <Tera/Core.h>
 #include <Tera/FObjectResource.h>
+#include <Tera/FPackage.h>
+
+#include <algorithm>
+#include <cctype>
 
 enum ClassIco : int {
 	IcoPackage = 0,
@@ -74,24 +78,16 @@ ClassIco ObjectClassToClassIco(const wxString& className)
 	return IcoGeneric;
 }
 
-ObjectTreeNode::ObjectTreeNode(const std::string& name, std::vector<FObjectExport*> exps)
+ObjectTreeNode::ObjectTreeNode(const std::string& name, const std::vector<FObjectExport*>& exps)
+	: RootExports(exps)
 {
 	Name = A2W(name);
-	for (FObjectExport* exp : exps)
-	{
-		ObjectTreeNode* child = new ObjectTreeNode(this, exp);
-		Children.Add(child);
-	}
 }
 
-ObjectTreeNode::ObjectTreeNode(std::vector<FObjectImport*> imps)
+ObjectTreeNode::ObjectTreeNode(const std::vector<FObjectImport*>& imps)
+	: RootImports(imps)
 {
 	Name = wxT("Imports");
-	for (FObjectImport* imp : imps)
-	{
-		ObjectTreeNode* child = new ObjectTreeNode(this, imp);
-		Children.Add(child);
-	}
 }
 
 ObjectTreeNode::ObjectTreeNode(ObjectTreeNode* parent, FObjectExport* exp)
@@ -99,11 +95,6 @@ ObjectTreeNode::ObjectTreeNode(ObjectTreeNode* parent, FObjectExport* exp)
 	, Parent(parent)
 {
 	Resource = (FObjectResource*)exp;
-	for (FObjectExport* expChild : exp->Inner)
-	{
-		ObjectTreeNode* child = new ObjectTreeNode(this, expChild);
-		Children.Add(child);
-	}
 }
 
 ObjectTreeNode::ObjectTreeNode(ObjectTreeNode* parent, FObjectImport* imp)
@@ -111,11 +102,6 @@ ObjectTreeNode::ObjectTreeNode(ObjectTreeNode* parent, FObjectImport* imp)
 	, Parent(parent)
 {
 	Resource = (FObjectResource*)imp;
-	for (FObjectImport* impChild : imp->Inner)
-	{
-		ObjectTreeNode* child = new ObjectTreeNode(this, impChild);
-		Children.Add(child);
-	}
 }
 
 wxString ObjectTreeNode::GetObjectName() const
@@ -133,35 +119,57 @@ PACKAGE_INDEX ObjectTreeNode::GetObjectIndex() const
 	return Resource ? Resource->ObjectIndex : CustomObjectIndex;
 }
 
-void ObjectTreeNode::Append(ObjectTreeNode* child)
+void ObjectTreeNode::Populate()
 {
-	Children.Add(child);
+	if (Populated)
+	{
+		return;
+	}
+	Populated = true;
+	const std::vector<FObjectExport*>& exports = Export ? Export->Inner : RootExports;
+	const std::vector<FObjectImport*>& imports = Import ? Import->Inner : RootImports;
+	Children.Alloc(exports.size() + imports.size());
+	for (FObjectExport* exp : exports)
+	{
+		Children.Add(new ObjectTreeNode(this, exp));
+	}
+	for (FObjectImport* imp : imports)
+	{
+		Children.Add(new ObjectTreeNode(this, imp));
+	}
 }
 
-ObjectTreeNode* ObjectTreeNode::FindItemByObjectIndex(PACKAGE_INDEX index)
+bool ObjectTreeNode::HasChildren(const std::unordered_set<FObjectResource*>* visible) const
 {
-  if (index > 0)
-  {
-    if (Export && Export->ObjectIndex == index)
-    {
-      return this;
-    }
-  }
-  else if (index < 0)
-  {
-    if (Import && Import->ObjectIndex == index)
-    {
-      return this;
-    }
-  }
-  for (ObjectTreeNode* child : Children)
-  {
-    if (ObjectTreeNode* result = child->FindItemByObjectIndex(index))
-    {
-      return result;
-    }
-  }
-  return nullptr;
+	const std::vector<FObjectExport*>& exports = Export ? Export->Inner : RootExports;
+	const std::vector<FObjectImport*>& imports = Import ? Import->Inner : RootImports;
+	if (!visible)
+	{
+		return exports.size() || imports.size();
+	}
+	for (FObjectExport* exp : exports)
+	{
+		if (visible->count(exp))
+		{
+			return true;
+		}
+	}
+	for (FObjectImport* imp : imports)
+	{
+		if (visible->count(imp))
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+void ObjectTreeNode::GetChildResources(std::vector<FObjectResource*>& output) const
+{
+	const std::vector<FObjectExport*>& exports = Export ? Export->Inner : RootExports;
+	const std::vector<FObjectImport*>& imports = Import ? Import->Inner : RootImports;
+	output.insert(output.end(), exports.begin(), exports.end());
+	output.insert(output.end(), imports.begin(), imports.end());
 }
 
 ObjectTreeModel::ObjectTreeModel(const std::string& packageName, std::vector<FObjectExport*>& rootExports, std::vector<FObjectImport*>& rootImports)
@@ -171,6 +179,24 @@ ObjectTreeModel::ObjectTreeModel(const std::string& packageName, std::vector<FOb
 	{
 		RootImport = new ObjectTreeNode(rootImports);
 	}
+	if (rootExports.size())
+	{
+		Package = rootExports.front()->Package;
+	}
+	else if (rootImports.size())
+	{
+		Package = rootImports.front()->Package;
+	}
+}
+
+// Shared by all models
+static wxImageList* GetIconList()
+{
+	static wxImageList* IconList = nullptr;
+	if (IconList)
+	{
+		return IconList;
+	}
 	IconList = new wxImageList(16, 16, true, 2);
 	
 	// ORDER MATTERS!!!
@@ -214,6 +240,7 @@ ObjectTreeModel::ObjectTreeModel(const std::string& packageName, std::vector<FOb
 
 	// MaterialInstance icon
 	IconList->Add(wxBitmap("#126", wxBITMAP_TYPE_PNG_RESOURCE));
+	return IconList;
 }
 
 void ObjectTreeModel::GetValue(wxVariant& variant, const wxDataViewItem& item, unsigned int col) const
@@ -223,11 +250,11 @@ void ObjectTreeModel::GetValue(wxVariant& variant, const wxDataViewItem& item, u
 	if (!node->GetParent() || node->GetClassName() == wxS("Package"))
 	{
 		bool isImp = node->GetObjectIndex() == FAKE_IMPORT_ROOT;
-		value.SetIcon(IconList->GetIcon(isImp ? IcoPackageImp : IcoPackage));
+		value.SetIcon(GetIconList()->GetIcon(isImp ? IcoPackageImp : IcoPackage));
 	}
 	else
 	{
-		value.SetIcon(IconList->GetIcon(ObjectClassToClassIco(node->GetClassName())));
+		value.SetIcon(GetIconList()->GetIcon(ObjectClassToClassIco(node->GetClassName())));
 	}
 	variant << value;
 }
@@ -250,7 +277,7 @@ bool ObjectTreeModel::IsContainer(const wxDataViewItem& item) const
 	{
 		return true;
 	}
-	return node->GetChildren().GetCount();
+	return node->HasChildren(Filter.size() ? &FilterVisible : nullptr);
 }
 
 unsigned int ObjectTreeModel::GetChildren(const wxDataViewItem& parent, wxDataViewItemArray& array) const
@@ -265,30 +292,129 @@ unsigned int ObjectTreeModel::GetChildren(const wxDataViewItem& parent, wxDataVi
 		}
 		return array.size();
 	}
-	if (!node->GetChildren().GetCount())
+	ObjectTreeNodePtrArray& children = PopulateNode(node);
+	unsigned int count = 0;
+	array.reserve(array.size() + children.GetCount());
+	for (ObjectTreeNode* child : children)
 	{
-		return 0;
-	}
-	unsigned int count = node->GetChildren().GetCount();
-	for (unsigned int pos = 0; pos < count; pos++)
-	{
-		ObjectTreeNode* child = node->GetChildren().Item(pos);
-		array.Add(wxDataViewItem((void*)child));
+		if (Filter.empty() || FilterVisible.count(child->GetResource()))
+		{
+			array.Add(wxDataViewItem((void*)child));
+			count++;
+		}
 	}
 	return count;
 }
 
 ObjectTreeNode* ObjectTreeModel::FindItemByObjectIndex(PACKAGE_INDEX index)
 {
-	if (index > 0)
+	auto it = NodeIndex.find(index);
+	if (it != NodeIndex.end())
+	{
+		return it->second;
+	}
+	ObjectTreeNode* node = index > 0 ? RootExport : RootImport;
+	FObjectResource* resource = Package && index && index != FAKE_EXPORT_ROOT && index != FAKE_IMPORT_ROOT ? Package->GetResourceObject(index) : nullptr;
+	if (!node || !resource)
+	{
+		return nullptr;
+	}
+	// Expand the outers from the root
+	std::vector<FObjectResource*> outers;
+	for (FObjectResource* outer = resource; outer; outer = outer->GetOuter())
+	{
+		outers.push_back(outer);
+	}
+	for (auto outerIt = outers.rbegin(); outerIt != outers.rend(); ++outerIt)
+	{
+		PopulateNode(node);
+		it = NodeIndex.find((*outerIt)->ObjectIndex);
+		if (it == NodeIndex.end())
+		{
+			// The outer is not in this tree
+			return nullptr;
+		}
+		node = it->second;
+	}
+	return node;
+}
+
+void ObjectTreeModel::SetFilter(const wxString& filter)
+{
+	std::string upper = filter.Strip(wxString::both).ToStdString();
+	std::transform(upper.begin(), upper.end(), upper.begin(), [](unsigned char c) { return std::toupper(c); });
+	if (upper == Filter)
+	{
+		return;
+	}
+
+	std::vector<FObjectResource*> candidates;
+	if (Filter.size() && upper.find(Filter) != std::string::npos)
+	{
+		// Narrowed. Names without the previous filter can't contain this one.
+		candidates = std::move(FilterMatches);
+	}
+	else if (upper.size())
 	{
-		return RootExport->FindItemByObjectIndex(index);
+		std::vector<ObjectTreeNode*> roots = { RootExport };
+		if (RootImport)
+		{
+			roots.push_back(RootImport);
+		}
+		std::vector<FObjectResource*> stack;
+		for (ObjectTreeNode* root : roots)
+		{
+			root->GetChildResources(stack);
+		}
+		// Walk the objects instead of the nodes, so the search doesn't create them
+		while (stack.size())
+		{
+			FObjectResource* resource = stack.back();
+			stack.pop_back();
+			candidates.push_back(resource);
+			if (resource->ObjectIndex > 0)
+			{
+				const std::vector<FObjectExport*>& inner = ((FObjectExport*)resource)->Inner;
+				stack.insert(stack.end(), inner.begin(), inner.end());
+			}
+			else
+			{
+				const std::vector<FObjectImport*>& inner = ((FObjectImport*)resource)->Inner;
+				stack.insert(stack.end(), inner.begin(), inner.end());
+			}
+		}
 	}
-	else if (index < 0 && RootImport)
+
+	Filter = upper;
+	FilterMatches.clear();
+	FilterVisible.clear();
+	for (FObjectResource* resource : candidates)
 	{
-		return RootImport->FindItemByObjectIndex(index);
+		if (resource->GetObjectName().ToUpper().String().find(Filter) != std::string::npos)
+		{
+			FilterMatches.push_back(resource);
+			for (FObjectResource* outer = resource; outer && FilterVisible.insert(outer).second; outer = outer->GetOuter());
+		}
+	}
+	Cleared();
+}
+
+bool ObjectTreeModel::IsVisible(ObjectTreeNode* node) const
+{
+	return node && (Filter.empty() || !node->GetResource() || FilterVisible.count(node->GetResource()));
+}
+
+ObjectTreeNodePtrArray& ObjectTreeModel::PopulateNode(ObjectTreeNode* node) const
+{
+	if (!node->IsPopulated())
+	{
+		node->Populate();
+		for (ObjectTreeNode* child : node->GetChildren())
+		{
+			NodeIndex.emplace(child->GetObjectIndex(), child);
+		}
 	}
-	return nullptr;
+	return node->GetChildren();
 }
 
 void ObjectTreeDataViewCtrl::OnSize(wxSizeEvent& e)
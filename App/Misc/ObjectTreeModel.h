@@ -2,7 +2,10 @@
 #include <wx/dataview.h>
 #include <vector>
 #include <string>
+#include <unordered_map>
+#include <unordered_set>
 
+class FPackage;
 class FObjectResource;
 class FObjectExport;
 class FObjectImport;
@@ -17,8 +20,8 @@ WX_DEFINE_ARRAY_PTR(ObjectTreeNode*, ObjectTreeNodePtrArray);
 class ObjectTreeNode {
 public:
 
-	ObjectTreeNode(const std::string& name, std::vector<FObjectExport*> exps);
-	ObjectTreeNode(std::vector<FObjectImport*> imps);
+	ObjectTreeNode(const std::string& name, const std::vector<FObjectExport*>& exps);
+	ObjectTreeNode(const std::vector<FObjectImport*>& imps);
 
 	ObjectTreeNode(ObjectTreeNode* parent, FObjectExport* exp);
 
@@ -43,19 +46,35 @@ public:
 	wxString GetClassName() const;
 	PACKAGE_INDEX GetObjectIndex() const;
 
+	FObjectResource* GetResource() const
+	{
+		return Resource;
+	}
+
 	ObjectTreeNode* GetParent()
 	{
 		return Parent;
 	}
 
+	// Empty until the node is populated
 	ObjectTreeNodePtrArray& GetChildren()
 	{
 		return Children;
 	}
 
-	void Append(ObjectTreeNode* child);
+	bool IsPopulated() const
+	{
+		return Populated;
+	}
 
-	ObjectTreeNode* FindItemByObjectIndex(PACKAGE_INDEX index);
+	// Create nodes for the inner objects. Nodes are never removed, so pointers to them stay valid.
+	void Populate();
+
+	// Check inner objects without creating their nodes. If visible is not null, only objects in it count.
+	bool HasChildren(const std::unordered_set<FObjectResource*>* visible = nullptr) const;
+
+	// Append inner objects without creating their nodes
+	void GetChildResources(std::vector<FObjectResource*>& output) const;
 
 private:
 	FObjectExport* Export = nullptr;
@@ -63,8 +82,13 @@ private:
 	FObjectResource* Resource = nullptr;
 	PACKAGE_INDEX CustomObjectIndex = 0;
 
+	// Children of the root nodes
+	std::vector<FObjectExport*> RootExports;
+	std::vector<FObjectImport*> RootImports;
+
 	ObjectTreeNode* Parent = nullptr;
 	ObjectTreeNodePtrArray Children;
+	bool Populated = false;
 	wxString Name;
 };
 
@@ -76,7 +100,6 @@ public:
 	{
 		delete RootExport;
 		delete RootImport;
-		delete IconList;
 	}
 
 	unsigned int GetColumnCount() const override
@@ -112,8 +135,25 @@ public:
 
 	unsigned int GetChildren(const wxDataViewItem& parent, wxDataViewItemArray& array) const override;
 
+	// Creates the nodes of the object's outers if they were not expanded yet
 	ObjectTreeNode* FindItemByObjectIndex(PACKAGE_INDEX index);
 
+	// Show only objects whose names contain the filter and their outers. Case-insensitive. An empty filter shows all.
+	// A filter that contains the previous one checks only the previous matches.
+	void SetFilter(const wxString& filter);
+
+	bool IsFiltered() const
+	{
+		return Filter.size();
+	}
+
+	const std::vector<FObjectResource*>& GetFilterMatches() const
+	{
+		return FilterMatches;
+	}
+
+	bool IsVisible(ObjectTreeNode* node) const;
+
 	ObjectTreeNode* GetRootExport() const
 	{
 		return RootExport;
@@ -125,9 +165,20 @@ public:
   }
 
 private:
+	// Populate the node and index its children
+	ObjectTreeNodePtrArray& PopulateNode(ObjectTreeNode* node) const;
+
+	FPackage* Package = nullptr;
 	ObjectTreeNode* RootExport = nullptr;
 	ObjectTreeNode* RootImport = nullptr;
-	wxImageList* IconList = nullptr;
+	// Created nodes by their object index
+	mutable std::unordered_map<PACKAGE_INDEX, ObjectTreeNode*> NodeIndex;
+
+	// Upper case
+	std::string Filter;
+	std::vector<FObjectResource*> FilterMatches;
+	// Matches and their outers
+	std::unordered_set<FObjectResource*> FilterVisible;
 };
 
 class ObjectTreeDataViewCtrl : public wxDataViewCtrl {
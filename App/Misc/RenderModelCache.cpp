@@ -0,0 +1,485 @@
+#include "RenderModelCache.h"
+#include "../App.h"
+
+#include <osg/BlendFunc>
+#include <osg/Geometry>
+
+#include <Tera/Cast.h>
+#include <Tera/FPackage.h>
+#include <Tera/UMaterial.h>
+#include <Tera/USkeletalMesh.h>
+#include <Tera/UStaticMesh.h>
+#include <Tera/UTexture.h>
+
+#include <Utils/VertexDecoder.h>
+
+#include <algorithm>
+#include <ppltasks.h>
+
+namespace
+{
+  struct SectionRange {
+    uint32 FirstIndex = 0;
+    uint32 NumTriangles = 0;
+    UObject* Material = nullptr;
+  };
+
+  // Drawable sections of a LOD. Model drawables are created in the same order.
+  std::vector<SectionRange> GetSections(const UStaticMesh* mesh, int32 lod)
+  {
+    std::vector<SectionRange> result;
+    const FStaticMeshRenderData* model = mesh ? mesh->GetLod(lod) : nullptr;
+    if (!model)
+    {
+      return result;
+    }
+    const uint64 numIndices = model->IndexBuffer.GetElementCount();
+    for (const FStaticMeshElement& element : model->GetElements())
+    {
+      if (element.NumTriangles && (uint64)element.FirstIndex + (uint64)element.NumTriangles * 3 <= numIndices)
+      {
+        result.push_back({ element.FirstIndex, element.NumTriangles, element.Material });
+      }
+    }
+    return result;
+  }
+
+  std::vector<SectionRange> GetSections(const USkeletalMesh* mesh, int32 lod)
+  {
+    std::vector<SectionRange> result;
+    const FStaticLODModel* model = mesh ? mesh->GetLod(lod) : nullptr;
+    if (!model)
+    {
+      return result;
+    }
+    // TODO: Use MaterialMap to remap section materials to the global materials list
+    const std::vector<UObject*> materials = mesh->GetMaterials();
+    const uint64 numIndices = model->GetIndexContainer()->GetElementCount();
+    for (const FSkelMeshSection* section : model->GetSections())
+    {
+      if (section->NumTriangles && (uint64)section->BaseIndex + (uint64)section->NumTriangles * 3 <= numIndices)
+      {
+        result.push_back({ section->BaseIndex, section->NumTriangles, section->MaterialIndex < materials.size() ? materials[section->MaterialIndex] : nullptr });
+      }
+    }
+    return result;
+  }
+
+  std::vector<SectionRange> GetSections(UObject* mesh, int32 lod)
+  {
+    if (const UStaticMesh* staticMesh = Cast<UStaticMesh>(mesh))
+    {
+      return GetSections(staticMesh, lod);
+    }
+    return GetSections(Cast<USkeletalMesh>(mesh), lod);
+  }
+
+  // 16-bit buffers stay 16-bit on the GPU
+  template <typename T>
+  osg::ref_ptr<osg::PrimitiveSet> CreatePrimitive(const T& indexBuffer, const SectionRange& section)
+  {
+    const uint32 count = section.NumTriangles * 3;
+    if (indexBuffer.GetElementSize() == sizeof(uint16))
+    {
+      osg::ref_ptr<osg::DrawElementsUShort> indices = new osg::DrawElementsUShort(GL_TRIANGLES, count);
+      for (uint32 idx = 0; idx < count; ++idx)
+      {
+        (*indices)[idx] = (uint16)indexBuffer.GetIndex(section.FirstIndex + idx);
+      }
+      return indices;
+    }
+    osg::ref_ptr<osg::DrawElementsUInt> indices = new osg::DrawElementsUInt(GL_TRIANGLES, count);
+    for (uint32 idx = 0; idx < count; ++idx)
+    {
+      (*indices)[idx] = indexBuffer.GetIndex(section.FirstIndex + idx);
+    }
+    return indices;
+  }
+
+  template <typename T>
+  osg::ref_ptr<osg::Geode> CreateGeode(const VertexDecoder::Streams& streams, const T& indexBuffer, const std::vector<SectionRange>& sections)
+  {
+    osg::ref_ptr<osg::Vec3Array> vertices = new osg::Vec3Array;
+    osg::ref_ptr<osg::Vec3Array> normals = new osg::Vec3Array(osg::Array::BIND_PER_VERTEX);
+    osg::ref_ptr<osg::Vec2Array> uvs = new osg::Vec2Array(osg::Array::BIND_PER_VERTEX);
+    vertices->resize(streams.NumVertices);
+    normals->resize(streams.NumVertices);
+    uvs->resize(streams.NumVertices);
+    for (uint32 idx = 0; idx < streams.NumVertices; ++idx)
+    {
+      const FVector& normal = streams.TangentsZ[idx];
+      const FVector& position = streams.Positions[idx];
+      (*normals)[idx].set(normal.X, -normal.Y, normal.Z);
+      (*vertices)[idx].set(position.X, -position.Y, position.Z);
+      (*uvs)[idx].set(streams.UVs[0][idx].X, streams.UVs[0][idx].Y);
+    }
+
+    osg::ref_ptr<osg::Geode> result = new osg::Geode;
+    for (const SectionRange& section : sections)
+    {
+      osg::ref_ptr<osg::Geometry> geo = new osg::Geometry;
+      geo->addPrimitiveSet(CreatePrimitive(indexBuffer, section).get());
+      geo->setVertexArray(vertices.get());
+      geo->setNormalArray(normals.get());
+      geo->setTexCoordArray(0, uvs.get());
+      result->addDrawable(geo.get());
+    }
+    return result;
+  }
+}
+
+RenderModelCache& RenderModelCache::Get()
+{
+  static RenderModelCache cache;
+  return cache;
+}
+
+void RenderModelCache::RequestModel(UObject* mesh, std::weak_ptr<FPackage> package, const std::string& editorId)
+{
+  StartBuild(mesh, 0, package, editorId);
+}
+
+void RenderModelCache::PrefetchModel(UObject* mesh, int32 lod, std::weak_ptr<FPackage> package)
+{
+  StartBuild(mesh, lod, package, std::string());
+}
+
+bool RenderModelCache::IsBuilding(UObject* mesh, int32 lod)
+{
+  std::scoped_lock<std::mutex> lock(ModelsMutex);
+  PurgeExpired();
+  auto it = Models.find({ mesh, lod });
+  return it != Models.end() && it->second.Building;
+}
+
+osg::ref_ptr<osg::Geode> RenderModelCache::GetModel(UObject* mesh, int32 lod)
+{
+  std::scoped_lock<std::mutex> lock(ModelsMutex);
+  PurgeExpired();
+  auto it = Models.find({ mesh, lod });
+  if (it == Models.end() || !it->second.Ready || it->second.Package.expired())
+  {
+    return nullptr;
+  }
+  return it->second.Model;
+}
+
+osg::ref_ptr<osg::Geode> RenderModelCache::AcquireModel(UObject* mesh, std::weak_ptr<FPackage> package, int32 lod)
+{
+  const ModelKey key(mesh, lod);
+  {
+    std::scoped_lock<std::mutex> lock(ModelsMutex);
+    PurgeExpired();
+    auto it = Models.find(key);
+    if (it != Models.end() && it->second.Ready && !it->second.Package.expired())
+    {
+      return it->second.Model;
+    }
+  }
+
+  osg::ref_ptr<osg::Geode> model = BuildModel(mesh, lod);
+  if (!model)
+  {
+    return nullptr;
+  }
+
+  std::scoped_lock<std::mutex> lock(ModelsMutex);
+  PurgeExpired();
+  ModelEntry& entry = Models[key];
+  if (entry.Ready && !entry.Package.expired())
+  {
+    // Another thread has built the model first
+    return entry.Model;
+  }
+  if (!entry.Building)
+  {
+    entry.Package = package;
+    entry.Model = model;
+    entry.Ready = true;
+    TrackPackage(package);
+  }
+  // Otherwise a worker is building the same model. Keep this one private.
+  return model;
+}
+
+void RenderModelCache::RefreshMaterials(UObject* mesh)
+{
+  std::vector<std::pair<int32, osg::ref_ptr<osg::Geode>>> models;
+  {
+    std::scoped_lock<std::mutex> lock(ModelsMutex);
+    PurgeExpired();
+    for (auto it = Models.lower_bound({ mesh, 0 }); it != Models.end() && it->first.first == mesh; ++it)
+    {
+      if (it->second.Ready && !it->second.Package.expired())
+      {
+        models.emplace_back(it->first.second, it->second.Model);
+      }
+    }
+  }
+  for (auto& [lod, model] : models)
+  {
+    ApplyMaterials(mesh, lod, model.get());
+  }
+}
+
+osg::ref_ptr<osg::Texture2D> RenderModelCache::GetDiffuseTexture(UMaterialInterface* material)
+{
+  UTexture2D* texture = material ? material->GetDiffuseTexture() : nullptr;
+  if (!texture)
+  {
+    return nullptr;
+  }
+  const uint32 generation = texture->GetDataGeneration();
+  osg::ref_ptr<osg::Texture2D> result;
+  {
+    std::scoped_lock<std::mutex> lock(TexturesMutex);
+    auto it = Textures.find(texture);
+    if (it != Textures.end() && it->second.Generation == generation && it->second.Texture.lock(result))
+    {
+      return result;
+    }
+  }
+  // Render without the lock. Two threads may render the same texture, the first result is kept.
+  osg::ref_ptr<osg::Image> img = new osg::Image;
+  if (!texture->RenderTo(img.get()))
+  {
+    return nullptr;
+  }
+  osg::ref_ptr<osg::Texture2D> rendered = new osg::Texture2D(img);
+  rendered->setWrap(osg::Texture::WrapParameter::WRAP_S, osg::Texture::WrapMode::REPEAT);
+  rendered->setWrap(osg::Texture::WrapParameter::WRAP_T, osg::Texture::WrapMode::REPEAT);
+  std::scoped_lock<std::mutex> lock(TexturesMutex);
+  TextureEntry& entry = Textures[texture];
+  // Keep a newer image rendered by another thread
+  if (entry.Generation >= generation && entry.Texture.lock(result))
+  {
+    return result;
+  }
+  entry.Texture = rendered;
+  entry.Generation = generation;
+  return rendered;
+}
+
+osg::ref_ptr<osg::Geode> RenderModelCache::BuildModel(UObject* mesh, int32 lod)
+{
+  osg::ref_ptr<osg::Geode> model;
+  if (const UStaticMesh* staticMesh = Cast<UStaticMesh>(mesh))
+  {
+    model = BuildModel(staticMesh, lod);
+  }
+  else if (const USkeletalMesh* skelMesh = Cast<USkeletalMesh>(mesh))
+  {
+    model = BuildModel(skelMesh, lod);
+  }
+  if (model)
+  {
+    ApplyMaterials(mesh, lod, model.get());
+  }
+  return model;
+}
+
+void RenderModelCache::LoadDependencies(UObject* mesh)
+{
+  if (!mesh)
+  {
+    return;
+  }
+  mesh->Load();
+  int32 lodCount = 0;
+  if (const UStaticMesh* staticMesh = Cast<UStaticMesh>(mesh))
+  {
+    lodCount = staticMesh->GetLodCount();
+  }
+  else if (const USkeletalMesh* skelMesh = Cast<USkeletalMesh>(mesh))
+  {
+    lodCount = skelMesh->GetLodCount();
+  }
+  for (int32 lod = 0; lod < lodCount; ++lod)
+  {
+    for (const SectionRange& section : GetSections(mesh, lod))
+    {
+      UMaterialInterface* material = Cast<UMaterialInterface>(section.Material);
+      if (!material)
+      {
+        continue;
+      }
+      material->Load();
+      // Parents are loaded on the way
+      material->GetBlendMode();
+      UObject::LoadObject(material->GetDiffuseTexture());
+    }
+  }
+}
+
+osg::ref_ptr<osg::Geode> RenderModelCache::BuildModel(const UStaticMesh* mesh, int32 lod)
+{
+  const FStaticMeshRenderData* model = mesh ? mesh->GetLod(lod) : nullptr;
+  if (!model)
+  {
+    return nullptr;
+  }
+  VertexDecoder::Streams streams;
+  if (!VertexDecoder::Decode(model, streams))
+  {
+    return nullptr;
+  }
+  return CreateGeode(streams, model->IndexBuffer, GetSections(mesh, lod));
+}
+
+osg::ref_ptr<osg::Geode> RenderModelCache::BuildModel(const USkeletalMesh* mesh, int32 lod)
+{
+  const FStaticLODModel* model = mesh ? mesh->GetLod(lod) : nullptr;
+  if (!model)
+  {
+    return nullptr;
+  }
+  VertexDecoder::Streams streams;
+  VertexDecoder::Decode(model, streams);
+  return CreateGeode(streams, *model->GetIndexContainer(), GetSections(mesh, lod));
+}
+
+void RenderModelCache::ApplyMaterials(UObject* mesh, int32 lod, osg::Geode* model)
+{
+  std::vector<SectionRange> sections = GetSections(mesh, lod);
+  if (sections.size() != model->getNumDrawables())
+  {
+    return;
+  }
+  for (size_t idx = 0; idx < sections.size(); ++idx)
+  {
+    osg::Drawable* geo = model->getDrawable((unsigned int)idx);
+    geo->setStateSet(nullptr);
+    UMaterialInterface* material = Cast<UMaterialInterface>(sections[idx].Material);
+    if (osg::ref_ptr<osg::Texture2D> osgtex = GetDiffuseTexture(material))
+    {
+      geo->getOrCreateStateSet()->setTextureAttributeAndModes(0, osgtex.get());
+      if (material->GetBlendMode() == EBlendMode::BLEND_Masked)
+      {
+        geo->getOrCreateStateSet()->setAttributeAndModes(new osg::BlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA));
+        geo->getOrCreateStateSet()->setRenderingHint(osg::StateSet::TRANSPARENT_BIN);
+      }
+    }
+  }
+}
+
+void RenderModelCache::StartBuild(UObject* mesh, int32 lod, std::weak_ptr<FPackage> package, const std::string& editorId)
+{
+  const ModelKey key(mesh, lod);
+  uint32 buildId = 0;
+  {
+    std::scoped_lock<std::mutex> lock(ModelsMutex);
+    PurgeExpired();
+    auto it = Models.find(key);
+    if (it != Models.end())
+    {
+      if (it->second.Ready)
+      {
+        if (editorId.size())
+        {
+          SendEvent(wxTheApp, OBJECT_LOADED, editorId);
+        }
+      }
+      else if (editorId.size())
+      {
+        it->second.Waiting.push_back(editorId);
+      }
+      return;
+    }
+    ModelEntry& entry = Models[key];
+    entry.Package = package;
+    entry.Building = true;
+    entry.BuildId = buildId = ++NextBuildId;
+    if (editorId.size())
+    {
+      entry.Waiting.push_back(editorId);
+    }
+    TrackPackage(package);
+  }
+
+  // Builds run on the PPL pool. Level views may prefetch many LODs at once.
+  // Builds never load objects, so they don't block pool threads on loads. Meshes must be loaded with LoadDependencies.
+  concurrency::create_task([this, key, package, buildId] {
+    osg::ref_ptr<osg::Geode> model;
+    auto l = package.lock();
+    if (l && key.first->IsLoaded())
+    {
+      model = BuildModel(key.first, key.second);
+    }
+
+    std::vector<std::string> waiting;
+    {
+      std::scoped_lock<std::mutex> lock(ModelsMutex);
+      auto it = Models.find(key);
+      if (it == Models.end() || it->second.BuildId != buildId)
+      {
+        // The package was closed and the entry purged
+        return;
+      }
+      waiting.swap(it->second.Waiting);
+      if (model)
+      {
+        it->second.Model = model;
+        it->second.Ready = true;
+        it->second.Building = false;
+        Generation++;
+      }
+      else
+      {
+        // Let the editors fail and retry on the next request
+        Models.erase(it);
+      }
+    }
+    for (const std::string& id : waiting)
+    {
+      SendEvent(wxTheApp, OBJECT_LOADED, id);
+    }
+  });
+}
+
+void RenderModelCache::TrackPackage(const std::weak_ptr<FPackage>& package)
+{
+  for (const std::weak_ptr<FPackage>& tracked : Packages)
+  {
+    if (!tracked.owner_before(package) && !package.owner_before(tracked))
+    {
+      return;
+    }
+  }
+  Packages.push_back(package);
+}
+
+void RenderModelCache::PurgeExpired()
+{
+  auto closed = std::remove_if(Packages.begin(), Packages.end(), [](const std::weak_ptr<FPackage>& package) {
+    return package.expired();
+  });
+  if (closed == Packages.end())
+  {
+    return;
+  }
+  Packages.erase(closed, Packages.end());
+  // Builds of closed packages fail, their workers find no entry
+  for (auto it = Models.begin(); it != Models.end();)
+  {
+    if (it->second.Package.expired())
+    {
+      it = Models.erase(it);
+    }
+    else
+    {
+      ++it;
+    }
+  }
+  std::scoped_lock<std::mutex> lock(TexturesMutex);
+  for (auto it = Textures.begin(); it != Textures.end();)
+  {
+    if (!it->second.Texture.valid())
+    {
+      it = Textures.erase(it);
+    }
+    else
+    {
+      ++it;
+    }
+  }
+}
@@ -0,0 +1,114 @@
+#pragma once
+#include <osg/Geode>
+#include <osg/Texture2D>
+#include <osg/observer_ptr>
+
+#include <Tera/Core.h>
+
+#include <atomic>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+class FPackage;
+class UObject;
+class UTexture2D;
+class UMaterialInterface;
+class UStaticMesh;
+class USkeletalMesh;
+
+// Ready-to-draw models of static and skeletal meshes shared by all editors.
+// A model is built once per mesh LOD on a worker thread: vertex, normal and uv arrays are shared by the section geometries,
+// and diffuse textures are shared by all models that use them. Editors attach the same osg::Geode to their viewers.
+// Models live until the package of their mesh is closed.
+class RenderModelCache {
+public:
+	static RenderModelCache& Get();
+
+	// Build the first LOD of a mesh loaded with LoadDependencies on a worker thread. Sends OBJECT_LOADED with the editorId
+	// to the app when the model is ready or the build has failed. If the model is already cached the event is sent right away.
+	void RequestModel(UObject* mesh, std::weak_ptr<FPackage> package, const std::string& editorId);
+
+	// Build a LOD on a worker thread unless it is cached or being built. Poll GetModel for the result.
+	// The mesh must be loaded with LoadDependencies as well.
+	void PrefetchModel(UObject* mesh, int32 lod, std::weak_ptr<FPackage> package);
+
+	// Returns nullptr if the model is not ready
+	osg::ref_ptr<osg::Geode> GetModel(UObject* mesh, int32 lod = 0);
+
+	// True while a worker builds the LOD. A LOD that is neither ready nor building has failed or was never requested.
+	bool IsBuilding(UObject* mesh, int32 lod);
+
+	// Returns the cached model or builds it on the calling thread. The mesh must be loaded.
+	// Used by level previews to instance one model per mesh.
+	osg::ref_ptr<osg::Geode> AcquireModel(UObject* mesh, std::weak_ptr<FPackage> package, int32 lod = 0);
+
+	// Re-resolve materials of cached LODs and reload textures that changed since the models were built. Geometry is kept.
+	void RefreshMaterials(UObject* mesh);
+
+	// Incremented when a worker finishes a model. Views poll it to redraw with new LODs.
+	uint32 GetGeneration() const
+	{
+		return Generation;
+	}
+
+	// Shared texture of the material's diffuse map. Returns nullptr if the material has no diffuse texture.
+	osg::ref_ptr<osg::Texture2D> GetDiffuseTexture(UMaterialInterface* material);
+
+	// Load the mesh, materials of all its LODs and their diffuse textures on the calling thread.
+	// Builds of a mesh loaded this way don't load any objects, so they never wait for loads on the PPL pool.
+	static void LoadDependencies(UObject* mesh);
+
+	static osg::ref_ptr<osg::Geode> BuildModel(const UStaticMesh* mesh, int32 lod = 0);
+	static osg::ref_ptr<osg::Geode> BuildModel(const USkeletalMesh* mesh, int32 lod = 0);
+
+private:
+	RenderModelCache() = default;
+
+	// Geometry and materials of a static or a skeletal mesh
+	osg::ref_ptr<osg::Geode> BuildModel(UObject* mesh, int32 lod);
+
+	// Assign textures and blending to section geometries
+	void ApplyMaterials(UObject* mesh, int32 lod, osg::Geode* model);
+
+	// Add an entry and build it on the PPL pool. An empty editorId sends no event.
+	void StartBuild(UObject* mesh, int32 lod, std::weak_ptr<FPackage> package, const std::string& editorId);
+
+	// Drop models of closed packages and textures no model uses. Does nothing until a package of a model is closed.
+	// Every entry point calls it, so a mesh allocated at the address of a deleted one never gets its model.
+	// Expects ModelsMutex to be locked.
+	void PurgeExpired();
+
+	// Remember the package of a new entry. Expects ModelsMutex to be locked.
+	void TrackPackage(const std::weak_ptr<FPackage>& package);
+
+	struct ModelEntry {
+		std::weak_ptr<FPackage> Package;
+		osg::ref_ptr<osg::Geode> Model;
+		// Editors waiting for the model
+		std::vector<std::string> Waiting;
+		bool Building = false;
+		bool Ready = false;
+		// Tells the worker that the entry was not replaced while it was building
+		uint32 BuildId = 0;
+	};
+
+	struct TextureEntry {
+		osg::observer_ptr<osg::Texture2D> Texture;
+		// UTexture2D::GetDataGeneration of the rendered data. Changes when the texture is imported.
+		uint32 Generation = 0;
+	};
+
+	using ModelKey = std::pair<UObject*, int32>;
+
+	std::mutex ModelsMutex;
+	std::map<ModelKey, ModelEntry> Models;
+	// Packages of cached models
+	std::vector<std::weak_ptr<FPackage>> Packages;
+	uint32 NextBuildId = 0;
+	std::mutex TexturesMutex;
+	std::map<UTexture2D*, TextureEntry> Textures;
+	std::atomic_uint32_t Generation = 0;
+};
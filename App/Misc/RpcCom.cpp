@@ -1,9 +1,40 @@
 #include "../App.h"
 
+#include <Utils/ALog.h>
+
+#include <algorithm>
+#include <memory>
+
 const char* RpcPort = "4545";
+const char* RpcJobPort = "4546";
+
+// Delay between result requests of a job client
+#define RPC_JOB_POLL_INTERVAL 5
+#define RPC_JOB_RESULTS_ITEM "results"
 
 bool RpcConnection::OnExec(const wxString& topic, const wxString& message)
 {
+  if (topic == "job")
+  {
+    if (!Server)
+    {
+      return false;
+    }
+    BatchJob job;
+    long id = 0;
+    if (!message.BeforeFirst('\t').ToLong(&id) || !BatchRunner::ParseJobLine(message.AfterFirst('\t'), job))
+    {
+      return false;
+    }
+    if (job.Command == wxT("shutdown"))
+    {
+      wxTheApp->ExitMainLoop();
+      return true;
+    }
+    job.Line = (int32)id;
+    Server->SubmitJob(Id, job);
+    return true;
+  }
   if (MainApplication)
   {
     if (topic == "open")
@@ -14,6 +45,211 @@ bool RpcConnection::OnExec(const wxString& topic, const wxString& message)
   return true;
 }
 
+const void* RpcConnection::OnRequest(const wxString& topic, const wxString& item, size_t* size, wxIPCFormat format)
+{
+  if (topic != "job" || item != RPC_JOB_RESULTS_ITEM)
+  {
+    return NULL;
+  }
+  // Never return an empty response: the client treats NULL as a lost connection
+  Response = Results.size() ? std::string(Results.utf8_str()) : std::string("\n");
+  Results.clear();
+  if (size)
+  {
+    *size = Response.size();
+  }
+  return Response.c_str();
+}
+
+bool RpcConnection::OnStartAdvise(const wxString& topic, const wxString& item)
+{
+  if (topic != "job" || item != RPC_JOB_RESULTS_ITEM)
+  {
+    return false;
+  }
+  Advising = true;
+  if (Results.size())
+  {
+    Advise(RPC_JOB_RESULTS_ITEM, Results);
+    Results.clear();
+  }
+  return true;
+}
+
+bool RpcConnection::OnStopAdvise(const wxString& topic, const wxString& item)
+{
+  Advising = false;
+  return true;
+}
+
+bool RpcConnection::OnDisconnect()
+{
+  if (Server)
+  {
+    Server->ConnectionClosed(Id);
+  }
+  return wxConnection::OnDisconnect();
+}
+
+void RpcConnection::PushResult(const wxString& json)
+{
+  if (Advising)
+  {
+    Advise(RPC_JOB_RESULTS_ITEM, json + wxT("\n"));
+  }
+  else
+  {
+    Results += json + wxT("\n");
+  }
+}
+
+RpcServer::~RpcServer()
+{
+  StopJobs();
+}
+
+void RpcServer::RunWithDelegate(App* delegate)
+{
+  MainApplication = delegate;
+  Create(RpcPort);
+}
+
+bool RpcServer::RunJobServer(App* delegate, int32 workers)
+{
+  MainApplication = delegate;
+  if (!Create(RpcJobPort))
+  {
+    return false;
+  }
+  for (int32 idx = 0; idx < std::max<int32>(1, workers); ++idx)
+  {
+    Workers.emplace_back(&RpcServer::WorkerLoop, this, Queue);
+  }
+  LogI("Job server is running with %d worker(s)", (int)Workers.size());
+  return true;
+}
+
+bool RpcServer::StopJobs(std::chrono::milliseconds timeout)
+{
+  bool finished = false;
+  {
+    std::unique_lock<std::mutex> lock(Queue->Mutex);
+    Queue->Stopping = true;
+    Queue->Jobs.clear();
+    Queue->Changed.notify_all();
+    // Workers that were detached by a previous call are not waited for again
+    finished = Workers.empty() ? !Queue->RunningWorkers : Queue->Changed.wait_for(lock, timeout, [this] { return !Queue->RunningWorkers; });
+  }
+  for (std::thread& worker : Workers)
+  {
+    if (finished)
+    {
+      worker.join();
+    }
+    else
+    {
+      worker.detach();
+    }
+  }
+  if (!finished && Workers.size())
+  {
+    LogW("Job server stopped with unfinished jobs");
+  }
+  Workers.clear();
+  return finished;
+}
+
+wxConnectionBase* RpcServer::OnAcceptConnection(const wxString& topic)
+{
+  RpcConnection* conn = new RpcConnection;
+  conn->SetDelegate(MainApplication);
+  if (topic == "job")
+  {
+    if (Workers.empty())
+    {
+      delete conn;
+      return NULL;
+    }
+    const uint64 id = NextConnectionId++;
+    conn->SetServer(this, id);
+    Connections[id] = conn;
+  }
+  return conn;
+}
+
+void RpcServer::SubmitJob(uint64 connectionId, const BatchJob& job)
+{
+  {
+    std::scoped_lock<std::mutex> lock(Queue->Mutex);
+    if (Queue->Stopping)
+    {
+      return;
+    }
+    QueuedJob& queued = Queue->Jobs.emplace_back();
+    queued.ConnectionId = connectionId;
+    queued.Job = job;
+  }
+  Queue->Changed.notify_one();
+}
+
+void RpcServer::ConnectionClosed(uint64 connectionId)
+{
+  Connections.erase(connectionId);
+  // Nobody will read results of the queued jobs
+  std::scoped_lock<std::mutex> lock(Queue->Mutex);
+  Queue->Jobs.erase(std::remove_if(Queue->Jobs.begin(), Queue->Jobs.end(), [connectionId](const QueuedJob& job) {
+    return job.ConnectionId == connectionId;
+  }), Queue->Jobs.end());
+}
+
+void RpcServer::WorkerLoop(std::shared_ptr<JobQueue> queue)
+{
+  while (true)
+  {
+    QueuedJob queued;
+    {
+      std::unique_lock<std::mutex> lock(queue->Mutex);
+      queue->Changed.wait(lock, [&queue] { return queue->Stopping || queue->Jobs.size(); });
+      if (queue->Stopping)
+      {
+        return;
+      }
+      queued = std::move(queue->Jobs.front());
+      queue->Jobs.pop_front();
+      queue->RunningWorkers++;
+    }
+
+    // "wait" has no meaning here. Clients wait for results themselves.
+    const BatchJobResult result = BatchRunner::RunJob(queued.Job);
+    const wxString line = (result.Ok ? wxT("1\t") : wxT("0\t")) + BatchRunner::ToJson(result);
+
+    {
+      std::scoped_lock<std::mutex> lock(queue->Mutex);
+      queue->RunningWorkers--;
+      if (queue->Stopping)
+      {
+        // The server may be gone. Nobody reads the result.
+        queue->Changed.notify_all();
+        return;
+      }
+    }
+
+    // Connections live on the main thread. StopJobs runs there too, so the server is alive if it is not stopping.
+    const uint64 connectionId = queued.ConnectionId;
+    wxTheApp->CallAfter([this, queue, connectionId, line] {
+      if (queue->Stopping)
+      {
+        return;
+      }
+      auto it = Connections.find(connectionId);
+      if (it != Connections.end())
+      {
+        it->second->PushResult(line);
+      }
+    });
+  }
+}
+
 void RpcClient::SendRequest(const wxString& topic, const wxString& data)
 {
   RpcClient* client = new RpcClient;
@@ -26,8 +262,77 @@ void RpcClient::SendRequest(const wxString& topic, const wxString& data)
   delete client;
 }
 
-void RpcServer::RunWithDelegate(App* delegate)
+bool RpcClient::RunJobs(const std::vector<BatchJob>& jobs, const std::function<void(bool, const wxString&)>& report)
 {
-  MainApplication = delegate;
-  Create(RpcPort);
-}
\ No newline at end of file
+  RpcClient client;
+  std::unique_ptr<wxConnectionBase> conn(client.MakeConnection("localhost", RpcJobPort, "job"));
+  if (!conn)
+  {
+    return false;
+  }
+
+  size_t sent = 0;
+  size_t received = 0;
+  // Returns false if the connection is lost
+  auto drain = [&] {
+    size_t size = 0;
+    const char* data = (const char*)conn->Request(RPC_JOB_RESULTS_ITEM, &size, wxIPC_UTF8TEXT);
+    if (!data)
+    {
+      return false;
+    }
+    wxArrayString lines = wxSplit(wxString::FromUTF8(data, size), '\n', 0);
+    for (const wxString& line : lines)
+    {
+      if (line.size())
+      {
+        report(line.BeforeFirst('\t') == wxT("1"), line.AfterFirst('\t'));
+        received++;
+      }
+    }
+    return true;
+  };
+  auto waitAll = [&] {
+    while (received < sent)
+    {
+      const size_t before = received;
+      if (!drain())
+      {
+        return false;
+      }
+      if (before == received)
+      {
+        wxMilliSleep(RPC_JOB_POLL_INTERVAL);
+      }
+    }
+    return true;
+  };
+
+  for (const BatchJob& job : jobs)
+  {
+    if (job.Command == wxT("wait"))
+    {
+      if (!waitAll())
+      {
+        return false;
+      }
+      continue;
+    }
+    if (!conn->Execute(wxString::Format(wxT("%d\t"), job.Line) + BatchRunner::FormatJobLine(job)))
+    {
+      return false;
+    }
+    sent++;
+  }
+  return waitAll();
+}
+
+void RpcClient::StopJobServer()
+{
+  RpcClient client;
+  std::unique_ptr<wxConnectionBase> conn(client.MakeConnection("localhost", RpcJobPort, "job"));
+  if (conn)
+  {
+    conn->Execute(wxT("0\tshutdown"));
+  }
+}
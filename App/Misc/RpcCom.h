@@ -2,8 +2,26 @@
 #include <wx/wx.h>
 #include <wx/ipc.h>
 
+#include "BatchRunner.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
 class App;
+class RpcServer;
 
+// Topics:
+// "open" - open a package in the running editor. Execute(path)
+// "job" - job server only. Execute("<id>\t<job line>") queues a BatchRunner job, "<id>\tshutdown" stops the server.
+//   Results are "<1|0>\t<json>" lines, the flag is the job status. Clients that started the "results" advise loop get
+//   them pushed as soon as a job is done, others drain them with Request("results").
 class RpcConnection : public wxConnection {
 public:
   void SetDelegate(App* delegate)
@@ -11,28 +29,86 @@ public:
     MainApplication = delegate;
   }
 
+  void SetServer(RpcServer* server, uint64 id)
+  {
+    Server = server;
+    Id = id;
+  }
+
+  // Deliver a finished job. Main thread only.
+  void PushResult(const wxString& json);
+
 protected:
-  bool OnExec(const wxString& topic, const wxString& message);
+  bool OnExec(const wxString& topic, const wxString& message) override;
+  const void* OnRequest(const wxString& topic, const wxString& item, size_t* size, wxIPCFormat format) override;
+  bool OnStartAdvise(const wxString& topic, const wxString& item) override;
+  bool OnStopAdvise(const wxString& topic, const wxString& item) override;
+  bool OnDisconnect() override;
 
 private:
   App* MainApplication = NULL;
+  RpcServer* Server = NULL;
+  uint64 Id = 0;
+  bool Advising = false;
+  // Results waiting for a Request
+  wxString Results;
+  // Keeps the last response alive until the next request
+  std::string Response;
 };
 
 class RpcServer : public wxServer {
 public:
+  ~RpcServer();
+
   void RunWithDelegate(App* delegate);
 
-  wxConnectionBase* OnAcceptConnection(const wxString& topic) 
-  {
-    RpcConnection* conn = new RpcConnection;
-    conn->SetDelegate(MainApplication);
-    return conn;
-  }
+  // Serve the "job" topic with a pool of workers. The core must be loaded.
+  bool RunJobServer(App* delegate, int32 workers);
+
+  // Drop the queued jobs and wait for the running ones up to the timeout. Returns false if some jobs are still running.
+  // Their workers are detached and their results are dropped. Must be called before the core is unloaded.
+  bool StopJobs(std::chrono::milliseconds timeout = std::chrono::seconds(30));
+
+  wxConnectionBase* OnAcceptConnection(const wxString& topic) override;
+
+  void SubmitJob(uint64 connectionId, const BatchJob& job);
+  void ConnectionClosed(uint64 connectionId);
+
+private:
+  struct QueuedJob {
+    uint64 ConnectionId = 0;
+    BatchJob Job;
+  };
+
+  // Shared with the workers, so a detached worker can finish its job after the server is gone
+  struct JobQueue {
+    std::deque<QueuedJob> Jobs;
+    std::mutex Mutex;
+    std::condition_variable Changed;
+    int32 RunningWorkers = 0;
+    bool Stopping = false;
+  };
+
+  void WorkerLoop(std::shared_ptr<JobQueue> queue);
+
 private:
   App* MainApplication = NULL;
+  // Live connections by id. Main thread only.
+  std::map<uint64, RpcConnection*> Connections;
+  uint64 NextConnectionId = 1;
+
+  std::vector<std::thread> Workers;
+  std::shared_ptr<JobQueue> Queue = std::make_shared<JobQueue>();
 };
 
 class RpcClient : public wxClient {
 public:
   static void SendRequest(const wxString& topic, const wxString& data);
-};
\ No newline at end of file
+
+  // Run jobs on a job server. Results are reported as (ok, JSON line) in the completion order.
+  // "wait" jobs are barriers: later jobs are sent when all previous results arrive.
+  // Returns false if there is no server or the connection is lost.
+  static bool RunJobs(const std::vector<BatchJob>& jobs, const std::function<void(bool, const wxString&)>& report);
+
+  static void StopJobServer();
+};
@@ -0,0 +1,56 @@
+#include "SceneOctree.h"
+
+#include <algorithm>
+
+namespace
+{
+  void BuildCell(osg::Group* cell, std::vector<SceneOctree::Item>& items, size_t leafSize, int depth)
+  {
+    if (items.size() <= leafSize || depth <= 0)
+    {
+      for (const SceneOctree::Item& item : items)
+      {
+        cell->addChild(item.Node.get());
+      }
+      return;
+    }
+
+    osg::BoundingBox bounds;
+    for (const SceneOctree::Item& item : items)
+    {
+      bounds.expandBy(item.Bounds.center());
+    }
+    const osg::Vec3 center = bounds.center();
+
+    std::vector<SceneOctree::Item> octants[8];
+    for (SceneOctree::Item& item : items)
+    {
+      const osg::Vec3 itemCenter = item.Bounds.center();
+      const int octant = (itemCenter.x() > center.x() ? 1 : 0) | (itemCenter.y() > center.y() ? 2 : 0) | (itemCenter.z() > center.z() ? 4 : 0);
+      octants[octant].push_back(std::move(item));
+    }
+    items.clear();
+
+    for (std::vector<SceneOctree::Item>& octant : octants)
+    {
+      if (octant.empty())
+      {
+        continue;
+      }
+      osg::ref_ptr<osg::Group> child = new osg::Group;
+      // Items with the same center can't be split further
+      BuildCell(child.get(), octant, leafSize, bounds.radius() > 0 ? depth - 1 : 0);
+      cell->addChild(child.get());
+    }
+  }
+}
+
+osg::ref_ptr<osg::Group> SceneOctree::Build(std::vector<Item>& items, size_t leafSize, int maxDepth)
+{
+  osg::ref_ptr<osg::Group> root = new osg::Group;
+  if (items.size())
+  {
+    BuildCell(root.get(), items, std::max<size_t>(leafSize, 1), maxDepth);
+  }
+  return root;
+}
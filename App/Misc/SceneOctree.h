@@ -0,0 +1,19 @@
+#pragma once
+#include <osg/BoundingBox>
+#include <osg/Group>
+
+#include <vector>
+
+// Groups scene nodes into an octree so the viewer culls whole regions instead of testing every node against the frustum.
+// Each octree cell is an osg::Group. OSG computes group bounds from the children, so culling needs no extra callbacks.
+class SceneOctree {
+public:
+	struct Item {
+		osg::ref_ptr<osg::Node> Node;
+		// World space bounds of the node
+		osg::BoundingBox Bounds;
+	};
+
+	// Items are split by their centers until a cell has leafSize items or less. Consumes the items.
+	static osg::ref_ptr<osg::Group> Build(std::vector<Item>& items, size_t leafSize = 32, int maxDepth = 8);
+};
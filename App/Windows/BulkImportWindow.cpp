@@ -1132,7 +1132,7 @@ void BulkImportWindow::OnContinueClicked(wxCommandEvent& event)
 
 	bool result = false;
 	std::thread([&progress, &operation, &result] {
-		result = operation.Execute(progress);
+		result = operation.Execute(&progress);
 		SendEvent(&progress, UPDATE_PROGRESS_FINISH);
 	}).detach();
 
@@ -28,7 +28,7 @@ CompositePackagePicker::CompositePackagePicker(wxWindow* parent, const wxString&
 	bSizer2->Add(m_staticText, 0, wxALIGN_CENTER_VERTICAL | wxALL, 5);
 
 	CompositeName = new wxTextCtrl(m_panel1, ControlElementId::TextField, wxEmptyString, wxDefaultPosition, wxDefaultSize, 0);
-	CompositeName->AutoComplete(((App*)wxTheApp)->GetCompositePackageNames());
+	CompositeName->AutoComplete(((App*)wxTheApp)->CreateCompositeNameCompleter());
 	bSizer2->Add(CompositeName, 1, wxALIGN_CENTER_VERTICAL | wxALL, 5);
 
 	m_panel1->SetSizer(bSizer2);
@@ -67,7 +67,7 @@ wxString CompositePackagePicker::GetResult() const
 
 void CompositePackagePicker::OnText(wxCommandEvent&)
 {
-	OpenButton->Enable(((App*)wxTheApp)->GetCompositePackageNames().Index(CompositeName->GetValue(), false) != wxNOT_FOUND);
+	OpenButton->Enable(((App*)wxTheApp)->IsCompositePackageName(CompositeName->GetValue()));
 }
 
 void CompositePackagePicker::OnTextEnter(wxCommandEvent&)
@@ -41,7 +41,7 @@ CompositePatcherWindow::CompositePatcherWindow(wxWindow* parent, const wxString&
 	bSizer13->Add(m_staticText14, 0, wxALIGN_CENTER_VERTICAL | wxALL, 5);
 
 	SourceField = new wxTextCtrl(this, ControlElementId::Source, wxEmptyString, wxDefaultPosition, wxDefaultSize, 0);
-	SourceField->AutoComplete(((App*)wxTheApp)->GetCompositePackageNames());
+	SourceField->AutoComplete(((App*)wxTheApp)->CreateCompositeNameCompleter());
 	bSizer13->Add(SourceField, 1, wxALIGN_CENTER_VERTICAL | wxALL, 5);
 
 	SelectButton = new wxButton(this, ControlElementId::Select, wxT("Select"), wxDefaultPosition, wxDefaultSize, 0);
@@ -152,7 +152,7 @@ CompositePatcherWindow::CompositePatcherWindow(wxWindow* parent, const wxString&
 
 void CompositePatcherWindow::OnSourceFieldText(wxCommandEvent&)
 {
-	bool enabled = ((App*)wxTheApp)->GetCompositePackageNames().Index(SourceField->GetValue(), false) != wxNOT_FOUND;
+	bool enabled = ((App*)wxTheApp)->IsCompositePackageName(SourceField->GetValue());
 	SelectButton->Enable(enabled);
 	if (!enabled)
 	{
@@ -5,6 +5,7 @@
 #include "CookingOptions.h"
 #include "CreateModWindow.h"
 #include "../Misc/ArchiveInfo.h"
+#include "../Misc/CompositeDumpOperation.h"
 #include "../Misc/ObjectProperties.h"
 #include "../App.h"
 
@@ -67,12 +68,23 @@ wxDEFINE_EVENT(UPDATE_PROPERTIES, wxCommandEvent);
 
 const wxString HelpUrl = wxS("https://github.com/VenoMKO/RealEditor/wiki");
 
+// Hidden editors are destroyed above these limits
+const size_t MaxIdleEditors = 32;
+const size_t IdleEditorsMemoryBudget = 256 * 1024 * 1024;
+// Exports on each side of the selection that are loaded ahead
+const int32 PrefetchNeighbourCount = 2;
+// Larger exports are loaded only when selected
+const FILE_OFFSET MaxPrefetchSerialSize = 8 * 1024 * 1024;
+// Filter matches are revealed in the object tree up to this count
+const size_t MaxRevealedFilterMatches = 64;
+
 #include "PackageWindowLayout.h"
 
 PackageWindow::PackageWindow(std::shared_ptr<FPackage>& package, App* application)
   : wxFrame(nullptr, wxID_ANY, wxEmptyString)
   , Application(application)
   , Package(package)
+  , LoadQueue(std::make_unique<ObjectLoadQueue>(package))
 {
 	wxString title = application->GetAppDisplayName() + wxT(" ") + GetAppVersion() + wxT(" - ");
 	if (package->IsComposite())
@@ -137,6 +149,9 @@ PackageWindow::PackageWindow(std::shared_ptr<FPackage>& package, App* applicatio
 	
 	ObjectTreeCtrl->Bind(wxEVT_SIZE, &PackageWindow::OnSize, this);
 	PropertiesCtrl->Bind(wxEVT_SIZE, &PackageWindow::OnSize, this);
+	PropertiesCtrl->Bind(wxEVT_PG_ITEM_EXPANDED, &PackageWindow::OnPropertyExpanded, this);
+	ObjectFilterCtrl->Bind(wxEVT_TEXT, &PackageWindow::OnObjectFilterChanged, this);
+	ObjectFilterCtrl->Bind(wxEVT_SEARCHCTRL_CANCEL_BTN, &PackageWindow::OnObjectFilterChanged, this);
 	HeartBeat.Bind(wxEVT_TIMER, &PackageWindow::OnTick, this);
 	HeartBeat.Start(1);
 }
@@ -153,6 +168,8 @@ void PackageWindow::OnCloseWindow(wxCloseEvent& event)
 
 PackageWindow::~PackageWindow()
 {
+	// Let running loads finish before the package goes away
+	LoadQueue.reset();
 	FPackage::UnloadPackage(Package);
 	delete ImageList;
 }
@@ -164,59 +181,15 @@ wxString PackageWindow::GetPackagePath() const
 
 void PackageWindow::SelectObject(const wxString& objectPath)
 {
-  std::vector<std::string> components;
-  std::istringstream f(objectPath.ToStdString());
-  std::string tmp;
-  while (std::getline(f, tmp, '.'))
-	{
-		if (tmp.size())
-		{
-			components.push_back(tmp);
-		}
-  }
-	if (components.empty())
+	// The first component is the package name
+	std::string path = objectPath.ToStdString();
+	size_t pos = path.find_first_not_of('.');
+	pos = pos == std::string::npos ? pos : path.find('.', pos);
+	if (pos == std::string::npos)
 	{
 		return;
 	}
-	FObjectResource* found = nullptr;
-
-	std::vector<FObjectExport*> searchItems = Package->GetRootExports();
-	for (int32 idx = 1; idx < components.size(); ++idx)
-	{
-		std::string upper = components[idx];
-    std::transform(upper.begin(), upper.end(), upper.begin(),
-      [](unsigned char c) { return std::toupper(c); }
-    );
-		for (FObjectExport* exp : searchItems)
-		{
-			if (exp->GetObjectName().ToUpper() == upper)
-			{
-				found = exp;
-				searchItems = exp->Inner;
-				break;
-			}
-		}
-	}
-	if (!found)
-	{
-		std::vector<FObjectImport*> searchItems = Package->GetRootImports();
-    for (int32 idx = 1; idx < components.size(); ++idx)
-    {
-      std::string upper = components[idx];
-      std::transform(upper.begin(), upper.end(), upper.begin(),
-        [](unsigned char c) { return std::toupper(c); }
-      );
-      for (FObjectImport* imp : searchItems)
-      {
-        if (imp->GetObjectName().ToUpper() == upper)
-        {
-          found = imp;
-          searchItems = imp->Inner;
-          break;
-        }
-      }
-    }
-	}
+	FObjectResource* found = Package->GetResourceByPath(path.substr(pos + 1));
 	if (found && found->ObjectIndex)
 	{
 		if (ObjectTreeNode* node = ((ObjectTreeModel*)ObjectTreeCtrl->GetModel())->FindItemByObjectIndex(found->ObjectIndex))
@@ -330,6 +303,112 @@ void PackageWindow::OnObjectTreeSelectItem(wxDataViewEvent& e)
 	else
 	{
 		OnExportObjectSelected(index);
+		PrefetchNeighbours(node);
+	}
+}
+
+void PackageWindow::OnObjectFilterChanged(wxCommandEvent& e)
+{
+	if (e.GetEventType() == wxEVT_SEARCHCTRL_CANCEL_BTN)
+	{
+		// Sends wxEVT_TEXT
+		ObjectFilterCtrl->Clear();
+		return;
+	}
+	if (!DataModel)
+	{
+		return;
+	}
+	ObjectTreeNode* selection = (ObjectTreeNode*)ObjectTreeCtrl->GetCurrentItem().GetID();
+	DataModel->SetFilter(ObjectFilterCtrl->GetValue());
+	ObjectTreeCtrl->Expand(wxDataViewItem(DataModel->GetRootExport()));
+	const std::vector<FObjectResource*>& matches = DataModel->GetFilterMatches();
+	if (DataModel->IsFiltered() && matches.size() <= MaxRevealedFilterMatches)
+	{
+		for (FObjectResource* resource : matches)
+		{
+			if (ObjectTreeNode* node = DataModel->FindItemByObjectIndex(resource->ObjectIndex))
+			{
+				ObjectTreeCtrl->EnsureVisible(wxDataViewItem(node));
+			}
+		}
+	}
+	if (DataModel->IsVisible(selection))
+	{
+		ObjectTreeCtrl->Select(wxDataViewItem(selection));
+		ObjectTreeCtrl->EnsureVisible(wxDataViewItem(selection));
+	}
+}
+
+void PackageWindow::PrefetchNeighbours(ObjectTreeNode* node)
+{
+	ObjectTreeNode* parent = node ? node->GetParent() : nullptr;
+	if (!parent)
+	{
+		return;
+	}
+	ObjectTreeNodePtrArray& siblings = parent->GetChildren();
+	const int32 count = (int32)siblings.GetCount();
+	int32 position = siblings.Index(node);
+	if (position == wxNOT_FOUND)
+	{
+		return;
+	}
+	// Closest first. Selecting a neighbour drops the rest.
+	for (int32 offset = 1; offset <= PrefetchNeighbourCount; ++offset)
+	{
+		for (int32 sibling : { position + offset, position - offset })
+		{
+			if (sibling < 0 || sibling >= count)
+			{
+				continue;
+			}
+			const PACKAGE_INDEX index = siblings[sibling]->GetObjectIndex();
+			if (index <= 0 || index == FAKE_EXPORT_ROOT)
+			{
+				continue;
+			}
+			FObjectExport* exp = Package->GetExportObject(index);
+			if (exp && exp->SerialSize <= MaxPrefetchSerialSize)
+			{
+				LoadQueue->Prefetch(Package->GetObject(index, false));
+			}
+		}
+	}
+}
+
+void PackageWindow::EvictIdleEditors()
+{
+	size_t count = 0;
+	size_t memory = 0;
+	for (const auto& p : Editors)
+	{
+		if (p.second != ActiveEditor)
+		{
+			count++;
+			memory += p.second->GetMemoryFootprint();
+		}
+	}
+	for (auto it = EditorHistory.begin(); it != EditorHistory.end() && (count > MaxIdleEditors || memory > IdleEditorsMemoryBudget);)
+	{
+		auto found = Editors.find(*it);
+		if (found == Editors.end())
+		{
+			it = EditorHistory.erase(it);
+			continue;
+		}
+		GenericEditor* editor = found->second;
+		if (editor == ActiveEditor || editor->HasPendingLoad())
+		{
+			++it;
+			continue;
+		}
+		count--;
+		memory -= std::min(memory, editor->GetMemoryFootprint());
+		Editors.erase(found);
+		it = EditorHistory.erase(it);
+		// Late OBJECT_LOADED events of the editor find no match and are ignored
+		editor->Destroy();
 	}
 }
 
@@ -476,6 +555,18 @@ void PackageWindow::OnExportObjectSelected(INT index)
 	}
 }
 
+void PackageWindow::OnPropertyExpanded(wxPropertyGridEvent& e)
+{
+	// Structs and arrays create their children on the first expansion
+	PropertiesCtrl->Freeze();
+	const bool created = CreateDeferredProperties(PropertiesCtrl, e.GetProperty());
+	PropertiesCtrl->Thaw();
+	if (created)
+	{
+		PropertiesCtrl->RefreshGrid();
+	}
+}
+
 void PackageWindow::UpdateProperties(UObject* object, std::vector<FPropertyTag*> properties)
 {
 	PropertiesCtrl->Freeze();
@@ -877,20 +968,26 @@ void PackageWindow::OnDumpCompositeObjectsClicked(wxCommandEvent&)
 		return;
 	}
 
-	if (wxMessageBox(_("Please, make sure you've turned off all composite mods!\nThis operation takes 20 to 30 minutes and requires at least 1.7 GB of free disk space.\nAre you ready to continue?"), _("Dump a list of objects from composite packages..."), wxICON_INFORMATION | wxYES_NO) != wxYES)
+	if (wxMessageBox(_("Please, make sure you've turned off all composite mods!\nThis operation may take several minutes.\nAre you ready to continue?"), _("Dump a list of objects from composite packages..."), wxICON_INFORMATION | wxYES_NO) != wxYES)
 	{
 		return;
 	}
 
+	CompositeDumpOperation operation(dest);
+	bool resume = false;
+	if (wxFileExists(dest + ".resume"))
+	{
+		resume = wxMessageBox(_("The previous dump to this file was interrupted.\nDo you want to continue it?"), _("Dump a list of objects from composite packages..."), wxICON_QUESTION | wxYES_NO) == wxYES;
+	}
+
 	ProgressWindow progress(this, "Dumping all objects");
 	progress.SetCurrentProgress(-1);
-	std::vector<std::pair<std::string, std::string>> failed;
-	std::thread([dest, &progress, &failed] {
+	bool finished = false;
+	std::thread([&operation, &progress, &finished, resume] {
 
 		// Update the mappers
 		
 		SendEvent(&progress, UPDATE_PROGRESS_DESC, wxT("Updating package mapper..."));
-		Sleep(200);
 		try
 		{
 			FPackage::LoadPkgMapper(true);
@@ -924,76 +1021,21 @@ void PackageWindow::OnDumpCompositeObjectsClicked(wxCommandEvent&)
 			return;
 		}
 
-		// Run dumping
-
-		std::ofstream s(dest.ToStdWstring(), std::ios::out | std::ios::binary);
-		auto compositeMap = FPackage::GetCompositePackageMap();
-		int idx = 0;
-		const int total = (int)compositeMap.size();
-		SendEvent(&progress, UPDATE_MAX_PROGRESS, total);
-		for (const auto& pair : compositeMap)
+		// Run dumping. A cancelled dump can be continued later.
+		SendEvent(&progress, UPDATE_PROGRESS_DESC, wxT("Reading export tables..."));
+		finished = operation.Execute(progress, resume && operation.CanResume());
+		if (!finished && operation.GetError().size())
 		{
-			if (pair.first == "tmm_marker")
-			{
-				// Skip the TMM marker
-				continue;
-			}
-			std::shared_ptr<FPackage> pkg = nullptr;
-			try
-			{
-				if ((pkg = FPackage::GetPackageNamed(pair.first)))
-				{
-					pkg->Load();
-					s << "// Object path: " << pair.second.ObjectPath.UTF8() << '\n';
-					auto allExports = pkg->GetAllExports();
-					for (FObjectExport* exp : allExports)
-					{
-						s << exp->GetClassName().UTF8() << '\t' << exp->ObjectIndex << '\t' << exp->GetObjectPath().UTF8() << '\n';
-					}
-					s << std::endl;
-					FPackage::UnloadPackage(pkg);
-					pkg = nullptr;
-				}
-				else
-				{
-					failed.emplace_back(std::make_pair(pair.first, "Failed to open the package!"));
-				}
-			}
-			catch (const std::exception& e)
-			{
-				failed.emplace_back(std::make_pair(pair.first, e.what()));
-				FPackage::UnloadPackage(pkg);
-				pkg = nullptr;
-			}
-			if (idx % 3 == 0)
-			{
-				if (progress.IsCanceled())
-				{
-					SendEvent(&progress, UPDATE_PROGRESS_FINISH);
-					return;
-				}
-				SendEvent(&progress, UPDATE_PROGRESS, idx);
-				SendEvent(&progress, UPDATE_PROGRESS_DESC, wxString::Format("Saving %d/%d...", idx, total));
-			}
-			idx++;
+			wxMessageBox(operation.GetError(), wxS("Error!"), wxICON_ERROR);
 		}
 		SendEvent(&progress, UPDATE_PROGRESS_FINISH);
 	}).detach();
 
 	progress.ShowModal();
 
-	if (failed.size())
+	if (finished && operation.GetErrorCount())
 	{
-		std::filesystem::path errDst = dest.ToStdWstring();
-		errDst.replace_extension("errors.txt");
-		std::ofstream s(errDst, std::ios::out | std::ios::binary);
-
-		for (const auto& pair : failed)
-		{
-			s << pair.first << ": " << pair.second << '\n';
-		}
-
-		wxMessageBox(_("Failed to iterate some of the packages!\nSee ") + errDst.filename().wstring() + _(" file for details"), _(""), wxICON_WARNING);
+		wxMessageBox(_("Failed to iterate some of the packages!\nSee ") + std::filesystem::path(operation.GetErrorsPath().ToStdWstring()).filename().wstring() + _(" file for details"), _(""), wxICON_WARNING);
 	}
 }
 
@@ -1,13 +1,17 @@
 #pragma once
 #include <wx/frame.h>
 #include <wx/splitter.h>
+#include <wx/srchctrl.h>
 #include <wx/toolbar.h>
 #include <wx/propgrid/manager.h>
 
 #include "../Editors/GenericEditor.h"
+#include "../Misc/ObjectLoadQueue.h"
 #include "../Misc/ObjectTreeModel.h"
 
+#include <list>
 #include <map>
+#include <memory>
 #include <vector>
 
 wxDECLARE_EVENT(PACKAGE_READY, wxCommandEvent);
@@ -33,6 +37,11 @@ public:
 	void SelectObject(const wxString& objectPath);
 	void SelectObject(UObject* object);
 
+	ObjectLoadQueue& GetLoadQueue()
+	{
+		return *LoadQueue;
+	}
+
 	bool OnObjectLoaded(const std::string& id);
 	void OnUpdateProperties(wxCommandEvent&);
 	void FixOSG();
@@ -74,6 +83,7 @@ private:
 	void OnObjectTreeStartEdit(wxDataViewEvent& e);
 	void OnObjectTreeSelectItem(wxDataViewEvent& e);
 	void OnObjectTreeContextMenu(wxDataViewEvent& e);
+	void OnObjectFilterChanged(wxCommandEvent& e);
 
 	void OnImportObjectSelected(INT index);
 	void OnExportObjectSelected(INT index);
@@ -83,7 +93,12 @@ private:
 	void SetContentHidden(bool hidden);
 
 	void ShowEditor(GenericEditor* editor);
+	// Destroy least recently shown editors above the count and memory limits
+	void EvictIdleEditors();
+	// Load exports next to the node in the tree
+	void PrefetchNeighbours(ObjectTreeNode* node);
 	void UpdateProperties(UObject* object, std::vector<FPropertyTag*> properties);
+	void OnPropertyExpanded(wxPropertyGridEvent& e);
 
 	void OnPropertiesSplitter(wxSplitterEvent& e);
 
@@ -95,6 +110,7 @@ private:
   App* Application = nullptr;
   std::shared_ptr<FPackage> Package = nullptr;
 	ObjectTreeDataViewCtrl* ObjectTreeCtrl = nullptr;
+	wxSearchCtrl* ObjectFilterCtrl = nullptr;
 	wxMenuItem* SettingsWindowMenu = nullptr;
 	wxMenuItem* LogWindowMenu = nullptr;
 	wxMenuItem* SaveMenu = nullptr;
@@ -124,7 +140,10 @@ private:
 	wxMenuItem* _DebugTestCookObject = nullptr;
 
 	std::map<PACKAGE_INDEX, GenericEditor*> Editors;
+	// Editors in the order they were shown, the latest at the back
+	std::list<PACKAGE_INDEX> EditorHistory;
 	GenericEditor* ActiveEditor = nullptr;
+	std::unique_ptr<ObjectLoadQueue> LoadQueue;
 	wxTimer HeartBeat;
 
 	wxObjectDataPtr<ObjectTreeModel> DataModel;
@@ -2,7 +2,12 @@
 #include "ProgressWindow.h"
 #include "../App.h"
 
+#include <atomic>
 #include <filesystem>
+#include <functional>
+#include <mutex>
+#include <vector>
+#include <ppl.h>
 
 #include <Utils/ALog.h>
 #include <Tera/FPackage.h>
@@ -17,6 +22,7 @@
 #include <Tera/USpeedTree.h>
 
 #include <Utils/FbxUtils.h>
+#include <Utils/MeshExporter.h>
 #include <Utils/TextureProcessor.h>
 
 void PackageWindow::OnBulkPackageExport(PACKAGE_INDEX objIndex)
@@ -85,6 +91,27 @@ void PackageWindow::OnBulkPackageExport(PACKAGE_INDEX objIndex)
 		return;
 	}
 
+	enum class MeshFormat {
+		FBX = 0,
+		GLB,
+		OBJ
+	};
+	MeshFormat meshFormat = MeshFormat::FBX;
+	if (std::find_if(exports.begin(), exports.end(), [](FObjectExport* exp) { return exp->GetClassName() == UStaticMesh::StaticClassName() || exp->GetClassName() == USkeletalMesh::StaticClassName(); }) != exports.end())
+	{
+		wxArrayString choices;
+		choices.Add(wxT("FBX (.fbx)"));
+		choices.Add(wxT("glTF Binary (.glb)"));
+		choices.Add(wxT("Wavefront OBJ (.obj)"));
+		wxSingleChoiceDialog formatDialog(this, wxT("Select a format to export meshes to:"), wxT("Mesh format"), choices);
+		formatDialog.SetSelection((int)MeshFormat::GLB);
+		if (formatDialog.ShowModal() != wxID_OK)
+		{
+			return;
+		}
+		meshFormat = (MeshFormat)formatDialog.GetSelection();
+	}
+
 	wxDirDialog dlg(NULL, "Select a directory to extract packages to...", "", wxDD_DEFAULT_STYLE | wxDD_DIR_MUST_EXIST);
 	if (dlg.ShowModal() != wxID_OK || dlg.GetPath().empty())
 	{
@@ -93,11 +120,24 @@ void PackageWindow::OnBulkPackageExport(PACKAGE_INDEX objIndex)
 
 	const std::filesystem::path root = std::filesystem::path(dlg.GetPath().ToStdWstring()) / (rootExport ? rootExport->GetObjectName().WString() : Package->GetPackageName().WString());
 	std::vector<FObjectExport*> failedExports;
+	std::mutex failedExportsMutex;
 
 	ProgressWindow progress(this, wxT("Exporting..."));
 	progress.SetMaxProgress(exports.size());
 
 	std::thread([&] {
+		auto addFailed = [&](FObjectExport* exp) {
+			std::scoped_lock<std::mutex> lock(failedExportsMutex);
+			failedExports.push_back(exp);
+		};
+
+		// Exports run on the PPL pool and must not wait for loads. All objects are loaded on this thread first, then exported in parallel.
+		std::vector<std::function<void()>> exportJobs;
+		std::atomic<int32> done(0);
+		auto finished = [&] {
+			SendEvent(&progress, UPDATE_PROGRESS, ++done);
+		};
+
 		for (int idx = 0; idx < exports.size(); ++idx)
 		{
 			if (progress.IsCanceled())
@@ -106,8 +146,7 @@ void PackageWindow::OnBulkPackageExport(PACKAGE_INDEX objIndex)
 				return;
 			}
 			FObjectExport* exp = exports[idx];
-			SendEvent(&progress, UPDATE_PROGRESS, idx);
-			SendEvent(&progress, UPDATE_PROGRESS_DESC, wxString("Exporting: ") + exp->GetObjectName().WString());
+			SendEvent(&progress, UPDATE_PROGRESS_DESC, wxString("Loading: ") + exp->GetObjectName().WString());
 			std::filesystem::path dest(root);
 			std::vector<std::wstring> pathComponents;
 			FObjectExport* outer = exp->Outer;
@@ -126,8 +165,9 @@ void PackageWindow::OnBulkPackageExport(PACKAGE_INDEX objIndex)
 			{
 				if (!std::filesystem::create_directories(dest, err))
 				{
-					failedExports.push_back(exp);
+					addFailed(exp);
 					LogE("Failed to create a directory to export %s", exp->GetObjectName().UTF8().c_str());
+					finished();
 					continue;
 				}
 			}
@@ -148,15 +188,14 @@ void PackageWindow::OnBulkPackageExport(PACKAGE_INDEX objIndex)
 			}
 			catch (...)
 			{
-				failedExports.push_back(exp);
-				LogE("Failed to load %s", exp->GetObjectName().UTF8().c_str());
-				continue;
+				obj = nullptr;
 			}
 
 			if (!obj)
 			{
-				failedExports.push_back(exp);
+				addFailed(exp);
 				LogE("Failed to load %s", exp->GetObjectName().UTF8().c_str());
+				finished();
 				continue;
 			}
 
@@ -165,8 +204,9 @@ void PackageWindow::OnBulkPackageExport(PACKAGE_INDEX objIndex)
 				UTexture2D* texture = Cast<UTexture2D>(obj);
 				if (!texture)
 				{
-					failedExports.push_back(exp);
+					addFailed(exp);
 					LogE("%s is not a texture", exp->GetObjectName().UTF8().c_str());
+					finished();
 					continue;
 				}
 				FTexture2DMipMap* mip = nullptr;
@@ -180,14 +220,15 @@ void PackageWindow::OnBulkPackageExport(PACKAGE_INDEX objIndex)
 				}
 				if (!mip)
 				{
-					failedExports.push_back(exp);
+					addFailed(exp);
+					finished();
 					continue;
 				}
 
-				dest.replace_extension(HasAVX2() ? "tga" : "dds");
+				dest.replace_extension("tga");
 
 				TextureProcessor::TCFormat inputFormat = TextureProcessor::TCFormat::None;
-				TextureProcessor::TCFormat outputFormat = HasAVX2() ? TextureProcessor::TCFormat::TGA : TextureProcessor::TCFormat::DDS;
+				TextureProcessor::TCFormat outputFormat = TextureProcessor::TCFormat::TGA;
 
 				if (texture->Format == PF_DXT1)
 				{
@@ -211,32 +252,34 @@ void PackageWindow::OnBulkPackageExport(PACKAGE_INDEX objIndex)
 				}
 				else
 				{
-					failedExports.push_back(exp);
+					addFailed(exp);
 					LogE("%s has unsupported pixel format!", exp->GetObjectName().UTF8().c_str());
+					finished();
 					continue;
 				}
 
-				TextureProcessor processor(inputFormat, outputFormat);
+				exportJobs.emplace_back([&, exp, mip, dest, inputFormat, outputFormat] {
+					TextureProcessor processor(inputFormat, outputFormat);
 
-				processor.SetInputData(mip->Data->GetAllocation(), mip->Data->GetBulkDataSize());
-				processor.SetOutputPath(W2A(dest.wstring()));
-				processor.SetInputDataDimensions(mip->SizeX, mip->SizeY);
+					processor.SetInputData(mip->Data->GetAllocation(), mip->Data->GetBulkDataSize());
+					processor.SetOutputPath(W2A(dest.wstring()));
+					processor.SetInputDataDimensions(mip->SizeX, mip->SizeY);
 
-				try
-				{
-					if (!processor.Process())
+					try
 					{
-						failedExports.push_back(exp);
-						LogE("Failed to export %s: %s", exp->GetObjectName().UTF8().c_str(), processor.GetError().c_str());
-						continue;
+						if (!processor.Process())
+						{
+							addFailed(exp);
+							LogE("Failed to export %s: %s", exp->GetObjectName().UTF8().c_str(), processor.GetError().c_str());
+						}
 					}
-				}
-				catch (...)
-				{
-					failedExports.push_back(exp);
-					LogE("Failed to export %s!", exp->GetObjectName().UTF8().c_str());
-					continue;
-				}
+					catch (...)
+					{
+						addFailed(exp);
+						LogE("Failed to export %s!", exp->GetObjectName().UTF8().c_str());
+					}
+					finished();
+				});
 				continue;
 			}
 			if (obj->GetClassName() == USoundNodeWave::StaticClassName())
@@ -244,20 +287,25 @@ void PackageWindow::OnBulkPackageExport(PACKAGE_INDEX objIndex)
 				dest.replace_extension("ogg");
 				if (USoundNodeWave* wave = Cast<USoundNodeWave>(obj))
 				{
-					const void* soundData = wave->GetResourceData();
-					const int32 soundDataSize = wave->GetResourceSize();
-					std::ofstream s(dest, std::ios::out | std::ios::trunc | std::ios::binary);
-					s.write((const char*)soundData, soundDataSize);
+					exportJobs.emplace_back([&, wave, dest] {
+						const void* soundData = wave->GetResourceData();
+						const int32 soundDataSize = wave->GetResourceSize();
+						std::ofstream s(dest, std::ios::out | std::ios::trunc | std::ios::binary);
+						s.write((const char*)soundData, soundDataSize);
+						finished();
+					});
 				}
 				else
 				{
-					failedExports.push_back(exp);
+					addFailed(exp);
 					LogE("%s is not a SoundNodeWave!", exp->GetObjectName().UTF8().c_str());
+					finished();
 				}
 				continue;
 			}
 			if (obj->GetClassName() == USpeedTree::StaticClassName())
 			{
+				// GetSptData uses the SpeedTree runtime. Keep it on this thread.
 				dest.replace_extension("spt");
 				if (USpeedTree* tree = Cast<USpeedTree>(obj))
 				{
@@ -265,8 +313,9 @@ void PackageWindow::OnBulkPackageExport(PACKAGE_INDEX objIndex)
 					FILE_OFFSET sptDataSize = 0;
 					if (!tree->GetSptData(&sptData, &sptDataSize, false) || !sptDataSize || !sptData)
 					{
-						failedExports.push_back(exp);
+						addFailed(exp);
 						LogE("Failed to export %s!", exp->GetObjectName().UTF8().c_str());
+						finished();
 						continue;
 					}
 					std::ofstream s(dest, std::ios::out | std::ios::trunc | std::ios::binary);
@@ -276,52 +325,64 @@ void PackageWindow::OnBulkPackageExport(PACKAGE_INDEX objIndex)
 				else
 				{
 					LogE("F%s is not a SpeedTree!", exp->GetObjectName().UTF8().c_str());
-					failedExports.push_back(exp);
+					addFailed(exp);
 				}
+				finished();
 				continue;
 			}
 			if (obj->GetClassName() == UStaticMesh::StaticClassName() || obj->GetClassName() == USkeletalMesh::StaticClassName())
 			{
-				FbxExportContext ctx;
-				ctx.Path = dest.replace_extension("fbx").wstring();
-
-				FbxUtils utils;
-				if (exp->GetClassName() == UStaticMesh::StaticClassName())
+				const bool isStatic = obj->GetClassName() == UStaticMesh::StaticClassName();
+				if (isStatic ? !Cast<UStaticMesh>(obj) : !Cast<USkeletalMesh>(obj))
 				{
-					if (UStaticMesh* mesh = Cast<UStaticMesh>(obj))
+					addFailed(exp);
+					LogE("%s is not a %s!", exp->GetObjectName().UTF8().c_str(), isStatic ? "StaticMesh" : "SkeletalMesh");
+					finished();
+					continue;
+				}
+				exportJobs.emplace_back([&, exp, obj, dest, isStatic]() mutable {
+					bool ok = false;
+					std::string error;
+					if (meshFormat == MeshFormat::FBX)
 					{
-						if (!utils.ExportStaticMesh(mesh, ctx))
-						{
-							failedExports.push_back(exp);
-							LogE("Failed to export %s!", exp->GetObjectName().UTF8().c_str());
-						}
+						// The FBX SDK manager is not thread-safe
+						static std::mutex fbxMutex;
+						std::scoped_lock<std::mutex> lock(fbxMutex);
+						FbxExportContext ctx;
+						ctx.Path = dest.replace_extension("fbx").wstring();
+						ctx.ExportSkeleton = true;
+						FbxUtils utils;
+						ok = isStatic ? utils.ExportStaticMesh(Cast<UStaticMesh>(obj), ctx) : utils.ExportSkeletalMesh(Cast<USkeletalMesh>(obj), ctx);
+						error = ctx.Error;
 					}
 					else
 					{
-						failedExports.push_back(exp);
-						LogE("%s is not a StaticMesh!", exp->GetObjectName().UTF8().c_str());
-					}
-				}
-				else
-				{
-					ctx.ExportSkeleton = true;
-					if (USkeletalMesh* mesh = Cast<USkeletalMesh>(obj))
-					{
-						if (!utils.ExportSkeletalMesh(mesh, ctx))
-						{
-							failedExports.push_back(exp);
-							LogE("Failed to export %s!", exp->GetObjectName().UTF8().c_str());
-						}
+						MeshExportContext ctx;
+						ctx.Format = meshFormat == MeshFormat::OBJ ? MeshExportFormat::OBJ : MeshExportFormat::GLB;
+						ctx.Path = dest.replace_extension(meshFormat == MeshFormat::OBJ ? "obj" : "glb").wstring();
+						ctx.ExportSkeleton = true;
+						ok = isStatic ? MeshExporter::ExportStaticMesh(Cast<UStaticMesh>(obj), ctx) : MeshExporter::ExportSkeletalMesh(Cast<USkeletalMesh>(obj), ctx);
+						error = ctx.Error;
 					}
-					else
+					if (!ok)
 					{
-						failedExports.push_back(exp);
-						LogE("%s is not a SkeletalMesh!", exp->GetObjectName().UTF8().c_str());
+						addFailed(exp);
+						LogE("Failed to export %s! %s", exp->GetObjectName().UTF8().c_str(), error.c_str());
 					}
-				}
+					finished();
+				});
 				continue;
 			}
+			finished();
 		}
+		SendEvent(&progress, UPDATE_PROGRESS_DESC, wxString("Exporting..."));
+		concurrency::parallel_for_each(exportJobs.begin(), exportJobs.end(), [&](const std::function<void()>& job) {
+			if (progress.IsCanceled())
+			{
+				return;
+			}
+			job();
+		});
 		SendEvent(&progress, UPDATE_PROGRESS_FINISH);
 	}).detach();
 
@@ -138,6 +138,11 @@ void PackageWindow::InitLayout()
 	stObjects->Wrap(-1);
 	treeSizer->Add(stObjects, 0, wxALL, 3);
 
+	ObjectFilterCtrl = new wxSearchCtrl(sidebarPanel, wxID_ANY, wxEmptyString, wxDefaultPosition, wxDefaultSize, 0);
+	ObjectFilterCtrl->ShowCancelButton(true);
+	ObjectFilterCtrl->SetDescriptiveText(wxT("Filter by name"));
+	treeSizer->Add(ObjectFilterCtrl, 0, wxLEFT | wxRIGHT | wxEXPAND, 4);
+
 	ObjectTreeCtrl = new ObjectTreeDataViewCtrl(sidebarPanel, wxID_ANY, wxDefaultPosition, wxDefaultSize, wxDV_NO_HEADER | wxDV_SINGLE);
 	ObjectTreeCtrl->SetBackgroundColour(wxSystemSettings::GetColour(wxSYS_COLOUR_WINDOW));
 	ObjectTreeCtrl->SetMinSize(wxSize(230, 600));
@@ -454,5 +459,9 @@ void PackageWindow::ShowEditor(GenericEditor* editor)
 	if ((ActiveEditor = editor))
 	{
 		Toolbar->Bind(wxEVT_TOOL, &GenericEditor::OnToolBarEvent, ActiveEditor);
+		const PACKAGE_INDEX index = editor->GetObject()->GetExportObject()->ObjectIndex;
+		EditorHistory.remove(index);
+		EditorHistory.push_back(index);
+		EvictIdleEditors();
 	}
 }
\ No newline at end of file
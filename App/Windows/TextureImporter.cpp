@@ -8,7 +8,8 @@ enum ControlElementId {
   MipGen,
   MipFilter,
   AddressX,
-  AddressY
+  AddressY,
+  Quality
 };
 
 inline int PixelFormatToWx(EPixelFormat fmt)
@@ -81,30 +82,15 @@ inline TextureAddress WxToTextureAddress(int address)
 
 wxString TextureImporter::LoadImageDialog(wxWindow* parent)
 {
-  wxString ext;
-  if (HasAVX2())
-  {
-    ext = wxT("Image files (*.png, *.tga, *.dds)|*.png;*.tga;*.dds");
-  }
-  else
-  {
-    ext = wxT("DDS files (*.dds)|*.dds");
-  }
+  // Without AVX2 images can be imported only to uncompressed formats. See TextureImporter::OnImportClicked.
+  wxString ext = wxT("Image files (*.png, *.tga, *.dds)|*.png;*.tga;*.dds");
   return wxFileSelector("Import a texture", wxEmptyString, wxEmptyString, ext, ext, wxFD_OPEN, parent);
 }
 
 
 wxString TextureImporter::SaveImageDialog(wxWindow* parent, const wxString& defaultFileName)
 {
-  wxString allowedExts;
-  if (HasAVX2())
-  {
-    allowedExts = wxT("TGA image|*.tga|*.PNG image|*.png|*.DDS texture|*.dds");
-  }
-  else
-  {
-    allowedExts = wxT("DDS texture|*.dds");
-  }
+  wxString allowedExts = wxT("TGA image|*.tga|*.PNG image|*.png|*.DDS texture|*.dds");
   return wxSaveFileSelector("texture", allowedExts, defaultFileName, parent);
 }
 
@@ -143,9 +129,28 @@ TextureImporter::TextureImporter(wxWindow* parent, EPixelFormat fmt, bool bNorma
 	PixelFormatChoices.Add("A8R8G8B8");
 	PixelFormatChoices.Add("G8");
 	PixelFormat = new wxChoice(m_panel1, ControlElementId::Format, wxDefaultPosition, wxDefaultSize, PixelFormatChoices, 0);
+	if (!HasAVX2() && fmt != PF_A8R8G8B8 && fmt != PF_G8)
+	{
+		// DXT compression needs AVX2
+		fmt = PF_A8R8G8B8;
+	}
 	PixelFormat->SetSelection(PixelFormatToWx(fmt));
 	bSizer2->Add(PixelFormat, 1, wxALIGN_CENTER_VERTICAL | wxALL, 5);
 
+	wxStaticText* m_staticText21;
+	m_staticText21 = new wxStaticText(m_panel1, wxID_ANY, wxT("Quality:"), wxDefaultPosition, wxDefaultSize, 0);
+	m_staticText21->Wrap(-1);
+	bSizer2->Add(m_staticText21, 0, wxALIGN_CENTER_VERTICAL | wxALL, 5);
+
+	wxArrayString QualityChoices;
+	QualityChoices.Add("Fast");
+	QualityChoices.Add("Normal");
+	QualityChoices.Add("Production");
+	Quality = new wxChoice(m_panel1, ControlElementId::Quality, wxDefaultPosition, wxDefaultSize, QualityChoices, 0);
+	Quality->SetSelection((int)TextureProcessor::TCQuality::Production);
+	Quality->SetToolTip(wxT("Compression quality of DXT formats. Lower quality imports large textures faster."));
+	bSizer2->Add(Quality, 1, wxALIGN_CENTER_VERTICAL | wxALL, 5);
+
 
 	m_panel1->SetSizer(bSizer2);
 	m_panel1->Layout();
@@ -208,7 +213,6 @@ TextureImporter::TextureImporter(wxWindow* parent, EPixelFormat fmt, bool bNorma
 
 	GenMips = new wxCheckBox(m_panel9, ControlElementId::MipGen, wxT("Generate mipmaps"), wxDefaultPosition, wxDefaultSize, 0);
 	GenMips->SetValue(false);
-	GenMips->Enable(HasAVX2());
 	bSizer14->Add(GenMips, 0, wxALL, 5);
 
 	wxStaticText* m_staticText20;
@@ -375,6 +379,11 @@ MipFilterType TextureImporter::GetMipFilter() const
 	return (MipFilterType)MipFilter->GetSelection();
 }
 
+TextureProcessor::TCQuality TextureImporter::GetQuality() const
+{
+	return (TextureProcessor::TCQuality)Quality->GetSelection();
+}
+
 bool TextureImporter::IsNormal() const
 {
 	return Normal->GetValue();
@@ -405,8 +414,20 @@ void TextureImporter::OnSRGBClick(wxCommandEvent&)
 	Normal->Enable(!SRGB->GetValue());
 }
 
+void TextureImporter::OnImportClicked(wxCommandEvent& event)
+{
+	const EPixelFormat fmt = GetPixelFormat();
+	if (!HasAVX2() && fmt != PF_A8R8G8B8 && fmt != PF_G8)
+	{
+		wxMessageBox(wxT("Your CPU does not support AVX2 instructions. DXT textures can be imported from DDS files only. Select A8R8G8B8 or G8 format to import this image."), wxT("Error!"), wxICON_ERROR, this);
+		return;
+	}
+	event.Skip();
+}
+
 wxBEGIN_EVENT_TABLE(TextureImporter, wxDialog)
 EVT_CHECKBOX(ControlElementId::Normal, TextureImporter::OnNormalClick)
 EVT_CHECKBOX(ControlElementId::MipGen, TextureImporter::OnGenMipsClicked)
 EVT_CHECKBOX(ControlElementId::SRGB, TextureImporter::OnSRGBClick)
+EVT_BUTTON(wxID_OK, TextureImporter::OnImportClicked)
 wxEND_EVENT_TABLE()
\ No newline at end of file
@@ -1,6 +1,7 @@
 #pragma once
 #include <wx/wx.h>
 #include <Tera/UTexture.h>
+#include <Utils/TextureProcessor.h>
 
 class TextureImporter : public wxDialog {
 public:
@@ -14,6 +15,7 @@ public:
   TextureAddress GetAddressX() const;
   TextureAddress GetAddressY() const;
   MipFilterType GetMipFilter() const;
+  TextureProcessor::TCQuality GetQuality() const;
   bool IsNormal() const;
   bool IsSRGB() const;
   bool GetGenerateMips() const;
@@ -22,6 +24,7 @@ protected:
   void OnNormalClick(wxCommandEvent&);
   void OnGenMipsClicked(wxCommandEvent&);
   void OnSRGBClick(wxCommandEvent&);
+  void OnImportClicked(wxCommandEvent& event);
 
 protected:
   wxChoice* PixelFormat = nullptr;
@@ -29,6 +32,7 @@ protected:
   wxCheckBox* SRGB = nullptr;
   wxCheckBox* GenMips = nullptr;
   wxChoice* MipFilter = nullptr;
+  wxChoice* Quality = nullptr;
   wxChoice* AddressX = nullptr;
   wxChoice* AddressY = nullptr;
   wxButton* CancelButton = nullptr;
@@ -42,7 +42,8 @@
 #include <Utils/ALog.h>
 
 #define HEAP_ALLOC(var,size) lzo_align_t __LZO_MMODEL var [ ((size) + (sizeof(lzo_align_t) - 1)) / sizeof(lzo_align_t) ]
-static HEAP_ALLOC(wrkmem, LZO1X_1_MEM_COMPRESS);
+// Packages, bulk data and TFC groups are compressed on several threads at once. Each thread needs its own dictionary.
+static thread_local HEAP_ALLOC(wrkmem, LZO1X_1_MEM_COMPRESS);
 
 #define COMPRESSED_BLOCK_MAGIC PACKAGE_MAGIC
 #define COMPRESSION_FLAGS_TYPE_MASK		0x0F
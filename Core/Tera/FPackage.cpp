@@ -11,11 +11,14 @@
 #include "UTexture.h"
 #include "Cast.h"
 
+#include "Utils/CompositePatcher.h"
+
 #include <iostream>
 #include <sstream>
 #include <algorithm>
 #include <filesystem>
 #include <array>
+#include <deque>
 #include <ppl.h>
 
 const char* PackageMapperName = "PkgMapper";
@@ -24,9 +27,6 @@ const char* ObjectRedirectorMapperName = "ObjectRedirectorMapper";
 const char* PackageListName = "DirCache.re";
 const char* PersistentDataName = "GlobalPersistentCookerData";
 
-const char Key1[] = { 12, 6, 9, 4, 3, 14, 1, 10, 13, 2, 7, 15, 0, 8, 5, 11 };
-const char Key2[] = { 'G', 'e', 'n', 'e', 'r', 'a', 't', 'e', 'P', 'a', 'c', 'k', 'a', 'g', 'e', 'M', 'a', 'p', 'p', 'e', 'r' };
-
 FString FPackage::RootDir;
 std::recursive_mutex FPackage::PackagesMutex;
 std::vector<std::shared_ptr<FPackage>> FPackage::LoadedPackages;
@@ -107,31 +107,10 @@ void BuildPackageList(const FString& path, std::vector<FString>& dirCache, std::
 
 void EncryptMapper(const FString& decrypted, std::vector<char>& encrypted)
 {
-  size_t size = decrypted.Size();
-  size_t offset = 0;
-  encrypted.resize(size);
-  for (offset = 0; offset < size; ++offset)
-  {
-    encrypted[offset] = decrypted[offset] ^ Key2[offset % sizeof(Key2)];
-  }
-
-  {
-    size_t a = 1;
-    size_t b = size - 1;
-    for (offset = (size / 2 + 1) / 2; offset; --offset, a += 2, b -= 2)
-    {
-      std::swap(encrypted[a], encrypted[b]);
-    }
-  }
-
-  std::array<char, sizeof(Key1)> tmp;
-  for (size_t offset = 0; offset + sizeof(Key1) <= size; offset += sizeof(Key1))
+  encrypted.resize(decrypted.Size());
+  if (encrypted.size())
   {
-    memcpy(&tmp[0], &encrypted[offset], sizeof(Key1));
-    for (size_t idx = 0; idx < sizeof(Key1); ++idx)
-    {
-      encrypted[offset + idx] = tmp[Key1[idx]];
-    }
+    EncryptMapperData(decrypted.C_str(), &encrypted[0], encrypted.size());
   }
 }
 
@@ -160,31 +139,9 @@ void DecryptMapper(const std::filesystem::path& path, FString& decrypted)
   
   LogI("Decrypting \"%s\"", path.filename().string().c_str());
 
-  size_t offset = 0;
-  for (; offset + sizeof(Key1) <= size; offset += sizeof(Key1))
+  if (size)
   {
-    for (size_t idx = 0; idx < sizeof(Key1); ++idx)
-    {
-      decrypted[offset + idx] = encrypted[offset + Key1[idx]];
-    }
-  }
-  for (; offset < size; ++offset)
-  {
-    decrypted[offset] = encrypted[offset];
-  }
-
-  {
-    size_t a = 1;
-    size_t b = size - 1;
-    for (offset = (size / 2 + 1) / 2; offset; --offset, a += 2, b -= 2)
-    {
-      std::swap(decrypted[a], decrypted[b]);
-    }
-  }
-
-  for (offset = 0; offset < size; ++offset)
-  {
-    decrypted[offset] ^= Key2[offset % sizeof(Key2)];
+    DecryptMapperData(&encrypted[0], &decrypted[0], size);
   }
 
   if ((*(wchar*)decrypted.C_str()) == 0xFEFF)
@@ -272,19 +229,66 @@ void FPackage::UpdateDirCache()
   LogI("Done. Found %ld packages", DirCache.size());
 }
 
-void FPackage::CreateCompositeMod(const std::vector<FString>& items, const FString& destination, FString name, FString author)
+// Size of a single buffer used to copy mod parts into the container
+#define COMPOSITE_MOD_COPY_CHUNK (8 * 1024 * 1024)
+
+// Copy size bytes from src to dst through two reusable buffers.
+// Next chunk is read on the PPL pool while the current one is being written.
+static void StreamCopy(FStream& src, FStream& dst, FILE_OFFSET size, std::vector<uint8>(&buffers)[2])
 {
-  std::vector<FString> objects;
-  std::vector<std::pair<FString, int32>> tfcs;
+  const FILE_OFFSET chunkSize = (FILE_OFFSET)buffers[0].size();
+  int32 current = 0;
+  FILE_OFFSET length = std::min(size, chunkSize);
+  src.SerializeBytes(buffers[current].data(), length);
+  concurrency::task_group reads;
+  while (length)
+  {
+    size -= length;
+    const FILE_OFFSET nextLength = std::min(size, chunkSize);
+    if (nextLength)
+    {
+      reads.run([&src, &buffers, current, nextLength] {
+        src.SerializeBytes(buffers[current ^ 1].data(), nextLength);
+      });
+    }
+    try
+    {
+      dst.SerializeBytes(buffers[current].data(), length);
+    }
+    catch (...)
+    {
+      // The read must finish before the buffers go away
+      reads.wait();
+      throw;
+    }
+    reads.wait();
+    current ^= 1;
+    length = nextLength;
+  }
+}
 
-  for (const FString& path : items)
-  {
+void FPackage::CreateCompositeMod(const std::vector<FString>& items, const FString& destination, FString name, FString author)
+{
+  // Validate all inputs concurrently. Errors are reported in the items order.
+  struct ItemInfo {
+    bool IsTfc = false;
+    int32 TfcIndex = 0;
+    FString ObjectName;
+    FILE_OFFSET Size = 0;
+    FString Error;
+  };
+  std::vector<ItemInfo> infos(items.size());
+  concurrency::parallel_for(size_t(0), items.size(), [&items, &infos](size_t itemIndex) {
+    const FString& path = items[itemIndex];
+    ItemInfo& info = infos[itemIndex];
     if (path.FileExtension().ToUpper() == "TFC")
     {
+      info.IsTfc = true;
       FString fname = path.Filename();
       if (!fname.StartWith(NAME_WorldTextures) || fname.Size() < strlen(NAME_WorldTextures) + 3)
       {
-        UThrow("Incorrect TFC name: %s!", path.Filename().UTF8().c_str());
+        info.Error = Sprintf("Incorrect TFC name: %s!", path.Filename().UTF8().c_str());
+        return;
       }
       int32 idx = 0;
       try
@@ -297,10 +301,11 @@ void FPackage::CreateCompositeMod(const std::vector<FString>& items, const FStri
       }
       if (idx <= 0)
       {
-        UThrow("Incorrect TFC name: %s!", path.Filename().UTF8().c_str());
+        info.Error = Sprintf("Incorrect TFC name: %s!", path.Filename().UTF8().c_str());
+        return;
       }
-      tfcs.push_back(std::make_pair(path, idx));
-      continue;
+      info.TfcIndex = idx;
+      return;
     }
 
     FReadStream s(path);
@@ -308,25 +313,45 @@ void FPackage::CreateCompositeMod(const std::vector<FString>& items, const FStri
     s << sum;
     if (!s.IsGood())
     {
-      UThrow("Failed to read package %s.", path.Filename().C_str());
+      info.Error = Sprintf("Failed to read package %s.", path.Filename().C_str());
+      return;
     }
     if (!sum.FolderName.StartWith("MOD:"))
     {
-      UThrow("Package %s has no composite info! Try to resave it from the original.", sum.PackageName.C_str());
+      info.Error = Sprintf("Package %s has no composite info! Try to resave it from the original.", sum.PackageName.C_str());
+      return;
     }
-    FString objName = sum.FolderName.Substr(4);
-    if (objName.Empty())
+    info.ObjectName = sum.FolderName.Substr(4);
+    if (info.ObjectName.Empty())
     {
-      UThrow("Package %s has no composite info! Try to resave it from the original.", sum.PackageName.C_str());
+      info.Error = Sprintf("Package %s has no composite info! Try to resave it from the original.", sum.PackageName.C_str());
+      return;
     }
-    for (int32 idx = 0; idx < objects.size(); ++idx)
+    info.Size = s.GetSize();
+  });
+
+  std::vector<FString> objects;
+  std::vector<std::pair<FString, int32>> tfcs;
+  std::unordered_map<FString, size_t> objectOwners;
+  for (size_t itemIndex = 0; itemIndex < items.size(); ++itemIndex)
+  {
+    const ItemInfo& info = infos[itemIndex];
+    if (info.Error.Size())
     {
-      if (objects[idx] == objName)
-      {
-        UThrow("%s and %s are modifying the same composite package!", path.Filename().C_str(), items[idx].Filename().C_str());
-      }
+      UThrow("%s", info.Error.C_str());
+    }
+    if (info.IsTfc)
+    {
+      tfcs.push_back(std::make_pair(items[itemIndex], info.TfcIndex));
+      continue;
     }
-    objects.push_back(objName);
+    auto owner = objectOwners.find(info.ObjectName);
+    if (owner != objectOwners.end())
+    {
+      UThrow("%s and %s are modifying the same composite package!", items[itemIndex].Filename().C_str(), items[owner->second].Filename().C_str());
+    }
+    objectOwners[info.ObjectName] = itemIndex;
+    objects.push_back(info.ObjectName);
   }
 
   if (objects.empty())
@@ -334,21 +359,25 @@ void FPackage::CreateCompositeMod(const std::vector<FString>& items, const FStri
     UThrow("You did not select any valid GPK file!");
   }
 
+  std::vector<uint8> buffers[2];
+  buffers[0].resize(COMPOSITE_MOD_COPY_CHUNK);
+  buffers[1].resize(COMPOSITE_MOD_COPY_CHUNK);
+
   std::vector<FILE_OFFSET> offsets;
   FWriteStream write(destination);
-  for (const FString& path : items)
+  for (size_t itemIndex = 0; itemIndex < items.size(); ++itemIndex)
   {
-    if (path.FileExtension().ToUpper() == "TFC")
+    if (infos[itemIndex].IsTfc)
     {
       continue;
     }
-    FReadStream read(path);
-    FILE_OFFSET size = read.GetSize();
-    void* data = malloc(size);
-    read.SerializeBytes(data, size);
+    FReadStream read(items[itemIndex]);
     offsets.push_back(write.GetPosition());
-    write.SerializeBytes(data, size);
-    free(data);
+    StreamCopy(read, write, infos[itemIndex].Size, buffers);
+    if (!read.IsGood() || !write.IsGood())
+    {
+      UThrow("Failed to copy %s to the mod container!", items[itemIndex].Filename().UTF8().c_str());
+    }
   }
 
   FILE_OFFSET gpkEndOffset = write.GetPosition();
@@ -359,10 +388,11 @@ void FPackage::CreateCompositeMod(const std::vector<FString>& items, const FStri
     FReadStream read(tfc.first);
     FILE_OFFSET tfcOffset = write.GetPosition();
     FILE_OFFSET tfcSize = read.GetSize();
-    void* data = malloc(tfcSize);
-    read.SerializeBytes(data, tfcSize);
-    write.SerializeBytes(data, tfcSize);
-    free(data);
+    StreamCopy(read, write, tfcSize, buffers);
+    if (!read.IsGood() || !write.IsGood())
+    {
+      UThrow("Failed to copy %s to the mod container!", tfc.first.Filename().UTF8().c_str());
+    }
     tfcOffsets.push_back({ tfcOffset, tfcSize, tfc.second });
   }
   FILE_OFFSET tfcEnd = write.GetPosition();
@@ -1161,21 +1191,7 @@ std::shared_ptr<FPackage> FPackage::GetPackageNamed(const FString& name, FGuid g
   if (CoreVersion > VER_TERA_CLASSIC && CompositPackageMap.count(name))
   {
     const FCompositePackageMapEntry& entry = CompositPackageMap[name];
-    FString packagePath;
-    for (FString& path : DirCache)
-    {
-      std::wstring filename = path.FilenameWString();
-      if (filename.size() < entry.FileName.Size())
-      {
-        continue;
-      }
-      std::wstring tmp = entry.FileName.WString();
-      if (std::mismatch(tmp.begin(), tmp.end(), filename.begin()).first == tmp.end())
-      {
-        packagePath = RootDir.FStringByAppendingPath(path);
-        break;
-      }
-    }
+    FString packagePath = GetCompositeContainerPath(entry);
     if (packagePath.Size())
     {
       LogI("Reading composite package %s from %s...", name.C_str(), entry.FileName.C_str());
@@ -1241,6 +1257,126 @@ std::shared_ptr<FPackage> FPackage::GetPackageNamed(const FString& name, FGuid g
   return nullptr;
 }
 
+FString FPackage::GetPackagePathNamed(const FString& name)
+{
+  if (CoreVersion > VER_TERA_CLASSIC && CompositPackageMap.count(name))
+  {
+    return FString();
+  }
+  std::wstring wname = name.WString();
+  for (FString& path : DirCache)
+  {
+    std::wstring filename = path.FilenameWString();
+    if (filename.size() >= wname.size() && std::mismatch(wname.begin(), wname.end(), filename.begin()).first == wname.end())
+    {
+      return RootDir.FStringByAppendingPath(path);
+    }
+  }
+  return FString();
+}
+
+FString FPackage::GetCompositeContainerPath(const FCompositePackageMapEntry& entry)
+{
+  std::wstring tmp = entry.FileName.WString();
+  for (FString& path : DirCache)
+  {
+    std::wstring filename = path.FilenameWString();
+    if (filename.size() < tmp.size())
+    {
+      continue;
+    }
+    if (std::mismatch(tmp.begin(), tmp.end(), filename.begin()).first == tmp.end())
+    {
+      return RootDir.FStringByAppendingPath(path);
+    }
+  }
+  return FString();
+}
+
+void FPackage::ReadCompositeExportTable(FStream& container, const FString& name, const FCompositePackageMapEntry& entry, std::vector<FExportTableEntry>& output)
+{
+  output.clear();
+  void* rawData = malloc(entry.Size);
+  container.SetPosition(entry.Offset);
+  container.SerializeBytes(rawData, entry.Size);
+  if (!container.IsGood())
+  {
+    free(rawData);
+    UThrow("Failed to read %s", name.C_str());
+  }
+
+  MReadStream rawStream(rawData, true, entry.Size);
+  FPackageSummary sum;
+  rawStream << sum;
+  if (CoreVersion && sum.GetFileVersion() != CoreVersion)
+  {
+    UThrow("%s version (%d/%d) differs from your game version(%d)", name.C_str(), sum.GetFileVersion(), sum.GetLicenseeVersion(), CoreVersion);
+  }
+  sum.PackageName = name;
+
+  // Tables of a compressed package are in the decompressed data. Keep it in memory instead of a temp file.
+  std::unique_ptr<MReadStream> decompressedStream;
+  if (sum.CompressedChunks.size())
+  {
+    FILE_OFFSET endOffset = 0;
+    for (const FCompressedChunk& chunk : sum.CompressedChunks)
+    {
+      if (chunk.CompressedOffset < 0 || chunk.CompressedSize < 0 || chunk.CompressedOffset + chunk.CompressedSize > entry.Size || chunk.DecompressedOffset < 0 || chunk.DecompressedSize < 0)
+      {
+        UThrow("%s has an invalid compressed chunk", name.C_str());
+      }
+      endOffset = std::max(endOffset, chunk.DecompressedOffset + chunk.DecompressedSize);
+    }
+    uint8* decompressedData = (uint8*)malloc(endOffset);
+    decompressedStream = std::make_unique<MReadStream>(decompressedData, true, endOffset);
+    for (const FCompressedChunk& chunk : sum.CompressedChunks)
+    {
+      LZO::Decompress((uint8*)rawStream.GetAllocation() + chunk.CompressedOffset, chunk.CompressedSize, decompressedData + chunk.DecompressedOffset, chunk.DecompressedSize);
+    }
+  }
+  FStream& s = decompressedStream ? (FStream&)*decompressedStream : (FStream&)rawStream;
+
+  // A transient package only resolves names and outers. It is not registered in LoadedPackages.
+  FPackage package(sum);
+  s.SetPackage(&package);
+
+  s.SetPosition(sum.NamesOffset);
+  for (uint32 idx = 0; idx < sum.NamesCount && s.IsGood(); ++idx)
+  {
+    s << package.Names.emplace_back(FNameEntry());
+  }
+
+  s.SetPosition(sum.ImportsOffset);
+  for (uint32 idx = 0; idx < sum.ImportsCount && s.IsGood(); ++idx)
+  {
+    FObjectImport* imp = package.Imports.emplace_back(new FObjectImport(&package));
+    imp->ObjectIndex = -(PACKAGE_INDEX)idx - 1;
+    s << *imp;
+  }
+
+  s.SetPosition(sum.ExportsOffset);
+  for (uint32 idx = 0; idx < sum.ExportsCount && s.IsGood(); ++idx)
+  {
+    FObjectExport* exp = package.Exports.emplace_back(new FObjectExport(&package));
+    exp->ObjectIndex = (PACKAGE_INDEX)idx + 1;
+    s << *exp;
+  }
+
+  if (!s.IsGood())
+  {
+    UThrow("Failed to read tables of %s", name.C_str());
+  }
+
+  output.reserve(package.Exports.size());
+  for (FObjectExport* exp : package.Exports)
+  {
+    FExportTableEntry& result = output.emplace_back();
+    result.ClassName = exp->GetClassName();
+    result.ObjectIndex = exp->ObjectIndex;
+    result.ObjectPath = exp->GetObjectPath();
+  }
+}
+
 void FPackage::UnloadPackage(std::shared_ptr<FPackage> package)
 {
   if (!package)
@@ -2130,9 +2266,7 @@ UObject* FPackage::GetObject(FObjectImport* imp, bool load)
         {
           if (impPkgName == external->GetPackageName(false))
           {
-            UObject* obj = external->GetObject(imp, load);
-            ImportObjects[imp->ObjectIndex] = obj;
-            return obj;
+            return SetCachedImportObject(imp->ObjectIndex, external->GetObject(imp, load));
           }
         }
       }
@@ -2142,10 +2276,11 @@ UObject* FPackage::GetObject(FObjectImport* imp, bool load)
         package->Load();
         if (UObject* obj = package->GetObject(imp, load))
         {
-          std::scoped_lock<std::mutex> lock(ExternalPackagesMutex);
-          ExternalPackages.emplace_back(package);
-          ImportObjects[imp->ObjectIndex] = obj;
-          return obj;
+          {
+            std::scoped_lock<std::mutex> lock(ExternalPackagesMutex);
+            ExternalPackages.emplace_back(package);
+          }
+          return SetCachedImportObject(imp->ObjectIndex, obj);
         }
         UnloadPackage(package);
       }
@@ -2523,17 +2658,22 @@ PACKAGE_INDEX FPackage::ImportClass(UClass* cls)
 
 void FPackage::AddNetObject(UObject* object)
 {
+  std::scoped_lock<std::mutex> lock(NetIndexMutex);
   NetIndexMap[object->GetNetIndex()] = object;
 }
 
 UObject* FPackage::GetObject(NET_INDEX netIndex, const FString& name, const FString& className)
 {
   UObject* result = nullptr;
-  if (netIndex != INDEX_NONE && NetIndexMap.count(netIndex))
   {
-    result = NetIndexMap[netIndex];
+    std::scoped_lock<std::mutex> lock(NetIndexMutex);
+    auto it = netIndex != INDEX_NONE ? NetIndexMap.find(netIndex) : NetIndexMap.end();
+    if (it != NetIndexMap.end())
+    {
+      result = it->second;
+    }
   }
-  else
+  if (!result)
   {
     std::vector<FObjectExport*> exps = GetExportObject(name);
     UObject* obj = nullptr;
@@ -2577,6 +2717,75 @@ std::vector<FObjectExport*> FPackage::GetExportObject(const FString& name)
   return std::vector<FObjectExport*>();
 }
 
+FObjectResource* FPackage::GetResourceByPath(const FString& path) const
+{
+  // Normalize the path: skip empty components and ignore the case
+  std::string normalized;
+  {
+    std::string component;
+    std::istringstream stream(path.ToUpper().String());
+    while (std::getline(stream, component, '.'))
+    {
+      if (component.size())
+      {
+        normalized += normalized.size() ? "." + component : component;
+      }
+    }
+  }
+  if (normalized.empty())
+  {
+    return nullptr;
+  }
+  const FString key(normalized);
+
+  std::scoped_lock<std::mutex> lock(ResourcePathsMutex);
+  if (!ResourcePathsValid)
+  {
+    ExportPaths.clear();
+    ImportPaths.clear();
+    // Breadth-first, so the first of the objects with the same path wins
+    std::deque<std::pair<FObjectExport*, FString>> exports;
+    for (FObjectExport* exp : RootExports)
+    {
+      exports.emplace_back(exp, exp->GetObjectName().ToUpper());
+    }
+    while (exports.size())
+    {
+      auto [exp, expPath] = exports.front();
+      exports.pop_front();
+      for (FObjectExport* inner : exp->Inner)
+      {
+        exports.emplace_back(inner, expPath + "." + inner->GetObjectName().ToUpper());
+      }
+      ExportPaths.emplace(std::move(expPath), exp);
+    }
+    std::deque<std::pair<FObjectImport*, FString>> imports;
+    for (FObjectImport* imp : RootImports)
+    {
+      imports.emplace_back(imp, imp->GetObjectName().ToUpper());
+    }
+    while (imports.size())
+    {
+      auto [imp, impPath] = imports.front();
+      imports.pop_front();
+      for (FObjectImport* inner : imp->Inner)
+      {
+        imports.emplace_back(inner, impPath + "." + inner->GetObjectName().ToUpper());
+      }
+      ImportPaths.emplace(std::move(impPath), imp);
+    }
+    ResourcePathsValid = true;
+  }
+
+  auto exportIt = ExportPaths.find(key);
+  if (exportIt != ExportPaths.end())
+  {
+    return exportIt->second;
+  }
+  auto importIt = ImportPaths.find(key);
+  return importIt != ImportPaths.end() ? importIt->second : nullptr;
+}
+
 void FPackage::MarkDirty(bool dirty)
 {
   if (dirty)
@@ -2601,6 +2810,12 @@ FObjectImport* FPackage::GetImportObject(const FString& objectName, const FStrin
   return nullptr;
 }
 
+void FPackage::InvalidateResourcePaths()
+{
+  std::scoped_lock<std::mutex> lock(ResourcePathsMutex);
+  ResourcePathsValid = false;
+}
+
 bool FPackage::AddImport(UObject* object, FObjectImport*& output)
 {
   if (!object || !object->GetPackage() || object->GetPackage() == this)
@@ -2608,6 +2823,8 @@ bool FPackage::AddImport(UObject* object, FObjectImport*& output)
     output = nullptr;
     return false;
   }
+  // The import tree changes below and some paths return early after changing it
+  InvalidateResourcePaths();
 
   FObjectImport* outerPackage = nullptr;
   FString outerPackageName = object->GetPackage()->GetPackageName();
@@ -2648,6 +2865,7 @@ bool FPackage::AddImport(UObject* object, FObjectImport*& output)
     importObject->ObjectIndex = -(PACKAGE_INDEX)Imports.size();
     RootImports.push_back(importObject);
     outerPackage = importObject;
+    InvalidateResourcePaths();
     MarkDirty();
   }
 
@@ -2674,6 +2892,7 @@ bool FPackage::AddImport(UObject* object, FObjectImport*& output)
     {
       outerImp->Inner.push_back(imp);
       imp->OuterIndex = outerImp->ObjectIndex;
+      InvalidateResourcePaths();
     }
     outerImp = imp;
   }
@@ -2694,6 +2913,7 @@ bool FPackage::AddImport(UObject* object, FObjectImport*& output)
   importObject->ObjectIndex = -(PACKAGE_INDEX)Imports.size();
   output = importObject;
   ImportObjects[importObject->ObjectIndex] = object;
+  InvalidateResourcePaths();
   MarkDirty();
   return true;
 }
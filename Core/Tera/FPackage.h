@@ -27,6 +27,13 @@ struct PackageSaveContext {
 	std::function<bool(void)> IsCancelledCallback;
 };
 
+// Export table entry read without loading the package
+struct FExportTableEntry {
+	FString ClassName;
+	PACKAGE_INDEX ObjectIndex = 0;
+	FString ObjectPath;
+};
+
 class FPackage {
 public:
 
@@ -48,6 +55,8 @@ public:
 	static std::shared_ptr<FPackage> GetPackage(const FString& path);
 	// Load and retain a package by name and guid(if valid). Every GetPackageNamed call must pair a UnloadPackage call
 	static std::shared_ptr<FPackage> GetPackageNamed(const FString& name, FGuid guid = FGuid());
+	// Path of the first file GetPackageNamed would try for the name. Empty for composite and missing packages.
+	static FString GetPackagePathNamed(const FString& name);
 	// Release a package. 
 	static void UnloadPackage(std::shared_ptr<FPackage> package);
 	// Find and cache all packages
@@ -66,6 +75,11 @@ public:
 	static FString GetCompositePackageMapPath();
 	// Get composite package name for an object path
 	static FString GetObjectCompositePath(const FString& path);
+	// Get full path of the container file that stores the composite package entry. Empty if there is no such file
+	static FString GetCompositeContainerPath(const FCompositePackageMapEntry& entry);
+	// Read the export table of a composite package straight from its container slice.
+	// Doesn't register the package, create objects or write temporary files. Thread safe. Throws.
+	static void ReadCompositeExportTable(FStream& container, const FString& name, const FCompositePackageMapEntry& entry, std::vector<FExportTableEntry>& output);
 	// Update DirCache
 	static void UpdateDirCache();
 	// Create a composite mod package
@@ -121,6 +135,13 @@ public:
 	// Get all exports that match the name
 	std::vector<FObjectExport*> GetExportObject(const FString& name);
 
+	// Find a resource by its path inside the package, e.g. "Group.Object". Case-insensitive. Exports take precedence.
+	// Paths are hashed on the first call.
+	FObjectResource* GetResourceByPath(const FString& path) const;
+
+	// Rebuild the paths on the next GetResourceByPath. Call after changing root resources or Inner lists.
+	void InvalidateResourcePaths();
+
 	// Package has changes
 	inline bool IsDirty() const
 	{
@@ -379,9 +400,15 @@ private:
 	FString CompositeSourcePath;
 
 	// Cached netIndices for faster netIndex lookup. Containes only loaded objects!
+	std::mutex NetIndexMutex;
 	std::map<NET_INDEX, UObject*> NetIndexMap;
 	// Name to Object map for faster import lookup
 	std::unordered_map<FString, std::vector<FObjectExport*>> ObjectNameToExportMap;
+	// Upper case paths of resources for GetResourceByPath. Rebuilt after resources are linked.
+	mutable std::mutex ResourcePathsMutex;
+	mutable std::unordered_map<FString, FObjectExport*> ExportPaths;
+	mutable std::unordered_map<FString, FObjectImport*> ImportPaths;
+	mutable bool ResourcePathsValid = false;
 	// List of packages we rely on
 	std::mutex ExternalPackagesMutex;
 	std::vector<std::shared_ptr<FPackage>> ExternalPackages;
@@ -32,6 +32,23 @@ public:
 
   void Serialize(FStream& s) override;
 
+  // Compressed keys. CompressedTrackOffsets index this buffer.
+  const uint8* GetCompressedData() const
+  {
+    return SerializedData;
+  }
+
+  int32 GetCompressedSize() const
+  {
+    return NumBytes;
+  }
+
+  // Tracks of the compressed data. Four offsets per track: translation keys, number of translation keys, rotation keys, number of rotation keys.
+  int32 GetCompressedTrackCount() const
+  {
+    return (int32)CompressedTrackOffsets.size() / 4;
+  }
+
 protected:
   std::vector<FRawAnimSequenceTrack> RawAnimationData;
   int32 NumBytes = 0;
@@ -19,6 +19,7 @@ UProperty* CreateProperty(const char* name, const  char* className, UStruct* par
 {
   VObjectExport* exp = parent->GetPackage()->CreateVirtualExport(name, className);
   parent->GetExportObject()->Inner.push_back(exp);
+  parent->GetPackage()->InvalidateResourcePaths();
   UProperty* prop = (UProperty*)UObject::Object(exp);
   exp->SetObject(prop);
   if (UField* field = parent->GetChildren())
@@ -8,10 +8,70 @@
 
 #include "Utils/ALog.h"
 
+#include <condition_variable>
+#include <mutex>
+#include <unordered_map>
+
 #if DUMP_OBJECTS
 #include <filesystem>
 #endif
 
+namespace
+{
+  // Guards UObject::Loader and WaitingThreads
+  std::mutex LoadMutex;
+  // Notified when any load finishes
+  std::condition_variable LoadFinished;
+  // Loaders of objects the threads wait for
+  std::unordered_map<std::thread::id, std::thread::id> WaitingThreads;
+
+  // Ends a load even if serialization throws
+  class LoadScope {
+  public:
+    LoadScope(std::thread::id& loader, bool& failed)
+      : Loader(loader)
+      , Failed(failed)
+    {}
+
+    ~LoadScope()
+    {
+      {
+        std::scoped_lock<std::mutex> lock(LoadMutex);
+        Loader = std::thread::id();
+        Failed = !Finished;
+      }
+      LoadFinished.notify_all();
+    }
+
+    void Finish()
+    {
+      Finished = true;
+    }
+
+  private:
+    std::thread::id& Loader;
+    bool& Failed;
+    bool Finished = false;
+  };
+
+  // True if the loader is the current thread or waits for it through other loaders. Expects LoadMutex to be locked.
+  bool WaitsForCurrentThread(std::thread::id loader)
+  {
+    const std::thread::id self = std::this_thread::get_id();
+    // Waits never form a cycle, so the chain ends
+    while (loader != self)
+    {
+      auto it = WaitingThreads.find(loader);
+      if (it == WaitingThreads.end())
+      {
+        return false;
+      }
+      loader = it->second;
+    }
+    return true;
+  }
+}
+
 UObject::UObject(FObjectExport* exp)
   : Export(exp)
 {
@@ -324,7 +384,7 @@ void UObject::Serialize(FStream& s)
 
 void UObject::Load()
 {
-  if (!GetPackage()->GetStream().GetLoadSerializedObjects())
+  if (Loaded || !GetPackage()->GetStream().GetLoadSerializedObjects())
   {
     return;
   }
@@ -338,11 +398,27 @@ void UObject::Load()
 
 void UObject::Load(FStream& s)
 {
-  if (Loaded || Loading)
+  const std::thread::id self = std::this_thread::get_id();
   {
-    return;
+    std::unique_lock<std::mutex> lock(LoadMutex);
+    while (Loader != std::thread::id())
+    {
+      if (WaitsForCurrentThread(Loader))
+      {
+        // Waiting would deadlock
+        return;
+      }
+      WaitingThreads[self] = Loader;
+      LoadFinished.wait(lock);
+      WaitingThreads.erase(self);
+    }
+    if (Loaded || LoadFailed)
+    {
+      return;
+    }
+    Loader = self;
   }
-  Loading = true;
+  LoadScope scope(Loader, LoadFailed);
 
   // Load object's class and a default object
   if (GetClassName() != UClass::StaticClassName())
@@ -393,13 +469,20 @@ void UObject::Load(FStream& s)
 #endif
 
   Loaded = true;
-  Loading = false;
 
   if (s.IsReading())
   {
     //DBreakIf(s.GetPosition() != Export->SerialOffset + Export->SerialSize);
     PostLoad();
   }
+  // Other threads wait for PostLoad too
+  scope.Finish();
+}
+
+bool UObject::IsLoading() const
+{
+  std::scoped_lock<std::mutex> lock(LoadMutex);
+  return Loader != std::thread::id();
 }
 
 void UObject::PostLoad()
@@ -3,6 +3,9 @@
 #include "FStream.h"
 #include "FPropertyTag.h"
 
+#include <atomic>
+#include <thread>
+
 // Common UObject subclass declarations
 #define DECL_UOBJ(TClass, TSuper)\
 public:\
@@ -142,6 +145,8 @@ public:
   virtual void Load();
 
   // Load the object from the provided stream. Will set correct stream offset.
+  // Safe to call from several threads: a thread waits for a load running on another thread, unless that load waits
+  // for this thread. A load that waits for itself returns the object as is, like a recursive load on one thread does.
   virtual void Load(FStream& s);
 
   // Serialize object by an index
@@ -241,6 +246,9 @@ public:
     return Loaded;
   }
 
+  // True while a thread loads the object. IsLoaded is set before PostLoad, this one after it.
+  bool IsLoading() const;
+
   // Get object's class object
   inline UClass* GetClass() const
   {
@@ -294,7 +302,7 @@ protected:
   void SerializeTrailingData(FStream& s);
 
 protected:
-  bool Loaded = false;
+  std::atomic_bool Loaded = { false };
   FObjectExport* Export = nullptr;
   FStateFrame* StateFrame = nullptr;
   NET_INDEX NetIndex = INDEX_NONE;
@@ -317,5 +325,8 @@ protected:
   std::string Description;
 #endif
 private:
-  bool Loading = false;
+  // Thread that loads the object. Empty unless a load is running. Guarded by the load mutex.
+  std::thread::id Loader;
+  // Serialization has thrown. The object is not loaded again, as before loads could wait.
+  bool LoadFailed = false;
 };
\ No newline at end of file
@@ -460,11 +460,27 @@ public:
 		return NumTexCoords;
 	}
 
+	uint32 GetNumVertices() const
+	{
+		return NumVertices;
+	}
+
+	// Vertices in the order of the index buffer, chunk by chunk
+	const FSkeletalMeshVertexBuffer& GetGPUSkinVertexBuffer() const
+	{
+		return VertexBufferGPUSkin;
+	}
+
 	const FMultiSizeIndexContainer* GetIndexContainer() const
 	{
 		return &IndexContainer;
 	}
 
+	const std::vector<FSkelMeshChunk>& GetChunks() const
+	{
+		return Chunks;
+	}
+
 private:
 	std::vector<FSkelMeshSection> Sections;
 	std::vector<uint16> LegacyShadowIndices;
@@ -504,6 +520,11 @@ public:
 		return &LodModels[idx];
 	}
 
+	inline int32 GetLodCount() const
+	{
+		return (int32)LodModels.size();
+	}
+
 	inline std::vector<UObject*> GetMaterials() const
 	{
 		return Materials;
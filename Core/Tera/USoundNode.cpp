@@ -40,11 +40,3 @@ void USoundNodeWave::Serialize(FStream& s)
   UnkData4.Serialize(s, this);
   UnkData5.Serialize(s, this);
 }
-
-void USoundNodeWave::PostLoad()
-{
-  if ((ResourceSize = PCData.GetBulkDataSize()))
-  {
-    PCData.GetCopy(&ResourceData);
-  }
-}
@@ -13,21 +13,16 @@ public:
   bool RegisterProperty(FPropertyTag* property) override;
 
   void Serialize(FStream& s) override;
-  void PostLoad() override;
 
+  // PC Ogg Vorbis data. Read in place, not copied.
   const void* GetResourceData() const
   {
-    return ResourceData;
+    return PCData.GetAllocation();
   }
 
   uint32 GetResourceSize() const
   {
-    return ResourceSize;
-  }
-
-  ~USoundNodeWave() override
-  {
-    free(ResourceData);
+    return PCData.GetAllocation() ? PCData.GetBulkDataSize() : 0;
   }
 
   friend bool SoundTravaller::Visit(USoundNodeWave* texture);
@@ -42,7 +37,4 @@ protected:
   FByteBulkData UnkData3;
   FByteBulkData UnkData4;
   FByteBulkData UnkData5;
-
-  void* ResourceData = nullptr;
-  uint32 ResourceSize = 0;
 };
@@ -279,8 +279,23 @@ public:
     return &LODModels[idx];
   }
 
+  int32 GetLodCount() const
+  {
+    return (int32)LODModels.size();
+  }
+
   std::vector<UObject*> GetMaterials() const;
 
+  const FBoxSphereBounds& GetBounds() const
+  {
+    return Bounds;
+  }
+
+  const FkDOPTreeCompact& GetkDOPTree() const
+  {
+    return kDOPTree;
+  }
+
 protected:
   DECL_UREF(UObject, FBodySetup);
 
@@ -48,6 +48,13 @@ PF_Info PixelFormatInfo[] = {
   { 1,			1,			1,			0,			3, 			GL_NONE},           //	PF_FloatR11G11B10
 };
 
+// Process-wide, so generations of different textures never repeat
+inline uint32 NewDataGeneration()
+{
+  static std::atomic_uint32_t next = 0;
+  return ++next;
+}
+
 inline bool FindInternalFormatAndType(uint32 pixelFormat, GLenum& outFormat, GLenum& outType, bool bSRGB)
 {
   switch (pixelFormat)
@@ -351,6 +358,7 @@ void UTexture2D::DisableCaching()
 void UTexture2D::PostLoad()
 {
   Super::PostLoad();
+  DataGeneration = NewDataGeneration();
   FString cacheName;
   FStream* rs = nullptr;
   for (int32 idx = 0; idx < Mips.size(); ++idx)
@@ -476,6 +484,7 @@ void UTexture2D::DeleteStorage()
     delete e;
   }
   CachedEtcMips.clear();
+  DataGeneration = NewDataGeneration();
 }
 
 
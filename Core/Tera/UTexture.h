@@ -3,6 +3,7 @@
 #include <Utils/TextureTravaller.h>
 
 #include <array>
+#include <atomic>
 
 namespace osg
 {
@@ -49,6 +50,13 @@ public:
 
   bool RenderTo(osg::Image* target);
 
+  // Changes when the mip data is loaded or replaced. Caches of rendered images compare it to detect imports.
+  // Generations are unique across textures, so a texture allocated at the address of a deleted one never matches it.
+  uint32 GetDataGeneration() const
+  {
+    return DataGeneration;
+  }
+
   friend bool TextureTravaller::Visit(UTexture2D* texture);
 
   void Serialize(FStream& s) override;
@@ -73,6 +81,7 @@ protected:
   std::vector<FTexture2DMipMap*> CachedEtcMips;
   FGuid TextureFileCacheGuid;
   int32 MaxCachedResolution = 0;
+  std::atomic_uint32_t DataGeneration = 0;
 };
 
 class UTerrainWeightMapTexture : public UTexture2D {
@@ -0,0 +1,431 @@
+#include "AnimDecoder.h"
+
+#include <Tera/UAnimSequence.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <ppl.h>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#define ANIM_DECODER_SSE2 1
+#include <emmintrin.h>
+#endif
+
+// Tracks sampled by one worker. Keys are unpacked to the stack in chunks of this size.
+#define ANIM_DECODER_CHUNK_SIZE 64
+
+namespace
+{
+  template <typename T>
+  inline T Read(const uint8* ptr)
+  {
+    // Keys are packed without alignment
+    T result;
+    memcpy(&result, ptr, sizeof(T));
+    return result;
+  }
+
+  inline FVector ReadVector(const uint8* ptr)
+  {
+    return FVector(Read<float>(ptr), Read<float>(ptr + 4), Read<float>(ptr + 8));
+  }
+
+  // ACF_Float32NoW components: a sign bit, 3 exponent bits and the mantissa
+  inline float DecodePackedFloat(uint32 value, uint32 mantissaBits)
+  {
+    if (!value)
+    {
+      return 0.f;
+    }
+    const uint32 mantissa = value & ((1u << mantissaBits) - 1);
+    const uint32 exponent = (value >> mantissaBits) & 7;
+    const uint32 sign = (value >> (mantissaBits + 3)) & 1;
+    const uint32 bits = (sign << 31) | ((exponent + 123) << 23) | (mantissa << (23 - mantissaBits));
+    return Read<float>((const uint8*)&bits);
+  }
+
+  // Keys around the relative position in the sequence and the blend weight between them.
+  // Looping sequences blend the last key into the first one.
+  inline float GetKeys(float relativePos, int32 numKeys, bool looping, int32& index0, int32& index1)
+  {
+    index0 = 0;
+    index1 = 0;
+    if (numKeys < 2 || relativePos <= 0.f)
+    {
+      return 0.f;
+    }
+    const int32 lastKey = numKeys - 1;
+    if (relativePos >= 1.f)
+    {
+      index0 = looping ? 0 : lastKey;
+      index1 = index0;
+      return 0.f;
+    }
+    const float keyPos = relativePos * (float)(looping ? numKeys : lastKey);
+    index0 = std::min((int32)keyPos, lastKey);
+    index1 = index0 + 1;
+    if (index1 > lastKey)
+    {
+      index1 = looping ? 0 : lastKey;
+    }
+    return keyPos - (float)index0;
+  }
+}
+
+AnimDecoder::AnimDecoder(const UAnimSequence* sequence)
+{
+  if (!sequence || !sequence->GetCompressedData())
+  {
+    return;
+  }
+  RotationFormat = sequence->RotationCompressionFormat;
+  TranslationFormat = sequence->TranslationCompressionFormat;
+  Duration = sequence->SequenceDuration;
+  Looping = !sequence->bNoLoopingInterpolation;
+  if (RotationFormat >= ACF_MAX || (TranslationFormat != ACF_None && TranslationFormat != ACF_Float96NoW && TranslationFormat != ACF_Identity))
+  {
+    return;
+  }
+
+  const uint8* data = sequence->GetCompressedData();
+  const int64 size = sequence->GetCompressedSize();
+  const std::vector<int>& offsets = sequence->CompressedTrackOffsets;
+  const int32 numTracks = sequence->GetCompressedTrackCount();
+  Tracks.resize(numTracks);
+  for (int32 idx = 0; idx < numTracks; ++idx)
+  {
+    const int64 translationOffset = offsets[idx * 4];
+    const int64 numTranslations = offsets[idx * 4 + 1];
+    const int64 rotationOffset = offsets[idx * 4 + 2];
+    const int64 numRotations = offsets[idx * 4 + 3];
+    if (numTranslations < 0 || numRotations < 0)
+    {
+      Tracks.clear();
+      return;
+    }
+
+    int64 translationSize = 0;
+    if (TranslationFormat != ACF_Identity)
+    {
+      translationSize = numTranslations * (int64)sizeof(FVector);
+    }
+    int64 rotationSize = 0;
+    if (RotationFormat != ACF_Identity)
+    {
+      if (numRotations == 1)
+      {
+        rotationSize = (int64)GetRotationKeySize(ACF_Float96NoW);
+      }
+      else if (numRotations > 1)
+      {
+        // Interval keys are preceded by mins and ranges of the track
+        rotationSize = numRotations * (int64)GetRotationKeySize(RotationFormat) + (RotationFormat == ACF_IntervalFixed32NoW ? sizeof(float) * 6 : 0);
+      }
+    }
+    if ((translationSize && (translationOffset < 0 || translationOffset + translationSize > size)) ||
+        (rotationSize && (rotationOffset < 0 || rotationOffset + rotationSize > size)))
+    {
+      Tracks.clear();
+      return;
+    }
+
+    Track& track = Tracks[idx];
+    track.Translations = translationSize ? data + translationOffset : nullptr;
+    track.NumTranslations = translationSize ? (int32)numTranslations : 0;
+    track.Rotations = rotationSize ? data + rotationOffset : nullptr;
+    track.NumRotations = rotationSize ? (int32)numRotations : 0;
+  }
+  Valid = true;
+}
+
+size_t AnimDecoder::GetRotationKeySize(AnimationCompressionFormat format)
+{
+  switch (format)
+  {
+  case ACF_None:
+    return sizeof(float) * 4;
+  case ACF_Float96NoW:
+    return sizeof(float) * 3;
+  case ACF_Fixed48NoW:
+    return sizeof(uint16) * 3;
+  case ACF_IntervalFixed32NoW:
+  case ACF_Fixed32NoW:
+  case ACF_Float32NoW:
+    return sizeof(uint32);
+  default:
+    return 0;
+  }
+}
+
+void AnimDecoder::DecodeRotationKey(AnimationCompressionFormat format, const uint8* key, const float* mins, const float* ranges, FQuat& dst)
+{
+  switch (format)
+  {
+  case ACF_None:
+  {
+    dst.X = Read<float>(key);
+    dst.Y = Read<float>(key + 4);
+    dst.Z = Read<float>(key + 8);
+    // W is restored with the other formats. q and -q are the same rotation, so keep the one with a positive W.
+    if (Read<float>(key + 12) < 0.f)
+    {
+      dst.X = -dst.X;
+      dst.Y = -dst.Y;
+      dst.Z = -dst.Z;
+    }
+    break;
+  }
+  case ACF_Float96NoW:
+    dst.X = Read<float>(key);
+    dst.Y = Read<float>(key + 4);
+    dst.Z = Read<float>(key + 8);
+    break;
+  case ACF_Fixed48NoW:
+    dst.X = ((int32)Read<uint16>(key) - 32767) / 32767.f;
+    dst.Y = ((int32)Read<uint16>(key + 2) - 32767) / 32767.f;
+    dst.Z = ((int32)Read<uint16>(key + 4) - 32767) / 32767.f;
+    break;
+  case ACF_IntervalFixed32NoW:
+  {
+    // 11 bits X, 11 bits Y and 10 bits Z scaled to the track's interval
+    const uint32 packed = Read<uint32>(key);
+    dst.X = ((int32)(packed >> 21) - 1023) / 1023.f * ranges[0] + mins[0];
+    dst.Y = ((int32)((packed >> 10) & 0x7FF) - 1023) / 1023.f * ranges[1] + mins[1];
+    dst.Z = ((int32)(packed & 0x3FF) - 511) / 511.f * ranges[2] + mins[2];
+    break;
+  }
+  case ACF_Fixed32NoW:
+  {
+    const uint32 packed = Read<uint32>(key);
+    dst.X = ((int32)(packed >> 21) - 1023) / 1023.f;
+    dst.Y = ((int32)((packed >> 10) & 0x7FF) - 1023) / 1023.f;
+    dst.Z = ((int32)(packed & 0x3FF) - 511) / 511.f;
+    break;
+  }
+  case ACF_Float32NoW:
+  {
+    const uint32 packed = Read<uint32>(key);
+    dst.X = DecodePackedFloat(packed >> 21, 7);
+    dst.Y = DecodePackedFloat((packed >> 10) & 0x7FF, 7);
+    dst.Z = DecodePackedFloat(packed & 0x3FF, 6);
+    break;
+  }
+  default:
+    dst.X = dst.Y = dst.Z = 0.f;
+    break;
+  }
+}
+
+void AnimDecoder::RestoreW(FQuat* quats, size_t count)
+{
+  size_t idx = 0;
+#ifdef ANIM_DECODER_SSE2
+  const __m128 zero = _mm_setzero_ps();
+  const __m128 one = _mm_set1_ps(1.f);
+  for (; idx + 4 <= count; idx += 4)
+  {
+    __m128 x = _mm_loadu_ps(&quats[idx].X);
+    __m128 y = _mm_loadu_ps(&quats[idx + 1].X);
+    __m128 z = _mm_loadu_ps(&quats[idx + 2].X);
+    __m128 w = _mm_loadu_ps(&quats[idx + 3].X);
+    _MM_TRANSPOSE4_PS(x, y, z, w);
+    const __m128 lengthSquared = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, x), _mm_mul_ps(y, y)), _mm_mul_ps(z, z));
+    w = _mm_sqrt_ps(_mm_max_ps(_mm_sub_ps(one, lengthSquared), zero));
+    _MM_TRANSPOSE4_PS(x, y, z, w);
+    _mm_storeu_ps(&quats[idx].X, x);
+    _mm_storeu_ps(&quats[idx + 1].X, y);
+    _mm_storeu_ps(&quats[idx + 2].X, z);
+    _mm_storeu_ps(&quats[idx + 3].X, w);
+  }
+#endif
+  for (; idx < count; ++idx)
+  {
+    FQuat& q = quats[idx];
+    const float w = 1.f - (q.X * q.X + q.Y * q.Y + q.Z * q.Z);
+    q.W = w > 0.f ? std::sqrt(w) : 0.f;
+  }
+}
+
+void AnimDecoder::BlendRotations(const FQuat* a, const FQuat* b, const float* alphas, size_t count, FQuat* dst)
+{
+  size_t idx = 0;
+#ifdef ANIM_DECODER_SSE2
+  const __m128 zero = _mm_setzero_ps();
+  const __m128 one = _mm_set1_ps(1.f);
+  const __m128 signMask = _mm_set1_ps(-0.f);
+  for (; idx + 4 <= count; idx += 4)
+  {
+    __m128 ax = _mm_loadu_ps(&a[idx].X);
+    __m128 ay = _mm_loadu_ps(&a[idx + 1].X);
+    __m128 az = _mm_loadu_ps(&a[idx + 2].X);
+    __m128 aw = _mm_loadu_ps(&a[idx + 3].X);
+    _MM_TRANSPOSE4_PS(ax, ay, az, aw);
+    __m128 bx = _mm_loadu_ps(&b[idx].X);
+    __m128 by = _mm_loadu_ps(&b[idx + 1].X);
+    __m128 bz = _mm_loadu_ps(&b[idx + 2].X);
+    __m128 bw = _mm_loadu_ps(&b[idx + 3].X);
+    _MM_TRANSPOSE4_PS(bx, by, bz, bw);
+
+    const __m128 alpha = _mm_loadu_ps(alphas + idx);
+    const __m128 dot = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(ax, bx), _mm_mul_ps(ay, by)), _mm_mul_ps(az, bz)), _mm_mul_ps(aw, bw));
+    // Flip the second key when the keys are more than 180 degrees apart
+    const __m128 weightB = _mm_xor_ps(alpha, _mm_and_ps(_mm_cmplt_ps(dot, zero), signMask));
+    const __m128 weightA = _mm_sub_ps(one, alpha);
+    __m128 x = _mm_add_ps(_mm_mul_ps(ax, weightA), _mm_mul_ps(bx, weightB));
+    __m128 y = _mm_add_ps(_mm_mul_ps(ay, weightA), _mm_mul_ps(by, weightB));
+    __m128 z = _mm_add_ps(_mm_mul_ps(az, weightA), _mm_mul_ps(bz, weightB));
+    __m128 w = _mm_add_ps(_mm_mul_ps(aw, weightA), _mm_mul_ps(bw, weightB));
+
+    const __m128 lengthSquared = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(x, x), _mm_mul_ps(y, y)), _mm_mul_ps(z, z)), _mm_mul_ps(w, w));
+    const __m128 valid = _mm_cmpgt_ps(lengthSquared, zero);
+    const __m128 scale = _mm_and_ps(valid, _mm_div_ps(one, _mm_sqrt_ps(lengthSquared)));
+    x = _mm_mul_ps(x, scale);
+    y = _mm_mul_ps(y, scale);
+    z = _mm_mul_ps(z, scale);
+    // Degenerate blends become the identity
+    w = _mm_or_ps(_mm_mul_ps(w, scale), _mm_andnot_ps(valid, one));
+    _MM_TRANSPOSE4_PS(x, y, z, w);
+    _mm_storeu_ps(&dst[idx].X, x);
+    _mm_storeu_ps(&dst[idx + 1].X, y);
+    _mm_storeu_ps(&dst[idx + 2].X, z);
+    _mm_storeu_ps(&dst[idx + 3].X, w);
+  }
+#endif
+  for (; idx < count; ++idx)
+  {
+    const FQuat& qa = a[idx];
+    const FQuat& qb = b[idx];
+    const float dot = qa.X * qb.X + qa.Y * qb.Y + qa.Z * qb.Z + qa.W * qb.W;
+    const float weightB = dot < 0.f ? -alphas[idx] : alphas[idx];
+    const float weightA = 1.f - alphas[idx];
+    FQuat result;
+    result.X = qa.X * weightA + qb.X * weightB;
+    result.Y = qa.Y * weightA + qb.Y * weightB;
+    result.Z = qa.Z * weightA + qb.Z * weightB;
+    result.W = qa.W * weightA + qb.W * weightB;
+    const float lengthSquared = result.X * result.X + result.Y * result.Y + result.Z * result.Z + result.W * result.W;
+    if (lengthSquared > 0.f)
+    {
+      const float scale = 1.f / std::sqrt(lengthSquared);
+      result.X *= scale;
+      result.Y *= scale;
+      result.Z *= scale;
+      result.W *= scale;
+    }
+    else
+    {
+      result.X = result.Y = result.Z = 0.f;
+      result.W = 1.f;
+    }
+    dst[idx] = result;
+  }
+}
+
+void AnimDecoder::SampleRange(float time, int32 first, int32 count, FQuat* rotations, FVector* translations) const
+{
+  FQuat keys0[ANIM_DECODER_CHUNK_SIZE];
+  FQuat keys1[ANIM_DECODER_CHUNK_SIZE];
+  float alphas[ANIM_DECODER_CHUNK_SIZE];
+  const float relativePos = Duration > 0.f ? time / Duration : 0.f;
+  for (int32 chunk = 0; chunk < count; chunk += ANIM_DECODER_CHUNK_SIZE)
+  {
+    const int32 chunkSize = std::min(count - chunk, ANIM_DECODER_CHUNK_SIZE);
+    for (int32 idx = 0; idx < chunkSize; ++idx)
+    {
+      const Track& track = Tracks[first + chunk + idx];
+
+      FVector& translation = translations[chunk + idx];
+      if (track.NumTranslations)
+      {
+        int32 index0 = 0;
+        int32 index1 = 0;
+        const float alpha = GetKeys(relativePos, track.NumTranslations, Looping, index0, index1);
+        const FVector t0 = ReadVector(track.Translations + index0 * sizeof(FVector));
+        const FVector t1 = ReadVector(track.Translations + index1 * sizeof(FVector));
+        translation.X = t0.X + (t1.X - t0.X) * alpha;
+        translation.Y = t0.Y + (t1.Y - t0.Y) * alpha;
+        translation.Z = t0.Z + (t1.Z - t0.Z) * alpha;
+      }
+      else
+      {
+        translation.X = translation.Y = translation.Z = 0.f;
+      }
+
+      keys0[idx].X = keys0[idx].Y = keys0[idx].Z = 0.f;
+      keys1[idx] = keys0[idx];
+      alphas[idx] = 0.f;
+      if (track.NumRotations == 1)
+      {
+        DecodeRotationKey(ACF_Float96NoW, track.Rotations, nullptr, nullptr, keys0[idx]);
+        keys1[idx] = keys0[idx];
+      }
+      else if (track.NumRotations > 1)
+      {
+        int32 index0 = 0;
+        int32 index1 = 0;
+        alphas[idx] = GetKeys(relativePos, track.NumRotations, Looping, index0, index1);
+        const size_t keySize = GetRotationKeySize(RotationFormat);
+        if (RotationFormat == ACF_IntervalFixed32NoW)
+        {
+          float mins[3];
+          float ranges[3];
+          memcpy(mins, track.Rotations, sizeof(mins));
+          memcpy(ranges, track.Rotations + sizeof(mins), sizeof(ranges));
+          const uint8* keys = track.Rotations + sizeof(mins) + sizeof(ranges);
+          DecodeRotationKey(RotationFormat, keys + index0 * keySize, mins, ranges, keys0[idx]);
+          DecodeRotationKey(RotationFormat, keys + index1 * keySize, mins, ranges, keys1[idx]);
+        }
+        else
+        {
+          DecodeRotationKey(RotationFormat, track.Rotations + index0 * keySize, nullptr, nullptr, keys0[idx]);
+          DecodeRotationKey(RotationFormat, track.Rotations + index1 * keySize, nullptr, nullptr, keys1[idx]);
+        }
+      }
+    }
+    // Tracks without keys decode to zero vectors, so they become the identity here
+    RestoreW(keys0, chunkSize);
+    RestoreW(keys1, chunkSize);
+    BlendRotations(keys0, keys1, alphas, chunkSize, rotations + chunk);
+  }
+}
+
+void AnimDecoder::SampleTrack(int32 track, float time, FQuat& rotation, FVector& translation) const
+{
+  if (Valid && track >= 0 && track < (int32)Tracks.size())
+  {
+    SampleRange(time, track, 1, &rotation, &translation);
+  }
+}
+
+void AnimDecoder::SampleTracks(float time, FQuat* rotations, FVector* translations) const
+{
+  SampleTracks(&time, 1, rotations, translations);
+}
+
+void AnimDecoder::SampleTracks(const float* times, size_t numTimes, FQuat* rotations, FVector* translations) const
+{
+  const int32 numTracks = (int32)Tracks.size();
+  if (!Valid || !numTracks || !numTimes)
+  {
+    return;
+  }
+  // One task per chunk of tracks at one time
+  const size_t chunksPerTime = (numTracks + ANIM_DECODER_CHUNK_SIZE - 1) / ANIM_DECODER_CHUNK_SIZE;
+  const size_t numTasks = chunksPerTime * numTimes;
+  auto sample = [&](size_t task) {
+    const size_t timeIndex = task / chunksPerTime;
+    const int32 first = (int32)(task % chunksPerTime) * ANIM_DECODER_CHUNK_SIZE;
+    const int32 count = std::min(numTracks - first, ANIM_DECODER_CHUNK_SIZE);
+    const size_t output = timeIndex * numTracks + first;
+    SampleRange(times[timeIndex], first, count, rotations + output, translations + output);
+  };
+  if (numTasks == 1)
+  {
+    sample(0);
+  }
+  else
+  {
+    concurrency::parallel_for(size_t(0), numTasks, sample);
+  }
+}
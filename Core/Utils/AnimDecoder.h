@@ -0,0 +1,71 @@
+#pragma once
+#include <Tera/Core.h>
+#include <Tera/FStructs.h>
+
+#include <vector>
+
+class UAnimSequence;
+
+// Samples the compressed tracks of an animation sequence.
+// Rotation keys use any AnimationCompressionFormat. Translation keys are ACF_None, ACF_Float96NoW or ACF_Identity.
+// Tracks with a single key store it as ACF_Float96NoW. The decoder reads the sequence's buffer in place, so the
+// sequence must outlive it. Sampling doesn't modify the object, so any number of threads can sample at once.
+class AnimDecoder {
+public:
+  explicit AnimDecoder(const UAnimSequence* sequence);
+
+  // False if a format is not supported or a track points outside of the compressed data
+  bool IsValid() const
+  {
+    return Valid;
+  }
+
+  int32 GetTrackCount() const
+  {
+    return (int32)Tracks.size();
+  }
+
+  float GetDuration() const
+  {
+    return Duration;
+  }
+
+  // Time is in seconds and is clamped to the sequence
+  void SampleTrack(int32 track, float time, FQuat& rotation, FVector& translation) const;
+
+  // All tracks at the time. Large skeletons are split between PPL workers. Outputs hold GetTrackCount() items.
+  void SampleTracks(float time, FQuat* rotations, FVector* translations) const;
+
+  // All tracks at each of the times, e.g. every frame of an export. Track T at time I is at I * GetTrackCount() + T.
+  void SampleTracks(const float* times, size_t numTimes, FQuat* rotations, FVector* translations) const;
+
+  // W = sqrt(1 - X^2 - Y^2 - Z^2) for each quaternion
+  static void RestoreW(FQuat* quats, size_t count);
+
+  // Normalized lerp along the shortest path
+  static void BlendRotations(const FQuat* a, const FQuat* b, const float* alphas, size_t count, FQuat* dst);
+
+  // Decode a rotation key without W. mins and ranges are used by ACF_IntervalFixed32NoW only.
+  static void DecodeRotationKey(AnimationCompressionFormat format, const uint8* key, const float* mins, const float* ranges, FQuat& dst);
+
+  // Size of a rotation key in bytes
+  static size_t GetRotationKeySize(AnimationCompressionFormat format);
+
+private:
+  struct Track {
+    const uint8* Translations = nullptr;
+    int32 NumTranslations = 0;
+    const uint8* Rotations = nullptr;
+    int32 NumRotations = 0;
+  };
+
+  // Sample count tracks from the first one. Outputs are for the first track.
+  void SampleRange(float time, int32 first, int32 count, FQuat* rotations, FVector* translations) const;
+
+  std::vector<Track> Tracks;
+  AnimationCompressionFormat RotationFormat = ACF_None;
+  AnimationCompressionFormat TranslationFormat = ACF_None;
+  float Duration = 0.f;
+  bool Looping = true;
+  bool Valid = false;
+};
@@ -0,0 +1,347 @@
+#include "BCDecoder.h"
+#include <Utils/ALog.h>
+
+#include <algorithm>
+#include <cstring>
+#include <ppl.h>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#define BC_DECODER_SSE2 1
+#include <immintrin.h>
+#endif
+
+#if defined(__GNUC__) || defined(__clang__)
+#define BC_DECODER_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define BC_DECODER_TARGET_AVX2
+#endif
+
+// Surfaces with fewer blocks are decoded on the calling thread
+#define BC_DECODER_PARALLEL_MIN_BLOCKS 1024
+
+namespace
+{
+  inline uint16 Read16(const uint8* ptr)
+  {
+    return uint16(ptr[0] | (ptr[1] << 8));
+  }
+
+  inline uint32 Read32(const uint8* ptr)
+  {
+    uint32 v;
+    memcpy(&v, ptr, 4);
+    return v;
+  }
+
+  inline uint32 PackBGRA(uint32 r, uint32 g, uint32 b, uint32 a)
+  {
+    return b | (g << 8) | (r << 16) | (a << 24);
+  }
+
+  // D3D9 palette of a color block. DXT3/5 color blocks are always in the four color mode.
+  void BuildColorPalette(const uint8* block, bool dxt1, uint32* palette)
+  {
+    const uint16 c0 = Read16(block);
+    const uint16 c1 = Read16(block + 2);
+    uint32 r[4], g[4], b[4];
+    r[0] = (c0 >> 11) & 0x1F; r[0] = (r[0] << 3) | (r[0] >> 2);
+    g[0] = (c0 >> 5) & 0x3F; g[0] = (g[0] << 2) | (g[0] >> 4);
+    b[0] = c0 & 0x1F; b[0] = (b[0] << 3) | (b[0] >> 2);
+    r[1] = (c1 >> 11) & 0x1F; r[1] = (r[1] << 3) | (r[1] >> 2);
+    g[1] = (c1 >> 5) & 0x3F; g[1] = (g[1] << 2) | (g[1] >> 4);
+    b[1] = c1 & 0x1F; b[1] = (b[1] << 3) | (b[1] >> 2);
+    palette[0] = PackBGRA(r[0], g[0], b[0], 0xFF);
+    palette[1] = PackBGRA(r[1], g[1], b[1], 0xFF);
+    if (c0 > c1 || !dxt1)
+    {
+      palette[2] = PackBGRA((2 * r[0] + r[1] + 1) / 3, (2 * g[0] + g[1] + 1) / 3, (2 * b[0] + b[1] + 1) / 3, 0xFF);
+      palette[3] = PackBGRA((r[0] + 2 * r[1] + 1) / 3, (g[0] + 2 * g[1] + 1) / 3, (b[0] + 2 * b[1] + 1) / 3, 0xFF);
+    }
+    else
+    {
+      palette[2] = PackBGRA((r[0] + r[1]) / 2, (g[0] + g[1]) / 2, (b[0] + b[1]) / 2, 0xFF);
+      palette[3] = 0;
+    }
+  }
+
+  // DXT5 alpha palette. Values are pre-shifted to the alpha byte.
+  void BuildAlphaPalette(const uint8* block, uint32* palette)
+  {
+    const uint32 a0 = block[0];
+    const uint32 a1 = block[1];
+    palette[0] = a0;
+    palette[1] = a1;
+    if (a0 > a1)
+    {
+      for (uint32 idx = 1; idx < 7; ++idx)
+      {
+        palette[idx + 1] = ((7 - idx) * a0 + idx * a1 + 3) / 7;
+      }
+    }
+    else
+    {
+      for (uint32 idx = 1; idx < 5; ++idx)
+      {
+        palette[idx + 1] = ((5 - idx) * a0 + idx * a1 + 2) / 5;
+      }
+      palette[6] = 0;
+      palette[7] = 0xFF;
+    }
+    for (uint32 idx = 0; idx < 8; ++idx)
+    {
+      palette[idx] <<= 24;
+    }
+  }
+
+  // 48 bits of 3-bit DXT5 alpha indices
+  inline uint64 ReadAlphaIndices(const uint8* block)
+  {
+    uint64 bits = 0;
+    for (int32 idx = 0; idx < 6; ++idx)
+    {
+      bits |= uint64(block[2 + idx]) << (8 * idx);
+    }
+    return bits;
+  }
+
+  void DecodeBlockScalar(BCDecoder::Format format, const uint8* block, uint32* output)
+  {
+    const uint8* colorBlock = format == BCDecoder::Format::DXT1 ? block : block + 8;
+    uint32 palette[4];
+    BuildColorPalette(colorBlock, format == BCDecoder::Format::DXT1, palette);
+    const uint32 indices = Read32(colorBlock + 4);
+    for (int32 idx = 0; idx < 16; ++idx)
+    {
+      output[idx] = palette[(indices >> (2 * idx)) & 3];
+    }
+
+    if (format == BCDecoder::Format::DXT3)
+    {
+      for (int32 idx = 0; idx < 16; ++idx)
+      {
+        const uint32 alpha = ((block[idx / 2] >> (4 * (idx & 1))) & 0xF) * 17;
+        output[idx] = (output[idx] & 0x00FFFFFF) | (alpha << 24);
+      }
+    }
+    else if (format == BCDecoder::Format::DXT5)
+    {
+      uint32 alphaPalette[8];
+      BuildAlphaPalette(block, alphaPalette);
+      const uint64 alphaIndices = ReadAlphaIndices(block);
+      for (int32 idx = 0; idx < 16; ++idx)
+      {
+        output[idx] = (output[idx] & 0x00FFFFFF) | alphaPalette[(alphaIndices >> (3 * idx)) & 7];
+      }
+    }
+  }
+
+#ifdef BC_DECODER_SSE2
+  // SSE2 has no variable shuffles: palette entries are selected with compare masks, 4 pixels at a time
+  void DecodeBlockSse2(BCDecoder::Format format, const uint8* block, uint32* output)
+  {
+    const uint8* colorBlock = format == BCDecoder::Format::DXT1 ? block : block + 8;
+    uint32 palette[4];
+    BuildColorPalette(colorBlock, format == BCDecoder::Format::DXT1, palette);
+    const uint32 indices = Read32(colorBlock + 4);
+    const __m128i colorMask = _mm_set1_epi32(0x00FFFFFF);
+
+    uint32 alphaPalette[8];
+    uint64 alphaIndices = 0;
+    if (format == BCDecoder::Format::DXT5)
+    {
+      BuildAlphaPalette(block, alphaPalette);
+      alphaIndices = ReadAlphaIndices(block);
+    }
+
+    for (int32 row = 0; row < 4; ++row)
+    {
+      const uint32 rowBits = indices >> (8 * row);
+      const __m128i idx = _mm_setr_epi32(rowBits & 3, (rowBits >> 2) & 3, (rowBits >> 4) & 3, (rowBits >> 6) & 3);
+      __m128i color = _mm_setzero_si128();
+      for (int32 entry = 0; entry < 4; ++entry)
+      {
+        const __m128i mask = _mm_cmpeq_epi32(idx, _mm_set1_epi32(entry));
+        color = _mm_or_si128(color, _mm_and_si128(mask, _mm_set1_epi32((int)palette[entry])));
+      }
+
+      if (format == BCDecoder::Format::DXT3)
+      {
+        const uint32 rowAlpha = Read16(block + 2 * row);
+        __m128i alpha = _mm_setr_epi32(rowAlpha & 0xF, (rowAlpha >> 4) & 0xF, (rowAlpha >> 8) & 0xF, (rowAlpha >> 12) & 0xF);
+        alpha = _mm_slli_epi32(_mm_mullo_epi16(alpha, _mm_set1_epi32(17)), 24);
+        color = _mm_or_si128(_mm_and_si128(color, colorMask), alpha);
+      }
+      else if (format == BCDecoder::Format::DXT5)
+      {
+        const uint32 rowAlpha = uint32(alphaIndices >> (12 * row));
+        const __m128i aidx = _mm_setr_epi32(rowAlpha & 7, (rowAlpha >> 3) & 7, (rowAlpha >> 6) & 7, (rowAlpha >> 9) & 7);
+        __m128i alpha = _mm_setzero_si128();
+        for (int32 entry = 0; entry < 8; ++entry)
+        {
+          const __m128i mask = _mm_cmpeq_epi32(aidx, _mm_set1_epi32(entry));
+          alpha = _mm_or_si128(alpha, _mm_and_si128(mask, _mm_set1_epi32((int)alphaPalette[entry])));
+        }
+        color = _mm_or_si128(_mm_and_si128(color, colorMask), alpha);
+      }
+      _mm_storeu_si128((__m128i*)(output + 4 * row), color);
+    }
+  }
+
+  // AVX2 looks palette entries up with a lane permute, 8 pixels at a time
+  BC_DECODER_TARGET_AVX2 void DecodeBlockAvx2(BCDecoder::Format format, const uint8* block, uint32* output)
+  {
+    const uint8* colorBlock = format == BCDecoder::Format::DXT1 ? block : block + 8;
+    uint32 palette[4];
+    BuildColorPalette(colorBlock, format == BCDecoder::Format::DXT1, palette);
+    const uint32 indices = Read32(colorBlock + 4);
+    const __m256i colorPalette = _mm256_setr_epi32(palette[0], palette[1], palette[2], palette[3], palette[0], palette[1], palette[2], palette[3]);
+    const __m256i colorShifts = _mm256_setr_epi32(0, 2, 4, 6, 8, 10, 12, 14);
+    const __m256i colorMask = _mm256_set1_epi32(0x00FFFFFF);
+
+    __m256i alphaPalette = _mm256_setzero_si256();
+    uint64 alphaIndices = 0;
+    if (format == BCDecoder::Format::DXT5)
+    {
+      uint32 alphaValues[8];
+      BuildAlphaPalette(block, alphaValues);
+      alphaPalette = _mm256_loadu_si256((const __m256i*)alphaValues);
+      alphaIndices = ReadAlphaIndices(block);
+    }
+
+    for (int32 half = 0; half < 2; ++half)
+    {
+      const __m256i idx = _mm256_and_si256(_mm256_srlv_epi32(_mm256_set1_epi32(int(indices >> (16 * half))), colorShifts), _mm256_set1_epi32(3));
+      __m256i color = _mm256_permutevar8x32_epi32(colorPalette, idx);
+
+      if (format == BCDecoder::Format::DXT3)
+      {
+        const __m256i shifts = _mm256_setr_epi32(0, 4, 8, 12, 16, 20, 24, 28);
+        __m256i alpha = _mm256_and_si256(_mm256_srlv_epi32(_mm256_set1_epi32((int)Read32(block + 4 * half)), shifts), _mm256_set1_epi32(0xF));
+        alpha = _mm256_slli_epi32(_mm256_mullo_epi32(alpha, _mm256_set1_epi32(17)), 24);
+        color = _mm256_or_si256(_mm256_and_si256(color, colorMask), alpha);
+      }
+      else if (format == BCDecoder::Format::DXT5)
+      {
+        const __m256i shifts = _mm256_setr_epi32(0, 3, 6, 9, 12, 15, 18, 21);
+        const __m256i aidx = _mm256_and_si256(_mm256_srlv_epi32(_mm256_set1_epi32(int(alphaIndices >> (24 * half))), shifts), _mm256_set1_epi32(7));
+        color = _mm256_or_si256(_mm256_and_si256(color, colorMask), _mm256_permutevar8x32_epi32(alphaPalette, aidx));
+      }
+      _mm256_storeu_si256((__m256i*)(output + 8 * half), color);
+    }
+  }
+#endif
+
+  typedef void(*DecodeBlockFunc)(BCDecoder::Format, const uint8*, uint32*);
+
+#if _DEBUG
+  // Compare a SIMD path to the scalar reference on pseudo-random blocks of every format
+  bool MatchesScalar(DecodeBlockFunc func)
+  {
+    uint32 seed = 0x9E3779B9;
+    for (BCDecoder::Format format : { BCDecoder::Format::DXT1, BCDecoder::Format::DXT3, BCDecoder::Format::DXT5 })
+    {
+      for (int32 test = 0; test < 256; ++test)
+      {
+        uint8 block[16];
+        for (uint8& byte : block)
+        {
+          seed ^= seed << 13;
+          seed ^= seed >> 17;
+          seed ^= seed << 5;
+          byte = uint8(seed);
+        }
+        uint32 expected[16];
+        uint32 actual[16];
+        DecodeBlockScalar(format, block, expected);
+        func(format, block, actual);
+        if (memcmp(expected, actual, sizeof(expected)))
+        {
+          return false;
+        }
+      }
+    }
+    return true;
+  }
+#endif
+
+  DecodeBlockFunc GetDecodeBlockFunc()
+  {
+#ifdef BC_DECODER_SSE2
+    static const DecodeBlockFunc func = [] {
+      DecodeBlockFunc simd = HasAVX2() ? DecodeBlockAvx2 : DecodeBlockSse2;
+#if _DEBUG
+      if (!MatchesScalar(simd))
+      {
+        LogE("BCDecoder: the SIMD path doesn't match the scalar decoder. Using the scalar decoder.");
+        DBreak();
+        return (DecodeBlockFunc)DecodeBlockScalar;
+      }
+#endif
+      return simd;
+    }();
+    return func;
+#else
+    return DecodeBlockScalar;
+#endif
+  }
+
+  inline int32 GetBlockSize(BCDecoder::Format format)
+  {
+    return format == BCDecoder::Format::DXT1 ? 8 : 16;
+  }
+}
+
+size_t BCDecoder::GetCompressedSize(Format format, int32 width, int32 height)
+{
+  if (width <= 0 || height <= 0)
+  {
+    return 0;
+  }
+  return size_t((width + 3) / 4) * size_t((height + 3) / 4) * GetBlockSize(format);
+}
+
+void BCDecoder::DecodeBlock(Format format, const void* block, uint32* output)
+{
+  GetDecodeBlockFunc()(format, (const uint8*)block, output);
+}
+
+bool BCDecoder::Decode(Format format, const void* src, size_t srcSize, int32 width, int32 height, void* dst, size_t dstPitch)
+{
+  if (!src || !dst || width <= 0 || height <= 0 || dstPitch < size_t(width) * 4 || srcSize < GetCompressedSize(format, width, height))
+  {
+    return false;
+  }
+  const DecodeBlockFunc decodeBlock = GetDecodeBlockFunc();
+  const int32 blockSize = GetBlockSize(format);
+  const int32 blocksX = (width + 3) / 4;
+  const int32 blocksY = (height + 3) / 4;
+
+  auto decodeBlockRow = [&](int32 blockY) {
+    uint32 pixels[16];
+    const uint8* blocks = (const uint8*)src + size_t(blockY) * blocksX * blockSize;
+    const int32 rows = std::min(4, height - blockY * 4);
+    for (int32 blockX = 0; blockX < blocksX; ++blockX)
+    {
+      decodeBlock(format, blocks + size_t(blockX) * blockSize, pixels);
+      // Edge blocks of small mips are cropped
+      const size_t rowBytes = size_t(std::min(4, width - blockX * 4)) * 4;
+      for (int32 y = 0; y < rows; ++y)
+      {
+        memcpy((uint8*)dst + size_t(blockY * 4 + y) * dstPitch + size_t(blockX) * 16, pixels + 4 * y, rowBytes);
+      }
+    }
+  };
+
+  if (blocksX * blocksY >= BC_DECODER_PARALLEL_MIN_BLOCKS)
+  {
+    concurrency::parallel_for(0, blocksY, decodeBlockRow);
+  }
+  else
+  {
+    for (int32 blockY = 0; blockY < blocksY; ++blockY)
+    {
+      decodeBlockRow(blockY);
+    }
+  }
+  return true;
+}
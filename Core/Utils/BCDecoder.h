@@ -0,0 +1,25 @@
+#pragma once
+#include <Tera/Core.h>
+
+// Decodes BC1-BC3 (DXT1/3/5) surfaces to 8-bit BGRA.
+// Blocks are decoded with AVX2, SSE2 or scalar code depending on the CPU. Large surfaces are split by block rows
+// and decoded in parallel. The scalar code is the reference: debug builds check the SIMD path against it on first use
+// and fall back to it on a mismatch.
+class BCDecoder {
+public:
+  enum class Format {
+    DXT1,
+    DXT3,
+    DXT5
+  };
+
+  // Size of a compressed surface in bytes
+  static size_t GetCompressedSize(Format format, int32 width, int32 height);
+
+  // Decode a width x height surface. Rows are written top to bottom, dstPitch bytes apart.
+  // Returns false if the source is too small or the arguments are invalid.
+  static bool Decode(Format format, const void* src, size_t srcSize, int32 width, int32 height, void* dst, size_t dstPitch);
+
+  // Decode a single 4x4 block to 16 BGRA pixels
+  static void DecodeBlock(Format format, const void* block, uint32* output);
+};
@@ -1,43 +1,175 @@
 #include "CompositePatcher.h"
 
 #include <array>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
 #include <string_view>
+#include <intrin.h>
 
 const char Key1[] = { 12, 6, 9, 4, 3, 14, 1, 10, 13, 2, 7, 15, 0, 8, 5, 11 };
 const char Key2[] = { 'G', 'e', 'n', 'e', 'r', 'a', 't', 'e', 'P', 'a', 'c', 'k', 'a', 'g', 'e', 'M', 'a', 'p', 'p', 'e', 'r' };
 
-void GEncrytMapperFile(const std::wstring& path, const std::string& decrypted)
+static_assert(sizeof(Key1) == sizeof(__m128i), "Key1 must match SSE register size");
+
+namespace
 {
-  std::vector<char> encrypted;
-  size_t size = decrypted.size();
-  size_t offset = 0;
-  encrypted.resize(size);
-  for (offset = 0; offset < size; ++offset)
+  bool HasSSSE3()
   {
-    encrypted[offset] = decrypted[offset] ^ Key2[offset % sizeof(Key2)];
+    static const bool result = [] {
+      int info[4] = {};
+      __cpuid(info, 1);
+      return (info[2] & (1 << 9)) != 0;
+    }();
+    return result;
+  }
+
+  // dst[offset + idx] = src[offset + Key1[idx]] for every full block. The rest is copied as is. Works in place.
+  void ShuffleBlocks(const char* src, char* dst, size_t size)
+  {
+    size_t offset = 0;
+    if (HasSSSE3())
+    {
+      const __m128i mask = _mm_loadu_si128((const __m128i*)Key1);
+      for (; offset + sizeof(Key1) <= size; offset += sizeof(Key1))
+      {
+        const __m128i block = _mm_loadu_si128((const __m128i*)(src + offset));
+        _mm_storeu_si128((__m128i*)(dst + offset), _mm_shuffle_epi8(block, mask));
+      }
+    }
+    std::array<char, sizeof(Key1)> tmp;
+    for (; offset + sizeof(Key1) <= size; offset += sizeof(Key1))
+    {
+      memcpy(&tmp[0], src + offset, sizeof(Key1));
+      for (size_t idx = 0; idx < sizeof(Key1); ++idx)
+      {
+        dst[offset + idx] = tmp[Key1[idx]];
+      }
+    }
+    if (src != dst && offset < size)
+    {
+      memcpy(dst + offset, src + offset, size - offset);
+    }
   }
 
+  // Swap odd bytes from the front with bytes from the back. In place.
+  void SwapBytes(char* data, size_t size)
   {
+    if (size < 2)
+    {
+      return;
+    }
+    size_t count = (size / 2 + 1) / 2;
     size_t a = 1;
     size_t b = size - 1;
-    for (offset = (size / 2 + 1) / 2; offset; --offset, a += 2, b -= 2)
+    if (HasSSSE3())
+    {
+      // 8 swaps per iteration. Front window [a - 1, a + 14] holds targets in odd lanes,
+      // back window [b - 15, b] holds them in odd lanes too, but in reverse order.
+      const __m128i oddLanes = _mm_set1_epi16((short)0xFF00);
+      const __m128i mirror = _mm_setr_epi8(-128, 15, -128, 13, -128, 11, -128, 9, -128, 7, -128, 5, -128, 3, -128, 1);
+      for (; count >= 8 && a + 14 < b - 15; count -= 8, a += 16, b -= 16)
+      {
+        const __m128i front = _mm_loadu_si128((const __m128i*)(data + a - 1));
+        const __m128i back = _mm_loadu_si128((const __m128i*)(data + b - 15));
+        _mm_storeu_si128((__m128i*)(data + a - 1), _mm_or_si128(_mm_andnot_si128(oddLanes, front), _mm_shuffle_epi8(back, mirror)));
+        _mm_storeu_si128((__m128i*)(data + b - 15), _mm_or_si128(_mm_andnot_si128(oddLanes, back), _mm_shuffle_epi8(front, mirror)));
+      }
+    }
+    for (; count; --count, a += 2, b -= 2)
+    {
+      std::swap(data[a], data[b]);
+    }
+  }
+
+  // dst[offset] = src[offset] ^ Key2[offset % sizeof(Key2)]. Works in place.
+  void XorKey(const char* src, char* dst, size_t size)
+  {
+    // Key stream long enough to load 16 bytes at any key phase
+    char stream[sizeof(Key2) + sizeof(__m128i)];
+    for (size_t idx = 0; idx < sizeof(stream); ++idx)
+    {
+      stream[idx] = Key2[idx % sizeof(Key2)];
+    }
+    size_t offset = 0;
+    size_t phase = 0;
+    for (; offset + sizeof(__m128i) <= size; offset += sizeof(__m128i))
+    {
+      const __m128i value = _mm_loadu_si128((const __m128i*)(src + offset));
+      const __m128i key = _mm_loadu_si128((const __m128i*)(stream + phase));
+      _mm_storeu_si128((__m128i*)(dst + offset), _mm_xor_si128(value, key));
+      phase = (phase + sizeof(__m128i)) % sizeof(Key2);
+    }
+    for (; offset < size; ++offset)
+    {
+      dst[offset] = src[offset] ^ Key2[offset % sizeof(Key2)];
+    }
+  }
+
+  // Entries store offsets and sizes as int
+  int ParseEntryNumber(std::string_view text)
+  {
+    const unsigned long value = std::stoul(std::string(text));
+    if (value > (unsigned long)std::numeric_limits<int>::max())
     {
-      std::swap(encrypted[a], encrypted[b]);
+      throw std::out_of_range("Entry number is too large");
     }
+    return (int)value;
   }
 
-  std::array<char, sizeof(Key1)> tmp;
-  for (size_t offset = 0; offset + sizeof(Key1) <= size; offset += sizeof(Key1))
+  // Split "Object,CompositeName,Offset,Size," into the entry
+  void ParseEntry(std::string_view text, CompositeEntry& entry)
   {
-    memcpy(&tmp[0], &encrypted[offset], sizeof(Key1));
-    for (size_t idx = 0; idx < sizeof(Key1); ++idx)
+    std::array<std::string_view, 4> fields;
+    size_t pos = 0;
+    for (std::string_view& field : fields)
     {
-      encrypted[offset + idx] = tmp[Key1[idx]];
+      size_t end = text.find(',', pos);
+      if (end == std::string_view::npos)
+      {
+        throw std::runtime_error("Composite map is corrupted!");
+      }
+      field = text.substr(pos, end - pos);
+      pos = end + 1;
+    }
+    entry.Object = fields[0];
+    entry.CompositeName = fields[1];
+    try
+    {
+      entry.Offset = ParseEntryNumber(fields[2]);
+      entry.Size = ParseEntryNumber(fields[3]);
+    }
+    catch (...)
+    {
+      throw std::runtime_error("Composite map is corrupted! Invalid entry " + entry.CompositeName);
     }
   }
+}
+
+void DecryptMapperData(const char* src, char* dst, size_t size)
+{
+  ShuffleBlocks(src, dst, size);
+  SwapBytes(dst, size);
+  XorKey(dst, dst, size);
+}
+
+void EncryptMapperData(const char* src, char* dst, size_t size)
+{
+  XorKey(src, dst, size);
+  SwapBytes(dst, size);
+  ShuffleBlocks(dst, dst, size);
+}
+
+void GEncrytMapperFile(const std::wstring& path, const std::string& decrypted)
+{
+  std::vector<char> encrypted(decrypted.size());
+  if (encrypted.size())
+  {
+    EncryptMapperData(&decrypted[0], &encrypted[0], encrypted.size());
+  }
 
   std::ofstream s(path, std::ios::binary | std::ios::trunc);
-  s.write(&encrypted[0], encrypted.size());
+  s.write(encrypted.data(), encrypted.size());
 }
 
 void GDecrytMapperFile(const std::wstring& path, std::string& decrypted)
@@ -57,34 +189,12 @@ void GDecrytMapperFile(const std::wstring& path, std::string& decrypted)
     s.seekg(0, std::ios_base::beg);
     encrypted.resize(size);
     decrypted.resize(size);
-    s.read(&encrypted[0], size);
+    s.read(encrypted.data(), size);
   }
 
-  size_t offset = 0;
-  for (; offset + sizeof(Key1) <= size; offset += sizeof(Key1))
+  if (size)
   {
-    for (size_t idx = 0; idx < sizeof(Key1); ++idx)
-    {
-      decrypted[offset + idx] = encrypted[offset + Key1[idx]];
-    }
-  }
-  for (; offset < size; ++offset)
-  {
-    decrypted[offset] = encrypted[offset];
-  }
-
-  {
-    size_t a = 1;
-    size_t b = size - 1;
-    for (offset = (size / 2 + 1) / 2; offset; --offset, a += 2, b -= 2)
-    {
-      std::swap(decrypted[a], decrypted[b]);
-    }
-  }
-
-  for (offset = 0; offset < size; ++offset)
-  {
-    decrypted[offset] ^= Key2[offset % sizeof(Key2)];
+    DecryptMapperData(&encrypted[0], &decrypted[0], size);
   }
 }
 
@@ -95,187 +205,190 @@ CompositePatcher::CompositePatcher(const std::wstring& path)
 void CompositePatcher::Load()
 {
   GDecrytMapperFile(Path, Decrypted);
+  BuildIndex();
+  Loaded = true;
 }
 
 void CompositePatcher::Apply()
 {
+  Serialize();
   GEncrytMapperFile(Path, Decrypted);
 }
 
-bool CompositePatcher::DeleteEntry(const std::string& compositePackageName)
+void CompositePatcher::BuildIndex()
 {
-  std::string prefix = compositePackageName + '.';
-  size_t start = Decrypted.find(prefix);
-  if (start == std::string::npos)
-  {
-    return false;
-  }
-  size_t end = Decrypted.find('|', start);
-  if (end == std::string::npos)
-  {
-    return false;
-  }
-  
-  end++;
+  Containers.clear();
+  EntryIndex.clear();
+  ContainerIndex.clear();
+  Tail.clear();
 
-  if (start >= end)
+  // Layout: Filename?Object,CompositeName,Offset,Size,|...|!Filename?...|!
+  const std::string_view text(Decrypted);
+  size_t pos = 0;
+  size_t nameEnd = 0;
+  while ((nameEnd = text.find('?', pos)) != std::string_view::npos)
   {
-    return false;
-  }
+    const size_t end = text.find('!', nameEnd);
+    if (end == std::string_view::npos)
+    {
+      throw std::runtime_error("Composite map is corrupted!");
+    }
+    const size_t containerIndex = Containers.size();
+    Container& container = Containers.emplace_back();
+    container.Filename = text.substr(pos, nameEnd - pos);
+    ContainerIndex.emplace(container.Filename, containerIndex);
 
-  memmove(&Decrypted[start], &Decrypted[end], Decrypted.size() - end);
-  Decrypted.resize(Decrypted.size() - (end - start));
+    size_t entryStart = nameEnd + 1;
+    while (entryStart < end)
+    {
+      const size_t entryEnd = text.find('|', entryStart);
+      if (entryEnd == std::string_view::npos || entryEnd > end)
+      {
+        throw std::runtime_error("Composite map is corrupted!");
+      }
+      Item& item = container.Items.emplace_back();
+      item.Raw = text.substr(entryStart, entryEnd + 1 - entryStart);
+      ParseEntry(text.substr(entryStart, entryEnd - entryStart), item.Entry);
+      item.Entry.Filename = container.Filename;
+      EntryIndex.emplace(item.Entry.CompositeName, std::make_pair(containerIndex, container.Items.size() - 1));
+      container.Alive++;
+      entryStart = entryEnd + 1;
+    }
+    pos = end + 1;
+  }
+  Tail = text.substr(pos);
+}
 
-  if (Decrypted[start] == '!')
+void CompositePatcher::Serialize()
+{
+  std::string result;
+  result.reserve(Decrypted.size() + 1024);
+  for (const Container& container : Containers)
   {
-    // This as the last file entry. Remove the empty file with trailing "?!"
-    size_t fstart;
-    size_t fend = Decrypted.rfind('?', start);
-    if (fend == std::string::npos)
+    if (!container.Alive && container.Items.size())
     {
-      return false;
+      // All entries were removed. Drop the file.
+      continue;
     }
-    fstart = Decrypted.rfind('!', fend);
-    if (fstart == std::string::npos)
+    result += container.Filename;
+    result += '?';
+    for (const Item& item : container.Items)
     {
-      fstart = 0;
+      if (!item.Deleted)
+      {
+        result += item.Raw.size() ? item.Raw : item.Entry.ToString();
+      }
     }
-    memmove(&Decrypted[fstart], &Decrypted[start], Decrypted.size() - start);
-    Decrypted.resize(Decrypted.size() - (start - fstart));
+    result += '!';
   }
-  return false;
+  result += Tail;
+  Decrypted.swap(result);
 }
 
-std::string CompositePatcher::Patch(const std::string& compositePackageName, const CompositeEntry & dest)
+size_t CompositePatcher::GetContainer(const std::string& filename)
 {
-  if (Decrypted.empty())
+  auto it = ContainerIndex.find(filename);
+  if (it != ContainerIndex.end())
   {
-    throw "Composite map is empty!";
+    return it->second;
   }
-  std::string prefix = compositePackageName + '.';
-  size_t start = Decrypted.find(prefix);
-  if (start == std::string::npos)
+  Containers.emplace_back().Filename = filename;
+  ContainerIndex.emplace(filename, Containers.size() - 1);
+  return Containers.size() - 1;
+}
+
+void CompositePatcher::RemoveItem(size_t container, size_t item)
+{
+  Item& target = Containers[container].Items[item];
+  if (!target.Deleted)
   {
-    throw "Failed to find the entry " + compositePackageName;
+    target.Deleted = true;
+    target.Raw.clear();
+    Containers[container].Alive--;
   }
-  size_t end = Decrypted.find('|', start);
-  if (end == std::string::npos)
+}
+
+bool CompositePatcher::DeleteEntry(const std::string& compositePackageName)
+{
+  auto it = EntryIndex.find(compositePackageName);
+  if (it == EntryIndex.end())
   {
-    throw "Failed to find the end of the entry " + compositePackageName;
+    return false;
   }
-  end++;
-  std::string previousEntry = Decrypted.substr(start, end - start);
+  RemoveItem(it->second.first, it->second.second);
+  EntryIndex.erase(it);
+  return true;
+}
 
-  if (previousEntry.empty())
+bool CompositePatcher::GetEntry(const std::string& compositePackageName, CompositeEntry& output) const
+{
+  auto it = EntryIndex.find(compositePackageName);
+  if (it == EntryIndex.end())
   {
-    throw "Failed to find the entry " + compositePackageName;
+    return false;
   }
+  output = Containers[it->second.first].Items[it->second.second].Entry;
+  return true;
+}
 
-  // Find previousFilename
-  std::string previousFilename;
-  size_t fstart;
+std::string CompositePatcher::Patch(const std::string& compositePackageName, const CompositeEntry& dest)
+{
+  if (!Loaded || Containers.empty())
   {
-    size_t fend = Decrypted.rfind('?', start);
-    if (fend == std::string::npos)
-    {
-      throw "Failed to find the entries filename";
-    }
-    fstart = Decrypted.rfind('!', fend);
-    if (fstart == std::string::npos)
-    {
-      fstart = 0;
-    }
-    previousFilename = Decrypted.substr(fstart + 1, fend - fstart - 1);
+    throw std::runtime_error("Composite map is empty!");
+  }
+  auto it = EntryIndex.find(compositePackageName);
+  if (it == EntryIndex.end())
+  {
+    throw std::runtime_error("Failed to find the entry " + compositePackageName);
+  }
+  const size_t containerIndex = it->second.first;
+  const size_t itemIndex = it->second.second;
+  std::string previousEntry;
+  {
+    const Item& item = Containers[containerIndex].Items[itemIndex];
+    previousEntry = Containers[containerIndex].Filename + (item.Raw.size() ? item.Raw : item.Entry.ToString());
   }
 
   if (!dest.Size)
   {
     // Delete the entry and return
-    memmove(&Decrypted[start], &Decrypted[end], Decrypted.size() - end);
-    Decrypted.resize(Decrypted.size() - previousEntry.size());
-    return previousFilename + previousEntry;
+    RemoveItem(containerIndex, itemIndex);
+    EntryIndex.erase(it);
+    return previousEntry;
   }
 
-  std::string newEntry = dest.ToString();
-
-  if (previousFilename == dest.Filename)
+  std::pair<size_t, size_t> location(containerIndex, itemIndex);
+  if (Containers[containerIndex].Filename == dest.Filename)
   {
     // Just changing values
-
-    if (previousEntry.size() == newEntry.size())
-    {
-      memcpy(&Decrypted[start], &newEntry[0], newEntry.size());
-    }
-    else if (previousEntry.size() > newEntry.size())
-    {
-      // Copy new value
-      memcpy(&Decrypted[start], &newEntry[0], newEntry.size());
-      // Fit trailing data
-      memmove(&Decrypted[start + newEntry.size()], &Decrypted[end], Decrypted.size() - end);
-      // Shrink
-      Decrypted.resize(Decrypted.size() - (previousEntry.size() - newEntry.size()));
-    }
-    else
-    {
-      // Enlarge
-      Decrypted.resize(Decrypted.size() + (newEntry.size() - previousEntry.size()));
-      // Move trailing data to the end
-      memmove(&Decrypted[start + newEntry.size()], &Decrypted[end], Decrypted.size() - (end + (newEntry.size() - previousEntry.size())));
-      // Copy new value
-      memcpy(&Decrypted[start], &newEntry[0], newEntry.size());
-    }
+    Item& item = Containers[containerIndex].Items[itemIndex];
+    item.Entry = dest;
+    item.Raw.clear();
   }
   else
   {
-    // Moving to a different storage
-
-    // But first delete the old entry
-    memmove(&Decrypted[start], &Decrypted[end], Decrypted.size() - end);
-    Decrypted.resize(Decrypted.size() - previousEntry.size());
-
-    if (Decrypted[start] == '!')
-    {
-      // This as the last file entry. Remove the empty file with trailing "?!"
-      memmove(&Decrypted[fstart], &Decrypted[start], Decrypted.size() - start);
-      Decrypted.resize(Decrypted.size() - (start - fstart));
-    }
-
-    size_t newFileNameStart = Decrypted.find('!' + dest.Filename + '?');
-    if (newFileNameStart == std::string::npos)
-    {
-      // Check if the file name is the first entry(has no '!')
-      newFileNameStart = Decrypted.find(dest.Filename + '?');
-      if (newFileNameStart != 0)
-      {
-        // Npos or we found something, but it's not out filename cos newFileNameStart expected to be 0
-        newFileNameStart = std::string::npos;
-      }
-    }
-    else
-    {
-      // Skip '!'
-      newFileNameStart++;
-    }
+    // Moving to a different storage. Add to the end of an existing one or create a new storage.
+    RemoveItem(containerIndex, itemIndex);
+    const size_t newContainerIndex = GetContainer(dest.Filename);
+    Container& container = Containers[newContainerIndex];
+    container.Items.emplace_back().Entry = dest;
+    container.Alive++;
+    location = std::make_pair(newContainerIndex, container.Items.size() - 1);
+  }
 
-    if (newFileNameStart == std::string::npos)
-    {
-      // Create a new storage
-      Decrypted += dest.Filename + '?' + dest.ToString() + '!';
-    }
-    else
-    {
-      // Add to the end of an existing storage
-      size_t entryStart = Decrypted.find('!', newFileNameStart);
-      if (entryStart == std::string::npos)
-      {
-        throw "Failed to insert new value!";
-      }
+  EntryIndex.erase(it);
+  EntryIndex[dest.CompositeName] = location;
+  return previousEntry;
+}
 
-      std::string newEntry = dest.ToString();
-      Decrypted.resize(Decrypted.size() + newEntry.size());
-      memmove(&Decrypted[entryStart + newEntry.size()], &Decrypted[entryStart], Decrypted.size() - (entryStart + newEntry.size()));
-      memcpy(&Decrypted[entryStart], &newEntry[0], newEntry.size());
-    }
+std::vector<std::string> CompositePatcher::Patch(const std::vector<CompositePatch>& patches)
+{
+  std::vector<std::string> result;
+  result.reserve(patches.size());
+  for (const CompositePatch& patch : patches)
+  {
+    result.push_back(Patch(patch.CompositePackageName, patch.Entry));
   }
-  return previousFilename + previousEntry;
-}
\ No newline at end of file
+  return result;
+}
@@ -2,6 +2,7 @@
 #include <string>
 #include <vector>
 #include <fstream>
+#include <unordered_map>
 
 // I want this to be independent from RE.
 
@@ -23,6 +24,16 @@ struct CompositeEntry {
   }
 };
 
+// A single change of a batch. Entry.Size of 0 deletes the composite package.
+struct CompositePatch {
+  std::string CompositePackageName;
+  CompositeEntry Entry;
+};
+
+// Mapper transforms. size bytes from src to dst. dst may be src for an in-place transform, other overlaps are not supported.
+void DecryptMapperData(const char* src, char* dst, size_t size);
+void EncryptMapperData(const char* src, char* dst, size_t size);
+
 void GDecrytMapperFile(const std::wstring& path, std::string& output);
 void GEncrytMapperFile(const std::wstring& path, const std::string& decrypted);
 
@@ -30,8 +41,8 @@ class CompositePatcher {
 public:
   // Path - path to the .dat file.
   CompositePatcher(const std::wstring& path);
-  
-  // Read and decrypt .dat file. Throws.
+
+  // Read, decrypt and index .dat file. Throws.
   void Load();
 
   inline bool IsLoaded() const
@@ -39,18 +50,54 @@ public:
     return Loaded;
   }
 
-  // Encrypt and write .dat file. Throws.
+  // Serialize, encrypt and write .dat file. Throws.
   void Apply();
 
   // Delete the entry (and file if the entry was the last one)
   bool DeleteEntry(const std::string& compositePackageName);
 
   // Patch and entry with the compositePackageName by using dest as a reference. Returns old entry with the filename. Throws.
-  // If dest.Offset is 0, acts like a Delete. Removes an entry with the name compositePackageName without adding/changing anything
+  // If dest.Size is 0, acts like a Delete. Removes an entry with the name compositePackageName without adding/changing anything
   std::string Patch(const std::string& compositePackageName, const CompositeEntry& dest);
 
+  // Apply patches in order. Returns old entries with filenames. Throws on the first missing entry.
+  std::vector<std::string> Patch(const std::vector<CompositePatch>& patches);
+
+  // Get an entry by its composite package name. Returns false if there is no such entry.
+  bool GetEntry(const std::string& compositePackageName, CompositeEntry& output) const;
+
+private:
+  struct Item {
+    CompositeEntry Entry;
+    // Source text of an unmodified entry
+    std::string Raw;
+    bool Deleted = false;
+  };
+
+  struct Container {
+    std::string Filename;
+    std::vector<Item> Items;
+    size_t Alive = 0;
+  };
+
+  // Parse Decrypted into Containers
+  void BuildIndex();
+  // Build Decrypted from Containers
+  void Serialize();
+  // Get or create a container by its file name
+  size_t GetContainer(const std::string& filename);
+  // Remove an item. Keeps other indices valid.
+  void RemoveItem(size_t container, size_t item);
+
 private:
   bool Loaded = false;
   std::wstring Path;
   std::string Decrypted;
-};
\ No newline at end of file
+  // Data after the last container
+  std::string Tail;
+  std::vector<Container> Containers;
+  // Composite package name -> (container, item)
+  std::unordered_map<std::string, std::pair<size_t, size_t>> EntryIndex;
+  // File name -> container
+  std::unordered_map<std::string, size_t> ContainerIndex;
+};
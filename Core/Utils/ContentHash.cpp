@@ -0,0 +1,231 @@
+#include "ContentHash.h"
+#include <Tera/FStream.h>
+
+#include <cstring>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#define CONTENT_HASH_SSE2 1
+#include <emmintrin.h>
+#endif
+
+#if defined(_MSC_VER) && defined(_M_X64)
+#include <intrin.h>
+#endif
+
+#define CONTENT_HASH_STRIPE 64
+#define CONTENT_HASH_STRIPES_PER_BLOCK 16
+#define CONTENT_HASH_SECRET_SIZE 256
+// Secret bytes used to scramble the accumulators at the end of each block
+#define CONTENT_HASH_SCRAMBLE_OFFSET (CONTENT_HASH_SECRET_SIZE - CONTENT_HASH_STRIPE)
+
+namespace
+{
+  const uint64 Prime32 = 0x9E3779B1ULL;
+  const uint64 Prime64_1 = 0x9E3779B185EBCA87ULL;
+  const uint64 Prime64_2 = 0xC2B2AE3D27D4EB4FULL;
+  const uint64 Prime64_3 = 0x165667B19E3779F9ULL;
+
+  struct Secret {
+    alignas(16) uint8 Data[CONTENT_HASH_SECRET_SIZE];
+
+    Secret()
+    {
+      // Deterministic splitmix64 sequence. Must never change: hashes are persisted.
+      uint64 state = 0x52454454464331ULL;
+      for (size_t idx = 0; idx < CONTENT_HASH_SECRET_SIZE; idx += 8)
+      {
+        uint64 z = (state += 0x9E3779B97F4A7C15ULL);
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+        z ^= z >> 31;
+        memcpy(Data + idx, &z, 8);
+      }
+    }
+  };
+
+  const Secret& GetSecret()
+  {
+    static const Secret secret;
+    return secret;
+  }
+
+  inline uint64 Read64(const uint8* ptr)
+  {
+    uint64 v;
+    memcpy(&v, ptr, 8);
+    return v;
+  }
+
+  inline uint64 Mul128Fold64(uint64 a, uint64 b)
+  {
+#if defined(_MSC_VER) && defined(_M_X64)
+    uint64 hi = 0;
+    uint64 lo = _umul128(a, b, &hi);
+    return lo ^ hi;
+#elif defined(__SIZEOF_INT128__)
+    __uint128_t r = (__uint128_t)a * b;
+    return (uint64)r ^ (uint64)(r >> 64);
+#else
+    const uint64 aLo = a & 0xFFFFFFFF, aHi = a >> 32;
+    const uint64 bLo = b & 0xFFFFFFFF, bHi = b >> 32;
+    const uint64 ll = aLo * bLo, lh = aLo * bHi, hl = aHi * bLo, hh = aHi * bHi;
+    const uint64 cross = (ll >> 32) + (lh & 0xFFFFFFFF) + hl;
+    const uint64 hi = hh + (lh >> 32) + (cross >> 32);
+    const uint64 lo = (cross << 32) | (ll & 0xFFFFFFFF);
+    return lo ^ hi;
+#endif
+  }
+
+  inline uint64 Avalanche(uint64 h)
+  {
+    h ^= h >> 37;
+    h *= 0x165667919E3779F9ULL;
+    h ^= h >> 32;
+    return h;
+  }
+
+  void Accumulate(uint64* acc, const uint8* data, const uint8* key)
+  {
+#ifdef CONTENT_HASH_SSE2
+    __m128i* xacc = (__m128i*)acc;
+    for (int idx = 0; idx < 4; ++idx)
+    {
+      const __m128i dataVec = _mm_loadu_si128((const __m128i*)data + idx);
+      const __m128i keyVec = _mm_loadu_si128((const __m128i*)key + idx);
+      const __m128i dataKey = _mm_xor_si128(dataVec, keyVec);
+      const __m128i dataKeyHi = _mm_shuffle_epi32(dataKey, _MM_SHUFFLE(0, 3, 0, 1));
+      const __m128i product = _mm_mul_epu32(dataKey, dataKeyHi);
+      const __m128i dataSwap = _mm_shuffle_epi32(dataVec, _MM_SHUFFLE(1, 0, 3, 2));
+      xacc[idx] = _mm_add_epi64(_mm_add_epi64(xacc[idx], dataSwap), product);
+    }
+#else
+    for (int idx = 0; idx < 8; ++idx)
+    {
+      const uint64 dataVal = Read64(data + idx * 8);
+      const uint64 dataKey = dataVal ^ Read64(key + idx * 8);
+      acc[idx ^ 1] += dataVal;
+      acc[idx] += (dataKey & 0xFFFFFFFF) * (dataKey >> 32);
+    }
+#endif
+  }
+
+  void Scramble(uint64* acc, const uint8* key)
+  {
+#ifdef CONTENT_HASH_SSE2
+    __m128i* xacc = (__m128i*)acc;
+    const __m128i prime = _mm_set1_epi32((int)Prime32);
+    for (int idx = 0; idx < 4; ++idx)
+    {
+      __m128i a = xacc[idx];
+      a = _mm_xor_si128(a, _mm_srli_epi64(a, 47));
+      a = _mm_xor_si128(a, _mm_loadu_si128((const __m128i*)key + idx));
+      const __m128i productLo = _mm_mul_epu32(a, prime);
+      const __m128i productHi = _mm_mul_epu32(_mm_shuffle_epi32(a, _MM_SHUFFLE(0, 3, 0, 1)), prime);
+      xacc[idx] = _mm_add_epi64(productLo, _mm_slli_epi64(productHi, 32));
+    }
+#else
+    for (int idx = 0; idx < 8; ++idx)
+    {
+      uint64 a = acc[idx];
+      a ^= a >> 47;
+      a ^= Read64(key + idx * 8);
+      acc[idx] = a * Prime32;
+    }
+#endif
+  }
+
+  uint64 MergeAccumulators(const uint64* acc, const uint8* key, uint64 start)
+  {
+    uint64 result = start;
+    for (int idx = 0; idx < 4; ++idx)
+    {
+      result += Mul128Fold64(acc[2 * idx] ^ Read64(key + 16 * idx), acc[2 * idx + 1] ^ Read64(key + 16 * idx + 8));
+    }
+    return Avalanche(result);
+  }
+}
+
+FStream& operator<<(FStream& s, FContentHash& h)
+{
+  return s << h.A << h.B;
+}
+
+ContentHasher::ContentHasher()
+{
+  Acc[0] = Prime32;
+  Acc[1] = Prime64_1;
+  Acc[2] = Prime64_2;
+  Acc[3] = Prime64_3;
+  Acc[4] = 0x85EBCA77ULL;
+  Acc[5] = 0x27D4EB2F165667C5ULL;
+  Acc[6] = 0xC2B2AE3DULL;
+  Acc[7] = 0x61C8864E7A143579ULL;
+}
+
+void ContentHasher::ConsumeStripe(const uint8* stripe)
+{
+  const uint8* secret = GetSecret().Data;
+  Accumulate(Acc, stripe, secret + StripeIndex * 8);
+  if (++StripeIndex == CONTENT_HASH_STRIPES_PER_BLOCK)
+  {
+    Scramble(Acc, secret + CONTENT_HASH_SCRAMBLE_OFFSET);
+    StripeIndex = 0;
+  }
+}
+
+void ContentHasher::Update(const void* data, size_t size)
+{
+  if (!data || !size)
+  {
+    return;
+  }
+  const uint8* ptr = (const uint8*)data;
+  TotalSize += size;
+  if (Buffered)
+  {
+    const size_t fill = std::min<size_t>(CONTENT_HASH_STRIPE - Buffered, size);
+    memcpy(Buffer + Buffered, ptr, fill);
+    Buffered += fill;
+    ptr += fill;
+    size -= fill;
+    if (Buffered < CONTENT_HASH_STRIPE)
+    {
+      return;
+    }
+    ConsumeStripe(Buffer);
+    Buffered = 0;
+  }
+  while (size >= CONTENT_HASH_STRIPE)
+  {
+    ConsumeStripe(ptr);
+    ptr += CONTENT_HASH_STRIPE;
+    size -= CONTENT_HASH_STRIPE;
+  }
+  if (size)
+  {
+    memcpy(Buffer, ptr, size);
+    Buffered = size;
+  }
+}
+
+FContentHash ContentHasher::Final() const
+{
+  ContentHasher tmp(*this);
+  if (tmp.Buffered)
+  {
+    memset(tmp.Buffer + tmp.Buffered, 0, CONTENT_HASH_STRIPE - tmp.Buffered);
+    tmp.ConsumeStripe(tmp.Buffer);
+  }
+  const uint8* secret = GetSecret().Data;
+  FContentHash result;
+  result.A = MergeAccumulators(tmp.Acc, secret + 11, TotalSize * Prime64_1);
+  result.B = MergeAccumulators(tmp.Acc, secret + 117, ~(TotalSize * Prime64_2));
+  return result;
+}
+
+FContentHash ContentHasher::Hash(const void* data, size_t size)
+{
+  ContentHasher hasher;
+  hasher.Update(data, size);
+  return hasher.Final();
+}
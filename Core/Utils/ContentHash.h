@@ -0,0 +1,73 @@
+#pragma once
+#include <Tera/Core.h>
+
+// 128-bit content digest
+struct FContentHash {
+  uint64 A = 0;
+  uint64 B = 0;
+
+  inline bool IsZero() const
+  {
+    return !A && !B;
+  }
+
+  inline bool operator==(const FContentHash& other) const
+  {
+    return A == other.A && B == other.B;
+  }
+
+  inline bool operator!=(const FContentHash& other) const
+  {
+    return !(*this == other);
+  }
+
+  inline bool operator<(const FContentHash& other) const
+  {
+    return A != other.A ? A < other.A : B < other.B;
+  }
+
+  friend FStream& operator<<(FStream& s, FContentHash& h);
+};
+
+namespace std
+{
+  template <>
+  struct hash<FContentHash> {
+    size_t operator()(const FContentHash& h) const
+    {
+      return (size_t)(h.A ^ (h.B * 0x9E3779B97F4A7C15ULL));
+    }
+  };
+}
+
+// Streaming non-cryptographic 128-bit hash for large binary payloads.
+// Data is consumed in 64 byte stripes by eight 64-bit accumulators (SSE2 with a scalar fallback).
+// The result does not depend on how the input is split between Update calls and is stable between runs.
+class ContentHasher {
+public:
+  ContentHasher();
+
+  void Update(const void* data, size_t size);
+
+  template <typename T>
+  inline void UpdateValue(const T& value)
+  {
+    Update(&value, sizeof(T));
+  }
+
+  FContentHash Final() const;
+
+  // One-shot helper
+  static FContentHash Hash(const void* data, size_t size);
+
+private:
+  void ConsumeStripe(const uint8* stripe);
+
+private:
+  alignas(16) uint64 Acc[8];
+  uint8 Buffer[64];
+  size_t Buffered = 0;
+  // Stripes consumed in the current block
+  size_t StripeIndex = 0;
+  uint64 TotalSize = 0;
+};
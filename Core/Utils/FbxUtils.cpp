@@ -1,6 +1,7 @@
 #include <fbxsdk.h>
 
 #include "FbxUtils.h"
+#include "VertexDecoder.h"
 
 char* FbxWideToUtf8(const wchar_t* in)
 {
@@ -265,20 +266,21 @@ bool FbxUtils::ExportSkeletalMesh(USkeletalMesh* sourceMesh, FbxExportContext& c
     return false;
   }
 
-  const std::vector<FSoftSkinVertex> verticies = lod->GetVertices();
-  if (verticies.empty())
+  VertexDecoder::Streams verticies;
+  VertexDecoder::Decode(lod, verticies);
+  if (!verticies.NumVertices)
   {
     ctx.Error = "The model has no vertices!";
     return false;
   }
 
   FbxMesh* mesh = FbxMesh::Create(GetScene(), "geometry");
-  mesh->InitControlPoints(verticies.size());
+  mesh->InitControlPoints(verticies.NumVertices);
 
-  for (uint32 idx = 0; idx < verticies.size(); ++idx)
+  for (uint32 idx = 0; idx < verticies.NumVertices; ++idx)
   {
-    const FSoftSkinVertex& v = verticies[idx];
-    mesh->GetControlPoints()[idx] = FbxVector4(v.Position.X, -v.Position.Y, v.Position.Z);
+    const FVector& position = verticies.Positions[idx];
+    mesh->GetControlPoints()[idx] = FbxVector4(position.X, -position.Y, position.Z);
   }
 
   FbxLayer* layer = mesh->GetLayer(0);
@@ -287,7 +289,7 @@ bool FbxUtils::ExportSkeletalMesh(USkeletalMesh* sourceMesh, FbxExportContext& c
     layer = mesh->GetLayer(mesh->CreateLayer());
   }
 
-  const int32 numTexCoords = lod->GetNumTexCoords();
+  const int32 numTexCoords = verticies.NumUVs;
   FbxLayerElementUV* uvDiffuseLayer = FbxLayerElementUV::Create(mesh, "DiffuseUV");
   std::vector<FbxLayerElementUV*> customUVLayers;
   for (int32 idx = 1; idx < numTexCoords; ++idx)
@@ -309,21 +311,21 @@ bool FbxUtils::ExportSkeletalMesh(USkeletalMesh* sourceMesh, FbxExportContext& c
   layerElementTangent->SetMappingMode(FbxLayerElement::EMappingMode::eByControlPoint);
   layerElementTangent->SetReferenceMode(FbxLayerElement::EReferenceMode::eDirect);
 
-  for (uint32 idx = 0; idx < verticies.size(); ++idx)
+  for (uint32 idx = 0; idx < verticies.NumVertices; ++idx)
   {
-    const FSoftSkinVertex& v = verticies[idx];
     FVector tmp;
-    tmp = v.TangentX;
+    tmp = verticies.TangentsX[idx];
     layerElementTangent->GetDirectArray().Add(FbxVector4(tmp.X, -tmp.Y, tmp.Z));
-    tmp = v.TangentY;
+    tmp = verticies.TangentsY[idx];
     layerElementBinormal->GetDirectArray().Add(FbxVector4(tmp.X, -tmp.Y, tmp.Z));
-    tmp = v.TangentZ;
+    tmp = verticies.TangentsZ[idx];
     layerElementNormal->GetDirectArray().Add(FbxVector4(tmp.X, -tmp.Y, tmp.Z));
 
-    uvDiffuseLayer->GetDirectArray().Add(FbxVector2(v.UVs[0].X, -v.UVs[0].Y + 1.f));
+    uvDiffuseLayer->GetDirectArray().Add(FbxVector2(verticies.UVs[0][idx].X, -verticies.UVs[0][idx].Y + 1.f));
     for (int32 uvIdx = 0; uvIdx < customUVLayers.size(); ++uvIdx)
     {
-      customUVLayers[uvIdx]->GetDirectArray().Add(FbxVector2(v.UVs[uvIdx + 1].X, -v.UVs[uvIdx + 1].Y + 1.f));
+      const FVector2D& uv = verticies.UVs[uvIdx + 1][idx];
+      customUVLayers[uvIdx]->GetDirectArray().Add(FbxVector2(uv.X, -uv.Y + 1.f));
     }
   }
 
@@ -401,31 +403,32 @@ bool FbxUtils::ExportSkeletalMesh(USkeletalMesh* sourceMesh, FbxExportContext& c
   FbxGeometry* meshAttribute = (FbxGeometry*)mesh;
   FbxSkin* skin = FbxSkin::Create(GetScene(), "");
 
+  std::vector<FbxCluster*> clusters(bonesArray.Size());
   for (int boneIndex = 0; boneIndex < bonesArray.Size(); boneIndex++)
   {
-    FbxNode* boneNode = bonesArray[boneIndex];
-
-    FbxCluster* currentCluster = FbxCluster::Create(GetScene(), "");
-    currentCluster->SetLink(boneNode);
-    currentCluster->SetLinkMode(FbxCluster::eTotalOne);
+    clusters[boneIndex] = FbxCluster::Create(GetScene(), "");
+    clusters[boneIndex]->SetLink(bonesArray[boneIndex]);
+    clusters[boneIndex]->SetLinkMode(FbxCluster::eTotalOne);
+  }
 
-    int32 vertIndex = 0;
-    for (const FSoftSkinVertex& v : verticies)
+  // Influences are added in a single pass over the vertices
+  for (uint32 vertIndex = 0; vertIndex < verticies.NumVertices; ++vertIndex)
+  {
+    for (int influenceIndex = 0; influenceIndex < MAX_INFLUENCES; influenceIndex++)
     {
-      for (int influenceIndex = 0; influenceIndex < MAX_INFLUENCES; influenceIndex++)
+      const uint16 influenceBone = verticies.Bones[vertIndex * MAX_INFLUENCES + influenceIndex];
+      const float influenceWeight = (float)verticies.Weights[vertIndex * MAX_INFLUENCES + influenceIndex] / 255.0f;
+      if (influenceBone < clusters.size() && influenceWeight > 0.f)
       {
-
-        uint16 influenceBone = v.BoneMap->at(v.InfluenceBones[influenceIndex]);
-        float w = (float)v.InfluenceWeights[influenceIndex];
-        float influenceWeight = w / 255.0f;
-
-        if (influenceBone == boneIndex && influenceWeight > 0.f)
-        {
-          currentCluster->AddControlPointIndex(vertIndex, influenceWeight);
-        }
+        clusters[influenceBone]->AddControlPointIndex(vertIndex, influenceWeight);
       }
-      vertIndex++;
     }
+  }
+
+  for (int boneIndex = 0; boneIndex < bonesArray.Size(); boneIndex++)
+  {
+    FbxNode* boneNode = bonesArray[boneIndex];
+    FbxCluster* currentCluster = clusters[boneIndex];
     currentCluster->SetTransformMatrix(meshMatrix);
     FbxAMatrix linkMatrix = boneNode->EvaluateGlobalTransform();
     currentCluster->SetTransformLinkMatrix(linkMatrix);
@@ -446,20 +449,25 @@ bool FbxUtils::ExportStaticMesh(UStaticMesh* sourceMesh, FbxExportContext& ctx,
     return false;
   }
 
-  const std::vector<FStaticVertex> verticies = lod->GetVertices();
-  if (verticies.empty())
+  VertexDecoder::Streams verticies;
+  if (!VertexDecoder::Decode(lod, verticies))
+  {
+    ctx.Error = "Failed to decode vertices! The number of UV channels is not supported.";
+    return false;
+  }
+  if (!verticies.NumVertices)
   {
     ctx.Error = "The model has no vertices!";
     return false;
   }
 
   FbxMesh* mesh = FbxMesh::Create(GetScene(), "geometry");
-  mesh->InitControlPoints(verticies.size());
+  mesh->InitControlPoints(verticies.NumVertices);
 
-  for (uint32 idx = 0; idx < verticies.size(); ++idx)
+  for (uint32 idx = 0; idx < verticies.NumVertices; ++idx)
   {
-    const FStaticVertex& v = verticies[idx];
-    mesh->GetControlPoints()[idx] = FbxVector4(v.Position.X, -v.Position.Y, v.Position.Z);
+    const FVector& position = verticies.Positions[idx];
+    mesh->GetControlPoints()[idx] = FbxVector4(position.X, -position.Y, position.Z);
   }
 
   FbxLayer* layer = mesh->GetLayer(0);
@@ -468,7 +476,7 @@ bool FbxUtils::ExportStaticMesh(UStaticMesh* sourceMesh, FbxExportContext& ctx,
     layer = mesh->GetLayer(mesh->CreateLayer());
   }
 
-  const int32 numTexCoords = lod->VertexBuffer.NumTexCoords;
+  const int32 numTexCoords = verticies.NumUVs;
   FbxLayerElementUV* uvDiffuseLayer = FbxLayerElementUV::Create(mesh, "DiffuseUV");
   std::vector<FbxLayerElementUV*> customUVLayers;
   for (int32 idx = 1; idx < numTexCoords; ++idx)
@@ -490,21 +498,21 @@ bool FbxUtils::ExportStaticMesh(UStaticMesh* sourceMesh, FbxExportContext& ctx,
   layerElementTangent->SetMappingMode(FbxLayerElement::EMappingMode::eByControlPoint);
   layerElementTangent->SetReferenceMode(FbxLayerElement::EReferenceMode::eDirect);
 
-  for (uint32 idx = 0; idx < verticies.size(); ++idx)
+  for (uint32 idx = 0; idx < verticies.NumVertices; ++idx)
   {
-    const FStaticVertex& v = verticies[idx];
     FVector tmp;
-    tmp = v.TangentX;
+    tmp = verticies.TangentsX[idx];
     layerElementTangent->GetDirectArray().Add(FbxVector4(tmp.X, -tmp.Y, tmp.Z));
-    tmp = v.TangentY;
+    tmp = verticies.TangentsY[idx];
     layerElementBinormal->GetDirectArray().Add(FbxVector4(tmp.X, -tmp.Y, tmp.Z));
-    tmp = v.TangentZ;
+    tmp = verticies.TangentsZ[idx];
     layerElementNormal->GetDirectArray().Add(FbxVector4(tmp.X, -tmp.Y, tmp.Z));
 
-    uvDiffuseLayer->GetDirectArray().Add(FbxVector2(v.UVs[0].X, -v.UVs[0].Y + 1.f));
+    uvDiffuseLayer->GetDirectArray().Add(FbxVector2(verticies.UVs[0][idx].X, -verticies.UVs[0][idx].Y + 1.f));
     for (int32 uvIdx = 0; uvIdx < customUVLayers.size(); ++uvIdx)
     {
-      customUVLayers[uvIdx]->GetDirectArray().Add(FbxVector2(v.UVs[uvIdx + 1].X, -v.UVs[uvIdx + 1].Y + 1.f));
+      const FVector2D& uv = verticies.UVs[uvIdx + 1][idx];
+      customUVLayers[uvIdx]->GetDirectArray().Add(FbxVector2(uv.X, -uv.Y + 1.f));
     }
   }
 
@@ -0,0 +1,807 @@
+#include "MeshCollision.h"
+
+#include <Tera/UStaticMesh.h>
+#include <Tera/kDOP.h>
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <ppl.h>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#define MESH_COLLISION_SSE2 1
+#include <emmintrin.h>
+#endif
+
+// Traversal stack size. Trees of 32-bit triangle counts are less than 40 levels deep.
+#define MESH_COLLISION_STACK_SIZE 128
+
+namespace
+{
+  struct Vec3 {
+    float X = 0;
+    float Y = 0;
+    float Z = 0;
+
+    Vec3() = default;
+
+    Vec3(float x, float y, float z)
+      : X(x)
+      , Y(y)
+      , Z(z)
+    {}
+
+    Vec3(const FVector& v)
+      : X(v.X)
+      , Y(v.Y)
+      , Z(v.Z)
+    {}
+
+    Vec3 operator+(const Vec3& v) const
+    {
+      return Vec3(X + v.X, Y + v.Y, Z + v.Z);
+    }
+
+    Vec3 operator-(const Vec3& v) const
+    {
+      return Vec3(X - v.X, Y - v.Y, Z - v.Z);
+    }
+
+    Vec3 operator*(float s) const
+    {
+      return Vec3(X * s, Y * s, Z * s);
+    }
+
+    float operator[](int32 axis) const
+    {
+      return axis == 0 ? X : axis == 1 ? Y : Z;
+    }
+
+    FVector ToFVector() const
+    {
+      return FVector(X, Y, Z);
+    }
+  };
+
+  inline float Dot(const Vec3& a, const Vec3& b)
+  {
+    return a.X * b.X + a.Y * b.Y + a.Z * b.Z;
+  }
+
+  inline Vec3 Cross(const Vec3& a, const Vec3& b)
+  {
+    return Vec3(a.Y * b.Z - a.Z * b.Y, a.Z * b.X - a.X * b.Z, a.X * b.Y - a.Y * b.X);
+  }
+
+  inline float Component(const FVector& v, int32 axis)
+  {
+    return axis == 0 ? v.X : axis == 1 ? v.Y : v.Z;
+  }
+
+  struct Ray {
+    Vec3 Origin;
+    Vec3 Direction;
+    float InvDirection[4] = {};
+#ifdef MESH_COLLISION_SSE2
+    __m128 O;
+    __m128 InvD;
+#endif
+
+    Ray(const FVector& start, const FVector& end)
+      : Origin(start)
+      , Direction(Vec3(end) - Vec3(start))
+    {
+      for (int32 axis = 0; axis < 3; ++axis)
+      {
+        // Keep slabs of axis-parallel rays finite. Infinities would turn into NaNs on the slab planes.
+        const float d = Direction[axis];
+        InvDirection[axis] = 1.f / (std::fabs(d) > 1e-20f ? d : std::copysign(1e-20f, d));
+      }
+#ifdef MESH_COLLISION_SSE2
+      O = _mm_setr_ps(Origin.X, Origin.Y, Origin.Z, 0.f);
+      InvD = _mm_loadu_ps(InvDirection);
+#endif
+    }
+  };
+
+  // Slab test. Entry is the segment time where the ray enters the node.
+  inline bool IntersectNode(const MeshCollision::Node& node, const Ray& ray, float maxTime, float& entry)
+  {
+#ifdef MESH_COLLISION_SSE2
+    const __m128 t1 = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node.Min), ray.O), ray.InvD);
+    const __m128 t2 = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node.Max), ray.O), ray.InvD);
+    const __m128 tmin = _mm_min_ps(t1, t2);
+    const __m128 tmax = _mm_max_ps(t1, t2);
+    __m128 tnear = _mm_max_ss(tmin, _mm_shuffle_ps(tmin, tmin, _MM_SHUFFLE(1, 1, 1, 1)));
+    tnear = _mm_max_ss(tnear, _mm_shuffle_ps(tmin, tmin, _MM_SHUFFLE(2, 2, 2, 2)));
+    __m128 tfar = _mm_min_ss(tmax, _mm_shuffle_ps(tmax, tmax, _MM_SHUFFLE(1, 1, 1, 1)));
+    tfar = _mm_min_ss(tfar, _mm_shuffle_ps(tmax, tmax, _MM_SHUFFLE(2, 2, 2, 2)));
+    entry = std::max(_mm_cvtss_f32(tnear), 0.f);
+    return entry <= std::min(_mm_cvtss_f32(tfar), maxTime);
+#else
+    float tnear = 0.f;
+    float tfar = maxTime;
+    for (int32 axis = 0; axis < 3; ++axis)
+    {
+      const float t1 = (node.Min[axis] - ray.Origin[axis]) * ray.InvDirection[axis];
+      const float t2 = (node.Max[axis] - ray.Origin[axis]) * ray.InvDirection[axis];
+      tnear = std::max(tnear, std::min(t1, t2));
+      tfar = std::min(tfar, std::max(t1, t2));
+    }
+    entry = tnear;
+    return tnear <= tfar;
+#endif
+  }
+
+  inline bool NodeOverlapsBox(const MeshCollision::Node& node, const float* boxMin, const float* boxMax)
+  {
+#ifdef MESH_COLLISION_SSE2
+    const __m128 separated = _mm_or_ps(_mm_cmpgt_ps(_mm_load_ps(node.Min), _mm_load_ps(boxMax)), _mm_cmplt_ps(_mm_load_ps(node.Max), _mm_load_ps(boxMin)));
+    return !(_mm_movemask_ps(separated) & 7);
+#else
+    for (int32 axis = 0; axis < 3; ++axis)
+    {
+      if (node.Min[axis] > boxMax[axis] || node.Max[axis] < boxMin[axis])
+      {
+        return false;
+      }
+    }
+    return true;
+#endif
+  }
+
+  // Squared distance from the point to the node's box
+  inline float NodeDistanceSquared(const MeshCollision::Node& node, const float* point)
+  {
+#ifdef MESH_COLLISION_SSE2
+    const __m128 p = _mm_load_ps(point);
+    const __m128 d = _mm_sub_ps(_mm_min_ps(_mm_max_ps(p, _mm_load_ps(node.Min)), _mm_load_ps(node.Max)), p);
+    const __m128 sq = _mm_mul_ps(d, d);
+    const __m128 sum = _mm_add_ss(_mm_add_ss(sq, _mm_shuffle_ps(sq, sq, _MM_SHUFFLE(1, 1, 1, 1))), _mm_shuffle_ps(sq, sq, _MM_SHUFFLE(2, 2, 2, 2)));
+    return _mm_cvtss_f32(sum);
+#else
+    float result = 0.f;
+    for (int32 axis = 0; axis < 3; ++axis)
+    {
+      const float d = std::min(std::max(point[axis], node.Min[axis]), node.Max[axis]) - point[axis];
+      result += d * d;
+    }
+    return result;
+#endif
+  }
+
+  // Double-sided Moller-Trumbore
+  inline bool IntersectTriangle(const MeshCollision::Triangle& tri, const Ray& ray, float maxTime, float& time)
+  {
+    const Vec3 a(tri.A);
+    const Vec3 e1 = Vec3(tri.B) - a;
+    const Vec3 e2 = Vec3(tri.C) - a;
+    const Vec3 p = Cross(ray.Direction, e2);
+    const float det = Dot(e1, p);
+    if (det == 0.f)
+    {
+      return false;
+    }
+    const float invDet = 1.f / det;
+    const Vec3 s = ray.Origin - a;
+    const float u = Dot(s, p) * invDet;
+    if (u < 0.f || u > 1.f)
+    {
+      return false;
+    }
+    const Vec3 q = Cross(s, e1);
+    const float v = Dot(ray.Direction, q) * invDet;
+    if (v < 0.f || u + v > 1.f)
+    {
+      return false;
+    }
+    time = Dot(e2, q) * invDet;
+    return time >= 0.f && time < maxTime;
+  }
+
+  // Closest point on a triangle. Real-Time Collision Detection, 5.1.5.
+  Vec3 ClosestPointOnTriangle(const Vec3& p, const Vec3& a, const Vec3& b, const Vec3& c)
+  {
+    const Vec3 ab = b - a;
+    const Vec3 ac = c - a;
+    const Vec3 ap = p - a;
+    const float d1 = Dot(ab, ap);
+    const float d2 = Dot(ac, ap);
+    if (d1 <= 0.f && d2 <= 0.f)
+    {
+      return a;
+    }
+    const Vec3 bp = p - b;
+    const float d3 = Dot(ab, bp);
+    const float d4 = Dot(ac, bp);
+    if (d3 >= 0.f && d4 <= d3)
+    {
+      return b;
+    }
+    const float vc = d1 * d4 - d3 * d2;
+    if (vc <= 0.f && d1 >= 0.f && d3 <= 0.f)
+    {
+      return a + ab * (d1 / (d1 - d3));
+    }
+    const Vec3 cp = p - c;
+    const float d5 = Dot(ab, cp);
+    const float d6 = Dot(ac, cp);
+    if (d6 >= 0.f && d5 <= d6)
+    {
+      return c;
+    }
+    const float vb = d5 * d2 - d1 * d6;
+    if (vb <= 0.f && d2 >= 0.f && d6 <= 0.f)
+    {
+      return a + ac * (d2 / (d2 - d6));
+    }
+    const float va = d3 * d6 - d5 * d4;
+    if (va <= 0.f && (d4 - d3) >= 0.f && (d5 - d6) >= 0.f)
+    {
+      return b + (c - b) * ((d4 - d3) / ((d4 - d3) + (d5 - d6)));
+    }
+    const float denom = 1.f / (va + vb + vc);
+    return a + ab * (vb * denom) + ac * (vc * denom);
+  }
+
+  // Separating axis test. Fast 3D Triangle-Box Overlap Testing, Akenine-Moller.
+  bool TriangleOverlapsBox(const MeshCollision::Triangle& tri, const Vec3& center, const Vec3& extent)
+  {
+    const Vec3 v[3] = { Vec3(tri.A) - center, Vec3(tri.B) - center, Vec3(tri.C) - center };
+    auto overlapsOnAxis = [&](const Vec3& axis) {
+      const float p0 = Dot(v[0], axis);
+      const float p1 = Dot(v[1], axis);
+      const float p2 = Dot(v[2], axis);
+      const float r = extent.X * std::fabs(axis.X) + extent.Y * std::fabs(axis.Y) + extent.Z * std::fabs(axis.Z);
+      return std::max({ p0, p1, p2 }) >= -r && std::min({ p0, p1, p2 }) <= r;
+    };
+
+    // Box faces
+    for (int32 axis = 0; axis < 3; ++axis)
+    {
+      if (std::max({ v[0][axis], v[1][axis], v[2][axis] }) < -extent[axis] || std::min({ v[0][axis], v[1][axis], v[2][axis] }) > extent[axis])
+      {
+        return false;
+      }
+    }
+
+    // Triangle plane
+    const Vec3 edges[3] = { v[1] - v[0], v[2] - v[1], v[0] - v[2] };
+    if (!overlapsOnAxis(Cross(edges[0], edges[1])))
+    {
+      return false;
+    }
+
+    // Edge cross products
+    static const Vec3 boxAxes[3] = { Vec3(1, 0, 0), Vec3(0, 1, 0), Vec3(0, 0, 1) };
+    for (const Vec3& edge : edges)
+    {
+      for (const Vec3& boxAxis : boxAxes)
+      {
+        if (!overlapsOnAxis(Cross(boxAxis, edge)))
+        {
+          return false;
+        }
+      }
+    }
+    return true;
+  }
+
+  inline bool TriangleInBounds(const MeshCollision::Triangle& tri, const MeshCollision::Node& node, float tolerance)
+  {
+    for (const FVector* v : { &tri.A, &tri.B, &tri.C })
+    {
+      for (int32 axis = 0; axis < 3; ++axis)
+      {
+        const float value = Component(*v, axis);
+        if (value < node.Min[axis] - tolerance || value > node.Max[axis] + tolerance)
+        {
+          return false;
+        }
+      }
+    }
+    return true;
+  }
+}
+
+MeshCollision::MeshCollision(const UStaticMesh* mesh)
+{
+  const FStaticMeshRenderData* lod = mesh ? mesh->GetLod(0) : nullptr;
+  if (!lod || !lod->PositionBuffer.Data)
+  {
+    return;
+  }
+  const FVector* positions = lod->PositionBuffer.Data;
+  const uint32 numVertices = lod->PositionBuffer.NumVertices;
+
+  // Cooked collision triangles index the LOD 0 positions
+  const FkDOPTreeCompact& tree = mesh->GetkDOPTree();
+  bool useCollision = tree.Triangles.size();
+  for (const FkDOPCollisionTriangle& tri : tree.Triangles)
+  {
+    if (tri.Vertex1 >= numVertices || tri.Vertex2 >= numVertices || tri.Vertex3 >= numVertices)
+    {
+      useCollision = false;
+      break;
+    }
+  }
+
+  if (useCollision)
+  {
+    Triangles.resize(tree.Triangles.size());
+    for (size_t idx = 0; idx < Triangles.size(); ++idx)
+    {
+      const FkDOPCollisionTriangle& src = tree.Triangles[idx];
+      Triangle& dst = Triangles[idx];
+      dst.A = positions[src.Vertex1];
+      dst.B = positions[src.Vertex2];
+      dst.C = positions[src.Vertex3];
+      dst.Index = (int32)idx;
+      dst.MaterialIndex = src.MaterialIndex;
+    }
+    // The cooked layout is implicit. Accept the first interpretation that encloses every triangle.
+    for (bool balanced : { false, true })
+    {
+      for (bool invertedMax : { true, false })
+      {
+        if (!Cooked && DecodeCookedTree(tree, balanced, invertedMax))
+        {
+          Cooked = true;
+        }
+      }
+    }
+  }
+  else
+  {
+    // No collision data. Use the render triangles.
+    const uint64 numIndices = lod->IndexBuffer.GetElementCount();
+    const std::vector<FStaticMeshElement>& elements = lod->Elements;
+    for (size_t elementIndex = 0; elementIndex < elements.size(); ++elementIndex)
+    {
+      const FStaticMeshElement& element = elements[elementIndex];
+      if ((uint64)element.FirstIndex + (uint64)element.NumTriangles * 3 > numIndices)
+      {
+        continue;
+      }
+      for (uint32 face = 0; face < element.NumTriangles; ++face)
+      {
+        const uint32 i0 = lod->IndexBuffer.GetIndex(element.FirstIndex + face * 3);
+        const uint32 i1 = lod->IndexBuffer.GetIndex(element.FirstIndex + face * 3 + 1);
+        const uint32 i2 = lod->IndexBuffer.GetIndex(element.FirstIndex + face * 3 + 2);
+        if (i0 >= numVertices || i1 >= numVertices || i2 >= numVertices)
+        {
+          continue;
+        }
+        Triangle& dst = Triangles.emplace_back();
+        dst.A = positions[i0];
+        dst.B = positions[i1];
+        dst.C = positions[i2];
+        dst.Index = (int32)(element.FirstIndex / 3 + face);
+        dst.MaterialIndex = (uint16)elementIndex;
+      }
+    }
+  }
+
+  if (!Cooked && Triangles.size())
+  {
+    BuildTree();
+  }
+}
+
+bool MeshCollision::DecodeCookedTree(const FkDOPTreeCompact& tree, bool balancedSplit, bool invertedMax)
+{
+  // Nodes form a full binary tree in level order: children of N are 2N + 1 and 2N + 2.
+  // Node bounds are quantized to bytes relative to the parent bounds. Leaves hold up to MAX_TRIS_PER_LEAF triangles.
+  const uint32 numNodes = (uint32)tree.Nodes.size();
+  const uint32 numTriangles = (uint32)Triangles.size();
+  if (!numNodes)
+  {
+    return false;
+  }
+
+  std::vector<uint32> leafCounts(numNodes);
+  for (uint32 idx = numNodes; idx-- > 0;)
+  {
+    const uint64 left = 2ull * idx + 1;
+    if (left >= numNodes)
+    {
+      leafCounts[idx] = 1;
+      continue;
+    }
+    if (left + 1 >= numNodes)
+    {
+      return false;
+    }
+    leafCounts[idx] = leafCounts[left] + leafCounts[left + 1];
+  }
+  if ((uint64)leafCounts[0] * MAX_TRIS_PER_LEAF < numTriangles)
+  {
+    return false;
+  }
+
+  std::vector<Node> nodes(numNodes);
+  std::vector<uint32> firsts(numNodes);
+  std::vector<uint32> counts(numNodes);
+  counts[0] = numTriangles;
+  for (uint32 idx = 0; idx < numNodes; ++idx)
+  {
+    const FkDOPCompact& compact = tree.Nodes[idx].BoundingVolume;
+    const float* parentMin = idx ? nodes[(idx - 1) / 2].Min : tree.RootBounds.Min;
+    const float* parentMax = idx ? nodes[(idx - 1) / 2].Max : tree.RootBounds.Max;
+    Node& node = nodes[idx];
+    float tolerance = 0.f;
+    for (int32 plane = 0; plane < NUM_PLANES; ++plane)
+    {
+      const float extent = parentMax[plane] - parentMin[plane];
+      node.Min[plane] = parentMin[plane] + compact.Min[plane] * extent / 255.f;
+      node.Max[plane] = invertedMax ? parentMax[plane] - compact.Max[plane] * extent / 255.f : parentMin[plane] + compact.Max[plane] * extent / 255.f;
+      if (node.Min[plane] > node.Max[plane])
+      {
+        return false;
+      }
+      tolerance = std::max(tolerance, extent);
+    }
+
+    const uint32 left = 2 * idx + 1;
+    if (left < numNodes)
+    {
+      const uint32 leftCount = balancedSplit ? (counts[idx] + 1) / 2 : std::min<uint32>(counts[idx], leafCounts[left] * MAX_TRIS_PER_LEAF);
+      firsts[left] = firsts[idx];
+      counts[left] = leftCount;
+      firsts[left + 1] = firsts[idx] + leftCount;
+      counts[left + 1] = counts[idx] - leftCount;
+      node.Child = left;
+      node.NumTriangles = Node::InnerNode;
+      continue;
+    }
+
+    if (counts[idx] > MAX_TRIS_PER_LEAF)
+    {
+      return false;
+    }
+    node.Child = firsts[idx];
+    node.NumTriangles = counts[idx];
+    // Allow for rounding of the dequantized bounds
+    tolerance = tolerance * 1e-4f + 1e-3f;
+    for (uint32 tri = node.Child; tri < node.Child + node.NumTriangles; ++tri)
+    {
+      if (!TriangleInBounds(Triangles[tri], node, tolerance))
+      {
+        return false;
+      }
+    }
+  }
+
+  Nodes.swap(nodes);
+  return true;
+}
+
+void MeshCollision::BuildTree()
+{
+  Nodes.clear();
+  Nodes.reserve(Triangles.size() / MAX_TRIS_PER_LEAF * 2 + 1);
+  Nodes.emplace_back();
+  BuildNode(0, 0, (uint32)Triangles.size());
+}
+
+void MeshCollision::BuildNode(uint32 nodeIndex, uint32 first, uint32 count)
+{
+  float boundsMin[3] = { FLT_MAX, FLT_MAX, FLT_MAX };
+  float boundsMax[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+  float centerMin[3] = { FLT_MAX, FLT_MAX, FLT_MAX };
+  float centerMax[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+  for (uint32 idx = first; idx < first + count; ++idx)
+  {
+    const Triangle& tri = Triangles[idx];
+    for (int32 axis = 0; axis < 3; ++axis)
+    {
+      const float a = Component(tri.A, axis);
+      const float b = Component(tri.B, axis);
+      const float c = Component(tri.C, axis);
+      boundsMin[axis] = std::min({ boundsMin[axis], a, b, c });
+      boundsMax[axis] = std::max({ boundsMax[axis], a, b, c });
+      const float center = (a + b + c) / 3.f;
+      centerMin[axis] = std::min(centerMin[axis], center);
+      centerMax[axis] = std::max(centerMax[axis], center);
+    }
+  }
+  {
+    Node& node = Nodes[nodeIndex];
+    std::copy_n(boundsMin, 3, node.Min);
+    std::copy_n(boundsMax, 3, node.Max);
+    if (count <= MAX_TRIS_PER_LEAF)
+    {
+      node.Child = first;
+      node.NumTriangles = count;
+      return;
+    }
+  }
+
+  // Median split along the widest spread of triangle centers keeps the tree balanced
+  int32 axis = 0;
+  for (int32 candidate = 1; candidate < 3; ++candidate)
+  {
+    if (centerMax[candidate] - centerMin[candidate] > centerMax[axis] - centerMin[axis])
+    {
+      axis = candidate;
+    }
+  }
+  const uint32 leftCount = count / 2;
+  std::nth_element(Triangles.begin() + first, Triangles.begin() + first + leftCount, Triangles.begin() + first + count, [axis](const Triangle& a, const Triangle& b) {
+    return Component(a.A, axis) + Component(a.B, axis) + Component(a.C, axis) < Component(b.A, axis) + Component(b.B, axis) + Component(b.C, axis);
+  });
+
+  const uint32 child = (uint32)Nodes.size();
+  Nodes.emplace_back();
+  Nodes.emplace_back();
+  Nodes[nodeIndex].Child = child;
+  Nodes[nodeIndex].NumTriangles = Node::InnerNode;
+  BuildNode(child, first, leftCount);
+  BuildNode(child + 1, first + leftCount, count - leftCount);
+}
+
+bool MeshCollision::RayCast(const FVector& start, const FVector& end, MeshCollisionHit& hit) const
+{
+  if (Nodes.empty())
+  {
+    return false;
+  }
+  const Ray ray(start, end);
+  float best = 1.f;
+  const Triangle* bestTriangle = nullptr;
+
+  struct Entry {
+    uint32 Node;
+    float Time;
+  };
+  Entry stack[MESH_COLLISION_STACK_SIZE];
+  int32 top = 0;
+  float entry = 0.f;
+  if (!IntersectNode(Nodes[0], ray, best, entry))
+  {
+    return false;
+  }
+  stack[top++] = { 0, entry };
+  while (top)
+  {
+    const Entry current = stack[--top];
+    if (current.Time > best)
+    {
+      continue;
+    }
+    const Node& node = Nodes[current.Node];
+    if (node.NumTriangles != Node::InnerNode)
+    {
+      for (uint32 idx = node.Child; idx < node.Child + node.NumTriangles; ++idx)
+      {
+        float time = 0.f;
+        if (IntersectTriangle(Triangles[idx], ray, best, time))
+        {
+          best = time;
+          bestTriangle = &Triangles[idx];
+        }
+      }
+      continue;
+    }
+    float leftTime = 0.f;
+    float rightTime = 0.f;
+    const bool left = IntersectNode(Nodes[node.Child], ray, best, leftTime);
+    const bool right = IntersectNode(Nodes[node.Child + 1], ray, best, rightTime);
+    if (top + 2 > MESH_COLLISION_STACK_SIZE)
+    {
+      break;
+    }
+    // The nearer child is popped first
+    if (left && right)
+    {
+      if (leftTime <= rightTime)
+      {
+        stack[top++] = { node.Child + 1, rightTime };
+        stack[top++] = { node.Child, leftTime };
+      }
+      else
+      {
+        stack[top++] = { node.Child, leftTime };
+        stack[top++] = { node.Child + 1, rightTime };
+      }
+    }
+    else if (left)
+    {
+      stack[top++] = { node.Child, leftTime };
+    }
+    else if (right)
+    {
+      stack[top++] = { node.Child + 1, rightTime };
+    }
+  }
+
+  if (!bestTriangle)
+  {
+    return false;
+  }
+  const Vec3 normal = Cross(Vec3(bestTriangle->B) - Vec3(bestTriangle->A), Vec3(bestTriangle->C) - Vec3(bestTriangle->A));
+  const float length = std::sqrt(Dot(normal, normal));
+  hit.Time = best;
+  hit.Triangle = bestTriangle->Index;
+  hit.MaterialIndex = bestTriangle->MaterialIndex;
+  hit.Normal = length > 0.f ? (normal * (1.f / length)).ToFVector() : FVector();
+  return true;
+}
+
+bool MeshCollision::OverlapBox(const FVector& center, const FVector& extent, std::vector<int32>* triangles) const
+{
+  if (Nodes.empty())
+  {
+    return false;
+  }
+  alignas(16) const float boxMin[4] = { center.X - extent.X, center.Y - extent.Y, center.Z - extent.Z, 0.f };
+  alignas(16) const float boxMax[4] = { center.X + extent.X, center.Y + extent.Y, center.Z + extent.Z, 0.f };
+  bool result = false;
+  uint32 stack[MESH_COLLISION_STACK_SIZE];
+  int32 top = 0;
+  stack[top++] = 0;
+  while (top)
+  {
+    const Node& node = Nodes[stack[--top]];
+    if (!NodeOverlapsBox(node, boxMin, boxMax))
+    {
+      continue;
+    }
+    if (node.NumTriangles == Node::InnerNode)
+    {
+      if (top + 2 <= MESH_COLLISION_STACK_SIZE)
+      {
+        stack[top++] = node.Child + 1;
+        stack[top++] = node.Child;
+      }
+      continue;
+    }
+    for (uint32 idx = node.Child; idx < node.Child + node.NumTriangles; ++idx)
+    {
+      if (TriangleOverlapsBox(Triangles[idx], center, extent))
+      {
+        result = true;
+        if (!triangles)
+        {
+          return true;
+        }
+        triangles->push_back(Triangles[idx].Index);
+      }
+    }
+  }
+  return result;
+}
+
+bool MeshCollision::OverlapSphere(const FVector& center, float radius, std::vector<int32>* triangles) const
+{
+  if (Nodes.empty() || radius < 0.f)
+  {
+    return false;
+  }
+  alignas(16) const float point[4] = { center.X, center.Y, center.Z, 0.f };
+  const float radiusSquared = radius * radius;
+  bool result = false;
+  uint32 stack[MESH_COLLISION_STACK_SIZE];
+  int32 top = 0;
+  stack[top++] = 0;
+  while (top)
+  {
+    const Node& node = Nodes[stack[--top]];
+    if (NodeDistanceSquared(node, point) > radiusSquared)
+    {
+      continue;
+    }
+    if (node.NumTriangles == Node::InnerNode)
+    {
+      if (top + 2 <= MESH_COLLISION_STACK_SIZE)
+      {
+        stack[top++] = node.Child + 1;
+        stack[top++] = node.Child;
+      }
+      continue;
+    }
+    for (uint32 idx = node.Child; idx < node.Child + node.NumTriangles; ++idx)
+    {
+      const Triangle& tri = Triangles[idx];
+      const Vec3 d = ClosestPointOnTriangle(center, tri.A, tri.B, tri.C) - Vec3(center);
+      if (Dot(d, d) <= radiusSquared)
+      {
+        result = true;
+        if (!triangles)
+        {
+          return true;
+        }
+        triangles->push_back(tri.Index);
+      }
+    }
+  }
+  return result;
+}
+
+bool MeshCollision::ClosestPoint(const FVector& point, float maxDistance, FVector& result, int32* triangle) const
+{
+  if (Nodes.empty() || maxDistance < 0.f)
+  {
+    return false;
+  }
+  alignas(16) const float p[4] = { point.X, point.Y, point.Z, 0.f };
+  float best = maxDistance * maxDistance;
+  const Triangle* bestTriangle = nullptr;
+  Vec3 bestPoint;
+
+  struct Entry {
+    uint32 Node;
+    float DistanceSquared;
+  };
+  Entry stack[MESH_COLLISION_STACK_SIZE];
+  int32 top = 0;
+  stack[top++] = { 0, NodeDistanceSquared(Nodes[0], p) };
+  while (top)
+  {
+    const Entry current = stack[--top];
+    if (current.DistanceSquared > best)
+    {
+      continue;
+    }
+    const Node& node = Nodes[current.Node];
+    if (node.NumTriangles != Node::InnerNode)
+    {
+      for (uint32 idx = node.Child; idx < node.Child + node.NumTriangles; ++idx)
+      {
+        const Triangle& tri = Triangles[idx];
+        const Vec3 closest = ClosestPointOnTriangle(point, tri.A, tri.B, tri.C);
+        const Vec3 d = closest - Vec3(point);
+        const float distanceSquared = Dot(d, d);
+        if (distanceSquared <= best)
+        {
+          best = distanceSquared;
+          bestPoint = closest;
+          bestTriangle = &tri;
+        }
+      }
+      continue;
+    }
+    if (top + 2 > MESH_COLLISION_STACK_SIZE)
+    {
+      break;
+    }
+    const float left = NodeDistanceSquared(Nodes[node.Child], p);
+    const float right = NodeDistanceSquared(Nodes[node.Child + 1], p);
+    // The nearer child is popped first, so the farther one is often pruned
+    if (left <= right)
+    {
+      stack[top++] = { node.Child + 1, right };
+      stack[top++] = { node.Child, left };
+    }
+    else
+    {
+      stack[top++] = { node.Child, left };
+      stack[top++] = { node.Child + 1, right };
+    }
+  }
+
+  if (!bestTriangle)
+  {
+    return false;
+  }
+  result = bestPoint.ToFVector();
+  if (triangle)
+  {
+    *triangle = bestTriangle->Index;
+  }
+  return true;
+}
+
+void MeshCollision::RayCast(const FVector* starts, const FVector* ends, size_t count, MeshCollisionHit* hits, bool* results) const
+{
+  concurrency::parallel_for(size_t(0), count, [&](size_t idx) {
+    results[idx] = RayCast(starts[idx], ends[idx], hits[idx]);
+  });
+}
+
+void MeshCollision::ClosestPoint(const FVector* points, size_t count, float maxDistance, FVector* results, bool* found) const
+{
+  concurrency::parallel_for(size_t(0), count, [&](size_t idx) {
+    found[idx] = ClosestPoint(points[idx], maxDistance, results[idx]);
+  });
+}
@@ -0,0 +1,85 @@
+#pragma once
+#include <Tera/Core.h>
+#include <Tera/FStructs.h>
+
+#include <vector>
+
+class UStaticMesh;
+struct FkDOPTreeCompact;
+
+struct MeshCollisionHit {
+  // Fraction of the segment from the start to the end
+  float Time = 1.f;
+  // Index in the cooked collision triangles or in the LOD 0 triangles if the mesh has no collision
+  int32 Triangle = -1;
+  uint16 MaterialIndex = 0;
+  // Unit normal of the triangle
+  FVector Normal;
+};
+
+// Collision queries against the kDOP tree of a static mesh: ray casts, box and sphere overlaps and the closest point.
+// The compact cooked tree is decoded once to float bounds. If the cooked tree is missing or its layout does not match
+// its triangles, a tree with the same leaf size is built from the collision triangles instead.
+// Queries don't modify the object, so any number of threads can run them at once. Coordinates are in mesh space.
+class MeshCollision {
+public:
+  explicit MeshCollision(const UStaticMesh* mesh);
+
+  bool IsValid() const
+  {
+    return Nodes.size();
+  }
+
+  // False if the tree was rebuilt
+  bool UsesCookedTree() const
+  {
+    return Cooked;
+  }
+
+  size_t GetTriangleCount() const
+  {
+    return Triangles.size();
+  }
+
+  // Closest hit along the segment. Triangles are double-sided.
+  bool RayCast(const FVector& start, const FVector& end, MeshCollisionHit& hit) const;
+
+  // Append overlapping triangles if the output is not null. Returns true if anything overlaps.
+  bool OverlapBox(const FVector& center, const FVector& extent, std::vector<int32>* triangles = nullptr) const;
+  bool OverlapSphere(const FVector& center, float radius, std::vector<int32>* triangles = nullptr) const;
+
+  // Closest point of the surface within the maxDistance
+  bool ClosestPoint(const FVector& point, float maxDistance, FVector& result, int32* triangle = nullptr) const;
+
+  // Batch versions spread the queries over the PPL pool
+  void RayCast(const FVector* starts, const FVector* ends, size_t count, MeshCollisionHit* hits, bool* results) const;
+  void ClosestPoint(const FVector* points, size_t count, float maxDistance, FVector* results, bool* found) const;
+
+  struct alignas(16) Node {
+    float Min[4] = {};
+    float Max[4] = {};
+    // Inner nodes: children are Child and Child + 1. Leaves: triangles from Child to Child + NumTriangles.
+    uint32 Child = 0;
+    uint32 NumTriangles = InnerNode;
+
+    static constexpr uint32 InnerNode = 0xFFFFFFFF;
+  };
+
+  struct Triangle {
+    FVector A;
+    FVector B;
+    FVector C;
+    int32 Index = 0;
+    uint16 MaterialIndex = 0;
+  };
+
+private:
+  bool DecodeCookedTree(const FkDOPTreeCompact& tree, bool balancedSplit, bool invertedMax);
+  void BuildTree();
+  void BuildNode(uint32 nodeIndex, uint32 first, uint32 count);
+
+  std::vector<Node> Nodes;
+  // Ordered by leaves
+  std::vector<Triangle> Triangles;
+  bool Cooked = false;
+};
@@ -0,0 +1,796 @@
+#include "MeshExporter.h"
+
+#include <Tera/USkeletalMesh.h>
+#include <Tera/UStaticMesh.h>
+
+#include "VertexDecoder.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cfloat>
+#include <cmath>
+#include <cstdarg>
+#include <cstdio>
+#include <cstring>
+#include <cwctype>
+#include <filesystem>
+#include <fstream>
+#include <vector>
+
+// Size of the file write buffer
+#define MESH_EXPORTER_BUFFER_SIZE (1024 * 1024)
+
+#define GLB_MAGIC 0x46546C67
+#define GLB_VERSION 2
+#define GLB_CHUNK_JSON 0x4E4F534A
+#define GLB_CHUNK_BIN 0x004E4942
+
+#define GL_UNSIGNED_BYTE 5121
+#define GL_UNSIGNED_SHORT 5123
+#define GL_UNSIGNED_INT 5125
+#define GL_FLOAT 5126
+#define GL_ARRAY_BUFFER 34962
+#define GL_ELEMENT_ARRAY_BUFFER 34963
+
+namespace
+{
+  // Unreal units are centimeters
+  const float ExportScale = .01f;
+  // Same as the FBX exporter
+  const float DefaultDiffuse = .72f;
+
+  // Unreal is left-handed Z-up. Swapping Y and Z gives right-handed Y-up and keeps the triangle winding.
+  inline FVector ToExportSpace(const FVector& v)
+  {
+    return FVector(v.X, v.Z, v.Y);
+  }
+
+  inline float Dot(const FVector& a, const FVector& b)
+  {
+    return a.X * b.X + a.Y * b.Y + a.Z * b.Z;
+  }
+
+  inline FVector Normalized(const FVector& v, const FVector& fallback)
+  {
+    const float length = std::sqrt(Dot(v, v));
+    if (length < 1e-6f || !std::isfinite(length))
+    {
+      return fallback;
+    }
+    return v * (1.f / length);
+  }
+
+  inline uint32 Align4(uint32 value)
+  {
+    return (value + 3) & ~3u;
+  }
+
+  struct ExportSection {
+    uint32 FirstIndex = 0;
+    uint32 NumTriangles = 0;
+    int32 Material = 0;
+  };
+
+  // Decoded LOD data shared by the writers
+  struct ExportMesh {
+    VertexDecoder::Streams Vertices;
+    std::vector<uint32> Indices;
+    std::vector<ExportSection> Sections;
+    std::vector<std::string> MaterialNames;
+  };
+
+  std::string GetMaterialName(UObject* material, size_t idx)
+  {
+    return material ? material->GetObjectName().UTF8() : ("Material_" + std::to_string(idx + 1));
+  }
+
+  bool BuildMesh(const FStaticMeshRenderData* lod, ExportMesh& output)
+  {
+    if (!VertexDecoder::Decode(lod, output.Vertices))
+    {
+      return false;
+    }
+    output.Indices.resize(lod->IndexBuffer.GetElementCount());
+    for (uint32 idx = 0; idx < output.Indices.size(); ++idx)
+    {
+      output.Indices[idx] = lod->IndexBuffer.GetIndex(idx);
+    }
+
+    // Same material order as the FBX exporter
+    std::vector<UObject*> materials;
+    for (const FStaticMeshElement& element : lod->Elements)
+    {
+      if (!element.NumTriangles)
+      {
+        continue;
+      }
+      auto it = std::find(materials.begin(), materials.end(), element.Material);
+      ExportSection& section = output.Sections.emplace_back();
+      section.FirstIndex = element.FirstIndex;
+      section.NumTriangles = element.NumTriangles;
+      section.Material = (int32)(it - materials.begin());
+      if (it == materials.end())
+      {
+        materials.push_back(element.Material);
+      }
+    }
+    for (size_t idx = 0; idx < materials.size(); ++idx)
+    {
+      output.MaterialNames.emplace_back(GetMaterialName(materials[idx], idx));
+    }
+    return true;
+  }
+
+  void BuildMesh(const USkeletalMesh* mesh, const FStaticLODModel* lod, ExportMesh& output)
+  {
+    VertexDecoder::Decode(lod, output.Vertices);
+    const FMultiSizeIndexContainer* indexContainer = lod->GetIndexContainer();
+    output.Indices.resize(indexContainer->GetElementCount());
+    for (uint32 idx = 0; idx < output.Indices.size(); ++idx)
+    {
+      output.Indices[idx] = indexContainer->GetIndex(idx);
+    }
+
+    size_t numMaterials = 0;
+    for (const FSkelMeshSection* s : lod->GetSections())
+    {
+      if (!s->NumTriangles)
+      {
+        continue;
+      }
+      ExportSection& section = output.Sections.emplace_back();
+      section.FirstIndex = s->BaseIndex;
+      section.NumTriangles = s->NumTriangles;
+      section.Material = s->MaterialIndex;
+      numMaterials = std::max<size_t>(numMaterials, s->MaterialIndex + 1);
+    }
+    std::vector<UObject*> materials = mesh->GetMaterials();
+    numMaterials = std::max(numMaterials, materials.size());
+    for (size_t idx = 0; idx < numMaterials; ++idx)
+    {
+      output.MaterialNames.emplace_back(GetMaterialName(idx < materials.size() ? materials[idx] : nullptr, idx));
+    }
+  }
+
+  // Buffered binary file output
+  class FileWriter {
+  public:
+    FileWriter(const std::filesystem::path& path)
+      : Stream(path, std::ios::out | std::ios::trunc | std::ios::binary)
+    {
+      Buffer.reserve(MESH_EXPORTER_BUFFER_SIZE);
+    }
+
+    bool IsOpen() const
+    {
+      return Stream.is_open();
+    }
+
+    void Write(const void* data, size_t size)
+    {
+      if (Buffer.size() + size > MESH_EXPORTER_BUFFER_SIZE)
+      {
+        Flush();
+      }
+      if (size > MESH_EXPORTER_BUFFER_SIZE)
+      {
+        Stream.write((const char*)data, size);
+        return;
+      }
+      Buffer.insert(Buffer.end(), (const char*)data, (const char*)data + size);
+    }
+
+    template <typename T>
+    void WriteValue(const T& value)
+    {
+      Write(&value, sizeof(T));
+    }
+
+    void WriteVector(const FVector& v)
+    {
+      WriteValue(v.X);
+      WriteValue(v.Y);
+      WriteValue(v.Z);
+    }
+
+    void WriteString(const std::string& str)
+    {
+      Write(str.data(), str.size());
+    }
+
+    void Printf(const char* format, ...)
+    {
+      char tmp[256];
+      va_list args;
+      va_start(args, format);
+      const int len = vsnprintf(tmp, sizeof(tmp), format, args);
+      va_end(args);
+      if (len > 0)
+      {
+        Write(tmp, std::min<size_t>(len, sizeof(tmp) - 1));
+      }
+    }
+
+    bool Close()
+    {
+      Flush();
+      Stream.close();
+      return !Stream.fail();
+    }
+
+  private:
+    void Flush()
+    {
+      if (Buffer.size())
+      {
+        Stream.write(Buffer.data(), Buffer.size());
+        Buffer.clear();
+      }
+    }
+
+  private:
+    std::ofstream Stream;
+    std::vector<char> Buffer;
+  };
+
+  std::string JsonString(const std::string& str)
+  {
+    std::string result = "\"";
+    for (char c : str)
+    {
+      switch (c)
+      {
+      case '"':
+        result += "\\\"";
+        break;
+      case '\\':
+        result += "\\\\";
+        break;
+      default:
+        if ((uint8)c < 0x20)
+        {
+          char tmp[8];
+          snprintf(tmp, sizeof(tmp), "\\u%04x", (uint8)c);
+          result += tmp;
+        }
+        else
+        {
+          result += c;
+        }
+      }
+    }
+    return result + "\"";
+  }
+
+  std::string JsonFloat(float value)
+  {
+    char tmp[32];
+    snprintf(tmp, sizeof(tmp), "%.9g", std::isfinite(value) ? value : 0.f);
+    return tmp;
+  }
+
+  // Column-major 4x4 matrices, as glTF stores them
+  struct Matrix {
+    float M[16] = { 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1 };
+
+    static Matrix FromTransform(const FQuat& q, const FVector& t)
+    {
+      Matrix r;
+      const float xx = q.X * q.X, yy = q.Y * q.Y, zz = q.Z * q.Z;
+      const float xy = q.X * q.Y, xz = q.X * q.Z, yz = q.Y * q.Z;
+      const float wx = q.W * q.X, wy = q.W * q.Y, wz = q.W * q.Z;
+      r.M[0] = 1.f - 2.f * (yy + zz);
+      r.M[1] = 2.f * (xy + wz);
+      r.M[2] = 2.f * (xz - wy);
+      r.M[4] = 2.f * (xy - wz);
+      r.M[5] = 1.f - 2.f * (xx + zz);
+      r.M[6] = 2.f * (yz + wx);
+      r.M[8] = 2.f * (xz + wy);
+      r.M[9] = 2.f * (yz - wx);
+      r.M[10] = 1.f - 2.f * (xx + yy);
+      r.M[12] = t.X;
+      r.M[13] = t.Y;
+      r.M[14] = t.Z;
+      return r;
+    }
+
+    Matrix operator*(const Matrix& b) const
+    {
+      Matrix r;
+      for (int32 col = 0; col < 4; ++col)
+      {
+        for (int32 row = 0; row < 4; ++row)
+        {
+          r.M[col * 4 + row] = M[row] * b.M[col * 4] + M[4 + row] * b.M[col * 4 + 1] + M[8 + row] * b.M[col * 4 + 2] + M[12 + row] * b.M[col * 4 + 3];
+        }
+      }
+      return r;
+    }
+
+    // Inverse of a rotation and translation
+    Matrix InverseRigid() const
+    {
+      Matrix r;
+      for (int32 col = 0; col < 3; ++col)
+      {
+        for (int32 row = 0; row < 3; ++row)
+        {
+          r.M[col * 4 + row] = M[row * 4 + col];
+        }
+      }
+      for (int32 row = 0; row < 3; ++row)
+      {
+        r.M[12 + row] = -(r.M[row] * M[12] + r.M[4 + row] * M[13] + r.M[8 + row] * M[14]);
+      }
+      return r;
+    }
+  };
+
+  // Rotation of a bone in the export space
+  FQuat ToExportSpace(const FQuat& q)
+  {
+    FQuat r;
+    r.X = -q.X;
+    r.Y = -q.Z;
+    r.Z = -q.Y;
+    r.W = q.W;
+    const float length = std::sqrt(r.X * r.X + r.Y * r.Y + r.Z * r.Z + r.W * r.W);
+    if (length < 1e-6f || !std::isfinite(length))
+    {
+      r.X = r.Y = r.Z = 0.f;
+      r.W = 1.f;
+      return r;
+    }
+    r.X /= length;
+    r.Y /= length;
+    r.Z /= length;
+    r.W /= length;
+    return r;
+  }
+
+  bool Validate(const ExportMesh& mesh, MeshExportContext& ctx)
+  {
+    const uint32 numVertices = mesh.Vertices.NumVertices;
+    if (!numVertices)
+    {
+      ctx.Error = "The model has no vertices!";
+      return false;
+    }
+    uint64 numTriangles = 0;
+    for (const ExportSection& section : mesh.Sections)
+    {
+      const uint64 end = (uint64)section.FirstIndex + (uint64)section.NumTriangles * 3;
+      if (end > mesh.Indices.size())
+      {
+        ctx.Error = "The model has invalid sections!";
+        return false;
+      }
+      for (uint32 idx = section.FirstIndex; idx < end; ++idx)
+      {
+        if (mesh.Indices[idx] >= numVertices)
+        {
+          ctx.Error = "The model has invalid indices!";
+          return false;
+        }
+      }
+      numTriangles += section.NumTriangles;
+    }
+    if (!numTriangles)
+    {
+      ctx.Error = "The model has no triangles!";
+      return false;
+    }
+    return true;
+  }
+
+  bool WriteGlb(const ExportMesh& mesh, const std::string& meshName, const std::vector<FMeshBone>* bones, MeshExportContext& ctx)
+  {
+    const VertexDecoder::Streams& vertices = mesh.Vertices;
+    const uint32 numVertices = vertices.NumVertices;
+    const int32 numTexCoords = (int32)vertices.NumUVs;
+    const bool hasColors = vertices.Colors.size();
+    const bool hasSkin = bones && bones->size() && vertices.Bones.size();
+    const uint32 numBones = hasSkin ? (uint32)bones->size() : 0;
+
+    // Interleaved vertex layout
+    const uint32 normalOffset = 12;
+    const uint32 tangentOffset = 24;
+    const uint32 uvOffset = 40;
+    const uint32 colorOffset = uvOffset + 8 * numTexCoords;
+    const uint32 jointsOffset = colorOffset + (hasColors ? 4 : 0);
+    const uint32 weightsOffset = jointsOffset + 8;
+    const uint32 stride = hasSkin ? weightsOffset + 16 : jointsOffset;
+
+    const uint32 indexSize = numVertices <= 0xFFFF ? 2 : 4;
+    uint32 numIndices = 0;
+    for (const ExportSection& section : mesh.Sections)
+    {
+      numIndices += section.NumTriangles * 3;
+    }
+
+    const uint32 vertexBytes = stride * numVertices;
+    const uint32 indexBytes = numIndices * indexSize;
+    const uint32 ibmBytes = numBones * 64;
+    const uint32 binLength = vertexBytes + Align4(indexBytes) + ibmBytes;
+
+    FVector boundsMin(FLT_MAX);
+    FVector boundsMax(-FLT_MAX);
+    for (const FVector& position : vertices.Positions)
+    {
+      const FVector p = ToExportSpace(position) * ExportScale;
+      boundsMin = FVector(std::min(boundsMin.X, p.X), std::min(boundsMin.Y, p.Y), std::min(boundsMin.Z, p.Z));
+      boundsMax = FVector(std::max(boundsMax.X, p.X), std::max(boundsMax.Y, p.Y), std::max(boundsMax.Z, p.Z));
+    }
+
+    // Bone transforms. Parents always precede their children.
+    std::vector<FQuat> rotations(numBones);
+    std::vector<FVector> translations(numBones);
+    std::vector<Matrix> inverseBindMatrices(numBones);
+    std::vector<std::vector<uint32>> children(numBones);
+    std::vector<uint32> rootBones;
+    if (hasSkin)
+    {
+      std::vector<Matrix> globals(numBones);
+      for (uint32 idx = 0; idx < numBones; ++idx)
+      {
+        const FMeshBone& bone = bones->at(idx);
+        rotations[idx] = ToExportSpace(bone.BonePos.Orientation);
+        translations[idx] = ToExportSpace(bone.BonePos.Position) * ExportScale;
+        const Matrix local = Matrix::FromTransform(rotations[idx], translations[idx]);
+        // The root and bones with broken parent links are attached to the scene
+        if (idx && bone.ParentIndex >= 0 && (uint32)bone.ParentIndex < idx)
+        {
+          globals[idx] = globals[bone.ParentIndex] * local;
+          children[bone.ParentIndex].push_back(idx);
+        }
+        else
+        {
+          globals[idx] = local;
+          rootBones.push_back(idx);
+        }
+        inverseBindMatrices[idx] = globals[idx].InverseRigid();
+      }
+    }
+
+    // Node 0 is the mesh. Bone N is node N + 1.
+    std::string nodesJson = "{\"name\":" + JsonString(meshName) + ",\"mesh\":0" + (hasSkin ? ",\"skin\":0}" : "}");
+    for (uint32 idx = 0; idx < numBones; ++idx)
+    {
+      const FQuat& rotation = rotations[idx];
+      const FVector& translation = translations[idx];
+      nodesJson += ",{\"name\":" + JsonString(bones->at(idx).Name.String().UTF8());
+      nodesJson += ",\"rotation\":[" + JsonFloat(rotation.X) + "," + JsonFloat(rotation.Y) + "," + JsonFloat(rotation.Z) + "," + JsonFloat(rotation.W) + "]";
+      nodesJson += ",\"translation\":[" + JsonFloat(translation.X) + "," + JsonFloat(translation.Y) + "," + JsonFloat(translation.Z) + "]";
+      if (children[idx].size())
+      {
+        nodesJson += ",\"children\":[";
+        for (size_t childIdx = 0; childIdx < children[idx].size(); ++childIdx)
+        {
+          nodesJson += (childIdx ? "," : "") + std::to_string(children[idx][childIdx] + 1);
+        }
+        nodesJson += "]";
+      }
+      nodesJson += "}";
+    }
+
+    // Accessors: POSITION, NORMAL, TANGENT, TEXCOORD_n, COLOR_0, JOINTS_0, WEIGHTS_0, IBM, then one per section
+    std::string accessorsJson;
+    std::string attributesJson;
+    int32 accessorIndex = 0;
+    auto addAttribute = [&](const char* name, uint32 offset, uint32 componentType, const char* type, bool normalized, const std::string& extra) {
+      if (accessorIndex)
+      {
+        accessorsJson += ",";
+        attributesJson += ",";
+      }
+      accessorsJson += "{\"bufferView\":0,\"byteOffset\":" + std::to_string(offset) + ",\"componentType\":" + std::to_string(componentType);
+      accessorsJson += std::string(normalized ? ",\"normalized\":true" : "") + ",\"count\":" + std::to_string(numVertices) + ",\"type\":\"" + type + "\"" + extra + "}";
+      attributesJson += std::string("\"") + name + "\":" + std::to_string(accessorIndex++);
+    };
+    addAttribute("POSITION", 0, GL_FLOAT, "VEC3", false,
+      ",\"min\":[" + JsonFloat(boundsMin.X) + "," + JsonFloat(boundsMin.Y) + "," + JsonFloat(boundsMin.Z) + "]" +
+      ",\"max\":[" + JsonFloat(boundsMax.X) + "," + JsonFloat(boundsMax.Y) + "," + JsonFloat(boundsMax.Z) + "]");
+    addAttribute("NORMAL", normalOffset, GL_FLOAT, "VEC3", false, {});
+    addAttribute("TANGENT", tangentOffset, GL_FLOAT, "VEC4", false, {});
+    for (int32 uvIdx = 0; uvIdx < numTexCoords; ++uvIdx)
+    {
+      addAttribute(("TEXCOORD_" + std::to_string(uvIdx)).c_str(), uvOffset + 8 * uvIdx, GL_FLOAT, "VEC2", false, {});
+    }
+    if (hasColors)
+    {
+      addAttribute("COLOR_0", colorOffset, GL_UNSIGNED_BYTE, "VEC4", true, {});
+    }
+    int32 ibmAccessor = -1;
+    if (hasSkin)
+    {
+      addAttribute("JOINTS_0", jointsOffset, GL_UNSIGNED_SHORT, "VEC4", false, {});
+      addAttribute("WEIGHTS_0", weightsOffset, GL_FLOAT, "VEC4", false, {});
+      ibmAccessor = accessorIndex++;
+      accessorsJson += ",{\"bufferView\":2,\"componentType\":" + std::to_string(GL_FLOAT) + ",\"count\":" + std::to_string(numBones) + ",\"type\":\"MAT4\"}";
+    }
+
+    std::string primitivesJson;
+    uint32 indexOffset = 0;
+    for (size_t idx = 0; idx < mesh.Sections.size(); ++idx)
+    {
+      const ExportSection& section = mesh.Sections[idx];
+      accessorsJson += ",{\"bufferView\":1,\"byteOffset\":" + std::to_string(indexOffset) + ",\"componentType\":" + std::to_string(indexSize == 2 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT);
+      accessorsJson += ",\"count\":" + std::to_string(section.NumTriangles * 3) + ",\"type\":\"SCALAR\"}";
+      primitivesJson += std::string(idx ? "," : "") + "{\"attributes\":{" + attributesJson + "},\"indices\":" + std::to_string(accessorIndex++);
+      primitivesJson += ",\"material\":" + std::to_string(section.Material) + ",\"mode\":4}";
+      indexOffset += section.NumTriangles * 3 * indexSize;
+    }
+
+    std::string materialsJson;
+    for (size_t idx = 0; idx < mesh.MaterialNames.size(); ++idx)
+    {
+      materialsJson += std::string(idx ? "," : "") + "{\"name\":" + JsonString(mesh.MaterialNames[idx]);
+      materialsJson += ",\"pbrMetallicRoughness\":{\"baseColorFactor\":[" + JsonFloat(DefaultDiffuse) + "," + JsonFloat(DefaultDiffuse) + "," + JsonFloat(DefaultDiffuse) + ",1],\"metallicFactor\":0}}";
+    }
+
+    std::string json = "{\"asset\":{\"version\":\"2.0\",\"generator\":\"RealEditor\"},\"scene\":0,\"scenes\":[{\"nodes\":[0";
+    for (uint32 root : rootBones)
+    {
+      json += "," + std::to_string(root + 1);
+    }
+    json += "]}],\"nodes\":[" + nodesJson + "]";
+    json += ",\"meshes\":[{\"name\":" + JsonString(meshName) + ",\"primitives\":[" + primitivesJson + "]}]";
+    if (materialsJson.size())
+    {
+      json += ",\"materials\":[" + materialsJson + "]";
+    }
+    if (hasSkin)
+    {
+      json += ",\"skins\":[{\"inverseBindMatrices\":" + std::to_string(ibmAccessor) + ",\"joints\":[";
+      for (uint32 idx = 0; idx < numBones; ++idx)
+      {
+        json += (idx ? "," : "") + std::to_string(idx + 1);
+      }
+      json += "]";
+      if (rootBones.size())
+      {
+        json += ",\"skeleton\":" + std::to_string(rootBones.front() + 1);
+      }
+      json += "}]";
+    }
+    json += ",\"buffers\":[{\"byteLength\":" + std::to_string(binLength) + "}]";
+    json += ",\"bufferViews\":[{\"buffer\":0,\"byteLength\":" + std::to_string(vertexBytes) + ",\"byteStride\":" + std::to_string(stride) + ",\"target\":" + std::to_string(GL_ARRAY_BUFFER) + "}";
+    json += ",{\"buffer\":0,\"byteOffset\":" + std::to_string(vertexBytes) + ",\"byteLength\":" + std::to_string(indexBytes) + ",\"target\":" + std::to_string(GL_ELEMENT_ARRAY_BUFFER) + "}";
+    if (hasSkin)
+    {
+      json += ",{\"buffer\":0,\"byteOffset\":" + std::to_string(vertexBytes + Align4(indexBytes)) + ",\"byteLength\":" + std::to_string(ibmBytes) + "}";
+    }
+    json += "],\"accessors\":[" + accessorsJson + "]}";
+    // Chunks must be 4-byte aligned. JSON is padded with spaces.
+    json.resize(Align4((uint32)json.size()), ' ');
+
+    FileWriter writer(std::filesystem::path(ctx.Path));
+    if (!writer.IsOpen())
+    {
+      ctx.Error = "Failed to write data!";
+      return false;
+    }
+
+    writer.WriteValue<uint32>(GLB_MAGIC);
+    writer.WriteValue<uint32>(GLB_VERSION);
+    writer.WriteValue<uint32>(12 + 8 + (uint32)json.size() + 8 + binLength);
+    writer.WriteValue<uint32>((uint32)json.size());
+    writer.WriteValue<uint32>(GLB_CHUNK_JSON);
+    writer.WriteString(json);
+    writer.WriteValue<uint32>(binLength);
+    writer.WriteValue<uint32>(GLB_CHUNK_BIN);
+
+    for (uint32 vertIdx = 0; vertIdx < numVertices; ++vertIdx)
+    {
+      const FVector position = ToExportSpace(vertices.Positions[vertIdx]) * ExportScale;
+      const FVector normal = Normalized(ToExportSpace(vertices.TangentsZ[vertIdx]), FVector(0, 1, 0));
+      const FVector tangent = Normalized(ToExportSpace(vertices.TangentsX[vertIdx]), FVector(1, 0, 0));
+      const float handedness = Dot(normal ^ tangent, ToExportSpace(vertices.TangentsY[vertIdx])) < 0.f ? -1.f : 1.f;
+      writer.WriteVector(position);
+      writer.WriteVector(normal);
+      writer.WriteVector(tangent);
+      writer.WriteValue(handedness);
+      for (int32 uvIdx = 0; uvIdx < numTexCoords; ++uvIdx)
+      {
+        writer.WriteValue(vertices.UVs[uvIdx][vertIdx].X);
+        writer.WriteValue(vertices.UVs[uvIdx][vertIdx].Y);
+      }
+      if (hasColors)
+      {
+        const FColor& color = vertices.Colors[vertIdx];
+        const uint8 rgba[4] = { color.R, color.G, color.B, color.A };
+        writer.Write(rgba, sizeof(rgba));
+      }
+      if (hasSkin)
+      {
+        const uint16* vertexBones = &vertices.Bones[vertIdx * MAX_INFLUENCES];
+        const uint8* vertexWeights = &vertices.Weights[vertIdx * MAX_INFLUENCES];
+        uint16 joints[MAX_INFLUENCES] = {};
+        float normalizedWeights[MAX_INFLUENCES] = {};
+        uint32 total = 0;
+        for (int32 idx = 0; idx < MAX_INFLUENCES; ++idx)
+        {
+          total += vertexWeights[idx];
+        }
+        for (int32 idx = 0; idx < MAX_INFLUENCES; ++idx)
+        {
+          // glTF requires every joint to exist even if its weight is zero
+          joints[idx] = vertexWeights[idx] && vertexBones[idx] < numBones ? vertexBones[idx] : 0;
+          normalizedWeights[idx] = total ? (float)vertexWeights[idx] / (float)total : 0.f;
+        }
+        if (!total)
+        {
+          normalizedWeights[0] = 1.f;
+        }
+        writer.Write(joints, sizeof(joints));
+        writer.Write(normalizedWeights, sizeof(normalizedWeights));
+      }
+    }
+
+    for (const ExportSection& section : mesh.Sections)
+    {
+      const uint32 end = section.FirstIndex + section.NumTriangles * 3;
+      for (uint32 idx = section.FirstIndex; idx < end; ++idx)
+      {
+        const uint32 index = mesh.Indices[idx];
+        if (indexSize == 2)
+        {
+          writer.WriteValue<uint16>((uint16)index);
+        }
+        else
+        {
+          writer.WriteValue<uint32>(index);
+        }
+      }
+    }
+    const uint32 padding = 0;
+    writer.Write(&padding, Align4(indexBytes) - indexBytes);
+
+    for (const Matrix& m : inverseBindMatrices)
+    {
+      writer.Write(m.M, sizeof(m.M));
+    }
+
+    if (!writer.Close())
+    {
+      ctx.Error = "Failed to write data!";
+      return false;
+    }
+    return true;
+  }
+
+  std::string ObjName(const std::string& name)
+  {
+    std::string result = name;
+    std::replace_if(result.begin(), result.end(), [](char c) { return std::isspace((uint8)c); }, '_');
+    return result;
+  }
+
+  bool WriteObj(const ExportMesh& mesh, const std::string& meshName, MeshExportContext& ctx)
+  {
+    const std::filesystem::path path(ctx.Path);
+    std::filesystem::path mtlPath = path;
+    mtlPath.replace_extension(L"mtl");
+
+    FileWriter mtl(mtlPath);
+    if (!mtl.IsOpen())
+    {
+      ctx.Error = "Failed to write data!";
+      return false;
+    }
+    for (const std::string& name : mesh.MaterialNames)
+    {
+      mtl.WriteString("newmtl " + ObjName(name) + "\n");
+      mtl.Printf("Kd %.2f %.2f %.2f\n\n", DefaultDiffuse, DefaultDiffuse, DefaultDiffuse);
+    }
+    if (!mtl.Close())
+    {
+      ctx.Error = "Failed to write data!";
+      return false;
+    }
+
+    FileWriter obj(path);
+    if (!obj.IsOpen())
+    {
+      ctx.Error = "Failed to write data!";
+      return false;
+    }
+    obj.WriteString("# Exported by RealEditor\nmtllib " + ObjName(mtlPath.filename().u8string()) + "\no " + ObjName(meshName) + "\n");
+    const VertexDecoder::Streams& vertices = mesh.Vertices;
+    for (uint32 vertIdx = 0; vertIdx < vertices.NumVertices; ++vertIdx)
+    {
+      const FVector position = ToExportSpace(vertices.Positions[vertIdx]) * ExportScale;
+      const FVector normal = Normalized(ToExportSpace(vertices.TangentsZ[vertIdx]), FVector(0, 1, 0));
+      const FVector2D& uv = vertices.UVs[0][vertIdx];
+      obj.Printf("v %.6g %.6g %.6g\nvt %.6g %.6g\nvn %.6g %.6g %.6g\n", position.X, position.Y, position.Z, uv.X, 1.f - uv.Y, normal.X, normal.Y, normal.Z);
+    }
+    for (const ExportSection& section : mesh.Sections)
+    {
+      obj.WriteString("usemtl " + ObjName(mesh.MaterialNames[section.Material]) + "\n");
+      for (uint32 triangle = 0; triangle < section.NumTriangles; ++triangle)
+      {
+        const uint32 a = mesh.Indices[section.FirstIndex + triangle * 3] + 1;
+        const uint32 b = mesh.Indices[section.FirstIndex + triangle * 3 + 1] + 1;
+        const uint32 c = mesh.Indices[section.FirstIndex + triangle * 3 + 2] + 1;
+        obj.Printf("f %u/%u/%u %u/%u/%u %u/%u/%u\n", a, a, a, b, b, b, c, c, c);
+      }
+    }
+    if (!obj.Close())
+    {
+      ctx.Error = "Failed to write data!";
+      return false;
+    }
+    return true;
+  }
+}
+
+bool MeshExporter::ExportStaticMesh(const UStaticMesh* mesh, MeshExportContext& ctx)
+{
+  const FStaticMeshRenderData* lod = mesh ? mesh->GetLod(ctx.LodIndex) : nullptr;
+  if (!lod)
+  {
+    ctx.Error = "Failed to get the lod model!";
+    return false;
+  }
+  ExportMesh exportMesh;
+  if (!BuildMesh(lod, exportMesh))
+  {
+    ctx.Error = "Failed to decode vertices! The number of UV channels is not supported.";
+    return false;
+  }
+  if (!Validate(exportMesh, ctx))
+  {
+    return false;
+  }
+  const std::string name = mesh->GetObjectName().UTF8();
+  if (ctx.Format == MeshExportFormat::OBJ)
+  {
+    return WriteObj(exportMesh, name, ctx);
+  }
+  return WriteGlb(exportMesh, name, nullptr, ctx);
+}
+
+bool MeshExporter::ExportSkeletalMesh(const USkeletalMesh* mesh, MeshExportContext& ctx)
+{
+  const FStaticLODModel* lod = mesh ? mesh->GetLod(ctx.LodIndex) : nullptr;
+  if (!lod)
+  {
+    ctx.Error = "Failed to get the lod model!";
+    return false;
+  }
+  const std::vector<FMeshBone> bones = mesh->GetReferenceSkeleton();
+  const bool exportSkeleton = ctx.ExportSkeleton && ctx.Format == MeshExportFormat::GLB && bones.size();
+  ExportMesh exportMesh;
+  BuildMesh(mesh, lod, exportMesh);
+  if (!Validate(exportMesh, ctx))
+  {
+    return false;
+  }
+  const std::string name = mesh->GetObjectName().UTF8();
+  if (ctx.Format == MeshExportFormat::OBJ)
+  {
+    return WriteObj(exportMesh, name, ctx);
+  }
+  return WriteGlb(exportMesh, name, exportSkeleton ? &bones : nullptr, ctx);
+}
+
+bool MeshExporter::FormatFromExtension(const std::wstring& extension, MeshExportFormat& format)
+{
+  std::wstring ext = extension;
+  if (ext.size() && ext.front() == L'.')
+  {
+    ext.erase(ext.begin());
+  }
+  std::transform(ext.begin(), ext.end(), ext.begin(), ::towlower);
+  if (ext == L"glb")
+  {
+    format = MeshExportFormat::GLB;
+    return true;
+  }
+  if (ext == L"obj")
+  {
+    format = MeshExportFormat::OBJ;
+    return true;
+  }
+  return false;
+}
@@ -0,0 +1,34 @@
+#pragma once
+#include <Tera/Core.h>
+
+#include <string>
+
+class UStaticMesh;
+class USkeletalMesh;
+
+enum class MeshExportFormat {
+  GLB,
+  OBJ
+};
+
+struct MeshExportContext {
+  std::wstring Path;
+  MeshExportFormat Format = MeshExportFormat::GLB;
+  // Skeletal meshes only. OBJ has no skeletons.
+  bool ExportSkeleton = true;
+  uint32 LodIndex = 0;
+
+  std::string Error;
+};
+
+// Writes meshes to glTF 2.0 binaries and Wavefront OBJ files without the FBX SDK.
+// Vertices are decoded from the LOD buffers and streamed to the file. There is no shared state, so meshes can be exported in parallel.
+// Exported meshes are right-handed Y-up in meters.
+class MeshExporter {
+public:
+  static bool ExportStaticMesh(const UStaticMesh* mesh, MeshExportContext& ctx);
+  static bool ExportSkeletalMesh(const USkeletalMesh* mesh, MeshExportContext& ctx);
+
+  // "glb" or "obj". Returns false for other extensions.
+  static bool FormatFromExtension(const std::wstring& extension, MeshExportFormat& format);
+};
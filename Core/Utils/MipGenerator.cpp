@@ -0,0 +1,412 @@
+#include "MipGenerator.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <ppl.h>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#define MIP_GENERATOR_SSE2 1
+#include <emmintrin.h>
+#endif
+
+// Destination rows filtered by a single task
+#define MIP_GENERATOR_BAND_ROWS 32
+
+namespace
+{
+  const float Pi = 3.14159265358979323846f;
+
+  // Kernels take a distance in destination pixels
+
+  float BoxKernel(float x)
+  {
+    return fabsf(x) <= .5f ? 1.f : 0.f;
+  }
+
+  float TriangleKernel(float x)
+  {
+    x = fabsf(x);
+    return x < 1.f ? 1.f - x : 0.f;
+  }
+
+  float Bessel0(float x)
+  {
+    float sum = 1.f;
+    float term = 1.f;
+    for (int32 k = 1; k < 32 && term > sum * 1e-8f; ++k)
+    {
+      const float t = x / (2.f * k);
+      term *= t * t;
+      sum += term;
+    }
+    return sum;
+  }
+
+  float Sinc(float x)
+  {
+    if (fabsf(x) < 1e-4f)
+    {
+      return 1.f - x * x / 6.f;
+    }
+    return sinf(x) / x;
+  }
+
+  // Kaiser windowed sinc. Same width and alpha as NVTT uses.
+  const float KaiserWidth = 3.f;
+  const float KaiserAlpha = 4.f;
+
+  float KaiserKernel(float x)
+  {
+    const float t = x / KaiserWidth;
+    if (fabsf(t) >= 1.f)
+    {
+      return 0.f;
+    }
+    return Sinc(Pi * x) * Bessel0(KaiserAlpha * sqrtf(1.f - t * t)) / Bessel0(KaiserAlpha);
+  }
+
+  // Mitchell-Netravali with B = C = 1/3
+  float MitchellKernel(float x)
+  {
+    const float b = 1.f / 3.f;
+    const float c = 1.f / 3.f;
+    x = fabsf(x);
+    if (x < 1.f)
+    {
+      return ((12.f - 9.f * b - 6.f * c) * x * x * x + (-18.f + 12.f * b + 6.f * c) * x * x + (6.f - 2.f * b)) / 6.f;
+    }
+    if (x < 2.f)
+    {
+      return ((-b - 6.f * c) * x * x * x + (6.f * b + 30.f * c) * x * x + (-12.f * b - 48.f * c) * x + (8.f * b + 24.f * c)) / 6.f;
+    }
+    return 0.f;
+  }
+
+  struct FilterDesc {
+    float (*Kernel)(float) = nullptr;
+    // Support radius in destination pixels
+    float Width = 0.f;
+  };
+
+  FilterDesc GetFilter(MipFilterType type)
+  {
+    switch (type)
+    {
+    case MipFilterType::Box:
+      return { BoxKernel, .5f };
+    case MipFilterType::Triangle:
+      return { TriangleKernel, 1.f };
+    case MipFilterType::Mitchell:
+      return { MitchellKernel, 2.f };
+    case MipFilterType::Kaiser:
+    default:
+      return { KaiserKernel, KaiserWidth };
+    }
+  }
+
+  int32 AddressIndex(int32 idx, int32 size, TextureAddress mode)
+  {
+    if (idx >= 0 && idx < size)
+    {
+      return idx;
+    }
+    switch (mode)
+    {
+    case TA_Clamp:
+      return std::clamp(idx, 0, size - 1);
+    case TA_Mirror:
+    {
+      const int32 period = size * 2;
+      idx = ((idx % period) + period) % period;
+      return idx < size ? idx : period - 1 - idx;
+    }
+    case TA_Wrap:
+    default:
+      return ((idx % size) + size) % size;
+    }
+  }
+
+  // 1D resampling taps. Destination pixel i reads Count[i] source pixels starting at First[i] of Index and Weight.
+  struct Taps {
+    std::vector<int32> First;
+    std::vector<int32> Count;
+    std::vector<int32> Index;
+    std::vector<float> Weight;
+  };
+
+  Taps BuildTaps(int32 srcSize, int32 dstSize, const FilterDesc& filter, TextureAddress mode)
+  {
+    Taps taps;
+    const float scale = float(srcSize) / float(dstSize);
+    const float radius = filter.Width * scale;
+    for (int32 dst = 0; dst < dstSize; ++dst)
+    {
+      const float center = (dst + .5f) * scale;
+      const int32 first = (int32)floorf(center - radius);
+      const int32 last = (int32)ceilf(center + radius);
+      const int32 start = (int32)taps.Index.size();
+      float total = 0.f;
+      for (int32 src = first; src <= last; ++src)
+      {
+        const float weight = filter.Kernel((src + .5f - center) / scale);
+        if (weight == 0.f)
+        {
+          continue;
+        }
+        total += weight;
+        const int32 idx = AddressIndex(src, srcSize, mode);
+        // Merge taps that land on the same pixel after addressing
+        auto it = std::find(taps.Index.begin() + start, taps.Index.end(), idx);
+        if (it != taps.Index.end())
+        {
+          taps.Weight[it - taps.Index.begin()] += weight;
+          continue;
+        }
+        taps.Index.push_back(idx);
+        taps.Weight.push_back(weight);
+      }
+      if (total == 0.f)
+      {
+        taps.Index.resize(start);
+        taps.Weight.resize(start);
+        taps.Index.push_back(std::clamp((int32)center, 0, srcSize - 1));
+        taps.Weight.push_back(1.f);
+        total = 1.f;
+      }
+      for (size_t idx = start; idx < taps.Weight.size(); ++idx)
+      {
+        taps.Weight[idx] /= total;
+      }
+      taps.First.push_back(start);
+      taps.Count.push_back((int32)taps.Index.size() - start);
+    }
+    return taps;
+  }
+
+  // Filter a row of RGBA float pixels
+  void FilterRow(const float* src, float* dst, const Taps& taps)
+  {
+    const int32 dstSize = (int32)taps.First.size();
+    for (int32 x = 0; x < dstSize; ++x)
+    {
+      const int32* index = taps.Index.data() + taps.First[x];
+      const float* weight = taps.Weight.data() + taps.First[x];
+      const int32 count = taps.Count[x];
+#ifdef MIP_GENERATOR_SSE2
+      __m128 acc = _mm_setzero_ps();
+      for (int32 t = 0; t < count; ++t)
+      {
+        acc = _mm_add_ps(acc, _mm_mul_ps(_mm_set1_ps(weight[t]), _mm_loadu_ps(src + index[t] * 4)));
+      }
+      _mm_storeu_ps(dst + x * 4, acc);
+#else
+      float acc[4] = {};
+      for (int32 t = 0; t < count; ++t)
+      {
+        const float* pixel = src + index[t] * 4;
+        for (int32 c = 0; c < 4; ++c)
+        {
+          acc[c] += weight[t] * pixel[c];
+        }
+      }
+      memcpy(dst + x * 4, acc, sizeof(acc));
+#endif
+    }
+  }
+
+  // dst += src * weight
+  void AccumulateRow(const float* src, float weight, float* dst, int32 count)
+  {
+    int32 idx = 0;
+#ifdef MIP_GENERATOR_SSE2
+    const __m128 w = _mm_set1_ps(weight);
+    for (; idx + 4 <= count; idx += 4)
+    {
+      _mm_storeu_ps(dst + idx, _mm_add_ps(_mm_loadu_ps(dst + idx), _mm_mul_ps(w, _mm_loadu_ps(src + idx))));
+    }
+#endif
+    for (; idx < count; ++idx)
+    {
+      dst[idx] += src[idx] * weight;
+    }
+  }
+
+  float SrgbToLinear(float v)
+  {
+    return v <= .04045f ? v / 12.92f : powf((v + .055f) / 1.055f, 2.4f);
+  }
+
+  float LinearToSrgb(float v)
+  {
+    return v <= .0031308f ? v * 12.92f : 1.055f * powf(v, 1.f / 2.4f) - .055f;
+  }
+
+  // 8-bit channel values to float
+  struct ChannelTables {
+    ChannelTables()
+    {
+      for (int32 idx = 0; idx < 256; ++idx)
+      {
+        Linear[idx] = idx / 255.f;
+        Srgb[idx] = SrgbToLinear(Linear[idx]);
+      }
+    }
+
+    float Linear[256];
+    float Srgb[256];
+  };
+
+  inline uint8 ToByte(float v)
+  {
+    return (uint8)(std::clamp(v, 0.f, 1.f) * 255.f + .5f);
+  }
+}
+
+void MipGenerator::Build(const uint8* pixels, int32 sizeX, int32 sizeY, int32 maxLevels, std::vector<Level>& output) const
+{
+  if (!pixels || sizeX <= 0 || sizeY <= 0)
+  {
+    return;
+  }
+  static const ChannelTables tables;
+  const float* colorTable = SRGB ? tables.Srgb : tables.Linear;
+  const FilterDesc filter = GetFilter(Filter);
+
+  // Previous level as RGBA floats. Colors are linear and premultiplied if alpha weighted.
+  // Empty while the source is the 8-bit image.
+  std::vector<float> previous;
+  int32 srcX = sizeX;
+  int32 srcY = sizeY;
+  for (int32 levelIdx = 1; levelIdx < maxLevels && (srcX > 1 || srcY > 1); ++levelIdx)
+  {
+    const int32 dstX = std::max(1, srcX / 2);
+    const int32 dstY = std::max(1, srcY / 2);
+    const bool lastLevel = levelIdx + 1 >= maxLevels || (dstX == 1 && dstY == 1);
+    const Taps tapsX = BuildTaps(srcX, dstX, filter, AddressX);
+    const Taps tapsY = BuildTaps(srcY, dstY, filter, AddressY);
+
+    std::vector<float> next(lastLevel ? 0 : size_t(dstX) * dstY * 4);
+    Level& level = output.emplace_back();
+    level.SizeX = dstX;
+    level.SizeY = dstY;
+    level.Pixels.resize(size_t(dstX) * dstY * 4);
+
+    const int32 bandCount = (dstY + MIP_GENERATOR_BAND_ROWS - 1) / MIP_GENERATOR_BAND_ROWS;
+    concurrency::parallel_for(0, bandCount, [&](int32 band) {
+      const int32 y0 = band * MIP_GENERATOR_BAND_ROWS;
+      const int32 y1 = std::min(dstY, y0 + MIP_GENERATOR_BAND_ROWS);
+      const size_t rowSize = size_t(dstX) * 4;
+
+      // Horizontally filter source rows the band needs
+      std::vector<int32> slots(srcY, -1);
+      int32 slotCount = 0;
+      for (int32 y = y0; y < y1; ++y)
+      {
+        for (int32 t = 0; t < tapsY.Count[y]; ++t)
+        {
+          int32& slot = slots[tapsY.Index[tapsY.First[y] + t]];
+          if (slot < 0)
+          {
+            slot = slotCount++;
+          }
+        }
+      }
+      std::vector<float> rows(slotCount * rowSize);
+      std::vector<float> sourceRow(previous.empty() ? size_t(srcX) * 4 : 0);
+      for (int32 row = 0; row < srcY; ++row)
+      {
+        if (slots[row] < 0)
+        {
+          continue;
+        }
+        const float* src = nullptr;
+        if (previous.empty())
+        {
+          const uint8* bgra = pixels + size_t(srcX) * 4 * row;
+          for (int32 x = 0; x < srcX; ++x, bgra += 4)
+          {
+            float* dst = sourceRow.data() + x * 4;
+            const float alpha = tables.Linear[bgra[3]];
+            const float weight = AlphaWeighted ? alpha : 1.f;
+            dst[0] = colorTable[bgra[2]] * weight;
+            dst[1] = colorTable[bgra[1]] * weight;
+            dst[2] = colorTable[bgra[0]] * weight;
+            dst[3] = alpha;
+          }
+          src = sourceRow.data();
+        }
+        else
+        {
+          src = previous.data() + size_t(srcX) * 4 * row;
+        }
+        FilterRow(src, rows.data() + slots[row] * rowSize, tapsX);
+      }
+
+      // Vertical pass
+      std::vector<float> result(rowSize);
+      for (int32 y = y0; y < y1; ++y)
+      {
+        std::fill(result.begin(), result.end(), 0.f);
+        for (int32 t = 0; t < tapsY.Count[y]; ++t)
+        {
+          const int32 tap = tapsY.First[y] + t;
+          AccumulateRow(rows.data() + slots[tapsY.Index[tap]] * rowSize, tapsY.Weight[tap], result.data(), (int32)rowSize);
+        }
+
+        uint8* dst = level.Pixels.data() + rowSize * y;
+        for (int32 x = 0; x < dstX; ++x, dst += 4)
+        {
+          // Negative lobes may overshoot
+          float* pixel = result.data() + x * 4;
+          pixel[3] = std::clamp(pixel[3], 0.f, 1.f);
+          const float maxColor = AlphaWeighted ? pixel[3] : 1.f;
+          for (int32 c = 0; c < 3; ++c)
+          {
+            pixel[c] = std::clamp(pixel[c], 0.f, maxColor);
+          }
+
+          float color[3] = { pixel[0], pixel[1], pixel[2] };
+          if (AlphaWeighted && pixel[3] > 0.f)
+          {
+            for (float& v : color)
+            {
+              v = std::min(v / pixel[3], 1.f);
+            }
+          }
+          if (Normal)
+          {
+            float n[3] = { color[0] * 2.f - 1.f, color[1] * 2.f - 1.f, color[2] * 2.f - 1.f };
+            const float length = sqrtf(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+            if (length > 0.f)
+            {
+              for (int32 c = 0; c < 3; ++c)
+              {
+                color[c] = n[c] / length * .5f + .5f;
+              }
+            }
+          }
+          if (SRGB)
+          {
+            for (float& v : color)
+            {
+              v = LinearToSrgb(v);
+            }
+          }
+          dst[0] = ToByte(color[2]);
+          dst[1] = ToByte(color[1]);
+          dst[2] = ToByte(color[0]);
+          dst[3] = ToByte(pixel[3]);
+        }
+        if (!lastLevel)
+        {
+          memcpy(next.data() + rowSize * y, result.data(), rowSize * sizeof(float));
+        }
+      }
+    });
+
+    previous.swap(next);
+    srcX = dstX;
+    srcY = dstY;
+  }
+}
@@ -0,0 +1,52 @@
+#pragma once
+#include <Tera/Core.h>
+
+#include <vector>
+
+// Builds mip chains of 8-bit BGRA images.
+// Levels are downsampled with separable filters on float pixels (SSE2 when available). Rows are filtered in parallel.
+// The chain is kept in float, so every level is built from the unquantized previous one.
+class MipGenerator {
+public:
+  struct Level {
+    int32 SizeX = 0;
+    int32 SizeY = 0;
+    // BGRA, top to bottom
+    std::vector<uint8> Pixels;
+  };
+
+  MipGenerator(MipFilterType filter, TextureAddress addressX, TextureAddress addressY)
+    : Filter(filter)
+    , AddressX(addressX)
+    , AddressY(addressY)
+  {}
+
+  // Filter colors in linear space
+  inline void SetSrgb(bool srgb)
+  {
+    SRGB = srgb;
+  }
+
+  // Weight colors by alpha so transparent pixels don't bleed into visible ones
+  inline void SetAlphaWeighted(bool weighted)
+  {
+    AlphaWeighted = weighted;
+  }
+
+  // Renormalize filtered normals
+  inline void SetNormal(bool normal)
+  {
+    Normal = normal;
+  }
+
+  // Append levels below the source image until 1x1 or until the chain has maxLevels levels including the source.
+  void Build(const uint8* pixels, int32 sizeX, int32 sizeY, int32 maxLevels, std::vector<Level>& output) const;
+
+private:
+  MipFilterType Filter = MipFilterType::Kaiser;
+  TextureAddress AddressX = TA_Wrap;
+  TextureAddress AddressY = TA_Wrap;
+  bool SRGB = false;
+  bool AlphaWeighted = false;
+  bool Normal = false;
+};
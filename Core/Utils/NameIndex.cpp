@@ -0,0 +1,288 @@
+#include "NameIndex.h"
+
+#include <algorithm>
+#include <ppl.h>
+
+namespace
+{
+  inline char LowerChar(char ch)
+  {
+    return (ch >= 'A' && ch <= 'Z') ? ch + ('a' - 'A') : ch;
+  }
+
+  inline uint32 MakeTrigram(const char* ptr)
+  {
+    return ((uint32)(uint8)LowerChar(ptr[0]) << 16) | ((uint32)(uint8)LowerChar(ptr[1]) << 8) | (uint32)(uint8)LowerChar(ptr[2]);
+  }
+
+  inline std::string ToLower(const std::string& str)
+  {
+    std::string result(str);
+    for (char& ch : result)
+    {
+      ch = LowerChar(ch);
+    }
+    return result;
+  }
+
+  enum MatchScore : uint32 {
+    ScoreExact = 4000,
+    ScorePrefix = 3000,
+    ScoreSubstring = 2000,
+    ScoreFuzzy = 1000,
+  };
+}
+
+void NameIndex::Build(const std::vector<std::string>& names)
+{
+  Clear();
+  size_t total = 0;
+  for (const std::string& name : names)
+  {
+    total += name.size();
+  }
+  Blob.reserve(total);
+  Offsets.reserve(names.size() + 1);
+  Offsets.push_back(0);
+  for (const std::string& name : names)
+  {
+    Blob.insert(Blob.end(), name.begin(), name.end());
+    Offsets.push_back((uint32)Blob.size());
+  }
+
+  const uint32 count = Size();
+  Sorted.resize(count);
+  for (uint32 idx = 0; idx < count; ++idx)
+  {
+    Sorted[idx] = idx;
+  }
+  concurrency::parallel_sort(Sorted.begin(), Sorted.end(), [this](uint32 a, uint32 b) {
+    const char* pa = &Blob[0] + Offsets[a];
+    const char* pb = &Blob[0] + Offsets[b];
+    const uint32 la = Offsets[a + 1] - Offsets[a];
+    const uint32 lb = Offsets[b + 1] - Offsets[b];
+    const uint32 len = std::min(la, lb);
+    for (uint32 i = 0; i < len; ++i)
+    {
+      const char ca = LowerChar(pa[i]);
+      const char cb = LowerChar(pb[i]);
+      if (ca != cb)
+      {
+        return (uint8)ca < (uint8)cb;
+      }
+    }
+    return la < lb;
+  });
+
+  // Collect (trigram, name) pairs, sort them and pack into a CSR table.
+  std::vector<uint64> pairs;
+  pairs.reserve(total);
+  for (uint32 idx = 0; idx < count; ++idx)
+  {
+    const uint32 len = Offsets[idx + 1] - Offsets[idx];
+    for (uint32 pos = 0; pos + 3 <= len; ++pos)
+    {
+      pairs.push_back(((uint64)MakeTrigram(&Blob[Offsets[idx] + pos]) << 32) | idx);
+    }
+  }
+  concurrency::parallel_sort(pairs.begin(), pairs.end());
+  pairs.erase(std::unique(pairs.begin(), pairs.end()), pairs.end());
+
+  TrigramPostings.resize(pairs.size());
+  for (size_t idx = 0; idx < pairs.size(); ++idx)
+  {
+    const uint32 trigram = (uint32)(pairs[idx] >> 32);
+    if (Trigrams.empty() || Trigrams.back() != trigram)
+    {
+      Trigrams.push_back(trigram);
+      TrigramOffsets.push_back((uint32)idx);
+    }
+    TrigramPostings[idx] = (uint32)pairs[idx];
+  }
+  TrigramOffsets.push_back((uint32)TrigramPostings.size());
+  Hits.assign(count, 0);
+}
+
+void NameIndex::Clear()
+{
+  Blob.clear();
+  Offsets.clear();
+  Sorted.clear();
+  Trigrams.clear();
+  TrigramOffsets.clear();
+  TrigramPostings.clear();
+  Hits.clear();
+}
+
+int32 NameIndex::Compare(uint32 index, const std::string& query, bool prefixOnly) const
+{
+  const char* ptr = &Blob[0] + Offsets[index];
+  const size_t len = Offsets[index + 1] - Offsets[index];
+  const size_t cmpLen = std::min(len, query.size());
+  for (size_t i = 0; i < cmpLen; ++i)
+  {
+    const char ch = LowerChar(ptr[i]);
+    if (ch != query[i])
+    {
+      return (uint8)ch < (uint8)query[i] ? -1 : 1;
+    }
+  }
+  if (len < query.size())
+  {
+    return -1;
+  }
+  return (prefixOnly || len == query.size()) ? 0 : 1;
+}
+
+size_t NameIndex::FindSubstring(uint32 index, const std::string& query) const
+{
+  const char* ptr = &Blob[0] + Offsets[index];
+  const size_t len = Offsets[index + 1] - Offsets[index];
+  if (query.size() > len)
+  {
+    return std::string::npos;
+  }
+  for (size_t pos = 0; pos + query.size() <= len; ++pos)
+  {
+    size_t i = 0;
+    for (; i < query.size() && LowerChar(ptr[pos + i]) == query[i]; ++i);
+    if (i == query.size())
+    {
+      return pos;
+    }
+  }
+  return std::string::npos;
+}
+
+void NameIndex::GetPrefixRange(const std::string& query, uint32& outStart, uint32& outEnd) const
+{
+  auto lo = std::lower_bound(Sorted.begin(), Sorted.end(), query, [this](uint32 idx, const std::string& q) {
+    return Compare(idx, q, true) < 0;
+  });
+  auto hi = std::upper_bound(lo, Sorted.end(), query, [this](const std::string& q, uint32 idx) {
+    return Compare(idx, q, true) > 0;
+  });
+  outStart = (uint32)(lo - Sorted.begin());
+  outEnd = (uint32)(hi - Sorted.begin());
+}
+
+int32 NameIndex::Find(const std::string& name) const
+{
+  if (Empty() || name.empty())
+  {
+    return INDEX_NONE;
+  }
+  const std::string query = ToLower(name);
+  auto it = std::lower_bound(Sorted.begin(), Sorted.end(), query, [this](uint32 idx, const std::string& q) {
+    return Compare(idx, q, false) < 0;
+  });
+  if (it != Sorted.end() && !Compare(*it, query, false))
+  {
+    return (int32)*it;
+  }
+  return INDEX_NONE;
+}
+
+std::vector<uint32> NameIndex::Complete(const std::string& input, uint32 maxResults) const
+{
+  std::vector<uint32> result;
+  if (Empty() || input.empty() || !maxResults)
+  {
+    return result;
+  }
+  const std::string query = ToLower(input);
+  struct Candidate {
+    uint32 Index = 0;
+    uint32 Score = 0;
+  };
+  std::vector<Candidate> candidates;
+
+  if (query.size() < 3)
+  {
+    // Too short for trigrams. Sorted range is enough.
+    uint32 start = 0, end = 0;
+    GetPrefixRange(query, start, end);
+    candidates.reserve(end - start);
+    for (uint32 pos = start; pos < end; ++pos)
+    {
+      const uint32 idx = Sorted[pos];
+      const uint32 len = Offsets[idx + 1] - Offsets[idx];
+      candidates.push_back({ idx, len == query.size() ? ScoreExact : ScorePrefix - std::min<uint32>(len - (uint32)query.size(), 999) });
+    }
+  }
+  else
+  {
+    // Intersect trigram postings by counting hits per name
+    std::vector<uint32> queryTrigrams;
+    for (size_t pos = 0; pos + 3 <= query.size(); ++pos)
+    {
+      queryTrigrams.push_back(MakeTrigram(&query[pos]));
+    }
+    std::sort(queryTrigrams.begin(), queryTrigrams.end());
+    queryTrigrams.erase(std::unique(queryTrigrams.begin(), queryTrigrams.end()), queryTrigrams.end());
+
+    const uint32 total = (uint32)queryTrigrams.size();
+    const uint32 minHits = std::max<uint32>(1, (total + 1) / 2);
+    std::scoped_lock<std::mutex> lock(HitsMutex);
+    std::vector<uint16>& hits = Hits;
+    std::vector<uint32> touched;
+    for (uint32 trigram : queryTrigrams)
+    {
+      auto it = std::lower_bound(Trigrams.begin(), Trigrams.end(), trigram);
+      if (it == Trigrams.end() || *it != trigram)
+      {
+        continue;
+      }
+      const size_t slot = it - Trigrams.begin();
+      for (uint32 pos = TrigramOffsets[slot]; pos < TrigramOffsets[slot + 1]; ++pos)
+      {
+        const uint32 idx = TrigramPostings[pos];
+        if (!hits[idx]++)
+        {
+          touched.push_back(idx);
+        }
+      }
+    }
+
+    for (uint32 idx : touched)
+    {
+      const uint32 count = hits[idx];
+      hits[idx] = 0;
+      if (count < minHits)
+      {
+        continue;
+      }
+      const uint32 len = Offsets[idx + 1] - Offsets[idx];
+      size_t pos = count == total ? FindSubstring(idx, query) : std::string::npos;
+      if (pos == 0)
+      {
+        candidates.push_back({ idx, len == query.size() ? ScoreExact : ScorePrefix - std::min<uint32>(len - (uint32)query.size(), 999) });
+      }
+      else if (pos != std::string::npos)
+      {
+        candidates.push_back({ idx, ScoreSubstring - std::min<uint32>((uint32)pos, 499) });
+      }
+      else
+      {
+        candidates.push_back({ idx, ScoreFuzzy + (count * 499) / total });
+      }
+    }
+  }
+
+  const size_t resultCount = std::min<size_t>(maxResults, candidates.size());
+  std::partial_sort(candidates.begin(), candidates.begin() + resultCount, candidates.end(), [this](const Candidate& a, const Candidate& b) {
+    if (a.Score != b.Score)
+    {
+      return a.Score > b.Score;
+    }
+    const uint32 la = Offsets[a.Index + 1] - Offsets[a.Index];
+    const uint32 lb = Offsets[b.Index + 1] - Offsets[b.Index];
+    return la != lb ? la < lb : a.Index < b.Index;
+  });
+  result.reserve(resultCount);
+  for (size_t idx = 0; idx < resultCount; ++idx)
+  {
+    result.push_back(candidates[idx].Index);
+  }
+  return result;
+}
@@ -0,0 +1,69 @@
+#pragma once
+#include <Tera/Core.h>
+
+#include <mutex>
+
+// Case-insensitive lookup and completion over a fixed list of names.
+// Names are stored in a single character blob. A sorted permutation answers
+// exact and prefix queries, a compact trigram table answers substring and fuzzy ones.
+class NameIndex {
+public:
+  NameIndex() = default;
+  NameIndex(const NameIndex&) = delete;
+  NameIndex& operator=(const NameIndex&) = delete;
+
+  // Rebuild the index. Not thread safe with Find/Complete.
+  void Build(const std::vector<std::string>& names);
+
+  void Clear();
+
+  inline bool Empty() const
+  {
+    return Offsets.size() < 2;
+  }
+
+  inline uint32 Size() const
+  {
+    return Offsets.size() ? (uint32)Offsets.size() - 1 : 0;
+  }
+
+  // Get the original name by its index
+  inline std::string GetName(uint32 index) const
+  {
+    return std::string(&Blob[Offsets[index]], Offsets[index + 1] - Offsets[index]);
+  }
+
+  // Exact case-insensitive lookup. Returns INDEX_NONE if the name is not in the index.
+  int32 Find(const std::string& name) const;
+
+  // Ranked completions for the query: exact match, prefix matches, substring matches and
+  // names that share most of the query's trigrams. Returns name indices.
+  std::vector<uint32> Complete(const std::string& query, uint32 maxResults) const;
+
+private:
+  // Compare the name at index with the query. Returns <0, 0 or >0. Only first query.size() chars are compared if prefixOnly is set
+  int32 Compare(uint32 index, const std::string& query, bool prefixOnly) const;
+
+  // Position of the lowered query inside the name or npos
+  size_t FindSubstring(uint32 index, const std::string& query) const;
+
+  // Find the range in Sorted containing names starting with the query
+  void GetPrefixRange(const std::string& query, uint32& outStart, uint32& outEnd) const;
+
+private:
+  // All names one after another
+  std::vector<char> Blob;
+  // Name i occupies [Offsets[i], Offsets[i + 1]) of the Blob
+  std::vector<uint32> Offsets;
+  // Name indices sorted case-insensitively
+  std::vector<uint32> Sorted;
+  // Sorted unique trigram keys
+  std::vector<uint32> Trigrams;
+  // Postings of Trigrams[i] are [TrigramOffsets[i], TrigramOffsets[i + 1]) of the TrigramPostings
+  std::vector<uint32> TrigramOffsets;
+  std::vector<uint32> TrigramPostings;
+
+  // Trigram hits per name. Reused by Complete and zeroed after each query.
+  mutable std::vector<uint16> Hits;
+  mutable std::mutex HitsMutex;
+};
@@ -0,0 +1,311 @@
+#include "SoundDecoder.h"
+#include "ContentHash.h"
+#include <Tera/USoundNode.h>
+
+#include <vorbis/vorbisfile.h>
+
+#include <algorithm>
+#include <cmath>
+#include <list>
+#include <mutex>
+#include <unordered_map>
+
+static size_t OggRead(void* ptr, size_t size, size_t nmemb, void* datasource)
+{
+  SoundDecoder* decoder = (SoundDecoder*)datasource;
+  return decoder->ReadData(ptr, size * nmemb);
+}
+
+static int OggSeek(void* datasource, ogg_int64_t offset, int whence)
+{
+  SoundDecoder* decoder = (SoundDecoder*)datasource;
+  return decoder->SeekData(offset, whence);
+}
+
+static int OggClose(void* datasource)
+{
+  return 0;
+}
+
+static long OggTell(void* datasource)
+{
+  SoundDecoder* decoder = (SoundDecoder*)datasource;
+  return decoder->TellData();
+}
+
+SoundDecoder::~SoundDecoder()
+{
+  Close();
+}
+
+bool SoundDecoder::Open(const void* data, size_t size)
+{
+  Close();
+  if (!data || !size)
+  {
+    Error = "OGG file is empty or corrupted!";
+    return false;
+  }
+  Data = (const uint8*)data;
+  DataSize = size;
+  DataOffset = 0;
+
+  ov_callbacks cb;
+  cb.read_func = OggRead;
+  cb.seek_func = OggSeek;
+  cb.close_func = OggClose;
+  cb.tell_func = OggTell;
+
+  File = new OggVorbis_File();
+  if (ov_open_callbacks(this, File, nullptr, 0, cb) < 0)
+  {
+    // ov_open_callbacks clears the file on failure
+    delete File;
+    File = nullptr;
+    Error = "Not a valid OGG file!";
+    return false;
+  }
+
+  vorbis_info* vi = ov_info(File, -1);
+  if (!vi || vi->channels <= 0)
+  {
+    Close();
+    Error = "Not a valid OGG file!";
+    return false;
+  }
+  NumChannels = (uint32)vi->channels;
+  SampleRate = (uint32)vi->rate;
+  ogg_int64_t frames = ov_pcm_total(File, -1);
+  NumFrames = frames > 0 ? (uint64)frames : 0;
+  Duration = (float)ov_time_total(File, -1);
+  Ring.resize(RingFrames * NumChannels);
+  return true;
+}
+
+void SoundDecoder::Close()
+{
+  if (File)
+  {
+    ov_clear(File);
+    delete File;
+    File = nullptr;
+  }
+  Data = nullptr;
+  DataSize = 0;
+  DataOffset = 0;
+  NumChannels = 0;
+  SampleRate = 0;
+  NumFrames = 0;
+  Duration = 0.f;
+  Error.clear();
+  Ring.clear();
+  RingHead = 0;
+  RingCount = 0;
+  EndOfStream = false;
+}
+
+size_t SoundDecoder::Read(float* dst, size_t frames)
+{
+  size_t total = 0;
+  while (File && total < frames)
+  {
+    if (!RingCount)
+    {
+      FillRing();
+      if (!RingCount)
+      {
+        break;
+      }
+    }
+    const size_t count = std::min({ frames - total, RingCount, RingFrames - RingHead });
+    memcpy(dst + total * NumChannels, Ring.data() + RingHead * NumChannels, count * NumChannels * sizeof(float));
+    RingHead = (RingHead + count) % RingFrames;
+    RingCount -= count;
+    total += count;
+  }
+  return total;
+}
+
+bool SoundDecoder::Seek(double seconds)
+{
+  if (!File || ov_time_seek(File, seconds))
+  {
+    return false;
+  }
+  RingHead = 0;
+  RingCount = 0;
+  EndOfStream = false;
+  return true;
+}
+
+void SoundDecoder::FillRing()
+{
+  while (!EndOfStream && RingCount < RingFrames)
+  {
+    // Contiguous free space after the tail
+    const size_t tail = (RingHead + RingCount) % RingFrames;
+    const size_t space = std::min(RingFrames - RingCount, RingFrames - tail);
+    float** pcm = nullptr;
+    int section = 0;
+    long frames = ov_read_float(File, &pcm, (int)space, &section);
+    if (frames == OV_HOLE)
+    {
+      // Recoverable gap in the data
+      continue;
+    }
+    if (frames <= 0)
+    {
+      if (frames < 0)
+      {
+        Error = "The OGG stream is corrupted!";
+      }
+      EndOfStream = true;
+      break;
+    }
+    vorbis_info* vi = ov_info(File, section);
+    if (!vi || (uint32)vi->channels != NumChannels)
+    {
+      Error = "Chained OGG streams with different channel counts are not supported!";
+      EndOfStream = true;
+      break;
+    }
+    float* out = Ring.data() + tail * NumChannels;
+    for (long frame = 0; frame < frames; ++frame)
+    {
+      for (uint32 channel = 0; channel < NumChannels; ++channel)
+      {
+        *out++ = pcm[channel][frame];
+      }
+    }
+    RingCount += (size_t)frames;
+  }
+}
+
+size_t SoundDecoder::ReadData(void* ptr, size_t size)
+{
+  const size_t sizeToRead = std::min<size_t>(size, DataSize - DataOffset);
+  memcpy(ptr, Data + DataOffset, sizeToRead);
+  DataOffset += sizeToRead;
+  return sizeToRead;
+}
+
+int32 SoundDecoder::SeekData(int64 offset, int whence)
+{
+  int64 position = 0;
+  switch (whence)
+  {
+  case SEEK_SET:
+    position = offset;
+    break;
+  case SEEK_CUR:
+    position = (int64)DataOffset + offset;
+    break;
+  case SEEK_END:
+    position = (int64)DataSize + offset;
+    break;
+  default:
+    return -1;
+  }
+  if (position < 0 || position > (int64)DataSize)
+  {
+    return -1;
+  }
+  DataOffset = (size_t)position;
+  return 0;
+}
+
+long SoundDecoder::TellData() const
+{
+  return (long)DataOffset;
+}
+
+SoundSummary SoundDecoder::Summarize(const void* data, size_t size, uint32 buckets)
+{
+  SoundSummary summary;
+  SoundDecoder decoder;
+  if (!decoder.Open(data, size))
+  {
+    summary.Error = decoder.GetError();
+    return summary;
+  }
+  summary.NumChannels = decoder.GetNumChannels();
+  summary.SampleRate = decoder.GetSampleRate();
+  summary.Duration = decoder.GetDuration();
+  summary.Waveform.resize(buckets);
+
+  const uint64 expectedFrames = std::max<uint64>(decoder.GetNumFrames(), 1);
+  const uint32 channels = summary.NumChannels;
+  std::vector<float> block(1024 * channels);
+  double sumSquares = 0.;
+  uint64 position = 0;
+  while (size_t frames = decoder.Read(block.data(), 1024))
+  {
+    const float* sample = block.data();
+    for (size_t frame = 0; frame < frames; ++frame, ++position)
+    {
+      float framePeak = 0.f;
+      for (uint32 channel = 0; channel < channels; ++channel, ++sample)
+      {
+        framePeak = std::max(framePeak, std::abs(*sample));
+        sumSquares += (double)*sample * *sample;
+      }
+      if (buckets)
+      {
+        float& bucket = summary.Waveform[std::min<uint64>(position * buckets / expectedFrames, buckets - 1)];
+        bucket = std::max(bucket, framePeak);
+      }
+      summary.Peak = std::max(summary.Peak, framePeak);
+    }
+  }
+  if (decoder.GetError().size())
+  {
+    summary.Error = decoder.GetError();
+  }
+  summary.NumFrames = position;
+  summary.Rms = position ? (float)std::sqrt(sumSquares / ((double)position * channels)) : 0.f;
+  return summary;
+}
+
+std::shared_ptr<const SoundSummary> SoundDecoder::GetSummary(const USoundNodeWave* wave)
+{
+  return GetSummary(wave->GetResourceData(), wave->GetResourceSize());
+}
+
+std::shared_ptr<const SoundSummary> SoundDecoder::GetSummary(const void* data, size_t size)
+{
+  struct CacheEntry {
+    std::shared_ptr<const SoundSummary> Summary;
+    std::list<FContentHash>::iterator Use;
+  };
+  static std::mutex cacheMutex;
+  static std::unordered_map<FContentHash, CacheEntry> cache;
+  // Most recently used first
+  static std::list<FContentHash> uses;
+
+  const FContentHash hash = ContentHasher::Hash(data, data ? size : 0);
+  {
+    std::scoped_lock<std::mutex> lock(cacheMutex);
+    auto it = cache.find(hash);
+    if (it != cache.end())
+    {
+      uses.splice(uses.begin(), uses, it->second.Use);
+      return it->second.Summary;
+    }
+  }
+  // Decode without the lock. Two threads may decode the same sound, the first result is kept.
+  auto summary = std::make_shared<const SoundSummary>(Summarize(data, size));
+  std::scoped_lock<std::mutex> lock(cacheMutex);
+  auto [it, added] = cache.try_emplace(hash);
+  if (!added)
+  {
+    return it->second.Summary;
+  }
+  uses.push_front(hash);
+  it->second = { summary, uses.begin() };
+  if (cache.size() > SOUND_SUMMARY_CACHE_SIZE)
+  {
+    cache.erase(uses.back());
+    uses.pop_back();
+  }
+  return summary;
+}
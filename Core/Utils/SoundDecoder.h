@@ -0,0 +1,120 @@
+#pragma once
+#include <Tera/Core.h>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+class USoundNodeWave;
+struct OggVorbis_File;
+
+// Number of buckets in a waveform summary
+#define SOUND_WAVEFORM_BUCKETS 256
+// Max number of cached summaries. The least recently used ones are dropped.
+#define SOUND_SUMMARY_CACHE_SIZE 4096
+
+struct SoundSummary {
+  uint32 NumChannels = 0;
+  uint32 SampleRate = 0;
+  uint64 NumFrames = 0;
+  float Duration = 0.f;
+  // Linear, 1 is full scale. All channels.
+  float Peak = 0.f;
+  float Rms = 0.f;
+  // Peak of each bucket of frames. Buckets split the sound evenly.
+  std::vector<float> Waveform;
+  std::string Error;
+
+  bool IsValid() const
+  {
+    return Error.empty();
+  }
+};
+
+// Streams interleaved float samples from Ogg Vorbis data in memory. The data is read in place, so it must outlive the
+// decoder. Decoded samples go through a ring buffer of RingFrames, so memory use doesn't depend on the sound length.
+class SoundDecoder {
+public:
+  static constexpr size_t RingFrames = 4096;
+
+  SoundDecoder() = default;
+  ~SoundDecoder();
+
+  SoundDecoder(const SoundDecoder&) = delete;
+  SoundDecoder& operator=(const SoundDecoder&) = delete;
+
+  // Read the headers only. Nothing is decoded until Read.
+  bool Open(const void* data, size_t size);
+  void Close();
+
+  bool IsOpen() const
+  {
+    return File != nullptr;
+  }
+
+  uint32 GetNumChannels() const
+  {
+    return NumChannels;
+  }
+
+  uint32 GetSampleRate() const
+  {
+    return SampleRate;
+  }
+
+  // Zero if the stream is not seekable
+  uint64 GetNumFrames() const
+  {
+    return NumFrames;
+  }
+
+  float GetDuration() const
+  {
+    return Duration;
+  }
+
+  std::string GetError() const
+  {
+    return Error;
+  }
+
+  // Read up to frames * GetNumChannels() samples. Returns the number of frames read, zero at the end or on error.
+  size_t Read(float* dst, size_t frames);
+
+  bool Seek(double seconds);
+
+  // Decode the whole sound through the ring buffer
+  static SoundSummary Summarize(const void* data, size_t size, uint32 buckets = SOUND_WAVEFORM_BUCKETS);
+
+  // Summary of the wave's PC data. Summaries are cached by the content hash of the data, so the same sound is decoded
+  // once even if it is stored in several packages.
+  static std::shared_ptr<const SoundSummary> GetSummary(const USoundNodeWave* wave);
+  static std::shared_ptr<const SoundSummary> GetSummary(const void* data, size_t size);
+
+  // Data source callbacks
+  size_t ReadData(void* ptr, size_t size);
+  int32 SeekData(int64 offset, int whence);
+  long TellData() const;
+
+private:
+  // Decode until the ring is full or the stream ends
+  void FillRing();
+
+private:
+  OggVorbis_File* File = nullptr;
+  const uint8* Data = nullptr;
+  size_t DataSize = 0;
+  size_t DataOffset = 0;
+
+  uint32 NumChannels = 0;
+  uint32 SampleRate = 0;
+  uint64 NumFrames = 0;
+  float Duration = 0.f;
+  std::string Error;
+
+  // Interleaved samples
+  std::vector<float> Ring;
+  size_t RingHead = 0;
+  size_t RingCount = 0;
+  bool EndOfStream = false;
+};
@@ -26,10 +26,6 @@ public:
 
   bool Visit(USoundNodeWave* wave);
 
-  size_t ReadOgg(void* ptr, uint32 size);
-  int32 SeekOgg(uint64 offset, int whence);
-  uint32 TellOgg();
-
 private:
   struct FSoundInfo
   {
@@ -44,5 +40,4 @@ private:
   std::string Error;
   void* Data = nullptr;
   FILE_OFFSET DataSize = 0;
-  FILE_OFFSET DataOffset = 0;;
 };
\ No newline at end of file
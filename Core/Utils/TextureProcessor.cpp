@@ -8,8 +8,12 @@
 
 #include <ppl.h>
 #include <algorithm>
+#include <atomic>
+#include <mutex>
 
+#include "BCDecoder.h"
 #include "DDS.h"
+#include "MipGenerator.h"
 
 // freeimage raii container
 struct FreeImageHolder {
@@ -18,7 +22,9 @@ struct FreeImageHolder {
   {
     if (ctx)
     {
-      FreeImage_Initialise();
+      // Initialize the library once per process. Per-use init/deinit is not safe when several processors run concurrently.
+      static std::once_flag flag;
+      std::call_once(flag, [] { FreeImage_Initialise(); });
     }
   }
 
@@ -30,123 +36,65 @@ struct FreeImageHolder {
   {
     FreeImage_Unload(bmp);
     FreeImage_CloseMemory(mem);
-    if (ctx)
-    {
-      FreeImage_DeInitialise();
-    }
   }
 };
 
-// nvtt handler
-struct TPOutputHandler : public nvtt::OutputHandler {
-  static const int32 MaxMipCount = 16;
+// Max number of mips FileToBytes generates
+#define TP_MAX_MIP_COUNT 16
+// Rows of a mip encoded by a single task. Must be a multiple of the block height.
+#define TP_TILE_ROWS 64
 
-  struct Mip {
-    int32 SizeX = 0;
-    int32 SizeY = 0;
-
-    int32 Size = 0;
-    int32 LastOffset = 0;
-    void* Data = nullptr;
-  };
-
-  ~TPOutputHandler() override
-  {
-    for (int32 idx = 0; idx < MaxMipCount; ++idx)
-    {
-      free(Mips[idx].Data);
-    }
-  }
+// nvtt handler that writes a tile straight to its place in the output buffer
+struct TPTileOutputHandler : public nvtt::OutputHandler {
+  TPTileOutputHandler(uint8* dst, int32 size)
+    : Dst(dst)
+    , Size(size)
+  {}
 
   void beginImage(int size, int width, int height, int depth, int face, int miplevel) override
   {
-    if (miplevel >= MaxMipCount || !Ok)
-    {
-      Ok = false;
-      return;
-    }
-    Mip& mip = Mips[MipsCount];
-    mip.Size = size;
-    mip.SizeX = width;
-    mip.SizeY = height;
-    if (size)
-    {
-      mip.Data = malloc(size);
-    }
     DBreakIf(depth != 1);
-    MipsCount++;
+    Started = true;
   }
 
   bool writeData(const void* data, int size) override
   {
-    if (!Ok || !MipsCount || !data)
+    // Skip anything written outside of the image (e.g. a header)
+    if (!Started || !data)
     {
       return Ok;
     }
-    Mip& mip = Mips[MipsCount - 1];
-    if (mip.LastOffset + size > mip.Size)
-    {
-      if (mip.Size)
-      {
-        if (void* tmp = realloc(mip.Data, mip.LastOffset + size))
-        {
-          mip.Size = mip.LastOffset + size;
-          mip.Data = tmp;
-        }
-        else
-        {
-          Ok = false;
-        }
-      }
-      else
-      {
-        mip.Data = malloc(size);
-        mip.Size = size;
-      }
-    }
-    if (Ok && mip.Data)
+    if (!Ok || Offset + size > Size)
     {
-      void* dst = (uint8*)mip.Data + mip.LastOffset;
-      memcpy(dst, data, size);
-      mip.LastOffset += size;
+      Ok = false;
+      return false;
     }
-    return Ok;
+    memcpy(Dst + Offset, data, size);
+    Offset += size;
+    return true;
   }
 
   void endImage() override
   {}
 
-  Mip Mips[MaxMipCount];
-  int32 MipsCount = 0;
+  uint8* Dst = nullptr;
+  int32 Size = 0;
+  int32 Offset = 0;
+  bool Started = false;
   bool Ok = true;
 };
 
-nvtt::MipmapFilter MipFilterTypeToNvtt(MipFilterType type)
-{
-  switch (type)
-  {
-  case MipFilterType::Box:
-    return nvtt::MipmapFilter_Box;
-  case MipFilterType::Triangle:
-    return nvtt::MipmapFilter_Triangle;
-  case MipFilterType::Kaiser:
-  default:
-    return nvtt::MipmapFilter_Kaiser;
-  }
-}
-
-nvtt::WrapMode AddressModeToNvtt(TextureAddress mode)
+nvtt::Quality QualityToNvtt(TextureProcessor::TCQuality quality)
 {
-  switch (mode)
+  switch (quality)
   {
-  case TA_Clamp:
-    return nvtt::WrapMode_Clamp;
-  case TA_Mirror:
-    return nvtt::WrapMode_Mirror;
-  case TA_Wrap:
+  case TextureProcessor::TCQuality::Fast:
+    return nvtt::Quality_Fastest;
+  case TextureProcessor::TCQuality::Normal:
+    return nvtt::Quality_Normal;
+  case TextureProcessor::TCQuality::Production:
   default:
-    return nvtt::WrapMode_Repeat;
-    break;
+    return nvtt::Quality_Production;
   }
 }
 
@@ -162,7 +110,7 @@ bool TextureProcessor::Process()
     
     if (OutputPath.empty())
     {
-      if (!OutputData || !OutputDataSize)
+      if (OutputMips.empty())
       {
         Error = "Texture Processor: no output specified";
         return false;
@@ -181,65 +129,65 @@ bool TextureProcessor::Process()
 
 bool TextureProcessor::BytesToFile()
 {
-  nvtt::Surface surface;
-  bool hasAlpha = true;
   if (OutputFormat == TCFormat::DDS)
   {
     return BytesToDDS();
   }
-  if (!HasAVX2())
+  if (InputDataSizeX <= 0 || InputDataSizeY <= 0)
   {
-    Error = "Texture Processor: Your CPU does not support AVX2 instructions. Please, use DDS format to export the texture.";
+    Error = "Texture Processor: invalid input dimensions";
     return false;
   }
+
+  // Input is decoded in-house so there is no NVTT roundtrip and no AVX2 requirement
+  FreeImageHolder holder(true);
+  int bits = 32;
   if (InputFormat == TCFormat::DXT1 || InputFormat == TCFormat::DXT3 || InputFormat == TCFormat::DXT5)
   {
-    nvtt::Format fmt = nvtt::Format_Count;
-    if (InputFormat == TCFormat::DXT1)
-    {
-      fmt = nvtt::Format_DXT1;
-      hasAlpha = false;
-    }
-    else if (InputFormat == TCFormat::DXT3)
+    BCDecoder::Format fmt = BCDecoder::Format::DXT1;
+    if (InputFormat == TCFormat::DXT3)
     {
-      fmt = nvtt::Format_DXT3;
+      fmt = BCDecoder::Format::DXT3;
     }
     else if (InputFormat == TCFormat::DXT5)
     {
-      fmt = nvtt::Format_DXT5;
+      fmt = BCDecoder::Format::DXT5;
     }
-    LogI("Texture Processor: Setting surface image");
-    if (!surface.setImage2D(fmt, nvtt::Decoder_D3D9, InputDataSizeX, InputDataSizeY, InputData))
+    LogI("Texture Processor: Decompress DXT data");
+    holder.bmp = FreeImage_Allocate(InputDataSizeX, InputDataSizeY, 32);
+    if (!holder.bmp || !BCDecoder::Decode(fmt, InputData, InputDataSize, InputDataSizeX, InputDataSizeY, FreeImage_GetBits(holder.bmp), FreeImage_GetPitch(holder.bmp)))
     {
-      Error = "Texture Processor: failed to create input surface (";
-      Error += "DXT1:" + std::to_string(InputDataSizeX) + "x" + std::to_string(InputDataSizeY) + ")";
+      Error = "Texture Processor: failed to decompress the texture (";
+      Error += "DXT:" + std::to_string(InputDataSizeX) + "x" + std::to_string(InputDataSizeY) + ")";
       return false;
     }
+    FreeImage_FlipVertical(holder.bmp);
+    if (InputFormat == TCFormat::DXT1)
+    {
+      // DXT1 textures are exported without alpha
+      bits = 24;
+      FIBITMAP* rgb = FreeImage_ConvertTo24Bits(holder.bmp);
+      FreeImage_Unload(holder.bmp);
+      holder.bmp = rgb;
+    }
   }
   else if (InputFormat == TCFormat::ARGB8)
   {
-    if (!surface.setImage(nvtt::InputFormat_BGRA_8UB, InputDataSizeX, InputDataSizeY, 1, InputData))
+    const size_t rowSize = size_t(InputDataSizeX) * 4;
+    if (size_t(InputDataSize) < rowSize * InputDataSizeY)
     {
       Error = "Texture Processor: failed to create input surface (";
       Error += "ARGB8:" + std::to_string(InputDataSizeX) + "x" + std::to_string(InputDataSizeY) + ")";
       return false;
     }
+    holder.bmp = FreeImage_Allocate(InputDataSizeX, InputDataSizeY, 32);
+    // FreeImage rows go bottom to top
+    for (int32 y = 0; y < InputDataSizeY; ++y)
+    {
+      memcpy(FreeImage_GetScanLine(holder.bmp, InputDataSizeY - 1 - y), (const uint8*)InputData + rowSize * y, rowSize);
+    }
   }
   else if (InputFormat == TCFormat::G8)
-  {
-    hasAlpha = false;
-    // Don't use nvtt for G8. Feed InputData directly to the FreeImage
-  }
-  else
-  {
-    Error = "Texture Processor: unsupported input " + std::to_string((int)InputFormat);
-    return false;
-  }
-
-
-  FreeImageHolder holder(true);
-  int bits = hasAlpha ? 32 : 24;
-  if (InputFormat == TCFormat::G8)
   {
     bits = 8;
     holder.bmp = FreeImage_Allocate(InputDataSizeX, InputDataSizeY, bits);
@@ -248,53 +196,14 @@ bool TextureProcessor::BytesToFile()
   }
   else
   {
-    if (surface.isNull() || !surface.width() || !surface.height())
-    {
-      Error = "Texture Processor: NVTT failed to create the surface!";
-      return false;
-    }
-
-    surface.flipY();
-    nvtt::CompressionOptions compressionOptions;
-    compressionOptions.setFormat(hasAlpha ? nvtt::Format_RGBA : nvtt::Format_RGB);
-    compressionOptions.setPixelFormat(hasAlpha ? 32 : 24, 0xFF0000, 0xFF00, 0xFF, hasAlpha ? 0xFF000000 : 0);
-
-    nvtt::OutputOptions outputOptions;
-    TPOutputHandler ohandler;
-    outputOptions.setSrgbFlag(SRGB);
-    outputOptions.setOutputHandler(&ohandler);
-
-    LogI("Texture Processor: Decompress DXT data");
-    nvtt::Context ctx;
-
-    try
-    {
-      if (!ctx.compress(surface, 0, 0, compressionOptions, outputOptions))
-      {
-        Error = "Texture Processor: Failed to decompress texture to RGBA!";
-        return false;
-      }
-    }
-    catch (...)
-    {
-      Error = "Texture Processor: NVTT failed to decompress texture to RGBA!";
-      return false;
-    }
-
-    if (!ohandler.MipsCount)
-    {
-      Error = "Texture Processor: Failed to decompress DXT texture to RGBA!";
-      return false;
-    }
-
-    if (!ohandler.Mips[0].Size)
-    {
-      Error = "Texture Processor: NVTT failed to decompress the texture!";
-      return false;
-    }
+    Error = "Texture Processor: unsupported input " + std::to_string((int)InputFormat);
+    return false;
+  }
 
-    holder.bmp = FreeImage_Allocate(ohandler.Mips[0].SizeX, ohandler.Mips[0].SizeY, bits);
-    memcpy(FreeImage_GetBits(holder.bmp), ohandler.Mips[0].Data, ohandler.Mips[0].Size);
+  if (!holder.bmp)
+  {
+    Error = "Texture Processor: failed to allocate the image!";
+    return false;
   }
   holder.mem = FreeImage_OpenMemory();
 
@@ -392,7 +301,7 @@ bool TextureProcessor::BytesToDDS()
   header.D3D9.dwPitchOrLinearSize = header.CalculateMipmapSize();
   FWriteStream s(OutputPath);
   s << header;
-  s.SerializeBytes(InputData, InputDataSize);
+  s.SerializeBytes(const_cast<void*>(InputData), InputDataSize);
   if (!s.IsGood())
   {
     Error = "Texture Processor: failed to save the file!";
@@ -429,7 +338,33 @@ bool TextureProcessor::FileToBytes()
     return false;
   }
 
-  if (!HasAVX2())
+  int32 blockSize = 0;
+  int32 pixelSize = 0;
+  nvtt::Format outFmt = nvtt::Format_Count;
+  if (OutputFormat == TCFormat::DXT1)
+  {
+    blockSize = 8;
+  }
+  else if (OutputFormat == TCFormat::DXT3 || OutputFormat == TCFormat::DXT5)
+  {
+    blockSize = 16;
+  }
+  else if (OutputFormat == TCFormat::ARGB8)
+  {
+    pixelSize = 4;
+  }
+  else if (OutputFormat == TCFormat::G8)
+  {
+    pixelSize = 1;
+  }
+  else
+  {
+    Error = "Texture Processor: Output format \"" + std::to_string((int)OutputFormat) + "\" is not supported!";
+    return false;
+  }
+
+  // NVTT is needed only to compress
+  if (blockSize && !HasAVX2())
   {
     Error = "Texture Processor: Your CPU does not support AVX2 instructions. Please, use DDS format to import the texture.";
     return false;
@@ -438,23 +373,18 @@ bool TextureProcessor::FileToBytes()
   holder.bmp = FreeImage_LoadU(fmt, A2W(InputPath).c_str());
   if (FreeImage_GetBPP(holder.bmp) != 32)
   {
-    holder.bmp = FreeImage_ConvertTo32Bits(holder.bmp);
+    FIBITMAP* bmp32 = FreeImage_ConvertTo32Bits(holder.bmp);
+    FreeImage_Unload(holder.bmp);
+    holder.bmp = bmp32;
   }
 
-  Alpha = FreeImage_IsTransparent(holder.bmp);
-  uint8* data = (uint8*)FreeImage_GetBits(holder.bmp);
-
-  if (!data)
+  if (!holder.bmp || !FreeImage_GetBits(holder.bmp))
   {
     Error = "Texture Processor: FreeImage failed to get bitmap!";
-    FreeImage_Unload(holder.bmp);
     return false;
   }
 
-  nvtt::Surface surface;
-  surface.setWrapMode(AddressModeToNvtt(AddressX));
-  nvtt::Format outFmt = nvtt::Format_Count;
-
+  Alpha = FreeImage_IsTransparent(holder.bmp);
   if (OutputFormat == TCFormat::DXT1)
   {
     outFmt = Alpha ? nvtt::Format_DXT1a : nvtt::Format_DXT1;
@@ -467,43 +397,86 @@ bool TextureProcessor::FileToBytes()
   {
     outFmt = nvtt::Format_DXT5;
   }
-  else if (OutputFormat == TCFormat::ARGB8)
-  {
-    outFmt = nvtt::Format_RGBA;
-  }
   else if (OutputFormat == TCFormat::G8)
   {
-    outFmt = nvtt::Format_RGBA;
     Alpha = false;
   }
 
-  try
+  const int32 minX = 4; // TODO: replace with PF block width & height
+  const int32 minY = minX;
+  if ((int32)FreeImage_GetWidth(holder.bmp) < minX || (int32)FreeImage_GetHeight(holder.bmp) < minY)
+  {
+    Error = "Texture Processor: failed to compress the bitmap. The image is too small!";
+    return false;
+  }
+
+  // BGRA pixels of every mip, top to bottom.
+  // Reserved up front so appending mips doesn't move the first level while it is being read.
+  std::vector<MipGenerator::Level> levels;
+  levels.reserve(TP_MAX_MIP_COUNT);
   {
-    if (!surface.setImage(nvtt::InputFormat_BGRA_8UB, FreeImage_GetWidth(holder.bmp), FreeImage_GetHeight(holder.bmp), 1, data))
+    MipGenerator::Level& level = levels.emplace_back();
+    level.SizeX = FreeImage_GetWidth(holder.bmp);
+    level.SizeY = FreeImage_GetHeight(holder.bmp);
+    level.Pixels.resize(size_t(level.SizeX) * level.SizeY * 4);
+    const size_t rowSize = size_t(level.SizeX) * 4;
+    // FreeImage rows go bottom to top
+    for (int32 y = 0; y < level.SizeY; ++y)
     {
-      Error = "Texture Processor: failed to set a surface.";
-      FreeImage_Unload(holder.bmp);
-      return false;
+      memcpy(level.Pixels.data() + rowSize * y, FreeImage_GetScanLine(holder.bmp, level.SizeY - 1 - y), rowSize);
     }
   }
-  catch (...)
+  FreeImage_Unload(holder.bmp);
+  holder.bmp = nullptr;
+
+  if (GenerateMips)
   {
-    Error = "Texture Processor: NVTT failed to set a surface.";
-    FreeImage_Unload(holder.bmp);
-    return false;
+    MipGenerator generator(MipFilter, AddressX, AddressY);
+    generator.SetSrgb(SRGB && !Normal);
+    generator.SetNormal(Normal);
+    generator.SetAlphaWeighted(Alpha);
+    generator.Build(levels[0].Pixels.data(), levels[0].SizeX, levels[0].SizeY, TP_MAX_MIP_COUNT, levels);
+  }
+
+  // Every mip gets its own final buffer. Encoders write in place and the buffers can be handed over to bulk data as is.
+  for (const MipGenerator::Level& level : levels)
+  {
+    OutputMip& mip = OutputMips.emplace_back();
+    mip.SizeX = level.SizeX;
+    mip.SizeY = level.SizeY;
+    mip.Size = blockSize ? ((level.SizeX + 3) / 4) * ((level.SizeY + 3) / 4) * blockSize : level.SizeX * level.SizeY * pixelSize;
+    if (!(mip.Data = malloc(mip.Size)))
+    {
+      Error = "Texture Processor: failed to allocate " + std::to_string(mip.Size) + " bytes.";
+      ClearOutput();
+      return false;
+    }
   }
+  OutputMipCount = (int32)OutputMips.size();
 
-  if (Normal)
+  if (!blockSize)
   {
-    surface.setNormalMap(true);
+    // A8R8G8B8 matches the BGRA byte order. G8 keeps the red channel.
+    concurrency::parallel_for(size_t(0), levels.size(), [&](size_t idx) {
+      const MipGenerator::Level& level = levels[idx];
+      if (pixelSize == 4)
+      {
+        memcpy(OutputMips[idx].Data, level.Pixels.data(), level.Pixels.size());
+        return;
+      }
+      uint8* dst = (uint8*)OutputMips[idx].Data;
+      const size_t count = size_t(level.SizeX) * level.SizeY;
+      for (size_t pos = 0; pos < count; ++pos)
+      {
+        dst[pos] = level.Pixels[pos * 4 + 2];
+      }
+    });
+    return true;
   }
-  surface.setAlphaMode(Alpha ? nvtt::AlphaMode_Transparency : nvtt::AlphaMode_None);
-  surface.flipY();
-  
 
   nvtt::CompressionOptions compressionOptions;
   compressionOptions.setFormat(outFmt);
-  compressionOptions.setQuality(nvtt::Quality_Production);
+  compressionOptions.setQuality(QualityToNvtt(Quality));
   if (outFmt == nvtt::Format_DXT3)
   {
     compressionOptions.setQuantization(false, true, false);
@@ -512,84 +485,76 @@ bool TextureProcessor::FileToBytes()
   {
     compressionOptions.setQuantization(false, true, true, 127);
   }
-  else if (outFmt == nvtt::Format_RGBA)
+
+  // Blocks don't depend on each other, so every mip is split into full width strips of block rows.
+  // Each strip is compressed separately and lands at its final offset.
+  struct Tile {
+    int32 Mip = 0;
+    int32 Y = 0;
+    int32 SizeY = 0;
+    int32 Offset = 0;
+    int32 Size = 0;
+  };
+  std::vector<Tile> tiles;
+  for (int32 mipIdx = 0; mipIdx < OutputMipCount; ++mipIdx)
   {
-    if (OutputFormat == TCFormat::G8)
-    {
-      compressionOptions.setPixelFormat(8, 0xff, 0, 0, 0);
-    }
-    else
+    const OutputMip& mip = OutputMips[mipIdx];
+    const int32 rowSize = ((mip.SizeX + 3) / 4) * blockSize;
+    for (int32 y = 0; y < mip.SizeY; y += TP_TILE_ROWS)
     {
-      compressionOptions.setPixelFormat(32, 0x00ff0000, 0x0000ff00, 0x000000ff, 0xff000000);
+      Tile& tile = tiles.emplace_back();
+      tile.Mip = mipIdx;
+      tile.Y = y;
+      tile.SizeY = std::min<int32>(TP_TILE_ROWS, mip.SizeY - y);
+      tile.Offset = (y / 4) * rowSize;
+      tile.Size = ((tile.SizeY + 3) / 4) * rowSize;
     }
   }
 
-  TPOutputHandler ohandler;
-  nvtt::OutputOptions outputOptions;
-  outputOptions.setOutputHandler(&ohandler);
-  nvtt::Context context;
-  
-  int32 idx = 0;
-  int32 sizeX = FreeImage_GetWidth(holder.bmp);
-  int32 sizeY = FreeImage_GetHeight(holder.bmp);
-
-  const int32 minX = 4; // TODO: replace with PF block width & height
-  const int32 minY = minX;
-  OutputDataSize = 0;
-
-  if (sizeX < minX || sizeY < minY)
-  {
-    Error = "Texture Processor: failed to compress the bitmap. The image is too small!";
-    return false;
-  }
-
-  while (idx < TPOutputHandler::MaxMipCount)
-  {
-    if (!context.compress(surface, 0, idx, compressionOptions, outputOptions))
+  // Tiles of the largest mip come first and take the longest
+  std::atomic<bool> failed(false);
+  concurrency::parallel_for(size_t(0), tiles.size(), [&](size_t idx) {
+    if (failed)
     {
-      Error = "Texture Processor: failed to compress the bitmap.";
-      return false;
+      return;
     }
-
-    OutputDataSize += ohandler.Mips[idx].Size;
-
-    if (GenerateMips)
+    const Tile& tile = tiles[idx];
+    const MipGenerator::Level& level = levels[tile.Mip];
+    try
     {
-      if (!surface.buildNextMipmap(MipFilterTypeToNvtt(MipFilter)))
+      nvtt::Surface surface;
+      if (!surface.setImage(nvtt::InputFormat_BGRA_8UB, level.SizeX, tile.SizeY, 1, level.Pixels.data() + size_t(level.SizeX) * tile.Y * 4))
+      {
+        failed = true;
+        return;
+      }
+      if (Normal)
+      {
+        surface.setNormalMap(true);
+      }
+      surface.setAlphaMode(Alpha ? nvtt::AlphaMode_Transparency : nvtt::AlphaMode_None);
+
+      TPTileOutputHandler handler((uint8*)OutputMips[tile.Mip].Data + tile.Offset, tile.Size);
+      nvtt::OutputOptions outputOptions;
+      outputOptions.setOutputHandler(&handler);
+      nvtt::Context context;
+      if (!context.compress(surface, 0, 0, compressionOptions, outputOptions) || !handler.Ok || handler.Offset != tile.Size)
       {
-        break;
+        failed = true;
       }
-      sizeX = surface.width();
-      sizeY = surface.height();
-      idx++;
     }
-    else
+    catch (...)
     {
-      break;
+      failed = true;
     }
-  }
+  });
 
-  if (!(OutputMipCount = ohandler.MipsCount))
+  if (failed)
   {
-    Error = "Texture Processor: failed to compress the bitmap. No mipmaps were generated.";
+    Error = "Texture Processor: failed to compress the bitmap.";
+    ClearOutput();
     return false;
   }
-  if (!OutputDataSize)
-  {
-    Error = "Texture Processor: NVTT encoding error!";
-    return false;
-  }
-
-  OutputData = malloc(OutputDataSize);
-  
-  int32 offset = 0;
-  for (int32 idx = 0; idx < OutputMipCount; ++idx)
-  {
-    TPOutputHandler::Mip& mip = ohandler.Mips[idx];
-    memcpy((uint8*)OutputData + offset, mip.Data, mip.Size);
-    OutputMips.push_back({mip.SizeX, mip.SizeY, mip.Size, (uint8*)OutputData + offset });
-    offset += ohandler.Mips[idx].Size;
-  }
   return true;
 }
 
@@ -657,11 +622,10 @@ bool TextureProcessor::DDSToBytes()
     return false;
   }
 
-  OutputData = malloc(mipSize);
-  s.SerializeBytes(OutputData, mipSize);
-  OutputDataSize = mipSize;
+  ClearOutput();
+  void* data = malloc(mipSize);
+  s.SerializeBytes(data, mipSize);
   OutputMipCount = 1;
-  OutputMips.clear();
-  OutputMips.push_back({header.GetWidth(), header.GetHeight(), OutputDataSize, OutputData});
+  OutputMips.push_back({header.GetWidth(), header.GetHeight(), (int32)mipSize, data});
   return true;
 }
@@ -16,6 +16,13 @@ public:
     DDS
   };
 
+  // Compression quality. Lower tiers trade block precision for speed.
+  enum class TCQuality {
+    Fast = 0,
+    Normal,
+    Production
+  };
+
   TextureProcessor(TCFormat from, TCFormat to)
     : InputFormat(from)
     , OutputFormat(to)
@@ -23,11 +30,11 @@ public:
 
   ~TextureProcessor()
   {
-    free(InputData);
-    free(OutputData);
+    ClearOutput();
   }
 
-  inline void SetInputData(void* data, int32 size)
+  // The data is not copied. It must stay valid until Process returns.
+  inline void SetInputData(const void* data, int32 size)
   {
     if (!data || size <= 0)
     {
@@ -36,13 +43,8 @@ public:
     }
     else
     {
-      if (InputData)
-      {
-        free(InputData);
-      }
-      InputData = malloc(size);
+      InputData = data;
       InputDataSize = size;
-      memcpy(InputData, data, size);
     }
   }
 
@@ -97,6 +99,11 @@ public:
     MipFilter = filter;
   }
 
+  inline void SetQuality(TCQuality quality)
+  {
+    Quality = quality;
+  }
+
   inline bool GetAlpha() const
   {
     return Alpha;
@@ -109,11 +116,12 @@ public:
 
   inline void ClearOutput()
   {
-    if (OutputData)
+    for (OutputMip& mip : OutputMips)
     {
-      free(OutputData);
+      free(mip.Data);
     }
     OutputMips.clear();
+    OutputMipCount = 0;
   }
 
   bool Process();
@@ -130,6 +138,15 @@ public:
     return OutputMips;
   }
 
+  // Hand the encoded mips over to the caller. Every mip is a separate malloc allocation the caller must free.
+  inline std::vector<OutputMip> TakeOutputMips()
+  {
+    std::vector<OutputMip> result = std::move(OutputMips);
+    OutputMips.clear();
+    OutputMipCount = 0;
+    return result;
+  }
+
   TCFormat GetOutputFormat() const
   {
     return OutputFormat;
@@ -146,14 +163,12 @@ private:
   TCFormat InputFormat = TCFormat::None;
   TCFormat OutputFormat = TCFormat::None;
 
-  void* InputData = nullptr;
+  const void* InputData = nullptr;
   int32 InputDataSize = 0;
   int32 InputDataSizeX = 0;
   int32 InputDataSizeY = 0;
   std::string InputPath;
 
-  void* OutputData = nullptr;
-  int32 OutputDataSize = 0;
   int32 OutputMipCount = 0;
 
   std::vector<OutputMip> OutputMips;
@@ -166,6 +181,7 @@ private:
   bool GenerateMips = false;
 
   MipFilterType MipFilter = MipFilterType::Mitchell;
+  TCQuality Quality = TCQuality::Production;
 
   TextureAddress AddressX = TA_Wrap;
   TextureAddress AddressY = TA_Wrap;
@@ -4,6 +4,21 @@
 #include <Tera/FObjectResource.h>
 #include <Tera/UClass.h>
 
+TextureTravaller::~TextureTravaller()
+{
+  if (OwnsData)
+  {
+    free(Data);
+  }
+  for (TMipMap& mip : Mips)
+  {
+    if (mip.OwnsData)
+    {
+      free(mip.Data);
+    }
+  }
+}
+
 void TextureTravaller::SetFormat(EPixelFormat format)
 {
   Format = format;
@@ -36,9 +51,9 @@ void TextureTravaller::SetRawData(void* data, int32 size, bool transferOwnership
   OwnsData = transferOwnership;
 }
 
-void TextureTravaller::AddMipMap(int32 sizeX, int32 sizeY, int32 size, void* data)
+void TextureTravaller::AddMipMap(int32 sizeX, int32 sizeY, int32 size, void* data, bool transferOwnership)
 {
-  Mips.push_back({ sizeX, sizeY, size, data });
+  Mips.push_back({ sizeX, sizeY, size, data, transferOwnership });
 }
 
 std::string TextureTravaller::GetError() const
@@ -139,8 +154,17 @@ bool TextureTravaller::Visit(UTexture2D* texture)
     mip->SizeX = tmip.SizeX;
     mip->SizeY = tmip.SizeY;
 
-    void* data = malloc(tmip.Size);
-    memcpy(data, tmip.Data, tmip.Size);
+    void* data = tmip.Data;
+    if (tmip.OwnsData)
+    {
+      // The bulk data owns the buffer from now on
+      tmip.OwnsData = false;
+    }
+    else
+    {
+      data = malloc(tmip.Size);
+      memcpy(data, tmip.Data, tmip.Size);
+    }
     mip->Data = new FByteBulkData(texture->GetPackage(), BULKDATA_SerializeCompressedLZO, tmip.Size, data, true);
     texture->Mips.push_back(mip);
   }
@@ -5,6 +5,13 @@
 class UTexture2D;
 class TextureTravaller {
 public:
+  TextureTravaller() = default;
+  ~TextureTravaller();
+
+  // Owned mip data would be freed twice
+  TextureTravaller(const TextureTravaller&) = delete;
+  TextureTravaller& operator=(const TextureTravaller&) = delete;
+
   void SetFormat(EPixelFormat format);
   void SetAddressX(TextureAddress x);
   void SetAddressY(TextureAddress y);
@@ -12,7 +19,8 @@ public:
   void SetSRGB(bool srgb);
 
   void SetRawData(void* data, int32 size, bool transferOwnership = false);
-  void AddMipMap(int32 sizeX, int32 sizeY, int32 size, void* data);
+  // With transferOwnership the malloc'ed data is moved to the texture's bulk data as is. Otherwise Visit copies it.
+  void AddMipMap(int32 sizeX, int32 sizeY, int32 size, void* data, bool transferOwnership = false);
 
   std::string GetError() const;
 
@@ -24,6 +32,7 @@ private:
     int32 SizeY = 0;
     int32 Size = 0;
     void* Data = nullptr;
+    bool OwnsData = false;
   };
 
 private:
@@ -5,6 +5,155 @@
 #include <Tera/UTexture.h>
 #include <Tera/UClass.h>
 
+#include <filesystem>
+#include <fstream>
+#include <limits>
+#include <ppl.h>
+
+#define TFC_STORE_INDEX_MAGIC 0x53434654
+#define TFC_STORE_INDEX_VERSION 1
+
+namespace
+{
+  // Per texture state of the parallel passes
+  struct TextureInfo {
+    UTexture2D* Texture = nullptr;
+    // Texture's mips are already stored in a cache. Otherwise mips are in memory.
+    bool Cached = false;
+    FContentHash Key;
+    FString Error;
+  };
+
+  struct PendingMip {
+    int32 MipIndex = 0;
+    std::vector<uint8> Data;
+    int32 ElementCount = 0;
+    uint32 Flags = 0;
+  };
+
+  struct PayloadGroup {
+    FContentHash Key;
+    bool Cached = false;
+    std::vector<UTexture2D*> Textures;
+    std::vector<PendingMip> Pending;
+    FString Error;
+  };
+
+  inline bool IsMipCacheable(const FTexture2DMipMap* mip)
+  {
+    return mip->SizeX > 64 && mip->SizeY > 64;
+  }
+
+  bool ReadCachedMip(FReadStream& rs, const FTexture2DMipMap* mip, std::vector<uint8>& output)
+  {
+    output.resize(mip->Data->GetBulkDataSizeOnDisk());
+    rs.SetPosition(mip->Data->GetBulkDataOffsetInFile());
+    rs.SerializeBytes(output.data(), (FILE_OFFSET)output.size());
+    return rs.IsGood();
+  }
+
+  void HashTexture(TextureInfo& info)
+  {
+    UTexture2D* tex = info.Texture;
+    ContentHasher hasher;
+    hasher.UpdateValue((uint8)info.Cached);
+    hasher.UpdateValue((uint32)tex->Format);
+    hasher.UpdateValue(tex->SizeX);
+    hasher.UpdateValue(tex->SizeY);
+    hasher.UpdateValue((uint32)tex->Mips.size());
+
+    std::unique_ptr<FReadStream> rs;
+    if (info.Cached)
+    {
+      rs = std::make_unique<FReadStream>(FPackage::GetTextureFileCachePath(tex->TextureFileCacheName->String()));
+      if (!rs->IsGood())
+      {
+        info.Error = FString::Sprintf("Failed to open %s", tex->TextureFileCacheName->String().UTF8().c_str());
+        return;
+      }
+    }
+
+    std::vector<uint8> buffer;
+    for (int32 midx = 0; midx < tex->Mips.size(); ++midx)
+    {
+      const FTexture2DMipMap* mip = tex->Mips[midx];
+      hasher.UpdateValue(mip->SizeX);
+      hasher.UpdateValue(mip->SizeY);
+      if (!mip->Data)
+      {
+        continue;
+      }
+      hasher.UpdateValue(mip->Data->ElementCount);
+      if (info.Cached)
+      {
+        if (mip->Data->IsStoredInSeparateFile())
+        {
+          if (!ReadCachedMip(*rs, mip, buffer))
+          {
+            info.Error = FString::Sprintf("Failed to read %s", tex->TextureFileCacheName->String().UTF8().c_str());
+            return;
+          }
+          hasher.Update(buffer.data(), buffer.size());
+        }
+      }
+      else if (const void* data = mip->Data->GetAllocation())
+      {
+        hasher.Update(data, mip->Data->GetBulkDataSize());
+      }
+    }
+    info.Key = hasher.Final();
+  }
+
+  void PreparePayload(PayloadGroup& group)
+  {
+    UTexture2D* tex = group.Textures.front();
+    if (group.Cached)
+    {
+      FReadStream rs(FPackage::GetTextureFileCachePath(tex->TextureFileCacheName->String()));
+      if (!rs.IsGood())
+      {
+        group.Error = FString::Sprintf("Failed to open %s", tex->TextureFileCacheName->String().UTF8().c_str());
+        return;
+      }
+      for (int32 midx = 0; midx < tex->Mips.size(); ++midx)
+      {
+        const FTexture2DMipMap* mip = tex->Mips[midx];
+        if (mip->Data && mip->Data->IsStoredInSeparateFile())
+        {
+          PendingMip& pending = group.Pending.emplace_back();
+          pending.MipIndex = midx;
+          pending.ElementCount = mip->Data->ElementCount;
+          pending.Flags = mip->Data->BulkDataFlags;
+          if (!ReadCachedMip(rs, mip, pending.Data))
+          {
+            group.Error = FString::Sprintf("Failed to read %s", tex->TextureFileCacheName->String().UTF8().c_str());
+            group.Pending.clear();
+            return;
+          }
+        }
+      }
+      return;
+    }
+
+    for (int32 midx = 0; midx < tex->Mips.size(); ++midx)
+    {
+      FTexture2DMipMap* mip = tex->Mips[midx];
+      if (!mip->Data || !IsMipCacheable(mip))
+      {
+        continue;
+      }
+      MWrightStream s(nullptr, 0);
+      s.SerializeCompressed(mip->Data->GetAllocation(), mip->Data->GetBulkDataSize(), COMPRESS_LZO);
+      PendingMip& pending = group.Pending.emplace_back();
+      pending.MipIndex = midx;
+      pending.ElementCount = mip->Data->ElementCount;
+      pending.Flags = (mip->Data->BulkDataFlags & ~BULKDATA_SerializeCompressed) | BULKDATA_SerializeCompressedLZO | BULKDATA_StoreInSeparateFile;
+      const uint8* data = (const uint8*)s.GetAllocation();
+      pending.Data.assign(data, data + s.GetPosition());
+    }
+  }
+}
+
 bool TfcBuilder::AddTexture(UTexture2D* texture)
 {
   if (!texture)
@@ -22,6 +171,77 @@ bool TfcBuilder::AddTexture(UTexture2D* texture)
   return true;
 }
 
+bool TfcBuilder::OpenStore(const FString& tfcPath)
+{
+  Store.clear();
+  BaseOffset = 0;
+  std::error_code err;
+  const uintmax_t fileSize = std::filesystem::file_size(tfcPath.WString(), err);
+  if (err || fileSize > (uintmax_t)std::numeric_limits<FILE_OFFSET>::max())
+  {
+    // Mip offsets are 32-bit. Nothing can be appended to a larger cache.
+    if (!err)
+    {
+      LogW("TFC store %s is too large to append to. Building a new cache.", tfcPath.UTF8().c_str());
+    }
+    return false;
+  }
+  FILE_OFFSET tfcSize = 0;
+  {
+    FReadStream rs(tfcPath);
+    if (!rs.IsGood() || !(tfcSize = rs.GetSize()))
+    {
+      return false;
+    }
+  }
+  if (!ReadStoreIndex(tfcPath + ".idx", tfcSize))
+  {
+    Store.clear();
+    return false;
+  }
+  BaseOffset = tfcSize;
+  return true;
+}
+
+bool TfcBuilder::ReadStoreIndex(const FString& indexPath, FILE_OFFSET tfcSize)
+{
+  FReadStream s(indexPath);
+  if (!s.IsGood())
+  {
+    return false;
+  }
+  uint32 magic = 0;
+  uint32 version = 0;
+  FILE_OFFSET indexedSize = 0;
+  uint32 count = 0;
+  s << magic << version << indexedSize << count;
+  if (!s.IsGood() || magic != TFC_STORE_INDEX_MAGIC || version != TFC_STORE_INDEX_VERSION || indexedSize != tfcSize)
+  {
+    LogW("TFC store index %s is outdated. Building a new cache.", indexPath.UTF8().c_str());
+    return false;
+  }
+  Store.reserve(count);
+  for (uint32 idx = 0; idx < count; ++idx)
+  {
+    FContentHash key;
+    std::vector<MipRecord> records;
+    s << key << records;
+    if (!s.IsGood())
+    {
+      return false;
+    }
+    for (const MipRecord& record : records)
+    {
+      if (record.Offset < 0 || record.SizeOnDisk < 0 || record.Offset + record.SizeOnDisk > tfcSize)
+      {
+        return false;
+      }
+    }
+    Store[key] = std::move(records);
+  }
+  return true;
+}
+
 bool TfcBuilder::Compile()
 {
   if (Textures.empty())
@@ -29,7 +249,9 @@ bool TfcBuilder::Compile()
     Error = "Nothing to do!";
     return false;
   }
-  std::map<uint32, std::vector<UTexture2D*>> tfcMap;
+
+  // Loading is not thread safe. Load and filter sequentially, hash in parallel.
+  std::vector<TextureInfo> infos;
   for (UTexture2D* tex : Textures)
   {
     tex->Load();
@@ -37,149 +259,224 @@ bool TfcBuilder::Compile()
     {
       continue;
     }
-    if (uint32 crc = tex->Hash())
+    TextureInfo& info = infos.emplace_back();
+    info.Texture = tex;
+    info.Cached = tex->TextureFileCacheName;
+  }
+
+  concurrency::parallel_for(size_t(0), infos.size(), [&](size_t idx) {
+    HashTexture(infos[idx]);
+  });
+
+  std::vector<PayloadGroup> groups;
+  std::unordered_map<FContentHash, size_t> groupIndices;
+  for (const TextureInfo& info : infos)
+  {
+    if (info.Error.Size())
     {
-      tfcMap[crc].push_back(tex);
+      LogE("%s", info.Error.UTF8().c_str());
+      continue;
     }
-    else
+    auto it = groupIndices.find(info.Key);
+    if (it == groupIndices.end())
     {
-      LogW("Failed to calculate texture hash: %s", tex->GetObjectName().UTF8().c_str());
+      it = groupIndices.emplace(info.Key, groups.size()).first;
+      PayloadGroup& group = groups.emplace_back();
+      group.Key = info.Key;
+      group.Cached = info.Cached;
     }
+    groups[it->second].Textures.push_back(info.Texture);
+  }
+
+  if (groups.empty())
+  {
+    Error = "Failed to calculate texture hashes. Nothing to do!";
+    return false;
   }
 
-  if (tfcMap.empty())
+  // Read or compress payloads of the textures that are not in the store yet
+  concurrency::parallel_for(size_t(0), groups.size(), [&](size_t idx) {
+    if (!Store.count(groups[idx].Key))
+    {
+      PreparePayload(groups[idx]);
+    }
+  });
+
+  // Sequential layout: append new payloads in a stable order
+  free(TfcData);
+  TfcData = nullptr;
+  TfcDataSize = 0;
+  size_t totalSize = 0;
+  for (const PayloadGroup& group : groups)
+  {
+    for (const PendingMip& pending : group.Pending)
+    {
+      totalSize += pending.Data.size();
+    }
+  }
+  if ((uint64)BaseOffset + totalSize > (uint64)std::numeric_limits<FILE_OFFSET>::max())
   {
-    Error = "Failed to calculate CRCs. Nothing to do!";
+    // Bulk data offsets in packages are 32-bit
+    Error = "The texture cache can't be larger than 2 GB! Split the textures between several caches.";
     return false;
   }
+  if (totalSize)
+  {
+    TfcData = malloc(totalSize);
+  }
 
-  MWrightStream s(nullptr, 0);
-  for (const auto& p : tfcMap)
+  bool result = false;
+  for (PayloadGroup& group : groups)
   {
-    UTexture2D* tex = p.second.front();
-    std::map<int32, FILE_OFFSET> offsets;
-    std::map<int32, std::pair<FILE_OFFSET, FILE_OFFSET>> sizes;
-    std::map<int32, uint32> flags;
+    if (group.Error.Size())
+    {
+      LogE("%s", group.Error.UTF8().c_str());
+      continue;
+    }
 
-    if (tex->TextureFileCacheName)
+    auto storeIt = Store.find(group.Key);
+    if (storeIt == Store.end())
     {
-      FReadStream rs(FPackage::GetTextureFileCachePath(tex->TextureFileCacheName->String()));
-      if (rs.IsGood())
+      if (group.Pending.empty())
       {
-        for (int32 midx = 0; midx < tex->Mips.size(); ++midx)
-        {
-          FTexture2DMipMap* mip = tex->Mips[midx];
-          if (mip->Data && mip->Data->IsStoredInSeparateFile())
-          {
-            rs.SetPosition(mip->Data->GetBulkDataOffsetInFile());
-            FILE_OFFSET tmpSize = mip->Data->GetBulkDataSizeOnDisk();
-            void* tmp = malloc(tmpSize);
-            rs.SerializeBytes(tmp, tmpSize);
-            FILE_OFFSET start = s.GetPosition();
-            s.SerializeBytes(tmp, tmpSize);
-            free(tmp);
-            offsets[midx] = start;
-            sizes[midx] = std::make_pair(s.GetPosition() - start, mip->Data->ElementCount);
-            flags[midx] = mip->Data->BulkDataFlags;
-          }
-        }
+        continue;
       }
-      else
+      std::vector<MipRecord> records;
+      for (PendingMip& pending : group.Pending)
       {
-        LogE("Failed to open %s", tex->TextureFileCacheName->String().UTF8().c_str());
+        MipRecord& record = records.emplace_back();
+        record.MipIndex = pending.MipIndex;
+        record.Offset = BaseOffset + TfcDataSize;
+        record.SizeOnDisk = (FILE_OFFSET)pending.Data.size();
+        record.ElementCount = pending.ElementCount;
+        record.Flags = pending.Flags;
+        memcpy((uint8*)TfcData + TfcDataSize, pending.Data.data(), pending.Data.size());
+        TfcDataSize += record.SizeOnDisk;
       }
+      group.Pending.clear();
+      storeIt = Store.emplace(group.Key, std::move(records)).first;
     }
-    else
+
+    const std::vector<MipRecord>& records = storeIt->second;
+    if (records.empty())
+    {
+      continue;
+    }
+    result = true;
+
+    for (UTexture2D* tex : group.Textures)
     {
+      if (!tex->TextureFileCacheName)
+      {
+        tex->TextureFileCacheNameProperty = new FPropertyTag(tex, tex->P_TextureFileCacheName, NAME_NameProperty);
+        tex->TextureFileCacheNameProperty->ClassProperty = tex->GetClass()->GetProperty(tex->P_TextureFileCacheName);
+        tex->TextureFileCacheNameProperty->Value->Type = FPropertyValue::VID::Name;
+        tex->TextureFileCacheNameProperty->Value->Data = new FName(tex->GetPackage(), Name);
+        tex->TextureFileCacheName = tex->TextureFileCacheNameProperty->Value->GetNamePtr();
+        tex->AddProperty(tex->TextureFileCacheNameProperty);
+      }
+
+      if (!tex->FirstResourceMemMipProperty)
+      {
+        tex->FirstResourceMemMipProperty = new FPropertyTag(tex, tex->P_FirstResourceMemMip, NAME_IntProperty);
+        tex->FirstResourceMemMipProperty->ClassProperty = tex->GetClass()->GetProperty(tex->P_FirstResourceMemMip);
+        tex->FirstResourceMemMipProperty->Value->Type = FPropertyValue::VID::Int;
+        tex->FirstResourceMemMipProperty->Value->Data = new int32(records.size());
+        tex->FirstResourceMemMip = tex->FirstResourceMemMipProperty->GetInt();
+        tex->AddProperty(tex->FirstResourceMemMipProperty);
+      }
+      else if (tex->FirstResourceMemMip != records.size())
+      {
+        tex->FirstResourceMemMipProperty->GetInt() = int32(records.size());
+        tex->FirstResourceMemMip = tex->FirstResourceMemMipProperty->GetInt();
+      }
+
+      tex->GetExportObject()->ExportFlags = EF_None;
+      tex->TextureFileCacheName->SetString(Name);
+
+      size_t recordIdx = 0;
       for (int32 midx = 0; midx < tex->Mips.size(); ++midx)
       {
         FTexture2DMipMap* mip = tex->Mips[midx];
-        if (mip->SizeX > 64 && mip->SizeY > 64)
+        if (!mip->Data)
         {
-          FILE_OFFSET start = s.GetPosition();
-          s.SerializeCompressed(mip->Data->GetAllocation(), mip->Data->GetBulkDataSize(), COMPRESS_LZO);
-          mip->Data->BulkDataFlags &= ~BULKDATA_SerializeCompressed;
-          mip->Data->BulkDataFlags |= (BULKDATA_SerializeCompressedLZO | BULKDATA_StoreInSeparateFile);
-
-          offsets[midx] = start;
-          sizes[midx] = std::make_pair(s.GetPosition() - start, mip->Data->ElementCount);
-          flags[midx] = mip->Data->BulkDataFlags;
+          continue;
         }
-        else if (offsets.size())
+        if (recordIdx < records.size() && records[recordIdx].MipIndex == midx)
         {
+          const MipRecord& record = records[recordIdx++];
+          mip->Data->BulkDataOffsetInFile = record.Offset;
+          mip->Data->BulkDataSizeOnDisk = record.SizeOnDisk;
+          mip->Data->ElementCount = record.ElementCount;
+          mip->Data->BulkDataFlags = record.Flags;
+        }
+        else if (!group.Cached && recordIdx)
+        {
+          // Small mips of in-memory textures stay in the package
           mip->Data->BulkDataFlags &= ~(BULKDATA_StoreInSeparateFile | BULKDATA_SerializeCompressed);
           mip->Data->BulkDataFlags |= BULKDATA_SerializeCompressedLZO;
         }
       }
+
+      tex->MarkDirty();
     }
+  }
 
-    if (offsets.size())
+  if (!result)
+  {
+    Error = "Failed to build the texture cache!";
+  }
+  return result;
+}
+
+bool TfcBuilder::Save(const FString& tfcPath)
+{
+  if (TfcData && TfcDataSize)
+  {
+    if (BaseOffset)
     {
-      for (int32 idx = 0; idx < p.second.size(); ++idx)
+      // Append to the store. Truncating the file would invalidate reused payloads.
+      std::fstream s(tfcPath.WString(), std::ios::in | std::ios::out | std::ios::binary);
+      s.seekp(BaseOffset);
+      s.write((const char*)TfcData, TfcDataSize);
+      if (!s.good())
       {
-        UTexture2D* tex = p.second[idx];
-
-        if (!tex->TextureFileCacheName)
-        {
-          tex->TextureFileCacheNameProperty = new FPropertyTag(tex, tex->P_TextureFileCacheName, NAME_NameProperty);
-          tex->TextureFileCacheNameProperty->ClassProperty = tex->GetClass()->GetProperty(tex->P_TextureFileCacheName);
-          tex->TextureFileCacheNameProperty->Value->Type = FPropertyValue::VID::Name;
-          tex->TextureFileCacheNameProperty->Value->Data = new FName(tex->GetPackage(), Name);
-          tex->TextureFileCacheName = tex->TextureFileCacheNameProperty->Value->GetNamePtr();
-          tex->AddProperty(tex->TextureFileCacheNameProperty);
-        }
-
-        if (!tex->FirstResourceMemMipProperty)
-        {
-          tex->FirstResourceMemMipProperty = new FPropertyTag(tex, tex->P_FirstResourceMemMip, NAME_IntProperty);
-          tex->FirstResourceMemMipProperty->ClassProperty = tex->GetClass()->GetProperty(tex->P_FirstResourceMemMip);
-          tex->FirstResourceMemMipProperty->Value->Type = FPropertyValue::VID::Int;
-          tex->FirstResourceMemMipProperty->Value->Data = new int32(offsets.size());
-          tex->FirstResourceMemMip = tex->FirstResourceMemMipProperty->GetInt();
-          tex->AddProperty(tex->FirstResourceMemMipProperty);
-        }
-        else if (tex->FirstResourceMemMip != offsets.size())
-        {
-          tex->FirstResourceMemMipProperty->GetInt() = int32(offsets.size());
-          tex->FirstResourceMemMip = tex->FirstResourceMemMipProperty->GetInt();
-        }
-
-        tex->GetExportObject()->ExportFlags = EF_None;
-        tex->TextureFileCacheName->SetString(Name);
-        for (int32 midx = 0; midx < tex->Mips.size(); ++midx)
-        {
-          FTexture2DMipMap* mip = tex->Mips[midx];
-          if (mip->Data && offsets.count(midx))
-          {
-            mip->Data->BulkDataOffsetInFile = offsets[midx];
-            mip->Data->BulkDataSizeOnDisk = sizes[midx].first;
-            mip->Data->ElementCount = sizes[midx].second;
-          }
-          if (mip->Data && flags.count(midx))
-          {
-            mip->Data->BulkDataFlags = flags[midx];
-          }
-        }
-
-        tex->MarkDirty();
+        Error = "Failed to write " + tfcPath;
+        return false;
+      }
+    }
+    else
+    {
+      FWriteStream s(tfcPath);
+      s.SerializeBytes(TfcData, TfcDataSize);
+      if (!s.IsGood())
+      {
+        Error = "Failed to write " + tfcPath;
+        return false;
       }
     }
   }
-
-  s.GetAllocation();
-  if (TfcData)
+  else if (!BaseOffset)
   {
-    free(TfcData);
-    TfcData = 0;
-    TfcDataSize = 0;
+    Error = "Nothing to save!";
+    return false;
   }
 
-  if (s.GetAllocation() && s.GetPosition())
+  FWriteStream s(tfcPath + ".idx");
+  uint32 magic = TFC_STORE_INDEX_MAGIC;
+  uint32 version = TFC_STORE_INDEX_VERSION;
+  FILE_OFFSET tfcSize = BaseOffset + TfcDataSize;
+  uint32 count = (uint32)Store.size();
+  s << magic << version << tfcSize << count;
+  for (auto& p : Store)
   {
-    TfcDataSize = s.GetPosition();
-    TfcData = malloc(TfcDataSize);
-    memcpy(TfcData, s.GetAllocation(), TfcDataSize);
-    return true;
+    FContentHash key = p.first;
+    s << key << p.second;
   }
-  return false;
+  if (!s.IsGood())
+  {
+    // The cache is fine, but the next build won't be able to reuse it
+    LogW("Failed to write TFC store index %s", (tfcPath + ".idx").UTF8().c_str());
+  }
+  return true;
 }
@@ -1,8 +1,15 @@
 #pragma once
 #include <Tera/Core.h>
 #include <Tera/FString.h>
+#include <Tera/FStream.h>
+#include <Utils/ContentHash.h>
+
+#include <unordered_map>
 
 class UTexture2D;
+// Builds a texture file cache. Textures are deduplicated by a hash of their full content (all mips).
+// An existing cache with its index can be used as a content-addressed store: known payloads are reused
+// and only new ones are appended.
 class TfcBuilder {
 public:
   TfcBuilder(const FString& name)
@@ -14,12 +21,18 @@ public:
     free(TfcData);
   }
 
+  // Bytes produced by the last Compile. They belong at GetBaseOffset() of the cache file.
   inline void* GetAllocation(FILE_OFFSET& size) const
   {
     size = TfcDataSize;
     return TfcData;
   }
 
+  inline FILE_OFFSET GetBaseOffset() const
+  {
+    return BaseOffset;
+  }
+
   inline FString GetError() const
   {
     return Error;
@@ -31,12 +44,39 @@ public:
   }
 
   bool AddTexture(UTexture2D* texture);
+
+  // Use an existing cache at the path and its index as a store. Returns false if the cache or its index
+  // are missing or don't match; Compile builds a new cache in that case.
+  bool OpenStore(const FString& tfcPath);
+
   bool Compile();
 
+  // Write new payloads to the cache at the path (append to the store or create a new file) and update its index
+  bool Save(const FString& tfcPath);
+
+private:
+  struct MipRecord {
+    int32 MipIndex = 0;
+    FILE_OFFSET Offset = 0;
+    FILE_OFFSET SizeOnDisk = 0;
+    int32 ElementCount = 0;
+    uint32 Flags = 0;
+
+    friend FStream& operator<<(FStream& s, MipRecord& r)
+    {
+      return s << r.MipIndex << r.Offset << r.SizeOnDisk << r.ElementCount << r.Flags;
+    }
+  };
+
+  bool ReadStoreIndex(const FString& indexPath, FILE_OFFSET tfcSize);
+
 private:
   FString Name;
   void* TfcData = nullptr;
   FILE_OFFSET TfcDataSize = 0;
+  FILE_OFFSET BaseOffset = 0;
   std::vector<UTexture2D*> Textures;
+  // Content hash -> mips stored in the cache
+  std::unordered_map<FContentHash, std::vector<MipRecord>> Store;
   FString Error;
-};
\ No newline at end of file
+};
@@ -0,0 +1,452 @@
+#include "VertexDecoder.h"
+#include <Utils/ALog.h>
+
+#include <Tera/UStaticMesh.h>
+#include <Tera/USkeletalMesh.h>
+
+#include <algorithm>
+#include <cstring>
+#include <ppl.h>
+#include <type_traits>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#define VERTEX_DECODER_SSE2 1
+#include <emmintrin.h>
+#endif
+
+// Meshes with fewer vertices are decoded on the calling thread
+#define VERTEX_DECODER_PARALLEL_MIN_VERTICES 16384
+// Number of vertices per parallel task
+#define VERTEX_DECODER_BATCH_SIZE 4096
+
+static_assert(sizeof(FVector) == sizeof(float) * 3, "Kernels write FVector arrays as packed floats");
+static_assert(sizeof(FVector2D) == sizeof(float) * 2, "Kernels write FVector2D arrays as packed floats");
+
+namespace
+{
+  inline uint32 Read32(const uint8* ptr)
+  {
+    uint32 v;
+    memcpy(&v, ptr, 4);
+    return v;
+  }
+
+#ifdef VERTEX_DECODER_SSE2
+  inline __m128i Gather4(const uint8* src, size_t stride)
+  {
+    return _mm_setr_epi32(int(Read32(src)), int(Read32(src + stride)), int(Read32(src + stride * 2)), int(Read32(src + stride * 3)));
+  }
+
+  // Interleave 4 vectors held as one component per register
+  inline void Store4(const __m128& x, const __m128& y, const __m128& z, FVector* dst)
+  {
+    const __m128 xy01 = _mm_unpacklo_ps(x, y);
+    const __m128 xy23 = _mm_unpackhi_ps(x, y);
+    const __m128 yz01 = _mm_unpacklo_ps(y, z);
+    const __m128 yz23 = _mm_unpackhi_ps(y, z);
+    const __m128 zx01 = _mm_unpacklo_ps(z, x);
+    const __m128 zx23 = _mm_unpackhi_ps(z, x);
+    float* out = (float*)dst;
+    _mm_storeu_ps(out, _mm_shuffle_ps(xy01, zx01, _MM_SHUFFLE(3, 0, 1, 0)));
+    _mm_storeu_ps(out + 4, _mm_shuffle_ps(yz01, xy23, _MM_SHUFFLE(1, 0, 3, 2)));
+    _mm_storeu_ps(out + 8, _mm_shuffle_ps(zx23, yz23, _MM_SHUFFLE(3, 2, 3, 0)));
+  }
+
+  // Same math as FPackedNormal::operator FVector
+  inline void UnpackNormals(const __m128i& packed, __m128& x, __m128& y, __m128& z)
+  {
+    const __m128i mask = _mm_set1_epi32(0xFF);
+    const __m128 scale = _mm_set1_ps((float)(1. / 127.5));
+    const __m128 bias = _mm_set1_ps(-1.f);
+    x = _mm_add_ps(_mm_mul_ps(_mm_cvtepi32_ps(_mm_and_si128(packed, mask)), scale), bias);
+    y = _mm_add_ps(_mm_mul_ps(_mm_cvtepi32_ps(_mm_and_si128(_mm_srli_epi32(packed, 8), mask)), scale), bias);
+    z = _mm_add_ps(_mm_mul_ps(_mm_cvtepi32_ps(_mm_and_si128(_mm_srli_epi32(packed, 16), mask)), scale), bias);
+  }
+
+  // Same rules as FFloat16::GetFloat: zero exponents flush to zero, infinities and NaNs clamp to the max exponent.
+  inline __m128i HalfToFloat(const __m128i& half)
+  {
+    const __m128i sign = _mm_slli_epi32(_mm_and_si128(half, _mm_set1_epi32(0x8000)), 16);
+    const __m128i exponent = _mm_and_si128(half, _mm_set1_epi32(0x7C00));
+    const __m128i normal = _mm_add_epi32(_mm_slli_epi32(_mm_and_si128(half, _mm_set1_epi32(0x7FFF)), 13), _mm_set1_epi32((127 - 15) << 23));
+    const __m128i zero = _mm_cmpeq_epi32(exponent, _mm_setzero_si128());
+    const __m128i special = _mm_cmpeq_epi32(exponent, _mm_set1_epi32(0x7C00));
+    __m128i result = _mm_andnot_si128(zero, normal);
+    result = _mm_or_si128(_mm_andnot_si128(special, result), _mm_and_si128(special, _mm_set1_epi32((142 << 23) | 8380416)));
+    return _mm_or_si128(result, sign);
+  }
+#endif
+
+  inline void DecodeUVs(const FVector2DHalf* src, size_t srcStride, size_t count, FVector2D* dst)
+  {
+    VertexDecoder::DecodeHalfUVs(src, srcStride, count, dst);
+  }
+
+  inline void DecodeUVs(const FVector2D* src, size_t srcStride, size_t count, FVector2D* dst)
+  {
+    VertexDecoder::Gather(src, srcStride, count, dst);
+  }
+
+  template <typename TVertex>
+  void DecodeStaticRange(const FStaticMeshRenderData* lod, const TVertex* vertices, size_t first, size_t count, VertexDecoder::Streams& output)
+  {
+    const TVertex* v = vertices + first;
+    std::copy_n(lod->PositionBuffer.Data + first, count, &output.Positions[first]);
+    VertexDecoder::DecodeNormals(&v->TangentX, sizeof(TVertex), count, &output.TangentsX[first]);
+    VertexDecoder::DecodeBinormals(&v->TangentX, &v->TangentZ, sizeof(TVertex), count, &output.TangentsY[first]);
+    VertexDecoder::DecodeNormals(&v->TangentZ, sizeof(TVertex), count, &output.TangentsZ[first]);
+    for (uint32 uvIdx = 0; uvIdx < output.NumUVs; ++uvIdx)
+    {
+      DecodeUVs(&v->UV[uvIdx], sizeof(TVertex), count, &output.UVs[uvIdx][first]);
+    }
+    if (output.Colors.size())
+    {
+      std::copy_n(lod->ColorBuffer.Data + first, count, &output.Colors[first]);
+    }
+  }
+
+  // Call func with the vertex buffer cast to its actual vertex type
+  template <template <uint32> typename TVertex, typename TBase, typename F>
+  void DispatchNumUVs(const TBase* data, uint32 numUVs, F&& func)
+  {
+    switch (numUVs)
+    {
+    case 1: func((const TVertex<1>*)data); break;
+    case 2: func((const TVertex<2>*)data); break;
+    case 3: func((const TVertex<3>*)data); break;
+    case 4: func((const TVertex<4>*)data); break;
+    }
+  }
+
+  template <typename TSkinVertex>
+  void DecodeSkinVertices(const std::vector<TSkinVertex>& vertices, const std::vector<uint16>& boneMap, size_t first, VertexDecoder::Streams& output)
+  {
+    if (vertices.empty())
+    {
+      return;
+    }
+    const size_t count = vertices.size();
+    const TSkinVertex* v = vertices.data();
+    VertexDecoder::Gather(&v->Position, sizeof(TSkinVertex), count, &output.Positions[first]);
+    VertexDecoder::DecodeNormals(&v->TangentX, sizeof(TSkinVertex), count, &output.TangentsX[first]);
+    VertexDecoder::DecodeNormals(&v->TangentY, sizeof(TSkinVertex), count, &output.TangentsY[first]);
+    VertexDecoder::DecodeNormals(&v->TangentZ, sizeof(TSkinVertex), count, &output.TangentsZ[first]);
+    for (uint32 uvIdx = 0; uvIdx < output.NumUVs; ++uvIdx)
+    {
+      VertexDecoder::Gather(&v->UVs[uvIdx], sizeof(TSkinVertex), count, &output.UVs[uvIdx][first]);
+    }
+
+    uint16* bones = &output.Bones[first * MAX_INFLUENCES];
+    uint8* weights = &output.Weights[first * MAX_INFLUENCES];
+    auto remap = [&](uint8 bone) -> uint16 {
+      return bone < boneMap.size() ? boneMap[bone] : 0;
+    };
+    for (size_t idx = 0; idx < count; ++idx, bones += MAX_INFLUENCES, weights += MAX_INFLUENCES)
+    {
+      if constexpr (std::is_same_v<TSkinVertex, FRigidSkinVertex>)
+      {
+        bones[0] = remap(v[idx].Bone);
+        weights[0] = 0xFF;
+        for (int32 influence = 1; influence < MAX_INFLUENCES; ++influence)
+        {
+          bones[influence] = 0;
+          weights[influence] = 0;
+        }
+      }
+      else
+      {
+        for (int32 influence = 0; influence < MAX_INFLUENCES; ++influence)
+        {
+          bones[influence] = remap(v[idx].InfluenceBones[influence]);
+          weights[influence] = v[idx].InfluenceWeights[influence];
+        }
+      }
+    }
+  }
+
+  inline void DecodeGPUSkinPositions(const FVector* src, size_t srcStride, size_t count, const FSkeletalMeshVertexBuffer&, FVector* dst)
+  {
+    VertexDecoder::Gather(src, srcStride, count, dst);
+  }
+
+  inline void DecodeGPUSkinPositions(const FPackedPosition* src, size_t srcStride, size_t count, const FSkeletalMeshVertexBuffer& buffer, FVector* dst)
+  {
+    VertexDecoder::DecodePackedPositions(src, srcStride, count, dst);
+    const FVector& scale = buffer.MeshExtension;
+    const FVector& origin = buffer.MeshOrigin;
+    for (size_t idx = 0; idx < count; ++idx)
+    {
+      FVector& position = dst[idx];
+      position = FVector(position.X * scale.X + origin.X, position.Y * scale.Y + origin.Y, position.Z * scale.Z + origin.Z);
+    }
+  }
+
+  template <typename TVertex>
+  void DecodeGPUSkinVertices(const FSkeletalMeshVertexBuffer& buffer, const TVertex* v, const std::vector<FSkelMeshChunk>& chunks, VertexDecoder::Streams& output)
+  {
+    const size_t count = output.NumVertices;
+    DecodeGPUSkinPositions(&v->Position, sizeof(TVertex), count, buffer, output.Positions.data());
+    VertexDecoder::DecodeNormals(&v->TangentX, sizeof(TVertex), count, output.TangentsX.data());
+    VertexDecoder::DecodeBinormals(&v->TangentX, &v->TangentZ, sizeof(TVertex), count, output.TangentsY.data());
+    VertexDecoder::DecodeNormals(&v->TangentZ, sizeof(TVertex), count, output.TangentsZ.data());
+    for (uint32 uvIdx = 0; uvIdx < output.NumUVs; ++uvIdx)
+    {
+      DecodeUVs(&v->UV[uvIdx], sizeof(TVertex), count, output.UVs[uvIdx].data());
+    }
+
+    // Bone indices are local to the chunk of the vertex
+    for (const FSkelMeshChunk& chunk : chunks)
+    {
+      const size_t last = std::min<size_t>((size_t)chunk.BaseVertexIndex + chunk.NumRigidVertices + chunk.NumSoftVertices, count);
+      for (size_t idx = chunk.BaseVertexIndex; idx < last; ++idx)
+      {
+        for (int32 influence = 0; influence < MAX_INFLUENCES; ++influence)
+        {
+          const uint8 bone = v[idx].BoneIndex[influence];
+          output.Bones[idx * MAX_INFLUENCES + influence] = bone < chunk.BoneMap.size() ? chunk.BoneMap[bone] : 0;
+          output.Weights[idx * MAX_INFLUENCES + influence] = v[idx].BoneWeight[influence];
+        }
+      }
+    }
+  }
+
+  void Resize(VertexDecoder::Streams& output, uint32 numVertices, uint32 numUVs, bool colors, bool skin)
+  {
+    output.NumVertices = numVertices;
+    output.NumUVs = numVertices ? numUVs : 0;
+    output.Positions.resize(numVertices);
+    output.TangentsX.resize(numVertices);
+    output.TangentsY.resize(numVertices);
+    output.TangentsZ.resize(numVertices);
+    for (uint32 uvIdx = 0; uvIdx < MAX_TEXCOORDS; ++uvIdx)
+    {
+      output.UVs[uvIdx].resize(uvIdx < output.NumUVs ? numVertices : 0);
+    }
+    output.Colors.resize(colors ? numVertices : 0);
+    output.Bones.resize(skin ? numVertices * MAX_INFLUENCES : 0);
+    output.Weights.resize(skin ? numVertices * MAX_INFLUENCES : 0);
+  }
+}
+
+void VertexDecoder::DecodeNormals(const FPackedNormal* src, size_t srcStride, size_t count, FVector* dst)
+{
+  const uint8* ptr = (const uint8*)src;
+  size_t idx = 0;
+#ifdef VERTEX_DECODER_SSE2
+  for (; idx + 4 <= count; idx += 4, ptr += srcStride * 4)
+  {
+    __m128 x, y, z;
+    UnpackNormals(Gather4(ptr, srcStride), x, y, z);
+    Store4(x, y, z, dst + idx);
+  }
+#endif
+  for (; idx < count; ++idx, ptr += srcStride)
+  {
+    dst[idx] = *(const FPackedNormal*)ptr;
+  }
+}
+
+void VertexDecoder::DecodeBinormals(const FPackedNormal* tangents, const FPackedNormal* normals, size_t srcStride, size_t count, FVector* dst)
+{
+  const uint8* tangentPtr = (const uint8*)tangents;
+  const uint8* normalPtr = (const uint8*)normals;
+  size_t idx = 0;
+#ifdef VERTEX_DECODER_SSE2
+  for (; idx + 4 <= count; idx += 4, tangentPtr += srcStride * 4, normalPtr += srcStride * 4)
+  {
+    __m128 tx, ty, tz, nx, ny, nz;
+    UnpackNormals(Gather4(tangentPtr, srcStride), tx, ty, tz);
+    const __m128i packedNormals = Gather4(normalPtr, srcStride);
+    UnpackNormals(packedNormals, nx, ny, nz);
+    // Same operation order as FStaticMeshVertexBase::GetTangentY
+    const __m128 sign = _mm_sub_ps(_mm_div_ps(_mm_cvtepi32_ps(_mm_srli_epi32(packedNormals, 24)), _mm_set1_ps(127.5f)), _mm_set1_ps(1.f));
+    const __m128 x = _mm_sub_ps(_mm_mul_ps(ny, tz), _mm_mul_ps(nz, ty));
+    const __m128 y = _mm_sub_ps(_mm_mul_ps(nz, tx), _mm_mul_ps(nx, tz));
+    const __m128 z = _mm_sub_ps(_mm_mul_ps(nx, ty), _mm_mul_ps(ny, tx));
+    Store4(_mm_mul_ps(x, sign), _mm_mul_ps(y, sign), _mm_mul_ps(z, sign), dst + idx);
+  }
+#endif
+  for (; idx < count; ++idx, tangentPtr += srcStride, normalPtr += srcStride)
+  {
+    const FPackedNormal& normal = *(const FPackedNormal*)normalPtr;
+    dst[idx] = (FVector(normal) ^ FVector(*(const FPackedNormal*)tangentPtr)) * ((float)normal.Vector.W / 127.5f - 1.0f);
+  }
+}
+
+void VertexDecoder::DecodeHalfUVs(const FVector2DHalf* src, size_t srcStride, size_t count, FVector2D* dst)
+{
+  const uint8* ptr = (const uint8*)src;
+  size_t idx = 0;
+#ifdef VERTEX_DECODER_SSE2
+  // Debug builds keep the float value next to the packed half
+  if constexpr (sizeof(FVector2DHalf) == sizeof(uint32))
+  {
+    for (; idx + 4 <= count; idx += 4, ptr += srcStride * 4)
+    {
+      const __m128i packed = Gather4(ptr, srcStride);
+      const __m128i u = HalfToFloat(_mm_and_si128(packed, _mm_set1_epi32(0xFFFF)));
+      const __m128i v = HalfToFloat(_mm_srli_epi32(packed, 16));
+      float* out = (float*)(dst + idx);
+      _mm_storeu_si128((__m128i*)out, _mm_unpacklo_epi32(u, v));
+      _mm_storeu_si128((__m128i*)(out + 4), _mm_unpackhi_epi32(u, v));
+    }
+  }
+#endif
+  for (; idx < count; ++idx, ptr += srcStride)
+  {
+    dst[idx] = *(const FVector2DHalf*)ptr;
+  }
+}
+
+void VertexDecoder::DecodePackedPositions(const FPackedPosition* src, size_t srcStride, size_t count, FVector* dst)
+{
+  const uint8* ptr = (const uint8*)src;
+  size_t idx = 0;
+#ifdef VERTEX_DECODER_SSE2
+  const __m128 xyScale = _mm_set1_ps(1023.f);
+  const __m128 zScale = _mm_set1_ps(511.f);
+  for (; idx + 4 <= count; idx += 4, ptr += srcStride * 4)
+  {
+    // Sign extend the 11:11:10 bit fields
+    const __m128i packed = Gather4(ptr, srcStride);
+    const __m128 x = _mm_div_ps(_mm_cvtepi32_ps(_mm_srai_epi32(_mm_slli_epi32(packed, 21), 21)), xyScale);
+    const __m128 y = _mm_div_ps(_mm_cvtepi32_ps(_mm_srai_epi32(_mm_slli_epi32(packed, 10), 21)), xyScale);
+    const __m128 z = _mm_div_ps(_mm_cvtepi32_ps(_mm_srai_epi32(packed, 22)), zScale);
+    Store4(x, y, z, dst + idx);
+  }
+#endif
+  for (; idx < count; ++idx, ptr += srcStride)
+  {
+    dst[idx] = *(const FPackedPosition*)ptr;
+  }
+}
+
+bool VertexDecoder::Decode(const FStaticMeshRenderData* lod, Streams& output)
+{
+  if (!lod || !lod->PositionBuffer.Data || !lod->VertexBuffer.Data)
+  {
+    Resize(output, 0, 0, false, false);
+    return false;
+  }
+  const FStaticMeshVertexBuffer& buffer = lod->VertexBuffer;
+  if (!buffer.NumTexCoords || buffer.NumTexCoords > MAX_TEXCOORDS)
+  {
+    // The vertex stride depends on the number of UVs. Any other count would read garbage.
+    LogE("VertexDecoder: unsupported number of UV channels: %u", buffer.NumTexCoords);
+    Resize(output, 0, 0, false, false);
+    return false;
+  }
+  const bool colors = lod->ColorBuffer.Data && lod->ColorBuffer.ElementCount >= lod->NumVertices;
+  Resize(output, lod->NumVertices, buffer.NumTexCoords, colors, false);
+
+  auto decode = [&](auto* vertices) {
+    const size_t numVertices = output.NumVertices;
+    if (numVertices < VERTEX_DECODER_PARALLEL_MIN_VERTICES)
+    {
+      DecodeStaticRange(lod, vertices, 0, numVertices, output);
+      return;
+    }
+    const size_t numBatches = (numVertices + VERTEX_DECODER_BATCH_SIZE - 1) / VERTEX_DECODER_BATCH_SIZE;
+    concurrency::parallel_for(size_t(0), numBatches, [&](size_t batch) {
+      const size_t first = batch * VERTEX_DECODER_BATCH_SIZE;
+      DecodeStaticRange(lod, vertices, first, std::min<size_t>(VERTEX_DECODER_BATCH_SIZE, numVertices - first), output);
+    });
+  };
+
+  if (buffer.bUseFullPrecisionUVs)
+  {
+    DispatchNumUVs<FStaticMeshVertexAA>(buffer.Data, output.NumUVs, decode);
+  }
+  else
+  {
+    DispatchNumUVs<FStaticMeshVertexA>(buffer.Data, output.NumUVs, decode);
+  }
+  return true;
+}
+
+bool VertexDecoder::Decode(const FStaticLODModel* lod, Streams& output)
+{
+  if (!lod)
+  {
+    Resize(output, 0, 0, false, false);
+    return false;
+  }
+  const std::vector<FSkelMeshChunk>& chunks = lod->GetChunks();
+  std::vector<size_t> offsets(chunks.size());
+  size_t numVertices = 0;
+  for (size_t idx = 0; idx < chunks.size(); ++idx)
+  {
+    offsets[idx] = numVertices;
+    numVertices += chunks[idx].RigidVertices.size() + chunks[idx].SoftVertices.size();
+  }
+  if (numVertices != lod->GetNumVertices() && lod->GetGPUSkinVertexBuffer().ElementCount == lod->GetNumVertices())
+  {
+    // Chunks without their vertices. The GPU buffer has them all.
+    return DecodeGPUSkin(lod, output);
+  }
+  Resize(output, (uint32)numVertices, std::clamp<int32>(lod->GetNumTexCoords(), 1, MAX_TEXCOORDS), false, true);
+
+  auto decodeChunk = [&](size_t idx) {
+    const FSkelMeshChunk& chunk = chunks[idx];
+    DecodeSkinVertices(chunk.RigidVertices, chunk.BoneMap, offsets[idx], output);
+    DecodeSkinVertices(chunk.SoftVertices, chunk.BoneMap, offsets[idx] + chunk.RigidVertices.size(), output);
+  };
+  if (numVertices >= VERTEX_DECODER_PARALLEL_MIN_VERTICES && chunks.size() > 1)
+  {
+    concurrency::parallel_for(size_t(0), chunks.size(), decodeChunk);
+  }
+  else
+  {
+    for (size_t idx = 0; idx < chunks.size(); ++idx)
+    {
+      decodeChunk(idx);
+    }
+  }
+  return true;
+}
+
+bool VertexDecoder::DecodeGPUSkin(const FStaticLODModel* lod, Streams& output)
+{
+  const FSkeletalMeshVertexBuffer* buffer = lod ? &lod->GetGPUSkinVertexBuffer() : nullptr;
+  if (!buffer || !buffer->Data || !buffer->ElementCount)
+  {
+    Resize(output, 0, 0, false, false);
+    return false;
+  }
+  if (!buffer->NumTexCoords || buffer->NumTexCoords > MAX_TEXCOORDS)
+  {
+    // The vertex stride depends on the number of UVs
+    LogE("VertexDecoder: unsupported number of UV channels: %u", buffer->NumTexCoords);
+    Resize(output, 0, 0, false, false);
+    return false;
+  }
+  Resize(output, buffer->ElementCount, buffer->NumTexCoords, false, true);
+
+  auto decode = [&](auto* vertices) {
+    DecodeGPUSkinVertices(*buffer, vertices, lod->GetChunks(), output);
+  };
+  // Same vertex types as the buffer serialization
+#if ENABLE_PACKED_VERTEX_POSITION
+  if (buffer->bUsePackedPosition)
+  {
+    if (buffer->bUseFullPrecisionUVs)
+    {
+      DispatchNumUVs<FGPUSkinVertexFloatAAB>(buffer->Data, output.NumUVs, decode);
+    }
+    else
+    {
+      DispatchNumUVs<FGPUSkinVertexFloatAB>(buffer->Data, output.NumUVs, decode);
+    }
+    return true;
+  }
+#endif
+  if (buffer->bUseFullPrecisionUVs)
+  {
+    DispatchNumUVs<FGPUSkinVertexFloatAABB>(buffer->Data, output.NumUVs, decode);
+  }
+  else
+  {
+    DispatchNumUVs<FGPUSkinVertexFloatABB>(buffer->Data, output.NumUVs, decode);
+  }
+  return true;
+}
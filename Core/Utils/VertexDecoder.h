@@ -0,0 +1,55 @@
+#pragma once
+#include <Tera/Core.h>
+#include <Tera/FStructs.h>
+
+#include <vector>
+
+class FStaticMeshRenderData;
+class FStaticLODModel;
+
+// Unpacks vertex attributes to float arrays.
+// Kernels read packed values srcStride bytes apart, so they can walk interleaved vertex buffers in place, and write
+// to caller-provided arrays. SSE2 and scalar paths produce identical results to the FStructs conversion operators.
+class VertexDecoder {
+public:
+  // One array per attribute. Reuse the same instance to avoid reallocations.
+  struct Streams {
+    uint32 NumVertices = 0;
+    uint32 NumUVs = 0;
+    std::vector<FVector> Positions;
+    std::vector<FVector> TangentsX; // Tangent
+    std::vector<FVector> TangentsY; // Binormal
+    std::vector<FVector> TangentsZ; // Normal
+    std::vector<FVector2D> UVs[MAX_TEXCOORDS];
+    // Empty if the mesh has no vertex colors
+    std::vector<FColor> Colors;
+    // Skeletal meshes only. MAX_INFLUENCES per vertex. Bones are indices in the reference skeleton.
+    std::vector<uint16> Bones;
+    std::vector<uint8> Weights;
+  };
+
+  // Decode all vertices of a LOD. Skeletal vertices are ordered by chunk: rigid vertices first, then soft ones.
+  // Returns false and leaves the output empty if the LOD is missing or static vertices have 0 or more than
+  // MAX_TEXCOORDS UV channels.
+  static bool Decode(const FStaticMeshRenderData* lod, Streams& output);
+  static bool Decode(const FStaticLODModel* lod, Streams& output);
+  // Decode the GPU skin vertex buffer of a skeletal LOD. Decode falls back to it if the chunks don't hold the vertices.
+  static bool DecodeGPUSkin(const FStaticLODModel* lod, Streams& output);
+
+  static void DecodeNormals(const FPackedNormal* src, size_t srcStride, size_t count, FVector* dst);
+  // Binormals from tangents and normals. The binormal sign is stored in the normal's W.
+  static void DecodeBinormals(const FPackedNormal* tangents, const FPackedNormal* normals, size_t srcStride, size_t count, FVector* dst);
+  static void DecodeHalfUVs(const FVector2DHalf* src, size_t srcStride, size_t count, FVector2D* dst);
+  // Positions in -1..1. GPU skin vertices scale them by the mesh extension and offset by the mesh origin.
+  static void DecodePackedPositions(const FPackedPosition* src, size_t srcStride, size_t count, FVector* dst);
+  // Strided copy of unpacked values
+  template <typename T>
+  static void Gather(const T* src, size_t srcStride, size_t count, T* dst)
+  {
+    const uint8* ptr = (const uint8*)src;
+    for (size_t idx = 0; idx < count; ++idx, ptr += srcStride)
+    {
+      dst[idx] = *(const T*)ptr;
+    }
+  }
+};